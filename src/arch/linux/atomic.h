@@ -0,0 +1,54 @@
+/*
+ * atomic.h
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef ATOMIC_H_
+#define ATOMIC_H_
+
+/*
+ * Atomic memory access primitives.
+ * Loads use acquire semantics, stores use release semantics and
+ * read-modify-write operations are sequentially consistent.
+ */
+
+#define BX_ATOMIC_LOAD(pointer) __atomic_load_n(pointer, __ATOMIC_ACQUIRE)
+
+#define BX_ATOMIC_STORE(pointer, value) __atomic_store_n(pointer, value, __ATOMIC_RELEASE)
+
+#define BX_ATOMIC_EXCHANGE(pointer, value) __atomic_exchange_n(pointer, value, __ATOMIC_SEQ_CST)
+
+#define BX_ATOMIC_ADD(pointer, value) __atomic_add_fetch(pointer, value, __ATOMIC_SEQ_CST)
+
+#define BX_ATOMIC_SUB(pointer, value) __atomic_sub_fetch(pointer, value, __ATOMIC_SEQ_CST)
+
+#define BX_ATOMIC_COMPARE_EXCHANGE(pointer, expected_pointer, desired) \
+	__atomic_compare_exchange_n(pointer, expected_pointer, desired, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+
+#endif /* ATOMIC_H_ */
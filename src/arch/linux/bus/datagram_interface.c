@@ -0,0 +1,600 @@
+/*
+ * datagram_interface.c
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "atomic.h"
+#include "compile_assert.h"
+#include "configuration.h"
+#include "logging.h"
+#include "bus/bus.h"
+#include "bus/datagram_interface.h"
+
+struct bx_dgram_data {
+	int fd;
+	int epoll_fd;
+	int wake_fd; ///< Wakes the receiving thread to flush or stop
+	pthread_t thread;
+	pthread_mutex_t mutex; ///< Protects the outgoing batch and the peers
+	struct bx_dgram_endpoint local;
+	struct bx_dgram_endpoint peers[BS_MAX_PEERS];
+	bx_size peer_number;
+	struct bx_dgram_endpoint out_endpoints[BS_BATCH_SIZE];
+	bx_uint8 out_data[BS_BATCH_SIZE][BS_MAX_MESSAGE_SIZE];
+	bx_size out_length[BS_BATCH_SIZE];
+	bx_uint64 out_time[BS_BATCH_SIZE]; ///< Time at which each message was queued, in milliseconds
+	bx_size out_number;
+	bx_uint32 dropped; ///< Accessed atomically
+	bx_boolean running; ///< Accessed atomically
+	bx_boolean started; ///< Whether the receiving thread was started
+	bx_boolean used;
+};
+
+static struct bx_dgram_data dgram_table[BS_MAX_INTERFACES];
+
+static void wake(struct bx_dgram_data *data) {
+	bx_uint64 value;
+
+	value = 1;
+	if (write(data->wake_fd, &value, sizeof value) < 0) {
+		BX_LOG(LOG_WARNING, "datagram_interface", "Cannot wake the receiving thread: %i", errno);
+	}
+}
+
+static bx_uint64 get_time_msec() {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (bx_uint64) now.tv_sec * 1000 + now.tv_nsec / (1000 * 1000);
+}
+
+/**
+ * Check whether a message of the batch goes to the destination of one of
+ * the first messages, which are waiting for their peer
+ *
+ * @return BX_BOOLEAN_TRUE if the message must wait as well
+ */
+static bx_boolean batch_is_waiting(struct bx_dgram_data *data, bx_size waiting_number, bx_size index) {
+	struct bx_dgram_endpoint *endpoint;
+	bx_size i;
+
+	endpoint = &data->out_endpoints[index];
+	for (i = 0; i < waiting_number; i++) {
+		if (data->out_endpoints[i].length == endpoint->length
+				&& memcmp(&data->out_endpoints[i].address, &endpoint->address, endpoint->length) == 0) {
+			return BX_BOOLEAN_TRUE;
+		}
+	}
+
+	return BX_BOOLEAN_FALSE;
+}
+
+/**
+ * Keep a message of the batch for the next flush. Kept messages are moved
+ * to the beginning of the batch, in order.
+ *
+ * @return New number of kept messages
+ */
+static bx_size batch_keep(struct bx_dgram_data *data, bx_size kept, bx_size index) {
+	if (kept != index) {
+		memcpy(&data->out_endpoints[kept], &data->out_endpoints[index], sizeof data->out_endpoints[kept]);
+		memcpy(data->out_data[kept], data->out_data[index], data->out_length[index]);
+		data->out_length[kept] = data->out_length[index];
+		data->out_time[kept] = data->out_time[index];
+	}
+
+	return kept + 1;
+}
+
+/**
+ * Send the outgoing batch with sendmmsg without blocking. Must be called
+ * with the mutex held. Messages whose peer is full stay in the batch,
+ * followed by the later messages to the same peer, and are retried by the
+ * receiving thread every BS_FLUSH_INTERVAL_MSEC. Messages not accepted
+ * within BS_SEND_TIMEOUT_MSEC of being queued, or refused by the socket,
+ * are dropped.
+ *
+ * @return 0 on success, -1 if messages were dropped
+ */
+static bx_int8 batch_flush(struct bx_dgram_data *data) {
+	struct mmsghdr headers[BS_BATCH_SIZE];
+	struct iovec vectors[BS_BATCH_SIZE];
+	bx_uint64 now;
+	bx_size next;
+	bx_size run;
+	bx_size kept;
+	bx_size i;
+	bx_int8 error;
+	int result;
+
+	for (i = 0; i < data->out_number; i++) {
+		vectors[i].iov_base = data->out_data[i];
+		vectors[i].iov_len = data->out_length[i];
+		memset(&headers[i].msg_hdr, 0, sizeof headers[i].msg_hdr);
+		headers[i].msg_hdr.msg_name = &data->out_endpoints[i].address;
+		headers[i].msg_hdr.msg_namelen = data->out_endpoints[i].length;
+		headers[i].msg_hdr.msg_iov = &vectors[i];
+		headers[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	error = 0;
+	kept = 0;
+	next = 0;
+	now = get_time_msec();
+	while (next < data->out_number) {
+		if (batch_is_waiting(data, kept, next) == BX_BOOLEAN_TRUE) {
+			kept = batch_keep(data, kept, next);
+			next++;
+			continue;
+		}
+		// Send up to the next message that must wait behind another one
+		run = 1;
+		while (next + run < data->out_number && batch_is_waiting(data, kept, next + run) == BX_BOOLEAN_FALSE) {
+			run++;
+		}
+
+		result = sendmmsg(data->fd, headers + next, run, MSG_DONTWAIT);
+		if (result > 0) {
+			next += result;
+		} else if (result < 0 && errno == EINTR) {
+			continue;
+		} else if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+				&& now - data->out_time[next] < BS_SEND_TIMEOUT_MSEC) {
+			kept = batch_keep(data, kept, next);
+			next++;
+		} else {
+			BX_ATOMIC_ADD(&data->dropped, 1);
+			error = -1;
+			next++;
+		}
+	}
+	data->out_number = kept;
+
+	return error;
+}
+
+/**
+ * Append a message to the outgoing batch. Must be called with the mutex
+ * held. A full batch is sent immediately, otherwise the receiving thread
+ * sends it within BS_FLUSH_INTERVAL_MSEC.
+ *
+ * @return 0 on success, -1 if the batch is still full of messages waiting
+ * for their peers
+ */
+static bx_int8 batch_add(struct bx_dgram_data *data, const struct bx_dgram_endpoint *endpoint, void *message, bx_size message_length) {
+	if (data->out_number == BS_BATCH_SIZE) {
+		batch_flush(data);
+		if (data->out_number == BS_BATCH_SIZE) {
+			return -1;
+		}
+	}
+
+	memcpy(&data->out_endpoints[data->out_number], endpoint, sizeof *endpoint);
+	memcpy(data->out_data[data->out_number], message, message_length);
+	data->out_length[data->out_number] = message_length;
+	data->out_time[data->out_number] = get_time_msec();
+	data->out_number++;
+
+	if (data->out_number == BS_BATCH_SIZE) {
+		batch_flush(data);
+		// Let the receiving thread retry the messages waiting for their peers
+		if (data->out_number > 0) {
+			wake(data);
+		}
+	} else if (data->out_number == 1) {
+		wake(data);
+	}
+
+	return 0;
+}
+
+/**
+ * Receive up to BS_BATCH_SIZE datagrams with recvmmsg directly into
+ * messages of the pool of the interface, and deliver them into the inbox.
+ * Messages left unused are kept for the next call.
+ *
+ * @return Number of messages left in buffers
+ */
+static bx_size receive_batch(struct bx_interface *interface, struct bx_bus_message **buffers, bx_size buffer_number) {
+	struct bx_dgram_data *data;
+	struct mmsghdr headers[BS_BATCH_SIZE];
+	struct iovec vectors[BS_BATCH_SIZE];
+	struct bx_dgram_endpoint *endpoint;
+	bx_uint8 discard[BS_MAX_MESSAGE_SIZE];
+	bx_size kept;
+	int received;
+	int i;
+
+	data = interface->data;
+	while (buffer_number < BS_BATCH_SIZE) {
+		buffers[buffer_number] = ha_bus_get_buffer(interface);
+		if (buffers[buffer_number] == NULL) {
+			break;
+		}
+		buffer_number++;
+	}
+
+	if (buffer_number == 0) {
+		// The pool is exhausted: drop the datagram instead of spinning on the readable socket
+		if (recv(data->fd, discard, sizeof discard, MSG_DONTWAIT) >= 0) {
+			BX_ATOMIC_ADD(&data->dropped, 1);
+		}
+		return 0;
+	}
+
+	for (i = 0; i < buffer_number; i++) {
+		endpoint = (struct bx_dgram_endpoint *) buffers[i]->endpoint;
+		vectors[i].iov_base = buffers[i]->data;
+		vectors[i].iov_len = BS_MAX_MESSAGE_SIZE;
+		memset(&headers[i].msg_hdr, 0, sizeof headers[i].msg_hdr);
+		headers[i].msg_hdr.msg_name = &endpoint->address;
+		headers[i].msg_hdr.msg_namelen = sizeof endpoint->address;
+		headers[i].msg_hdr.msg_iov = &vectors[i];
+		headers[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	received = recvmmsg(data->fd, headers, buffer_number, MSG_DONTWAIT, NULL);
+	if (received <= 0) {
+		return buffer_number;
+	}
+
+	kept = 0;
+	for (i = 0; i < received; i++) {
+		if (headers[i].msg_hdr.msg_flags & MSG_TRUNC) {
+			BX_ATOMIC_ADD(&data->dropped, 1);
+			buffers[kept++] = buffers[i];
+			continue;
+		}
+		endpoint = (struct bx_dgram_endpoint *) buffers[i]->endpoint;
+		endpoint->length = headers[i].msg_hdr.msg_namelen;
+		buffers[i]->length = headers[i].msg_len;
+		ha_bus_deliver(buffers[i]);
+	}
+	for (i = received; i < buffer_number; i++) {
+		buffers[kept++] = buffers[i];
+	}
+
+	return kept;
+}
+
+static void close_descriptors(struct bx_dgram_data *data) {
+	if (data->wake_fd >= 0) {
+		close(data->wake_fd);
+	}
+	if (data->epoll_fd >= 0) {
+		close(data->epoll_fd);
+	}
+	close(data->fd);
+}
+
+static void *receive_routine(void *argument) {
+	struct bx_interface *interface;
+	struct bx_dgram_data *data;
+	struct bx_bus_message *buffers[BS_BATCH_SIZE];
+	struct epoll_event events[2];
+	bx_size buffer_number;
+	bx_uint64 value;
+	bx_boolean readable;
+	int event_number;
+	int timeout;
+	int i;
+
+	interface = argument;
+	data = interface->data;
+	buffer_number = 0;
+	while (BX_ATOMIC_LOAD(&data->running) == BX_BOOLEAN_TRUE) {
+		pthread_mutex_lock(&data->mutex);
+		timeout = data->out_number > 0 ? BS_FLUSH_INTERVAL_MSEC : -1;
+		pthread_mutex_unlock(&data->mutex);
+
+		event_number = epoll_wait(data->epoll_fd, events, 2, timeout);
+		readable = BX_BOOLEAN_FALSE;
+		for (i = 0; i < event_number; i++) {
+			if (events[i].data.fd == data->wake_fd) {
+				if (read(data->wake_fd, &value, sizeof value) < 0 && errno != EAGAIN) {
+					BX_LOG(LOG_WARNING, "datagram_interface", "Cannot read the wake descriptor: %i", errno);
+				}
+			} else {
+				readable = BX_BOOLEAN_TRUE;
+			}
+		}
+
+		if (readable == BX_BOOLEAN_TRUE) {
+			buffer_number = receive_batch(interface, buffers, buffer_number);
+		}
+
+		// Send the batch that was already pending when the wait started
+		if (timeout >= 0) {
+			pthread_mutex_lock(&data->mutex);
+			if (data->out_number > 0) {
+				batch_flush(data);
+			}
+			pthread_mutex_unlock(&data->mutex);
+		}
+	}
+
+	pthread_mutex_lock(&data->mutex);
+	if (data->out_number > 0) {
+		batch_flush(data);
+		BX_ATOMIC_ADD(&data->dropped, data->out_number);
+		data->out_number = 0;
+	}
+	pthread_mutex_unlock(&data->mutex);
+	for (i = 0; i < buffer_number; i++) {
+		ha_bus_release(buffers[i]);
+	}
+
+	return NULL;
+}
+
+static bx_int8 dgram_send(struct bx_interface *interface, void *endpoint, void *message, bx_size message_length) {
+	struct bx_dgram_data *data;
+	struct bx_dgram_endpoint *destination;
+	bx_int8 error;
+
+	destination = endpoint;
+	if (destination == NULL || message_length > BS_MAX_MESSAGE_SIZE || destination->length == 0
+			|| destination->length > sizeof destination->address) {
+		return -1;
+	}
+
+	data = interface->data;
+	pthread_mutex_lock(&data->mutex);
+	error = batch_add(data, destination, message, message_length);
+	pthread_mutex_unlock(&data->mutex);
+
+	return error;
+}
+
+static bx_int8 dgram_broadcast(struct bx_interface *interface, void *message, bx_size message_length) {
+	struct bx_dgram_data *data;
+	bx_size i;
+	bx_int8 error;
+
+	if (message_length > BS_MAX_MESSAGE_SIZE) {
+		return -1;
+	}
+
+	error = 0;
+	data = interface->data;
+	pthread_mutex_lock(&data->mutex);
+	for (i = 0; i < data->peer_number; i++) {
+		if (batch_add(data, &data->peers[i], message, message_length) != 0) {
+			error = -1;
+		}
+	}
+	pthread_mutex_unlock(&data->mutex);
+
+	return error;
+}
+
+static bx_int8 dgram_flush(struct bx_interface *interface) {
+	struct bx_dgram_data *data;
+	bx_int8 error;
+
+	data = interface->data;
+	pthread_mutex_lock(&data->mutex);
+	error = batch_flush(data);
+	if (data->out_number > 0) {
+		wake(data);
+	}
+	pthread_mutex_unlock(&data->mutex);
+
+	return error;
+}
+
+static bx_int8 dgram_start(struct bx_interface *interface) {
+	struct bx_dgram_data *data;
+
+	data = interface->data;
+	if (pthread_create(&data->thread, NULL, receive_routine, interface) != 0) {
+		BX_LOG(LOG_ERROR, "datagram_interface", "Cannot start the receiving thread");
+		return -1;
+	}
+	data->started = BX_BOOLEAN_TRUE;
+
+	return 0;
+}
+
+static void dgram_destroy(struct bx_interface *interface) {
+	struct bx_dgram_data *data;
+
+	data = interface->data;
+	if (data == NULL) {
+		return;
+	}
+
+	if (data->started == BX_BOOLEAN_TRUE) {
+		BX_ATOMIC_STORE(&data->running, BX_BOOLEAN_FALSE);
+		wake(data);
+		pthread_join(data->thread, NULL);
+	}
+
+	pthread_mutex_destroy(&data->mutex);
+	close_descriptors(data);
+	if (data->local.address.ss_family == AF_UNIX) {
+		unlink(((struct sockaddr_un *) &data->local.address)->sun_path);
+	}
+	data->used = BX_BOOLEAN_FALSE;
+	interface->data = NULL;
+}
+
+void bx_dgram_udp_endpoint(struct bx_dgram_endpoint *endpoint, bx_uint16 port) {
+	struct sockaddr_in *address;
+
+	memset(endpoint, 0, sizeof *endpoint);
+	address = (struct sockaddr_in *) &endpoint->address;
+	address->sin_family = AF_INET;
+	address->sin_port = htons(port);
+	address->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	endpoint->length = sizeof *address;
+}
+
+bx_int8 bx_dgram_unix_endpoint(struct bx_dgram_endpoint *endpoint, const char *path) {
+	struct sockaddr_un *address;
+
+	memset(endpoint, 0, sizeof *endpoint);
+	address = (struct sockaddr_un *) &endpoint->address;
+	if (strlen(path) >= sizeof address->sun_path) {
+		return -1;
+	}
+	address->sun_family = AF_UNIX;
+	strcpy(address->sun_path, path);
+	endpoint->length = offsetof(struct sockaddr_un, sun_path) + strlen(path) + 1;
+
+	return 0;
+}
+
+bx_int8 bx_dgram_init(struct bx_interface *interface, const struct bx_dgram_endpoint *local) {
+	struct bx_dgram_data *data;
+	struct epoll_event event;
+	int error;
+	bx_uint8 i;
+
+	BX_COMPILE_ASSERT(sizeof (struct bx_dgram_endpoint) <= BS_ENDPOINT_SIZE);
+
+	data = NULL;
+	for (i = 0; i < BS_MAX_INTERFACES; i++) {
+		if (dgram_table[i].used == BX_BOOLEAN_FALSE) {
+			data = &dgram_table[i];
+			break;
+		}
+	}
+	if (data == NULL) {
+		BX_LOG(LOG_ERROR, "datagram_interface", "Cannot create interface: too many interfaces");
+		return -1;
+	}
+
+	data->fd = socket(local->address.ss_family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (data->fd < 0) {
+		BX_LOG(LOG_ERROR, "datagram_interface", "Cannot create socket: %i", errno);
+		return -1;
+	}
+	if (local->address.ss_family == AF_UNIX) {
+		unlink(((struct sockaddr_un *) &local->address)->sun_path);
+	}
+	if (bind(data->fd, (const struct sockaddr *) &local->address, local->length) != 0) {
+		BX_LOG(LOG_ERROR, "datagram_interface", "Cannot bind socket: %i", errno);
+		close(data->fd);
+		return -1;
+	}
+
+	data->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	data->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (data->epoll_fd < 0 || data->wake_fd < 0) {
+		BX_LOG(LOG_ERROR, "datagram_interface", "Cannot create event descriptors: %i", errno);
+		close_descriptors(data);
+		return -1;
+	}
+	memset(&event, 0, sizeof event);
+	event.events = EPOLLIN;
+	event.data.fd = data->fd;
+	error = epoll_ctl(data->epoll_fd, EPOLL_CTL_ADD, data->fd, &event);
+	event.data.fd = data->wake_fd;
+	error |= epoll_ctl(data->epoll_fd, EPOLL_CTL_ADD, data->wake_fd, &event);
+	if (error != 0) {
+		BX_LOG(LOG_ERROR, "datagram_interface", "Cannot register event descriptors: %i", errno);
+		close_descriptors(data);
+		return -1;
+	}
+
+	memcpy(&data->local, local, sizeof *local);
+	data->peer_number = 0;
+	data->out_number = 0;
+	data->dropped = 0;
+	data->running = BX_BOOLEAN_TRUE;
+	data->started = BX_BOOLEAN_FALSE;
+	pthread_mutex_init(&data->mutex, NULL);
+
+	interface->send = dgram_send;
+	interface->broadcast = dgram_broadcast;
+	interface->flush = dgram_flush;
+	interface->start = dgram_start;
+	interface->destroy = dgram_destroy;
+	interface->error = 0;
+	interface->data = data;
+	BX_ATOMIC_STORE(&interface->id, -1);
+	data->used = BX_BOOLEAN_TRUE;
+
+	return 0;
+}
+
+bx_int8 bx_dgram_get_local(struct bx_interface *interface, struct bx_dgram_endpoint *local) {
+	struct bx_dgram_data *data;
+
+	data = interface->data;
+	memset(local, 0, sizeof *local);
+	local->length = sizeof local->address;
+	if (getsockname(data->fd, (struct sockaddr *) &local->address, &local->length) != 0) {
+		return -1;
+	}
+
+	return 0;
+}
+
+bx_int8 bx_dgram_add_peer(struct bx_interface *interface, const struct bx_dgram_endpoint *peer) {
+	struct bx_dgram_data *data;
+	bx_int8 error;
+
+	data = interface->data;
+	pthread_mutex_lock(&data->mutex);
+	if (data->peer_number < BS_MAX_PEERS) {
+		memcpy(&data->peers[data->peer_number], peer, sizeof *peer);
+		data->peer_number++;
+		error = 0;
+	} else {
+		error = -1;
+	}
+	pthread_mutex_unlock(&data->mutex);
+
+	return error;
+}
+
+bx_uint32 bx_dgram_get_dropped(struct bx_interface *interface) {
+	struct bx_dgram_data *data;
+
+	data = interface->data;
+	return BX_ATOMIC_LOAD(&data->dropped);
+}
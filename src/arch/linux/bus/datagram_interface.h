@@ -0,0 +1,123 @@
+/*
+ * datagram_interface.h
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * Datagram interface.
+ * Bus interface exchanging messages as datagrams over a UDP or Unix domain
+ * socket. Outgoing messages are queued in a batch of BS_BATCH_SIZE
+ * messages, sent with a single sendmmsg when the batch is full, when the
+ * interface is flushed or at most BS_FLUSH_INTERVAL_MSEC after the first
+ * message was queued. A receiving thread waits on the socket with epoll
+ * and reads up to BS_BATCH_SIZE datagrams with a single recvmmsg, directly
+ * into messages taken from the pool of the interface, which are then
+ * delivered into the inbox of the bus. Sending never blocks: messages
+ * whose receiver is full stay in the batch and are retried by the
+ * receiving thread. Datagrams arriving while the pool is exhausted,
+ * datagrams longer than BS_MAX_MESSAGE_SIZE and datagrams the receiver
+ * does not accept within BS_SEND_TIMEOUT_MSEC are dropped.
+ * Loopback and Unix domain sockets cannot broadcast, so broadcast messages
+ * are sent to every peer added with bx_dgram_add_peer.
+ */
+
+#ifndef DATAGRAM_INTERFACE_H_
+#define DATAGRAM_INTERFACE_H_
+
+#include <sys/socket.h>
+#include "types.h"
+#include "bus/interface.h"
+
+/**
+ * Endpoint of a datagram interface, used as the endpoint argument of
+ * ha_bus_send and as the sender of the received messages
+ */
+struct bx_dgram_endpoint {
+	socklen_t length;
+	struct sockaddr_storage address;
+};
+
+/**
+ * Initialize a UDP endpoint on the loopback address
+ *
+ * @param endpoint Endpoint to initialize
+ * @param port Port in host byte order, 0 to bind to any free port
+ */
+void bx_dgram_udp_endpoint(struct bx_dgram_endpoint *endpoint, bx_uint16 port);
+
+/**
+ * Initialize a Unix domain socket endpoint
+ *
+ * @param endpoint Endpoint to initialize
+ * @param path Path of the socket
+ * @return 0 on success, -1 if the path is too long
+ */
+bx_int8 bx_dgram_unix_endpoint(struct bx_dgram_endpoint *endpoint, const char *path);
+
+/**
+ * Initialize a datagram interface bound to a local endpoint. The receiving
+ * thread is started when the interface is added to the bus. Sending
+ * through the interface fails while its batch is full of messages waiting
+ * for their receivers.
+ *
+ * @param interface Interface to initialize
+ * @param local Local endpoint, a Unix socket path is replaced if it exists
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_dgram_init(struct bx_interface *interface, const struct bx_dgram_endpoint *local);
+
+/**
+ * Retrieve the endpoint the interface is bound to
+ *
+ * @param interface Datagram interface
+ * @param local Retrieved endpoint
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_dgram_get_local(struct bx_interface *interface, struct bx_dgram_endpoint *local);
+
+/**
+ * Add a peer receiving the broadcast messages of the interface
+ *
+ * @param interface Datagram interface
+ * @param peer Peer endpoint
+ * @return 0 on success, -1 if there are too many peers
+ */
+bx_int8 bx_dgram_add_peer(struct bx_interface *interface, const struct bx_dgram_endpoint *peer);
+
+/**
+ * Retrieve the number of messages dropped by the interface, either
+ * received while the pool of the interface was exhausted or not sent
+ * within BS_SEND_TIMEOUT_MSEC
+ *
+ * @param interface Datagram interface
+ * @return Number of dropped messages
+ */
+bx_uint32 bx_dgram_get_dropped(struct bx_interface *interface);
+
+#endif /* DATAGRAM_INTERFACE_H_ */
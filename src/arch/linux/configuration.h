@@ -38,20 +38,59 @@
 // Virtual machine
 #define VM_STACK_SIZE 512
 #define VM_VARIABLE_TABLE_SIZE 512
+#define VM_CONTEXT_NUMBER 8
 
 // Pcode repository
-#define PR_CODE_STORAGE_SIZE 4092
+// Bytes available to the programs, a power of two
+#define PR_CODE_STORAGE_SIZE 4096
+#define PR_MIN_BLOCK_SIZE 16
+#define PR_MAX_PCODES 64
+#define PR_HASH_BUCKETS 32
+#define PR_MAX_MODULES 16
 
 // Document manager
 #define DM_MAX_FIELD_NUMBER 512
 #define DM_FIELD_IDENTIFIER_LENGTH 16
+#define DM_INDEX_SIZE 1024
+#define DM_SNAPSHOT_MAX_ATTEMPTS 1000
 #define DM_MMAP_STORAGE_SIZE 512
+#define DM_MMAP_MAX_ATTEMPTS 100000
+#define DM_MMAP_OPEN_ATTEMPTS 1000
+#define DM_MMAP_OPEN_WAIT_USEC 1000
+#define DM_COLUMN_CAPACITY 256
+#define DM_COLUMN_MAX_ATTEMPTS 1000
+#define DM_JOURNAL_MAX_FIELDS 64
+#define DM_JOURNAL_COMPACTION_SIZE 65536
+#define DM_JOURNAL_PATH_LENGTH 256
 
 // Timer
-#define TM_TICK_PERIOD_MS 125
-#define TM_TIMER_STORAGE_SIZE 512
+#define TM_DEFAULT_RESOLUTION_USEC 125000
+#define TM_MIN_RESOLUTION_USEC 50
+#define TM_TIMER_STORAGE_SIZE 65024
+#define TM_MAX_TIMERS 1536
+#define TM_WHEEL_LEVELS 4
+#define TM_WHEEL_SLOT_BITS 6
+#define TM_MAX_DEGRADE_SHIFT 3
+#define TM_LATENCY_SUB_BUCKET_BITS 1
+#define TM_LATENCY_BUCKETS 32
 
 // Event handler
-#define EV_HANDLER_STORAGE_SIZE 512
+#define EV_HANDLER_STORAGE_SIZE 8192
+#define EV_PRIORITY_LEVELS 4
+#define EV_MAX_TASKS 32
+#define EV_MAX_WORKERS 8
+#define EV_READY_LIMIT EV_MAX_TASKS
+#define EV_LATENCY_BUCKETS 16
+#define EV_LATENCY_BUCKET_USEC 10
+
+// Bus
+#define BS_MAX_INTERFACES 4
+#define BS_MAX_MESSAGE_SIZE 512
+#define BS_ENDPOINT_SIZE 136
+#define BS_INTERFACE_MESSAGES 64
+#define BS_BATCH_SIZE 16
+#define BS_MAX_PEERS 16
+#define BS_FLUSH_INTERVAL_MSEC 1
+#define BS_SEND_TIMEOUT_MSEC 20
 
 #endif /* CONFIGURATION_H_ */
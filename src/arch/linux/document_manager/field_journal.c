@@ -0,0 +1,567 @@
+/*
+ * field_journal.c
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "configuration.h"
+#include "logging.h"
+#include "document_manager/document_manager.h"
+#include "document_manager/field_journal.h"
+
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
+struct journal_field {
+	char identifier[DM_FIELD_IDENTIFIER_LENGTH];
+	bx_ssize handle;
+	bx_uint32 version;		///< Version of the last value written to the disk
+};
+
+static struct bx_field_journal {
+	struct journal_field fields[DM_JOURNAL_MAX_FIELDS];
+	bx_size field_number;
+	char journal_path[DM_JOURNAL_PATH_LENGTH];
+	char snapshot_path[DM_JOURNAL_PATH_LENGTH];
+	int fd;
+	off_t size;				///< Size of the journal file
+	bx_uint32 generation;
+	bx_uint32 commit_interval_usec;
+	bx_boolean open;
+	bx_boolean running;		///< Protected by the mutex
+	pthread_t thread;
+	pthread_mutex_t mutex;	///< Serializes the operations on the files
+	pthread_cond_t condition;
+} journal;
+
+/**
+ * Computes the checksum of a record
+ *
+ * @param record Journal record
+ *
+ * @return FNV-1a hash of the identifier and the value of the record
+ */
+static bx_uint32 record_checksum(const struct bx_journal_record *record) {
+	const bx_uint8 *data;
+	bx_uint32 hash;
+	bx_size i;
+
+	data = (const bx_uint8 *) record;
+	hash = FNV_OFFSET_BASIS;
+	for (i = 0; i < offsetof(struct bx_journal_record, checksum); i++) {
+		hash = (hash ^ data[i]) * FNV_PRIME;
+	}
+
+	return hash;
+}
+
+/**
+ * Fills a record
+ *
+ * @param record Destination record
+ * @param field Persistent field
+ * @param value Value of the field
+ */
+static void record_fill(struct bx_journal_record *record, struct journal_field *field, bx_uint32 value) {
+
+	memcpy(record->identifier, field->identifier, DM_FIELD_IDENTIFIER_LENGTH);
+	record->value = value;
+	record->checksum = record_checksum(record);
+}
+
+/**
+ * Looks up a persistent field
+ *
+ * @param identifier Field identifier, not necessarily null terminated
+ *
+ * @return Persistent field, NULL if the field is not registered
+ */
+static struct journal_field *field_find(const char *identifier) {
+	bx_size i;
+
+	for (i = 0; i < journal.field_number; i++) {
+		if (strncmp(journal.fields[i].identifier, identifier, DM_FIELD_IDENTIFIER_LENGTH) == 0) {
+			return &journal.fields[i];
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Writes a buffer completely
+ *
+ * @param fd Destination file descriptor
+ * @param data Source buffer
+ * @param length Buffer length
+ *
+ * @return 0 on success, -1 on failure
+ */
+static bx_int8 write_all(int fd, const void *data, size_t length) {
+	const char *position;
+	ssize_t written;
+
+	position = data;
+	while (length > 0) {
+		written = write(fd, position, length);
+		if (written < 0 && errno == EINTR) {
+			continue;
+		}
+		if (written <= 0) {
+			return -1;
+		}
+		position += written;
+		length -= written;
+	}
+
+	return 0;
+}
+
+/**
+ * Writes the header of a file
+ *
+ * @param fd Destination file descriptor
+ * @param generation Generation of the file
+ *
+ * @return 0 on success, -1 on failure
+ */
+static bx_int8 header_write(int fd, bx_uint32 generation) {
+	struct bx_journal_header header;
+
+	header.magic = BX_JOURNAL_MAGIC;
+	header.version = BX_JOURNAL_VERSION;
+	header.reserved = 0;
+	header.generation = generation;
+
+	return write_all(fd, &header, sizeof (struct bx_journal_header));
+}
+
+/**
+ * Applies the records of a file to the persistent fields. Replay stops at
+ * the first incomplete or corrupted record.
+ *
+ * @param path File path
+ * @param min_generation Files older than this generation are skipped
+ * @param generation Returns the generation of the file, unchanged if the file is empty
+ *
+ * @return 0 on success, -1 if the file cannot be read or is not valid
+ */
+static bx_int8 file_replay(const char *path, bx_uint32 min_generation, bx_uint32 *generation) {
+	struct bx_journal_header *header;
+	struct bx_journal_record *records;
+	struct journal_field *field;
+	struct stat status;
+	size_t record_number;
+	size_t i;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		if (errno == ENOENT) {
+			return 0;
+		}
+		BX_LOG(LOG_ERROR, "field_journal", "Cannot open %s: %i", path, errno);
+		return -1;
+	}
+	if (fstat(fd, &status) != 0) {
+		BX_LOG(LOG_ERROR, "field_journal", "Cannot stat %s: %i", path, errno);
+		close(fd);
+		return -1;
+	}
+	if (status.st_size < sizeof (struct bx_journal_header)) {
+		// A crash during compaction may leave a truncated journal behind
+		close(fd);
+		return 0;
+	}
+
+	header = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (header == MAP_FAILED) {
+		BX_LOG(LOG_ERROR, "field_journal", "Cannot map %s: %i", path, errno);
+		return -1;
+	}
+	if (header->magic != BX_JOURNAL_MAGIC || header->version != BX_JOURNAL_VERSION) {
+		BX_LOG(LOG_ERROR, "field_journal", "Invalid file %s", path);
+		munmap(header, status.st_size);
+		return -1;
+	}
+	if (header->generation < min_generation) {
+		BX_LOG(LOG_DEBUG, "field_journal", "Skipping %s: generation %u already compacted",
+				path, header->generation);
+		munmap(header, status.st_size);
+		return 0;
+	}
+
+	records = (struct bx_journal_record *) (header + 1);
+	record_number = (status.st_size - sizeof (struct bx_journal_header)) / sizeof (struct bx_journal_record);
+	for (i = 0; i < record_number; i++) {
+		if (record_checksum(&records[i]) != records[i].checksum) {
+			BX_LOG(LOG_WARNING, "field_journal", "Corrupted record %zu in %s, ignoring the rest", i, path);
+			break;
+		}
+		field = field_find(records[i].identifier);
+		if (field != NULL) {
+			bx_docman_invoke_set(field->identifier, &records[i].value);
+		}
+	}
+	*generation = header->generation;
+	munmap(header, status.st_size);
+
+	return 0;
+}
+
+/**
+ * Flushes the directory containing a file, making a rename durable
+ *
+ * @param path File path
+ *
+ * @return 0 on success, -1 on failure
+ */
+static bx_int8 directory_sync(const char *path) {
+	char directory[DM_JOURNAL_PATH_LENGTH];
+	char *separator;
+	bx_int8 error;
+	int fd;
+
+	strncpy(directory, path, DM_JOURNAL_PATH_LENGTH - 1);
+	directory[DM_JOURNAL_PATH_LENGTH - 1] = '\0';
+	separator = strrchr(directory, '/');
+	if (separator == NULL) {
+		strcpy(directory, ".");
+	} else if (separator == directory) {
+		separator[1] = '\0';
+	} else {
+		separator[0] = '\0';
+	}
+
+	fd = open(directory, O_RDONLY | O_DIRECTORY);
+	if (fd < 0) {
+		return -1;
+	}
+	error = fsync(fd) == 0 ? 0 : -1;
+	close(fd);
+
+	return error;
+}
+
+/**
+ * Collects the current value of the persistent fields
+ *
+ * @param records Destination records
+ * @param versions Destination versions
+ * @param changed_only Collect only the fields changed since the last commit
+ *
+ * @return Number of records collected
+ */
+static bx_size fields_collect(struct bx_journal_record *records, bx_uint32 *versions, bx_boolean changed_only) {
+	struct journal_field *field;
+	bx_uint32 value;
+	bx_uint32 version;
+	bx_size count;
+	bx_size i;
+
+	count = 0;
+	for (i = 0; i < journal.field_number; i++) {
+		field = &journal.fields[i];
+		if (bx_docman_get_versioned(field->handle, &value, &version) != 0) {
+			BX_LOG(LOG_WARNING, "field_journal", "Cannot read field %.*s",
+					DM_FIELD_IDENTIFIER_LENGTH, field->identifier);
+			versions[i] = field->version;
+			continue;
+		}
+		versions[i] = version;
+		if (changed_only == BX_BOOLEAN_FALSE || version != field->version) {
+			record_fill(&records[count++], field, value);
+		}
+	}
+
+	return count;
+}
+
+/**
+ * Writes all the persistent fields to a new snapshot and empties the
+ * journal. Must be called with the mutex held.
+ *
+ * @return 0 on success, -1 on failure
+ */
+static bx_int8 compact_locked(void) {
+	struct bx_journal_record records[DM_JOURNAL_MAX_FIELDS];
+	bx_uint32 versions[DM_JOURNAL_MAX_FIELDS];
+	char temporary_path[DM_JOURNAL_PATH_LENGTH + 4];
+	bx_size count;
+	bx_size i;
+	int fd;
+
+	count = fields_collect(records, versions, BX_BOOLEAN_FALSE);
+
+	snprintf(temporary_path, sizeof (temporary_path), "%s.tmp", journal.snapshot_path);
+	fd = open(temporary_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0) {
+		BX_LOG(LOG_ERROR, "field_journal", "Cannot create %s: %i", temporary_path, errno);
+		return -1;
+	}
+	if (header_write(fd, journal.generation + 1) != 0
+			|| write_all(fd, records, count * sizeof (struct bx_journal_record)) != 0
+			|| fdatasync(fd) != 0) {
+		BX_LOG(LOG_ERROR, "field_journal", "Cannot write %s: %i", temporary_path, errno);
+		close(fd);
+		unlink(temporary_path);
+		return -1;
+	}
+	close(fd);
+	if (rename(temporary_path, journal.snapshot_path) != 0) {
+		BX_LOG(LOG_ERROR, "field_journal", "Cannot replace %s: %i", journal.snapshot_path, errno);
+		unlink(temporary_path);
+		return -1;
+	}
+	directory_sync(journal.snapshot_path);
+
+	// From now on the journal belongs to an old generation and is ignored
+	journal.generation++;
+	for (i = 0; i < journal.field_number; i++) {
+		journal.fields[i].version = versions[i];
+	}
+	if (ftruncate(journal.fd, 0) != 0 || header_write(journal.fd, journal.generation) != 0
+			|| fdatasync(journal.fd) != 0) {
+		BX_LOG(LOG_ERROR, "field_journal", "Cannot reset %s: %i", journal.journal_path, errno);
+		return -1;
+	}
+	journal.size = sizeof (struct bx_journal_header);
+
+	return 0;
+}
+
+/**
+ * Appends the fields changed since the last commit to the journal with a
+ * single write and flushes it. Must be called with the mutex held.
+ *
+ * @return 0 on success, -1 on failure
+ */
+static bx_int8 commit_locked(void) {
+	struct bx_journal_record records[DM_JOURNAL_MAX_FIELDS];
+	bx_uint32 versions[DM_JOURNAL_MAX_FIELDS];
+	size_t length;
+	bx_size count;
+	bx_size i;
+
+	count = fields_collect(records, versions, BX_BOOLEAN_TRUE);
+	if (count == 0) {
+		return 0;
+	}
+
+	length = count * sizeof (struct bx_journal_record);
+	if (write_all(journal.fd, records, length) != 0 || fdatasync(journal.fd) != 0) {
+		BX_LOG(LOG_ERROR, "field_journal", "Cannot write %s: %i", journal.journal_path, errno);
+		// Drop the partial records, otherwise replay would stop before the next commits
+		if (ftruncate(journal.fd, journal.size) != 0) {
+			BX_LOG(LOG_ERROR, "field_journal", "Cannot truncate %s: %i", journal.journal_path, errno);
+		}
+		return -1;
+	}
+	journal.size += length;
+	for (i = 0; i < journal.field_number; i++) {
+		journal.fields[i].version = versions[i];
+	}
+
+	if (journal.size >= DM_JOURNAL_COMPACTION_SIZE) {
+		return compact_locked();
+	}
+
+	return 0;
+}
+
+/**
+ * Commit thread: commits the changes at every interval until the journal
+ * is closed
+ *
+ * @param arg Unused
+ *
+ * @return Always NULL
+ */
+static void *commit_routine(void *arg) {
+	struct timespec deadline;
+
+	pthread_mutex_lock(&journal.mutex);
+	while (journal.running == BX_BOOLEAN_TRUE) {
+		clock_gettime(CLOCK_MONOTONIC, &deadline);
+		deadline.tv_sec += journal.commit_interval_usec / 1000000;
+		deadline.tv_nsec += (journal.commit_interval_usec % 1000000) * 1000;
+		if (deadline.tv_nsec >= 1000000000) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+		while (journal.running == BX_BOOLEAN_TRUE
+				&& pthread_cond_timedwait(&journal.condition, &journal.mutex, &deadline) != ETIMEDOUT) {
+		}
+		if (journal.running == BX_BOOLEAN_TRUE) {
+			commit_locked();
+		}
+	}
+	pthread_mutex_unlock(&journal.mutex);
+
+	return NULL;
+}
+
+bx_int8 bx_journal_add_field(char *identifier) {
+	struct journal_field *field;
+	bx_ssize handle;
+
+	if (identifier == NULL || journal.open == BX_BOOLEAN_TRUE
+			|| journal.field_number >= DM_JOURNAL_MAX_FIELDS || field_find(identifier) != NULL) {
+		return -1;
+	}
+
+	handle = bx_docman_get_handle(identifier);
+	if (handle < 0) {
+		return -1;
+	}
+
+	field = &journal.fields[journal.field_number];
+	strncpy(field->identifier, identifier, DM_FIELD_IDENTIFIER_LENGTH);
+	field->handle = handle;
+	field->version = 0;
+	journal.field_number++;
+
+	return 0;
+}
+
+bx_int8 bx_journal_open(const char *journal_path, const char *snapshot_path, bx_uint32 commit_interval_usec) {
+	pthread_condattr_t condition_attr;
+	bx_uint32 snapshot_generation;
+	bx_uint32 journal_generation;
+
+	if (journal_path == NULL || snapshot_path == NULL || commit_interval_usec == 0
+			|| journal.open == BX_BOOLEAN_TRUE || strlen(journal_path) >= DM_JOURNAL_PATH_LENGTH
+			|| strlen(snapshot_path) >= DM_JOURNAL_PATH_LENGTH) {
+		return -1;
+	}
+	strcpy(journal.journal_path, journal_path);
+	strcpy(journal.snapshot_path, snapshot_path);
+
+	snapshot_generation = 0;
+	if (file_replay(snapshot_path, 0, &snapshot_generation) != 0) {
+		return -1;
+	}
+	journal_generation = snapshot_generation;
+	if (file_replay(journal_path, snapshot_generation, &journal_generation) != 0) {
+		return -1;
+	}
+	journal.generation = journal_generation;
+
+	journal.fd = open(journal_path, O_WRONLY | O_CREAT | O_APPEND, 0600);
+	if (journal.fd < 0) {
+		BX_LOG(LOG_ERROR, "field_journal", "Cannot open %s: %i", journal_path, errno);
+		return -1;
+	}
+
+	// Start from a clean journal: this also drops a corrupted tail
+	if (compact_locked() != 0) {
+		close(journal.fd);
+		return -1;
+	}
+
+	pthread_mutex_init(&journal.mutex, NULL);
+	pthread_condattr_init(&condition_attr);
+	pthread_condattr_setclock(&condition_attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&journal.condition, &condition_attr);
+	pthread_condattr_destroy(&condition_attr);
+	journal.commit_interval_usec = commit_interval_usec;
+	journal.running = BX_BOOLEAN_TRUE;
+	if (pthread_create(&journal.thread, NULL, commit_routine, NULL) != 0) {
+		BX_LOG(LOG_ERROR, "field_journal", "Cannot start the commit thread");
+		pthread_cond_destroy(&journal.condition);
+		pthread_mutex_destroy(&journal.mutex);
+		close(journal.fd);
+		return -1;
+	}
+	journal.open = BX_BOOLEAN_TRUE;
+
+	return 0;
+}
+
+bx_int8 bx_journal_commit() {
+	bx_int8 error;
+
+	if (journal.open == BX_BOOLEAN_FALSE) {
+		return -1;
+	}
+
+	pthread_mutex_lock(&journal.mutex);
+	error = commit_locked();
+	pthread_mutex_unlock(&journal.mutex);
+
+	return error;
+}
+
+bx_int8 bx_journal_compact() {
+	bx_int8 error;
+
+	if (journal.open == BX_BOOLEAN_FALSE) {
+		return -1;
+	}
+
+	pthread_mutex_lock(&journal.mutex);
+	error = compact_locked();
+	pthread_mutex_unlock(&journal.mutex);
+
+	return error;
+}
+
+bx_int8 bx_journal_close() {
+	bx_int8 error;
+
+	if (journal.open == BX_BOOLEAN_FALSE) {
+		return -1;
+	}
+
+	pthread_mutex_lock(&journal.mutex);
+	journal.running = BX_BOOLEAN_FALSE;
+	pthread_cond_signal(&journal.condition);
+	pthread_mutex_unlock(&journal.mutex);
+	pthread_join(journal.thread, NULL);
+
+	error = commit_locked();
+	close(journal.fd);
+	pthread_cond_destroy(&journal.condition);
+	pthread_mutex_destroy(&journal.mutex);
+	journal.field_number = 0;
+	journal.open = BX_BOOLEAN_FALSE;
+
+	return error;
+}
@@ -0,0 +1,125 @@
+/*
+ * field_journal.h
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * Field journal.
+ * The field journal persists the values of the fields registered as
+ * persistent in an append-only journal file. Writing a field does not
+ * touch the disk: a commit thread periodically appends a record for each
+ * persistent field whose version changed since the previous commit and
+ * then flushes the journal with a single fdatasync. When the journal grows
+ * beyond DM_JOURNAL_COMPACTION_SIZE bytes it is compacted into a snapshot
+ * file holding one record per field, and emptied.
+ *
+ * Both files start with a header followed by records, in host byte order:
+ *
+ * +--------+---------+----------+------------+----------+----------+-----+
+ * | Magic  | Version | Reserved | Generation | Record 0 | Record 1 | ... |
+ * | 32 bit | 16 bit  | 16 bit   | 32 bit     | 192 bit  | 192 bit  |     |
+ * +--------+---------+----------+------------+----------+----------+-----+
+ *
+ * Each record contains the field identifier, the 32 bit value and a
+ * checksum, so that a record torn by a crash is detected and discarded.
+ * Every compaction increments the generation; a journal older than the
+ * snapshot is already contained in it and is not replayed.
+ *
+ * Only the values set through the document manager are versioned, so only
+ * those are persisted.
+ */
+
+#ifndef FIELD_JOURNAL_H_
+#define FIELD_JOURNAL_H_
+
+#include "types.h"
+#include "configuration.h"
+
+#define BX_JOURNAL_MAGIC 0x42584A4E
+#define BX_JOURNAL_VERSION 1
+
+struct bx_journal_header {
+	bx_uint32 magic;
+	bx_uint16 version;
+	bx_uint16 reserved;
+	bx_uint32 generation;
+};
+
+struct bx_journal_record {
+	char identifier[DM_FIELD_IDENTIFIER_LENGTH];
+	bx_uint32 value;
+	bx_uint32 checksum;		///< FNV-1a hash of the identifier and the value
+};
+
+/**
+ * Registers a field as persistent. Fields have to be registered before the
+ * journal is opened to be restored.
+ *
+ * @param identifier Identifier of a field of the document manager
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_journal_add_field(char *identifier);
+
+/**
+ * Restores the values of the persistent fields from the snapshot and the
+ * journal and starts the commit thread.
+ *
+ * @param journal_path Path of the journal file
+ * @param snapshot_path Path of the snapshot file
+ * @param commit_interval_usec Interval between two commits in microseconds
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_journal_open(const char *journal_path, const char *snapshot_path, bx_uint32 commit_interval_usec);
+
+/**
+ * Commits the changes of the persistent fields immediately
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_journal_commit(void);
+
+/**
+ * Writes the values of the persistent fields to the snapshot and empties
+ * the journal
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_journal_compact(void);
+
+/**
+ * Stops the commit thread, commits the last changes and closes the journal.
+ * The persistent fields are unregistered.
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_journal_close(void);
+
+#endif /* FIELD_JOURNAL_H_ */
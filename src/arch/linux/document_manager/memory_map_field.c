@@ -30,14 +30,324 @@
  */
 
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "configuration.h"
+#include "logging.h"
+#include "atomic.h"
+#include "utils/seqlock.h"
 #include "document_manager/memory_map_field.h"
 
-bx_int8 bx_mmap_field_init(struct bx_document_field *instance, enum bx_builtin_type type) {
+/**
+ * Fields refer to their slots by index and access them through the region,
+ * so closing the region detaches them: their accesses fail until the region
+ * is opened again.
+ */
+static struct bx_mmap_region {
+	struct bx_mmap_header *header;	///< Beginning of the mapping, NULL if not open, accessed atomically
+	bx_uint32 users;				///< Slot accesses in progress, accessed atomically
+} mmap_region;
+
+static bx_int8 mmap_field_get(struct bx_document_field *instance, void *data);
+static bx_int8 mmap_field_set(struct bx_document_field *instance, void *data);
+
+/**
+ * Initializes the content of a newly created region
+ *
+ * @param header Beginning of the region
+ */
+static void region_format(struct bx_mmap_header *header) {
+	struct bx_mmap_slot *slots;
+	bx_size i;
+
+	slots = (struct bx_mmap_slot *) (header + 1);
+	for (i = 0; i < BX_MMAP_SLOT_NUMBER; i++) {
+		bx_seqlock_init(&slots[i].sequence);
+		slots[i].type = BX_MMAP_SLOT_UNUSED;
+		slots[i].value = 0;
+		slots[i].reserved = 0;
+	}
+	header->version = BX_MMAP_VERSION;
+	header->slot_number = BX_MMAP_SLOT_NUMBER;
+
+	// Other processes check the magic number last
+	BX_ATOMIC_STORE(&header->magic, BX_MMAP_MAGIC);
+}
+
+/**
+ * Returns a slot of the region. The region is not unmapped until
+ * slot_release is invoked.
+ *
+ * @param slot Index of the slot
+ *
+ * @return Slot pointer, NULL if the region is not open or the index is invalid
+ */
+static struct bx_mmap_slot *slot_acquire(bx_uint16 slot) {
+	struct bx_mmap_header *header;
+
+	BX_ATOMIC_ADD(&mmap_region.users, 1);
+	header = BX_ATOMIC_LOAD(&mmap_region.header);
+	if (header == NULL || slot >= header->slot_number) {
+		BX_ATOMIC_SUB(&mmap_region.users, 1);
+		return NULL;
+	}
+
+	return (struct bx_mmap_slot *) (header + 1) + slot;
+}
+
+/**
+ * Releases a slot returned by slot_acquire
+ */
+static void slot_release() {
+	BX_ATOMIC_SUB(&mmap_region.users, 1);
+}
+
+/**
+ * Waits for the process creating a region to size it
+ *
+ * @param fd Shared memory object
+ *
+ * @return 0 once the region has its full size, -1 on timeout
+ */
+static bx_int8 region_wait_size(int fd) {
+	struct stat status;
+	bx_uint32 attempts;
+
+	for (attempts = 0; attempts < DM_MMAP_OPEN_ATTEMPTS; attempts++) {
+		if (fstat(fd, &status) != 0) {
+			return -1;
+		}
+		if (status.st_size >= DM_MMAP_STORAGE_SIZE) {
+			return 0;
+		}
+		usleep(DM_MMAP_OPEN_WAIT_USEC);
+	}
+
+	return -1;
+}
+
+/**
+ * Waits for the process creating a region to initialize it
+ *
+ * @param header Beginning of the region
+ *
+ * @return 0 once the magic number is written, -1 on timeout
+ */
+static bx_int8 region_wait_format(struct bx_mmap_header *header) {
+	bx_uint32 attempts;
+
+	for (attempts = 0; attempts < DM_MMAP_OPEN_ATTEMPTS; attempts++) {
+		if (BX_ATOMIC_LOAD(&header->magic) == BX_MMAP_MAGIC) {
+			return 0;
+		}
+		usleep(DM_MMAP_OPEN_WAIT_USEC);
+	}
+
+	return -1;
+}
+
+/**
+ * Writes a value in a slot
+ *
+ * @param slot Destination slot
+ * @param data Source memory location
+ *
+ * @return 0 on success, -1 if a writer did not complete
+ */
+static bx_int8 slot_write(struct bx_mmap_slot *slot, void *data) {
+	bx_uint32 value;
+	bx_uint32 attempts;
+
+	memcpy(&value, data, 4);
+	for (attempts = 0; attempts < DM_MMAP_MAX_ATTEMPTS; attempts++) {
+		if (bx_seqlock_write_try_begin(&slot->sequence) == BX_BOOLEAN_TRUE) {
+			BX_ATOMIC_STORE(&slot->value, value);
+			bx_seqlock_write_end(&slot->sequence);
+			return 0;
+		}
+	}
+
+	BX_LOG(LOG_ERROR, "memory_map_field", "Cannot write slot: update in progress");
+	return -1;
+}
+
+/**
+ * Reads a consistent value from a slot
+ *
+ * @param slot Source slot
+ * @param data Destination memory location
+ *
+ * @return 0 on success, -1 if a writer did not complete
+ */
+static bx_int8 slot_read(struct bx_mmap_slot *slot, void *data) {
+	bx_uint32 value;
+	bx_uint32 start;
+	bx_uint32 attempts;
+
+	for (attempts = 0; attempts < DM_MMAP_MAX_ATTEMPTS; attempts++) {
+		start = bx_seqlock_read_begin(&slot->sequence);
+		value = BX_ATOMIC_LOAD(&slot->value);
+		if (bx_seqlock_read_end(&slot->sequence, start) == BX_BOOLEAN_TRUE) {
+			memcpy(data, &value, 4);
+			return 0;
+		}
+	}
+
+	BX_LOG(LOG_ERROR, "memory_map_field", "Cannot read slot: update in progress");
+	return -1;
+}
+
+bx_int8 bx_mmap_open(const char *name) {
+	struct bx_mmap_header *header;
+	bx_boolean created;
+	int fd;
+
+	if (name == NULL || BX_ATOMIC_LOAD(&mmap_region.header) != NULL) {
+		return -1;
+	}
+
+	created = BX_BOOLEAN_TRUE;
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0 && errno == EEXIST) {
+		created = BX_BOOLEAN_FALSE;
+		fd = shm_open(name, O_RDWR, 0600);
+	}
+	if (fd < 0) {
+		BX_LOG(LOG_ERROR, "memory_map_field", "Cannot open region %s: %i", name, errno);
+		return -1;
+	}
+	if (created == BX_BOOLEAN_TRUE && ftruncate(fd, DM_MMAP_STORAGE_SIZE) != 0) {
+		BX_LOG(LOG_ERROR, "memory_map_field", "Cannot size region %s: %i", name, errno);
+		close(fd);
+		shm_unlink(name);
+		return -1;
+	}
+	// Accessing the mapping beyond the size of the object raises SIGBUS
+	if (created == BX_BOOLEAN_FALSE && region_wait_size(fd) != 0) {
+		BX_LOG(LOG_ERROR, "memory_map_field", "Region %s was not sized by its creator", name);
+		close(fd);
+		return -1;
+	}
+
+	header = mmap(NULL, DM_MMAP_STORAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (header == MAP_FAILED) {
+		BX_LOG(LOG_ERROR, "memory_map_field", "Cannot map region %s: %i", name, errno);
+		return -1;
+	}
+
+	if (created == BX_BOOLEAN_TRUE) {
+		region_format(header);
+	} else if (region_wait_format(header) != 0 ||
+			header->version != BX_MMAP_VERSION || header->slot_number > BX_MMAP_SLOT_NUMBER) {
+		BX_LOG(LOG_ERROR, "memory_map_field", "Invalid region %s", name);
+		munmap(header, DM_MMAP_STORAGE_SIZE);
+		return -1;
+	}
+
+	BX_ATOMIC_STORE(&mmap_region.header, header);
+
+	return 0;
+}
+
+bx_int8 bx_mmap_close() {
+	struct bx_mmap_header *header;
+
+	header = BX_ATOMIC_EXCHANGE(&mmap_region.header, NULL);
+	if (header == NULL) {
+		return -1;
+	}
+
+	// Wait for the accesses that found the region open
+	while (BX_ATOMIC_ADD(&mmap_region.users, 0) != 0) {
+		sched_yield();
+	}
+	munmap(header, DM_MMAP_STORAGE_SIZE);
+
+	return 0;
+}
+
+bx_int8 bx_mmap_field_init(struct bx_document_field *instance, enum bx_builtin_type type, bx_uint16 slot) {
+	struct bx_mmap_slot *mmap_slot;
+	bx_uint32 slot_type;
+
+	if (instance == NULL || (type != BX_INT && type != BX_FLOAT && type != BX_BOOL)) {
+		return -1;
+	}
+
+	mmap_slot = slot_acquire(slot);
+	if (mmap_slot == NULL) {
+		return -1;
+	}
+
+	slot_type = BX_MMAP_SLOT_UNUSED;
+	if (!BX_ATOMIC_COMPARE_EXCHANGE(&mmap_slot->type, &slot_type, (bx_uint32) type) && slot_type != type) {
+		slot_release();
+		BX_LOG(LOG_ERROR, "memory_map_field", "Slot %u already contains a value of type %u", slot, slot_type);
+		return -1;
+	}
+	slot_release();
+
+	instance->type = type;
+	instance->private_data = (void *) (size_t) slot;
+	instance->get = &mmap_field_get;
+	instance->set = &mmap_field_set;
+
+	return 0;
+}
+
+bx_int8 bx_mmap_write(bx_uint16 slot, void *data) {
+	struct bx_mmap_slot *mmap_slot;
+	bx_int8 error;
+
+	if (data == NULL) {
+		return -1;
+	}
+	mmap_slot = slot_acquire(slot);
+	if (mmap_slot == NULL) {
+		return -1;
+	}
+	error = slot_write(mmap_slot, data);
+	slot_release();
+
+	return error;
+}
+
+bx_int8 bx_mmap_read(bx_uint16 slot, void *data) {
+	struct bx_mmap_slot *mmap_slot;
+	bx_int8 error;
+
+	if (data == NULL) {
+		return -1;
+	}
+	mmap_slot = slot_acquire(slot);
+	if (mmap_slot == NULL) {
+		return -1;
+	}
+	error = slot_read(mmap_slot, data);
+	slot_release();
+
+	return error;
+}
+
+static bx_int8 mmap_field_get(struct bx_document_field *instance, void *data) {
+
+	if (instance == NULL) {
+		return -1;
+	}
+
+	return bx_mmap_read((bx_uint16) (size_t) instance->private_data, data);
+}
+
+static bx_int8 mmap_field_set(struct bx_document_field *instance, void *data) {
 
 	if (instance == NULL) {
 		return -1;
 	}
 
-	return 0; //TODO: Stub
+	return bx_mmap_write((bx_uint16) (size_t) instance->private_data, data);
 }
@@ -29,12 +29,100 @@
  *
  */
 
+/**
+ * Memory mapped fields.
+ * The values of memory mapped fields are stored in a POSIX shared memory
+ * region of DM_MMAP_STORAGE_SIZE bytes, so that external processes can
+ * publish values by writing them in place. The region starts with a header
+ * followed by an array of slots, all in host byte order:
+ *
+ * +--------+---------+-------------+----------+----------+-----+
+ * | Magic  | Version | Slot number | Slot 0   | Slot 1   | ... |
+ * | 32 bit | 16 bit  | 16 bit      | 128 bit  | 128 bit  |     |
+ * +--------+---------+-------------+----------+----------+-----+
+ *
+ * Each slot contains a sequence lock counter, the type of the value, the
+ * 32 bit value and a reserved word. Slot values are accessed through the
+ * sequence lock protocol of utils/seqlock.h with atomic 32 bit operations.
+ */
+
 #ifndef MEMORY_MAP_FIELD_H_
 #define MEMORY_MAP_FIELD_H_
 
 #include "types.h"
 #include "document_manager/document_manager.h"
 
-bx_int8 bx_mmap_field_init(struct bx_document_field *instance, enum bx_builtin_type type);
+#define BX_MMAP_MAGIC 0x42584D46
+#define BX_MMAP_VERSION 1
+#define BX_MMAP_SLOT_UNUSED 0xFFFFFFFF
+
+struct bx_mmap_header {
+	bx_uint32 magic;
+	bx_uint16 version;
+	bx_uint16 slot_number;
+};
+
+struct bx_mmap_slot {
+	bx_uint32 sequence;		///< Sequence lock counter
+	bx_uint32 type;			///< enum bx_builtin_type of the value, BX_MMAP_SLOT_UNUSED if unassigned
+	bx_uint32 value;
+	bx_uint32 reserved;
+};
+
+#define BX_MMAP_SLOT_NUMBER ((DM_MMAP_STORAGE_SIZE - sizeof (struct bx_mmap_header)) / sizeof (struct bx_mmap_slot))
+
+/**
+ * Opens the shared memory region, creating and initializing it if it does
+ * not exist. When another process is creating the region, waits up to
+ * DM_MMAP_OPEN_ATTEMPTS times DM_MMAP_OPEN_WAIT_USEC for it to be sized and
+ * initialized.
+ *
+ * @param name Name of the POSIX shared memory object, starting with a slash
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_mmap_open(const char *name);
+
+/**
+ * Unmaps the shared memory region once the accesses in progress complete.
+ * Memory mapped fields stay registered but their accesses fail until the
+ * region is opened again.
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_mmap_close(void);
+
+/**
+ * Initializes a field backed by a slot of the shared memory region.
+ * A slot is assigned to a type the first time it is used; the slot must be
+ * unassigned or already assigned to the same type.
+ *
+ * @param instance Field to initialize
+ * @param type Type of the field, BX_INT, BX_FLOAT or BX_BOOL
+ * @param slot Index of the slot
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_mmap_field_init(struct bx_document_field *instance, enum bx_builtin_type type, bx_uint16 slot);
+
+/**
+ * Writes a 32 bit value in a slot
+ *
+ * @param slot Index of the slot
+ * @param data Source memory location
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_mmap_write(bx_uint16 slot, void *data);
+
+/**
+ * Reads a consistent 32 bit value from a slot
+ *
+ * @param slot Index of the slot
+ * @param data Destination memory location
+ *
+ * @return 0 on success, -1 on failure or if a writer did not complete
+ */
+bx_int8 bx_mmap_read(bx_uint16 slot, void *data);
 
 #endif /* MEMORY_MAP_FIELD_H_ */
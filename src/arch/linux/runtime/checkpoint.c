@@ -0,0 +1,587 @@
+/*
+ * checkpoint.c
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "configuration.h"
+#include "logging.h"
+#include "runtime/checkpoint.h"
+#include "runtime/task_scheduler.h"
+#include "runtime/timer.h"
+#include "runtime/pcode_manager.h"
+#include "runtime/pcode_module.h"
+#include "document_manager/document_manager.h"
+#include "virtual_machine/virtual_machine.h"
+
+/**
+ * Rounds an offset up to a multiple of a power of two
+ */
+#define ALIGN_UP(offset, alignment) (((offset) + (alignment) - 1) & ~((bx_uint32) (alignment) - 1))
+
+/**
+ * Buffers holding the state while a checkpoint is saved or restored
+ */
+static struct bx_checkpoint {
+	struct bx_timer_state timers[TM_MAX_TIMERS];
+	struct bx_task_state task_states[EV_MAX_TASKS];
+	struct bx_checkpoint_task tasks[EV_MAX_TASKS];
+	struct bx_checkpoint_field fields[DM_MAX_FIELD_NUMBER];
+	bx_uint8 variables[VM_CONTEXT_NUMBER][VM_VARIABLE_TABLE_SIZE];
+	bx_boolean timer_slots[TM_MAX_TIMERS];
+	void *programs[EV_MAX_TASKS];
+	bx_size program_sizes[EV_MAX_TASKS];
+} checkpoint;
+
+/**
+ * Collects the tasks and their programs
+ *
+ * @param program_number Destination of the number of programs
+ *
+ * @return Number of tasks, -1 on failure
+ */
+static bx_ssize collect_tasks(bx_uint16 *program_number) {
+	struct bx_task_state *state;
+	struct bx_checkpoint_task *task;
+	bx_ssize task_number;
+	bx_ssize i;
+
+	task_number = bx_sched_get_task_states(checkpoint.task_states, EV_MAX_TASKS);
+	*program_number = 0;
+	for (i = 0; i < task_number; i++) {
+		state = &checkpoint.task_states[i];
+		task = &checkpoint.tasks[i];
+		memset(task, 0, sizeof (struct bx_checkpoint_task));
+		task->task_id = state->task_id;
+		task->native = state->native;
+		task->priority = state->priority;
+		task->overrun_policy = state->overrun_policy;
+		task->queue_limit = state->queue_limit;
+		task->requests = state->requests;
+		task->deadline_msec = state->deadline_msec;
+		if (state->native == BX_BOOLEAN_TRUE) {
+			continue;
+		}
+		if (bx_pcode_get_instructions(state->pcode, &checkpoint.programs[*program_number],
+				&checkpoint.program_sizes[*program_number]) != 0) {
+			return -1;
+		}
+		task->program = (*program_number)++;
+	}
+
+	return task_number;
+}
+
+/**
+ * Collects the values of the plain fields
+ *
+ * @return Number of fields
+ */
+static bx_size collect_fields() {
+	char identifier[DM_FIELD_IDENTIFIER_LENGTH + 1];
+	struct bx_checkpoint_field *field;
+	bx_uint32 version;
+	bx_size field_number;
+	bx_ssize handle;
+
+	field_number = 0;
+	identifier[DM_FIELD_IDENTIFIER_LENGTH] = '\0';
+	for (handle = 0; bx_docman_get_identifier(handle, identifier) == 0; handle++) {
+		// Computed fields take their values from elsewhere
+		if (bx_docman_get_storage(identifier) == NULL) {
+			continue;
+		}
+		field = &checkpoint.fields[field_number];
+		memcpy(field->identifier, identifier, DM_FIELD_IDENTIFIER_LENGTH);
+		if (bx_docman_get_versioned(handle, &field->value, &version) == 0) {
+			field_number++;
+		}
+	}
+
+	return field_number;
+}
+
+/**
+ * Writes a section of the checkpoint at its offset
+ *
+ * @param file Destination file
+ * @param offset Offset of the section
+ * @param data Section content
+ * @param length Section length
+ *
+ * @return BX_BOOLEAN_TRUE if the write failed, BX_BOOLEAN_FALSE otherwise
+ */
+static bx_boolean section_write(FILE *file, bx_uint32 offset, const void *data, size_t length) {
+
+	if (fseek(file, offset, SEEK_SET) != 0) {
+		return BX_BOOLEAN_TRUE;
+	}
+
+	return length > 0 && fwrite(data, length, 1, file) != 1;
+}
+
+/**
+ * Flushes a file to the disk
+ *
+ * @param path File path
+ *
+ * @return 0 on success, -1 on failure
+ */
+static bx_int8 file_sync(const char *path) {
+	bx_int8 error;
+	int fd;
+
+	fd = open(path, O_WRONLY);
+	if (fd < 0) {
+		return -1;
+	}
+	error = fdatasync(fd) == 0 ? 0 : -1;
+	close(fd);
+
+	return error;
+}
+
+/**
+ * Flushes the directory containing a file, making a rename durable
+ *
+ * @param path File path
+ *
+ * @return 0 on success, -1 on failure
+ */
+static bx_int8 directory_sync(const char *path) {
+	char directory[PATH_MAX];
+	char *separator;
+	bx_int8 error;
+	int fd;
+
+	strncpy(directory, path, PATH_MAX - 1);
+	directory[PATH_MAX - 1] = '\0';
+	separator = strrchr(directory, '/');
+	if (separator == NULL) {
+		strcpy(directory, ".");
+	} else if (separator == directory) {
+		separator[1] = '\0';
+	} else {
+		separator[0] = '\0';
+	}
+
+	fd = open(directory, O_RDONLY | O_DIRECTORY);
+	if (fd < 0) {
+		return -1;
+	}
+	error = fsync(fd) == 0 ? 0 : -1;
+	close(fd);
+
+	return error;
+}
+
+bx_int8 bx_checkpoint_save(const char *path) {
+	char temporary_path[PATH_MAX];
+	struct bx_checkpoint_header header;
+	bx_uint16 program_number;
+	bx_ssize timer_number;
+	bx_ssize task_number;
+	bx_size field_number;
+	bx_uint32 end;
+	bx_boolean error;
+	FILE *file;
+	bx_size i;
+
+	if (path == NULL || snprintf(temporary_path, PATH_MAX, "%s.tmp", path) >= PATH_MAX) {
+		return -1;
+	}
+
+	task_number = collect_tasks(&program_number);
+	timer_number = bx_timer_get_states(checkpoint.timers, TM_MAX_TIMERS);
+	if (task_number < 0 || timer_number < 0) {
+		BX_LOG(LOG_ERROR, "checkpoint", "Cannot read the runtime state");
+		return -1;
+	}
+	field_number = collect_fields();
+	for (i = 0; i < VM_CONTEXT_NUMBER; i++) {
+		bx_vm_get_variables(i, checkpoint.variables[i]);
+	}
+
+	memset(&header, 0, sizeof header);
+	header.magic = BX_CHECKPOINT_MAGIC;
+	header.version = BX_CHECKPOINT_VERSION;
+	header.instruction_set = BX_VM_INSTRUCTION_SET;
+	header.last_instruction = BX_INSTR_LAST;
+	header.timer_resolution_usec = bx_timer_get_resolution();
+	header.context_number = VM_CONTEXT_NUMBER;
+	header.variable_table_size = VM_VARIABLE_TABLE_SIZE;
+	header.timer_number = timer_number;
+	header.task_number = task_number;
+	header.field_number = field_number;
+	header.timer_offset = ALIGN_UP(sizeof header, 8);
+	header.task_offset = ALIGN_UP(header.timer_offset + timer_number * sizeof (struct bx_timer_state), 8);
+	header.field_offset = ALIGN_UP(header.task_offset + task_number * sizeof (struct bx_checkpoint_task), 8);
+	header.variable_offset = ALIGN_UP(header.field_offset + field_number * sizeof (struct bx_checkpoint_field), 8);
+	end = header.variable_offset + sizeof checkpoint.variables;
+	if (program_number > 0) {
+		header.module_offset = ALIGN_UP(end, sysconf(_SC_PAGESIZE));
+	}
+
+	file = fopen(temporary_path, "wb");
+	if (file == NULL) {
+		BX_LOG(LOG_ERROR, "checkpoint", "Cannot create %s: %i", temporary_path, errno);
+		return -1;
+	}
+	error = section_write(file, 0, &header, sizeof header);
+	error |= section_write(file, header.timer_offset, checkpoint.timers,
+			timer_number * sizeof (struct bx_timer_state));
+	error |= section_write(file, header.task_offset, checkpoint.tasks,
+			task_number * sizeof (struct bx_checkpoint_task));
+	error |= section_write(file, header.field_offset, checkpoint.fields,
+			field_number * sizeof (struct bx_checkpoint_field));
+	error |= section_write(file, header.variable_offset, checkpoint.variables, sizeof checkpoint.variables);
+	if (program_number > 0) {
+		// Extend the file up to the page boundary where the module begins
+		error |= ftruncate(fileno(file), header.module_offset) != 0;
+	}
+	if (fclose(file) != 0 || error) {
+		BX_LOG(LOG_ERROR, "checkpoint", "Cannot write %s", temporary_path);
+		unlink(temporary_path);
+		return -1;
+	}
+
+	if ((program_number > 0 && bx_pmod_append(temporary_path, checkpoint.programs,
+			checkpoint.program_sizes, program_number) != 0)
+			|| file_sync(temporary_path) != 0 || rename(temporary_path, path) != 0) {
+		BX_LOG(LOG_ERROR, "checkpoint", "Cannot save %s: %i", path, errno);
+		unlink(temporary_path);
+		return -1;
+	}
+	if (directory_sync(path) != 0) {
+		BX_LOG(LOG_WARNING, "checkpoint", "Cannot flush the directory of %s: %i", path, errno);
+	}
+
+	return 0;
+}
+
+/**
+ * Checks that the header of a checkpoint matches this runtime and that its
+ * sections are inside the file
+ *
+ * @param header Checkpoint header
+ * @param length File length
+ *
+ * @return 0 if the checkpoint is usable, -1 otherwise
+ */
+static bx_int8 check_header(const struct bx_checkpoint_header *header, size_t length) {
+
+	if (length < sizeof (struct bx_checkpoint_header) || header->magic != BX_CHECKPOINT_MAGIC
+			|| header->version != BX_CHECKPOINT_VERSION || header->instruction_set != BX_VM_INSTRUCTION_SET) {
+		return -1;
+	}
+	if (header->context_number != VM_CONTEXT_NUMBER || header->variable_table_size != VM_VARIABLE_TABLE_SIZE
+			|| header->timer_number > TM_MAX_TIMERS || header->task_number > EV_MAX_TASKS
+			|| header->field_number > DM_MAX_FIELD_NUMBER) {
+		return -1;
+	}
+	if (header->timer_offset + (size_t) header->timer_number * sizeof (struct bx_timer_state) > length
+			|| header->task_offset + (size_t) header->task_number * sizeof (struct bx_checkpoint_task) > length
+			|| header->field_offset + (size_t) header->field_number * sizeof (struct bx_checkpoint_field) > length
+			|| header->variable_offset + sizeof checkpoint.variables > length
+			|| header->module_offset > length) {
+		return -1;
+	}
+	if (header->timer_offset % 8 != 0 || header->task_offset % 8 != 0 || header->field_offset % 8 != 0) {
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Checks that the tasks and the timers of a checkpoint can be restored
+ * without modifying the runtime, and opens the module holding the programs.
+ * The programs are validated unless the checkpoint was written by a virtual
+ * machine with the same instructions.
+ *
+ * @param path Path of the checkpoint file
+ * @param header Checkpoint header
+ * @param tasks Task records
+ * @param timers Timer records
+ * @param module Destination of the module, NULL if there are no programs
+ *
+ * @return 0 if the checkpoint can be restored, -1 otherwise
+ */
+static bx_int8 check_records(const char *path, const struct bx_checkpoint_header *header,
+		const struct bx_checkpoint_task *tasks, const struct bx_timer_state *timers,
+		struct bx_pcode_module **module) {
+	bx_ssize existing_number;
+	bx_int32 program_number;
+	bx_boolean native_found;
+	bx_boolean found;
+	bx_uint16 table_slot;
+	bx_ssize j;
+	bx_uint32 i;
+
+	*module = NULL;
+	if (bx_timer_get_states(checkpoint.timers, TM_MAX_TIMERS) != 0 || header->timer_resolution_usec < TM_MIN_RESOLUTION_USEC) {
+		return -1;
+	}
+	memset(checkpoint.timer_slots, 0, sizeof checkpoint.timer_slots);
+	for (i = 0; i < header->timer_number; i++) {
+		table_slot = timers[i].timer_id % TM_MAX_TIMERS;
+		if (timers[i].timer_id < 0 || timers[i].remaining_ticks == 0 || checkpoint.timer_slots[table_slot]) {
+			return -1;
+		}
+		checkpoint.timer_slots[table_slot] = BX_BOOLEAN_TRUE;
+	}
+
+	program_number = 0;
+	if (header->module_offset != 0) {
+		if (header->last_instruction == BX_INSTR_LAST) {
+			*module = bx_pmod_open_trusted(path, header->module_offset);
+		} else {
+			BX_LOG(LOG_INFO, "checkpoint", "Instructions changed since %s was saved, validating programs", path);
+			*module = bx_pmod_open_at(path, header->module_offset);
+		}
+		program_number = bx_pmod_program_number(*module);
+		if (program_number < 0) {
+			return -1;
+		}
+	}
+
+	existing_number = bx_sched_get_task_states(checkpoint.task_states, EV_MAX_TASKS);
+	for (i = 0; i < header->task_number; i++) {
+		found = BX_BOOLEAN_FALSE;
+		native_found = BX_BOOLEAN_FALSE;
+		for (j = 0; j < existing_number; j++) {
+			if (checkpoint.task_states[j].task_id == tasks[i].task_id) {
+				found = BX_BOOLEAN_TRUE;
+				native_found = checkpoint.task_states[j].native;
+			}
+		}
+		// Native tasks have been added again by the application, pcode tasks are created
+		if (tasks[i].task_id < 0 || tasks[i].task_id >= EV_MAX_TASKS || tasks[i].priority >= EV_PRIORITY_LEVELS
+				|| tasks[i].overrun_policy > BX_SCHED_OVERRUN_DEGRADE
+				|| (tasks[i].native == BX_BOOLEAN_TRUE && native_found == BX_BOOLEAN_FALSE)
+				|| (tasks[i].native == BX_BOOLEAN_FALSE && (found == BX_BOOLEAN_TRUE || tasks[i].program >= program_number))) {
+			BX_LOG(LOG_ERROR, "checkpoint", "Cannot restore task %i", tasks[i].task_id);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Removes the pcode tasks restored from a checkpoint
+ *
+ * @param tasks Task records
+ * @param task_number Number of records whose task was restored
+ */
+static void remove_tasks(const struct bx_checkpoint_task *tasks, bx_uint32 task_number) {
+	bx_uint32 i;
+
+	for (i = 0; i < task_number; i++) {
+		if (tasks[i].native == BX_BOOLEAN_FALSE) {
+			bx_sched_remove_task(tasks[i].task_id);
+		}
+	}
+}
+
+/**
+ * Restores the tasks of a checkpoint. On failure the restored tasks are
+ * removed again.
+ *
+ * @param header Checkpoint header
+ * @param tasks Task records
+ * @param module Module holding the programs
+ *
+ * @return 0 on success, -1 on failure
+ */
+static bx_int8 restore_tasks(const struct bx_checkpoint_header *header,
+		const struct bx_checkpoint_task *tasks, struct bx_pcode_module *module) {
+	struct bx_pcode *pcode;
+	bx_uint32 i;
+
+	for (i = 0; i < header->task_number; i++) {
+		if (tasks[i].native == BX_BOOLEAN_TRUE) {
+			continue;
+		}
+		pcode = bx_pmod_load(module, tasks[i].program);
+		if (bx_sched_restore_pcode_task(tasks[i].task_id, pcode, tasks[i].priority, tasks[i].deadline_msec) != 0) {
+			BX_LOG(LOG_ERROR, "checkpoint", "Cannot restore task %i", tasks[i].task_id);
+			remove_tasks(tasks, i);
+			return -1;
+		}
+	}
+	for (i = 0; i < header->task_number; i++) {
+		bx_sched_set_overrun_policy(tasks[i].task_id, tasks[i].overrun_policy, tasks[i].queue_limit);
+	}
+
+	return 0;
+}
+
+/**
+ * Restores the timers of a checkpoint. On failure the restored timers are
+ * cancelled again.
+ *
+ * @param header Checkpoint header
+ * @param timers Timer records
+ *
+ * @return 0 on success, -1 on failure
+ */
+static bx_int8 restore_timers(const struct bx_checkpoint_header *header, const struct bx_timer_state *timers) {
+	bx_uint32 i;
+	bx_uint32 j;
+
+	for (i = 0; i < header->timer_number; i++) {
+		if (bx_timer_restore(&timers[i]) != 0) {
+			for (j = 0; j < i; j++) {
+				bx_timer_cancel(timers[j].timer_id);
+			}
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+bx_int8 bx_checkpoint_restore(const char *path) {
+	char identifier[DM_FIELD_IDENTIFIER_LENGTH + 1];
+	const struct bx_checkpoint_header *header;
+	const struct bx_checkpoint_task *tasks;
+	const struct bx_checkpoint_field *fields;
+	const struct bx_timer_state *timers;
+	const bx_uint8 *variables;
+	struct bx_pcode_module *module;
+	struct bx_field_storage *storage;
+	struct stat file_status;
+	bx_uint32 resolution_usec;
+	bx_uint8 *address;
+	bx_uint16 request;
+	bx_uint32 i;
+	bx_int8 error;
+	int fd;
+
+	if (path == NULL) {
+		return -1;
+	}
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		BX_LOG(LOG_ERROR, "checkpoint", "Cannot open %s: %i", path, errno);
+		return -1;
+	}
+	if (fstat(fd, &file_status) != 0 || file_status.st_size == 0) {
+		close(fd);
+		return -1;
+	}
+	address = mmap(NULL, file_status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (address == MAP_FAILED) {
+		BX_LOG(LOG_ERROR, "checkpoint", "Cannot map %s: %i", path, errno);
+		return -1;
+	}
+
+	header = (const struct bx_checkpoint_header *) address;
+	if (check_header(header, file_status.st_size) != 0) {
+		BX_LOG(LOG_ERROR, "checkpoint", "Invalid checkpoint %s", path);
+		munmap(address, file_status.st_size);
+		return -1;
+	}
+	timers = (const struct bx_timer_state *) (address + header->timer_offset);
+	tasks = (const struct bx_checkpoint_task *) (address + header->task_offset);
+	fields = (const struct bx_checkpoint_field *) (address + header->field_offset);
+	variables = address + header->variable_offset;
+
+	// Check everything before modifying the runtime
+	if (check_records(path, header, tasks, timers, &module) != 0) {
+		BX_LOG(LOG_ERROR, "checkpoint", "Cannot restore %s", path);
+		if (module != NULL) {
+			bx_pmod_close(module);
+		}
+		munmap(address, file_status.st_size);
+		return -1;
+	}
+
+	resolution_usec = bx_timer_get_resolution();
+	error = 0;
+	if (resolution_usec != header->timer_resolution_usec) {
+		error = bx_timer_set_resolution(header->timer_resolution_usec);
+	}
+	if (error == 0) {
+		error = restore_tasks(header, tasks, module);
+		if (error == 0 && restore_timers(header, timers) != 0) {
+			remove_tasks(tasks, header->task_number);
+			error = -1;
+		}
+		if (error != 0 && resolution_usec != header->timer_resolution_usec) {
+			bx_timer_set_resolution(resolution_usec);
+		}
+	}
+	// The mapping stays alive as long as the programs use it
+	if (module != NULL) {
+		bx_pmod_close(module);
+	}
+	if (error != 0) {
+		BX_LOG(LOG_ERROR, "checkpoint", "Cannot restore %s", path);
+		munmap(address, file_status.st_size);
+		return -1;
+	}
+
+	identifier[DM_FIELD_IDENTIFIER_LENGTH] = '\0';
+	for (i = 0; i < header->field_number; i++) {
+		memcpy(identifier, fields[i].identifier, DM_FIELD_IDENTIFIER_LENGTH);
+		storage = bx_docman_get_storage(identifier);
+		if (storage == NULL) {
+			BX_LOG(LOG_WARNING, "checkpoint", "Field %s is not a plain field anymore", identifier);
+			continue;
+		}
+		bx_docman_write_storage(storage, fields[i].value);
+	}
+	for (i = 0; i < VM_CONTEXT_NUMBER; i++) {
+		bx_vm_set_variables(i, variables + i * VM_VARIABLE_TABLE_SIZE);
+	}
+
+	// Executions that were pending when the checkpoint was saved
+	for (i = 0; i < header->task_number; i++) {
+		for (request = 0; request < tasks[i].requests; request++) {
+			if (bx_sched_schedule_task(tasks[i].task_id) != 0) {
+				break;
+			}
+		}
+	}
+	munmap(address, file_status.st_size);
+
+	return 0;
+}
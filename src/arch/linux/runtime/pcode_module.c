@@ -0,0 +1,422 @@
+/*
+ * pcode_module.c
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "configuration.h"
+#include "logging.h"
+#include "utils/memory_utils.h"
+#include "runtime/pcode_module.h"
+#include "runtime/pcode_manager.h"
+#include "runtime/critical_section.h"
+#include "virtual_machine/virtual_machine.h"
+
+struct bx_pcode_module {
+	bx_uint8 *address;			///< Read-only mapping of the module file
+	size_t length;				///< Mapping length in bytes
+	bx_uint16 program_number;
+	bx_uint32 references;		///< Open handle plus programs in the pcode repository
+	bx_boolean used;
+	bx_boolean open;
+};
+
+static struct bx_pcode_module module_table[PR_MAX_MODULES];
+
+/**
+ * Reads an entry of the program table
+ *
+ * @param address Beginning of the module
+ * @param index Program index
+ * @param offset Destination of the program offset
+ * @param size Destination of the program size
+ */
+static void read_entry(bx_uint8 *address, bx_uint16 index, bx_uint32 *offset, bx_uint32 *size) {
+	bx_uint8 *entry;
+
+	entry = address + BX_PCODE_MODULE_HEADER_SIZE + index * BX_PCODE_MODULE_ENTRY_SIZE;
+	BX_MUTILS_BTH_COPY(offset, entry, 4);
+	BX_MUTILS_BTH_COPY(size, entry + 4, 4);
+}
+
+/**
+ * Checks the header, the program table and the programs of a module
+ *
+ * @param address Beginning of the module
+ * @param length Module length in bytes
+ * @param check_programs BX_BOOLEAN_FALSE to skip the validation of the program code
+ * @param program_number Destination of the number of programs
+ *
+ * @return 0 if the module is valid, -1 otherwise
+ */
+static bx_int8 validate_module(bx_uint8 *address, size_t length, bx_boolean check_programs,
+		bx_uint16 *program_number) {
+	bx_uint32 magic;
+	bx_uint16 version;
+	bx_uint32 table_end;
+	bx_uint32 offset;
+	bx_uint32 size;
+	bx_uint16 i;
+
+	if (length < BX_PCODE_MODULE_HEADER_SIZE) {
+		return -1;
+	}
+	BX_MUTILS_BTH_COPY(&magic, address, 4);
+	BX_MUTILS_BTH_COPY(&version, address + 4, 2);
+	BX_MUTILS_BTH_COPY(program_number, address + 6, 2);
+	if (magic != BX_PCODE_MODULE_MAGIC || version != BX_PCODE_MODULE_VERSION) {
+		return -1;
+	}
+
+	table_end = BX_PCODE_MODULE_HEADER_SIZE + *program_number * BX_PCODE_MODULE_ENTRY_SIZE;
+	if (table_end > length) {
+		return -1;
+	}
+
+	for (i = 0; i < *program_number; i++) {
+		read_entry(address, i, &offset, &size);
+		if (offset < table_end || size == 0 || size > 0xFFFF || offset > length || size > length - offset) {
+			return -1;
+		}
+		if (check_programs == BX_BOOLEAN_TRUE && bx_vm_validate(address + offset, size) != 0) {
+			BX_LOG(LOG_ERROR, "pcode_module", "Program %u contains invalid code", i);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Maps a module stored in a file and adds it to the module table
+ *
+ * @param path Path of the file
+ * @param offset Offset of the module inside the file, multiple of the page size
+ * @param check_programs BX_BOOLEAN_FALSE to skip the validation of the program code
+ *
+ * @return Module instance pointer, NULL on error or invalid module
+ */
+static struct bx_pcode_module *module_open(const char *path, bx_uint32 offset, bx_boolean check_programs) {
+	struct bx_pcode_module *module;
+	struct stat file_status;
+	bx_uint16 program_number;
+	void *address;
+	size_t length;
+	int fd;
+	bx_size i;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		BX_LOG(LOG_ERROR, "pcode_module", "Cannot open module %s: %i", path, errno);
+		return NULL;
+	}
+	if (fstat(fd, &file_status) != 0 || file_status.st_size <= offset) {
+		close(fd);
+		return NULL;
+	}
+	length = file_status.st_size - offset;
+	address = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, offset);
+	close(fd);
+	if (address == MAP_FAILED) {
+		BX_LOG(LOG_ERROR, "pcode_module", "Cannot map module %s: %i", path, errno);
+		return NULL;
+	}
+
+	if (validate_module(address, length, check_programs, &program_number) != 0) {
+		BX_LOG(LOG_ERROR, "pcode_module", "Invalid module %s", path);
+		munmap(address, length);
+		return NULL;
+	}
+
+	bx_critical_enter();
+	module = NULL;
+	for (i = 0; i < PR_MAX_MODULES; i++) {
+		if (module_table[i].used == BX_BOOLEAN_FALSE) {
+			module = &module_table[i];
+			break;
+		}
+	}
+	if (module == NULL) {
+		bx_critical_exit();
+		BX_LOG(LOG_ERROR, "pcode_module", "Cannot open module %s: too many modules", path);
+		munmap(address, length);
+		return NULL;
+	}
+	module->address = address;
+	module->length = length;
+	module->program_number = program_number;
+	module->references = 1;
+	module->used = BX_BOOLEAN_TRUE;
+	module->open = BX_BOOLEAN_TRUE;
+	bx_critical_exit();
+
+	return module;
+}
+
+struct bx_pcode_module *bx_pmod_open(const char *path) {
+
+	if (path == NULL) {
+		return NULL;
+	}
+
+	return module_open(path, 0, BX_BOOLEAN_TRUE);
+}
+
+struct bx_pcode_module *bx_pmod_open_trusted(const char *path, bx_uint32 offset) {
+
+	if (path == NULL || offset % sysconf(_SC_PAGESIZE) != 0) {
+		return NULL;
+	}
+
+	return module_open(path, offset, BX_BOOLEAN_FALSE);
+}
+
+struct bx_pcode_module *bx_pmod_open_at(const char *path, bx_uint32 offset) {
+
+	if (path == NULL || offset % sysconf(_SC_PAGESIZE) != 0) {
+		return NULL;
+	}
+
+	return module_open(path, offset, BX_BOOLEAN_TRUE);
+}
+
+bx_int32 bx_pmod_program_number(struct bx_pcode_module *module) {
+
+	if (module == NULL || module->open == BX_BOOLEAN_FALSE) {
+		return -1;
+	}
+
+	return module->program_number;
+}
+
+struct bx_pcode *bx_pmod_load(struct bx_pcode_module *module, bx_uint16 index) {
+	struct bx_pcode *pcode;
+	bx_uint32 offset;
+	bx_uint32 size;
+
+	if (module == NULL) {
+		return NULL;
+	}
+
+	bx_critical_enter();
+	if (module->open == BX_BOOLEAN_FALSE || index >= module->program_number) {
+		bx_critical_exit();
+		return NULL;
+	}
+	read_entry(module->address, index, &offset, &size);
+	pcode = bx_pcode_add_in_place(module->address + offset, size, module);
+	if (pcode != NULL) {
+		module->references++;
+	}
+	bx_critical_exit();
+
+	return pcode;
+}
+
+bx_int8 bx_pmod_close(struct bx_pcode_module *module) {
+
+	if (module == NULL) {
+		return -1;
+	}
+
+	bx_critical_enter();
+	if (module->open == BX_BOOLEAN_FALSE) {
+		bx_critical_exit();
+		return -1;
+	}
+	module->open = BX_BOOLEAN_FALSE;
+	bx_pmod_release(module);
+	bx_critical_exit();
+
+	return 0;
+}
+
+void bx_pmod_release(struct bx_pcode_module *module) {
+
+	bx_critical_enter();
+	module->references--;
+	if (module->references == 0) {
+		munmap(module->address, module->length);
+		module->address = NULL;
+		module->used = BX_BOOLEAN_FALSE;
+	}
+	bx_critical_exit();
+}
+
+/**
+ * Writes a module at the current position of a file
+ *
+ * @param file Destination file
+ * @param programs Array of programs
+ * @param sizes Array of program sizes
+ * @param program_number Number of programs
+ *
+ * @return BX_BOOLEAN_TRUE if a write failed, BX_BOOLEAN_FALSE otherwise
+ */
+static bx_boolean module_write(FILE *file, void **programs, bx_size *sizes, bx_uint16 program_number) {
+	bx_uint8 field[4];
+	bx_uint32 value;
+	bx_uint16 version;
+	bx_uint32 offset;
+	bx_uint16 i;
+	bx_boolean error;
+
+	error = BX_BOOLEAN_FALSE;
+	value = BX_PCODE_MODULE_MAGIC;
+	BX_MUTILS_HTB_COPY(field, &value, 4);
+	error |= fwrite(field, 4, 1, file) != 1;
+	version = BX_PCODE_MODULE_VERSION;
+	BX_MUTILS_HTB_COPY(field, &version, 2);
+	error |= fwrite(field, 2, 1, file) != 1;
+	BX_MUTILS_HTB_COPY(field, &program_number, 2);
+	error |= fwrite(field, 2, 1, file) != 1;
+
+	offset = BX_PCODE_MODULE_HEADER_SIZE + program_number * BX_PCODE_MODULE_ENTRY_SIZE;
+	for (i = 0; i < program_number; i++) {
+		BX_MUTILS_HTB_COPY(field, &offset, 4);
+		error |= fwrite(field, 4, 1, file) != 1;
+		value = sizes[i];
+		BX_MUTILS_HTB_COPY(field, &value, 4);
+		error |= fwrite(field, 4, 1, file) != 1;
+		offset += sizes[i];
+	}
+	for (i = 0; i < program_number; i++) {
+		error |= fwrite(programs[i], 1, sizes[i], file) != sizes[i];
+	}
+
+	return error;
+}
+
+/**
+ * Writes a module in a file opened with the given mode and flushes it to the
+ * disk
+ *
+ * @param path Path of the file
+ * @param mode Mode passed to fopen
+ * @param programs Array of programs
+ * @param sizes Array of program sizes
+ * @param program_number Number of programs
+ *
+ * @return 0 on success, -1 on failure
+ */
+static bx_int8 module_save(const char *path, const char *mode, void **programs, bx_size *sizes,
+		bx_uint16 program_number) {
+	FILE *file;
+	bx_boolean error;
+
+	file = fopen(path, mode);
+	if (file == NULL) {
+		BX_LOG(LOG_ERROR, "pcode_module", "Cannot create module %s: %i", path, errno);
+		return -1;
+	}
+
+	error = module_write(file, programs, sizes, program_number);
+	error |= fflush(file) != 0 || fdatasync(fileno(file)) != 0;
+	if (fclose(file) != 0 || error) {
+		BX_LOG(LOG_ERROR, "pcode_module", "Error writing module %s", path);
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Flushes the directory containing a file, making a rename durable
+ *
+ * @param path File path
+ *
+ * @return 0 on success, -1 on failure
+ */
+static bx_int8 directory_sync(const char *path) {
+	char directory[PATH_MAX];
+	char *separator;
+	bx_int8 error;
+	int fd;
+
+	strncpy(directory, path, PATH_MAX - 1);
+	directory[PATH_MAX - 1] = '\0';
+	separator = strrchr(directory, '/');
+	if (separator == NULL) {
+		strcpy(directory, ".");
+	} else if (separator == directory) {
+		separator[1] = '\0';
+	} else {
+		separator[0] = '\0';
+	}
+
+	fd = open(directory, O_RDONLY | O_DIRECTORY);
+	if (fd < 0) {
+		return -1;
+	}
+	error = fsync(fd) == 0 ? 0 : -1;
+	close(fd);
+
+	return error;
+}
+
+bx_int8 bx_pmod_write(const char *path, void **programs, bx_size *sizes, bx_uint16 program_number) {
+	char temporary_path[PATH_MAX];
+
+	if (path == NULL || (program_number > 0 && (programs == NULL || sizes == NULL))
+			|| snprintf(temporary_path, PATH_MAX, "%s.tmp", path) >= PATH_MAX) {
+		return -1;
+	}
+
+	// Never truncate the module in place: processes may have it mapped
+	if (module_save(temporary_path, "wb", programs, sizes, program_number) != 0) {
+		unlink(temporary_path);
+		return -1;
+	}
+	if (rename(temporary_path, path) != 0) {
+		BX_LOG(LOG_ERROR, "pcode_module", "Cannot replace module %s: %i", path, errno);
+		unlink(temporary_path);
+		return -1;
+	}
+	if (directory_sync(path) != 0) {
+		BX_LOG(LOG_WARNING, "pcode_module", "Cannot flush the directory of %s: %i", path, errno);
+	}
+
+	return 0;
+}
+
+bx_int8 bx_pmod_append(const char *path, void **programs, bx_size *sizes, bx_uint16 program_number) {
+
+	if (path == NULL || (program_number > 0 && (programs == NULL || sizes == NULL))) {
+		return -1;
+	}
+
+	return module_save(path, "ab", programs, sizes, program_number);
+}
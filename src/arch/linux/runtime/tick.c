@@ -32,70 +32,186 @@
 #include <pthread.h>
 #include <time.h>
 #include <errno.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
 #include "logging.h"
+#include "atomic.h"
+#include "utils/seqlock.h"
 #include "runtime/tick.h"
 #include "runtime/critical_section.h"
 
+/*
+ * Tickless implementation: the tick count is derived from the monotonic clock
+ * and the tick thread sleeps on a timerfd armed with the absolute time of the
+ * next tick requested through bx_tick_set_next.
+ * With the virtual clock there is no tick thread: time only advances through
+ * bx_tick_step, which invokes the callback in the calling thread.
+ */
 static struct bx_tick {
 	pthread_t thread;
 	pthread_attr_t attr;
 	bx_tick_callback callback;
-	int period_msec;
-	bx_uint64 count;
+	bx_uint32 period_usec;		///< Written with start_usec under the sequence lock
+	int timer_fd;
+	bx_uint64 start_usec;		///< Monotonic time of tick 0, moved when the period changes
+	bx_uint32 sequence;			///< Sequence lock publishing start_usec and period_usec together
+	bx_uint64 next_tick;		///< Tick at which the callback is invoked, BX_TICK_IDLE if none
+	bx_uint64 stop_count;		///< Tick count at the time the tick process was stopped
+	bx_boolean running;			///< Accessed atomically
 	bx_boolean paused;
+	bx_boolean virtual_clock;	///< Simulated time instead of the monotonic clock
+	bx_uint64 virtual_usec;		///< Simulated time, accessed atomically
 } tick;
 
-void *tick_routine(void *arg) {
-	int error;
-	struct timespec period;
+/**
+ * Arms the timerfd to expire at the beginning of a tick
+ *
+ * @param tick_count Tick to wait for, BX_TICK_IDLE to disarm
+ */
+static void arm_timer(bx_uint64 tick_count) {
+	struct itimerspec timer_spec;
+	bx_uint64 expiry_usec;
 
-	period.tv_sec = (1000 * 1000 * tick.period_msec) / (1000 * 1000 * 1000);
-	period.tv_nsec = (1000 * 1000 * tick.period_msec) % (1000 * 1000 * 1000);
+	timer_spec.it_interval.tv_sec = 0;
+	timer_spec.it_interval.tv_nsec = 0;
+	if (tick_count == BX_TICK_IDLE) {
+		timer_spec.it_value.tv_sec = 0;
+		timer_spec.it_value.tv_nsec = 0;
+	} else {
+		expiry_usec = tick.start_usec + tick_count * tick.period_usec;
+		timer_spec.it_value.tv_sec = expiry_usec / (1000 * 1000);
+		timer_spec.it_value.tv_nsec = (expiry_usec % (1000 * 1000)) * 1000;
+	}
+
+	if (timerfd_settime(tick.timer_fd, TFD_TIMER_ABSTIME, &timer_spec, NULL) != 0) {
+		BX_LOG(LOG_ERROR, "tick", "Error arming timer: %i", errno);
+	}
+}
+
+/**
+ * Moves tick 0 to the current time and changes the period. Writers are
+ * serialized by the critical section, readers of the pair use get_time_base.
+ *
+ * @param period_usec Tick period
+ */
+static void set_time_base(bx_uint32 period_usec) {
+
+	while (bx_seqlock_write_try_begin(&tick.sequence) == BX_BOOLEAN_FALSE) {
+		continue;
+	}
+	BX_ATOMIC_STORE(&tick.start_usec, bx_tick_get_time_usec());
+	BX_ATOMIC_STORE(&tick.period_usec, period_usec);
+	bx_seqlock_write_end(&tick.sequence);
+}
+
+/**
+ * Reads the start time and the period without entering the critical section
+ *
+ * @param start_usec Monotonic time of tick 0
+ * @param period_usec Tick period
+ */
+static void get_time_base(bx_uint64 *start_usec, bx_uint32 *period_usec) {
+	bx_uint32 start;
+
+	do {
+		start = bx_seqlock_read_begin(&tick.sequence);
+		*start_usec = BX_ATOMIC_LOAD(&tick.start_usec);
+		*period_usec = BX_ATOMIC_LOAD(&tick.period_usec);
+	} while (bx_seqlock_read_end(&tick.sequence, start) == BX_BOOLEAN_FALSE);
+}
+
+void *tick_routine(void *arg) {
+	bx_uint64 expirations;
+	ssize_t read_size;
 
 	while (1) {
-		bx_critical_enter();
+		read_size = read(tick.timer_fd, &expirations, sizeof expirations);
+		if (read_size != sizeof expirations) {
+			BX_LOG(LOG_DEBUG, "tick", "Error waiting for the timer: %i", errno);
+			continue;
+		}
 
-		++tick.count;
+		// A request received while paused is served on resume
+		bx_critical_enter();
 		if (!tick.paused) {
+			tick.next_tick = BX_TICK_IDLE;
 			tick.callback();
 		}
-
 		bx_critical_exit();
-
-		error = nanosleep(&period, NULL);
-		if (error != 0) {
-			BX_LOG(LOG_DEBUG, "tick", "Error sleeping: %i", errno);
-		}
-		pthread_testcancel();
 	}
 
 	return NULL;
 }
 
-bx_int8 bx_tick_start(bx_int32 period_msec, bx_tick_callback callback) {
+bx_int8 bx_tick_start(bx_uint32 period_usec, bx_tick_callback callback) {
 	int error;
 
+	if (period_usec == 0) {
+		return -1;
+	}
+
 	BX_LOG(LOG_DEBUG, "tick", "Starting tick process...");
 	tick.callback = callback;
-	tick.period_msec = period_msec;
-	tick.count = 0;
+	tick.next_tick = BX_TICK_IDLE;
+	tick.paused = BX_BOOLEAN_FALSE;
+	set_time_base(period_usec);
+
+	if (tick.virtual_clock == BX_BOOLEAN_TRUE) {
+		BX_ATOMIC_STORE(&tick.running, BX_BOOLEAN_TRUE);
+		BX_LOG(LOG_DEBUG, "tick", "Tick process started on the virtual clock");
+		return 0;
+	}
+
+	tick.timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	if (tick.timer_fd < 0) {
+		BX_LOG(LOG_ERROR, "tick", "Error creating timer: %i", errno);
+		return -1;
+	}
 
 	error = pthread_attr_init(&tick.attr);
 	if (error != 0) {
+		close(tick.timer_fd);
 		return -1;
 	}
 	error = pthread_create(&tick.thread, &tick.attr, tick_routine, NULL);
 	if (error != 0) {
 		pthread_attr_destroy(&tick.attr);
+		close(tick.timer_fd);
 		return -1;
 	}
 
-	tick.paused = BX_BOOLEAN_FALSE;
+	BX_ATOMIC_STORE(&tick.running, BX_BOOLEAN_TRUE);
 	BX_LOG(LOG_DEBUG, "tick", "Tick process started");
 
 	return 0;
 }
 
+void bx_tick_set_next(bx_uint64 tick_count) {
+	bx_critical_enter();
+	tick.next_tick = tick_count;
+	if (!tick.paused && !tick.virtual_clock) {
+		arm_timer(tick_count);
+	}
+	bx_critical_exit();
+}
+
+bx_int8 bx_tick_set_period(bx_uint32 period_usec) {
+
+	if (period_usec == 0) {
+		return -1;
+	}
+
+	bx_critical_enter();
+	set_time_base(period_usec);
+	tick.next_tick = BX_TICK_IDLE;
+	if (!tick.paused && !tick.virtual_clock) {
+		arm_timer(BX_TICK_IDLE);
+	}
+	bx_critical_exit();
+
+	return 0;
+}
+
 void bx_tick_pause() {
 	bx_critical_enter();
 	tick.paused = BX_BOOLEAN_TRUE;
@@ -105,26 +221,100 @@ void bx_tick_pause() {
 void bx_tick_resume() {
 	bx_critical_enter();
 	tick.paused = BX_BOOLEAN_FALSE;
+	if (!tick.virtual_clock) {
+		arm_timer(tick.next_tick);
+	}
 	bx_critical_exit();
 }
 
 bx_uint64 bx_tick_get_count() {
-	bx_uint64 tick_count_copy;
+	bx_uint64 start_usec;
+	bx_uint32 period_usec;
 
-	bx_critical_enter();
-	tick_count_copy = tick.count;
-	bx_critical_exit();
+	if (BX_ATOMIC_LOAD(&tick.running) == BX_BOOLEAN_FALSE) {
+		return tick.stop_count;
+	}
+
+	get_time_base(&start_usec, &period_usec);
+
+	return (bx_tick_get_time_usec() - start_usec) / period_usec;
+}
+
+bx_uint64 bx_tick_get_tick_time_usec(bx_uint64 tick_count) {
+	bx_uint64 start_usec;
+	bx_uint32 period_usec;
+
+	get_time_base(&start_usec, &period_usec);
+
+	return start_usec + tick_count * period_usec;
+}
+
+bx_uint64 bx_tick_get_time_usec() {
+	struct timespec now;
+
+	if (tick.virtual_clock == BX_BOOLEAN_TRUE) {
+		return BX_ATOMIC_LOAD(&tick.virtual_usec);
+	}
 
-	return tick_count_copy;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (bx_uint64) now.tv_sec * 1000 * 1000 + now.tv_nsec / 1000;
 }
 
 bx_int8 bx_tick_stop() {
 
 	BX_LOG(LOG_DEBUG, "tick", "Stopping tick process...");
-	pthread_cancel(tick.thread);
-	pthread_join(tick.thread, NULL);
-	pthread_attr_destroy(&tick.attr);
+	if (tick.virtual_clock == BX_BOOLEAN_FALSE) {
+		pthread_cancel(tick.thread);
+		pthread_join(tick.thread, NULL);
+		pthread_attr_destroy(&tick.attr);
+		close(tick.timer_fd);
+	}
+	tick.stop_count = bx_tick_get_count();
+	BX_ATOMIC_STORE(&tick.running, BX_BOOLEAN_FALSE);
 	BX_LOG(LOG_DEBUG, "tick", "Tick process halted");
 
 	return 0;
 }
+
+bx_int8 bx_tick_use_virtual_clock(bx_boolean enabled) {
+
+	if (BX_ATOMIC_LOAD(&tick.running) == BX_BOOLEAN_TRUE) {
+		BX_LOG(LOG_ERROR, "tick", "Cannot change the clock while the tick process is running");
+		return -1;
+	}
+
+	tick.virtual_clock = enabled;
+	BX_ATOMIC_STORE(&tick.virtual_usec, 0);
+
+	return 0;
+}
+
+bx_boolean bx_tick_step(bx_uint64 until_usec) {
+	bx_uint64 tick_usec;
+
+	if (tick.virtual_clock == BX_BOOLEAN_FALSE ||
+			BX_ATOMIC_LOAD(&tick.running) == BX_BOOLEAN_FALSE) {
+		return BX_BOOLEAN_FALSE;
+	}
+
+	bx_critical_enter();
+	if (!tick.paused && tick.next_tick != BX_TICK_IDLE) {
+		tick_usec = tick.start_usec + tick.next_tick * tick.period_usec;
+		if (tick_usec <= until_usec) {
+			if (tick_usec > BX_ATOMIC_LOAD(&tick.virtual_usec)) {
+				BX_ATOMIC_STORE(&tick.virtual_usec, tick_usec);
+			}
+			tick.next_tick = BX_TICK_IDLE;
+			tick.callback();
+			bx_critical_exit();
+			return BX_BOOLEAN_TRUE;
+		}
+	}
+	if (until_usec > BX_ATOMIC_LOAD(&tick.virtual_usec)) {
+		BX_ATOMIC_STORE(&tick.virtual_usec, until_usec);
+	}
+	bx_critical_exit();
+
+	return BX_BOOLEAN_FALSE;
+}
@@ -0,0 +1,103 @@
+/*
+ * worker.c
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include "logging.h"
+#include "configuration.h"
+#include "runtime/worker.h"
+
+static struct bx_worker_pool {
+	pthread_t thread[EV_MAX_WORKERS];
+	bx_uint8 index[EV_MAX_WORKERS];
+	bx_uint8 worker_number;
+	bx_worker_routine routine;
+} worker_pool;
+
+static void *worker_routine(void *arg) {
+
+	worker_pool.routine(*(bx_uint8 *) arg);
+
+	return NULL;
+}
+
+bx_int8 bx_worker_start(bx_uint8 worker_number, bx_worker_routine routine) {
+	int error;
+	bx_uint8 i;
+
+	if (routine == NULL || worker_number == 0 || worker_number > EV_MAX_WORKERS) {
+		return -1;
+	}
+
+	BX_LOG(LOG_DEBUG, "worker", "Starting %u workers...", worker_number);
+	worker_pool.routine = routine;
+	worker_pool.worker_number = 0;
+	for (i = 0; i < worker_number; i++) {
+		worker_pool.index[i] = i;
+		error = pthread_create(&worker_pool.thread[i], NULL, worker_routine, &worker_pool.index[i]);
+		if (error != 0) {
+			BX_LOG(LOG_ERROR, "worker", "Error starting worker %u: %i", i, error);
+			return -1;
+		}
+		worker_pool.worker_number++;
+	}
+
+	return 0;
+}
+
+bx_uint8 bx_worker_online_cpus() {
+	long cpus;
+
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cpus < 1) {
+		return 1;
+	}
+
+	return cpus > 255 ? 255 : cpus;
+}
+
+void bx_worker_yield() {
+	sched_yield();
+}
+
+bx_int8 bx_worker_stop() {
+	bx_uint8 i;
+
+	BX_LOG(LOG_DEBUG, "worker", "Waiting for workers to stop...");
+	for (i = 0; i < worker_pool.worker_number; i++) {
+		pthread_join(worker_pool.thread[i], NULL);
+	}
+	worker_pool.worker_number = 0;
+	BX_LOG(LOG_DEBUG, "worker", "Workers stopped");
+
+	return 0;
+}
@@ -29,8 +29,158 @@
  *
  */
 
+#include <stddef.h>
+#include <string.h>
+#include "atomic.h"
+#include "logging.h"
 #include "bus/bus.h"
 
+static struct bx_bus {
+	struct bx_interface *interfaces[BS_MAX_INTERFACES];
+	struct bx_mpsc_queue pools[BS_MAX_INTERFACES]; ///< Free messages, consumed by the receiving thread of each interface
+	struct bx_bus_message messages[BS_MAX_INTERFACES][BS_INTERFACE_MESSAGES];
+	struct bx_mpsc_queue inbox;
+	bx_uint8 interface_number;
+} bus;
+
 bx_int8 ha_bus_init() {
-	return -1; //TODO: Stub
+	bus.interface_number = 0;
+	bx_mpsc_init(&bus.inbox);
+	return 0;
+}
+
+bx_int8 ha_bus_add_interface(struct bx_interface *interface) {
+	bx_int8 id;
+	bx_uint16 i;
+
+	if (interface == NULL || interface->send == NULL) {
+		return -1;
+	}
+	if (bus.interface_number >= BS_MAX_INTERFACES) {
+		BX_LOG(LOG_ERROR, "bus", "Cannot add interface: too many interfaces");
+		return -1;
+	}
+
+	id = bus.interface_number;
+	bx_mpsc_init(&bus.pools[id]);
+	for (i = 0; i < BS_INTERFACE_MESSAGES; i++) {
+		bus.messages[id][i].interface = interface;
+		bx_mpsc_push(&bus.pools[id], &bus.messages[id][i].node);
+	}
+	bus.interfaces[id] = interface;
+	bus.interface_number++;
+	// Publish the pool to the receiving thread of the interface
+	BX_ATOMIC_STORE(&interface->id, id);
+
+	if (interface->start != NULL && interface->start(interface) != 0) {
+		BX_LOG(LOG_ERROR, "bus", "Cannot start interface %i", id);
+		BX_ATOMIC_STORE(&interface->id, -1);
+		bus.interfaces[id] = NULL;
+		bus.interface_number--;
+		return -1;
+	}
+
+	return id;
+}
+
+bx_int8 ha_bus_send(bx_int8 interface_id, void *endpoint, void *message, bx_size message_length) {
+	if (interface_id < 0 || interface_id >= bus.interface_number || message_length > BS_MAX_MESSAGE_SIZE) {
+		return -1;
+	}
+	return bus.interfaces[interface_id]->send(bus.interfaces[interface_id], endpoint, message, message_length);
+}
+
+bx_int8 ha_bus_broadcast(void *message, bx_size message_length) {
+	bx_int8 result;
+	bx_uint8 i;
+
+	if (message_length > BS_MAX_MESSAGE_SIZE) {
+		return -1;
+	}
+
+	result = 0;
+	for (i = 0; i < bus.interface_number; i++) {
+		if (bus.interfaces[i]->broadcast != NULL && bus.interfaces[i]->broadcast(bus.interfaces[i], message, message_length) != 0) {
+			result = -1;
+		}
+	}
+	return result;
+}
+
+bx_int8 ha_bus_flush() {
+	bx_int8 result;
+	bx_uint8 i;
+
+	result = 0;
+	for (i = 0; i < bus.interface_number; i++) {
+		if (bus.interfaces[i]->flush != NULL && bus.interfaces[i]->flush(bus.interfaces[i]) != 0) {
+			result = -1;
+		}
+	}
+	return result;
+}
+
+struct bx_bus_message *ha_bus_receive() {
+	struct bx_mpsc_node *node;
+
+	node = bx_mpsc_pop(&bus.inbox);
+	if (node == NULL) {
+		return NULL;
+	}
+	return BX_MPSC_ELEMENT(node, struct bx_bus_message, node);
+}
+
+void ha_bus_release(struct bx_bus_message *message) {
+	bx_mpsc_push(&bus.pools[BX_ATOMIC_LOAD(&message->interface->id)], &message->node);
+}
+
+struct bx_bus_message *ha_bus_get_buffer(struct bx_interface *interface) {
+	struct bx_mpsc_node *node;
+	bx_int8 id;
+
+	id = BX_ATOMIC_LOAD(&interface->id);
+	if (id < 0) {
+		return NULL;
+	}
+	node = bx_mpsc_pop(&bus.pools[id]);
+	if (node == NULL) {
+		return NULL;
+	}
+	return BX_MPSC_ELEMENT(node, struct bx_bus_message, node);
+}
+
+void ha_bus_deliver(struct bx_bus_message *message) {
+	bx_mpsc_push(&bus.inbox, &message->node);
+}
+
+bx_int8 ha_bus_receive_callback(struct bx_interface *interface, void *endpoint, void *message, bx_size message_length) {
+	struct bx_bus_message *buffer;
+
+	if (message_length > BS_MAX_MESSAGE_SIZE) {
+		return -1;
+	}
+	buffer = ha_bus_get_buffer(interface);
+	if (buffer == NULL) {
+		return -1;
+	}
+
+	memcpy(buffer->endpoint, endpoint, sizeof buffer->endpoint);
+	memcpy(buffer->data, message, message_length);
+	buffer->length = message_length;
+	ha_bus_deliver(buffer);
+	return 0;
+}
+
+bx_int8 ha_bus_destroy() {
+	bx_uint8 i;
+
+	for (i = 0; i < bus.interface_number; i++) {
+		if (bus.interfaces[i]->destroy != NULL) {
+			bus.interfaces[i]->destroy(bus.interfaces[i]);
+		}
+		bus.interfaces[i] = NULL;
+	}
+	bus.interface_number = 0;
+	bx_mpsc_init(&bus.inbox);
+	return 0;
 }
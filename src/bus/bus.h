@@ -29,20 +29,133 @@
  *
  */
 
+/**
+ * Message bus.
+ * The bus exchanges messages between the runtime and the remote nodes
+ * reachable through its interfaces. Every interface owns a pool of
+ * BS_INTERFACE_MESSAGES messages: the receiving thread of the interface
+ * takes a free message from the pool, fills it and delivers it into the
+ * inbox of the bus. Both the inbox and the pools are lock-free queues, so
+ * interfaces never block on the consumer of the messages. Received
+ * messages must be released once processed, to return them to the pool of
+ * the interface that received them.
+ */
+
 #ifndef BUS_H_
 #define BUS_H_
 
 #include "types.h"
+#include "configuration.h"
+#include "utils/mpsc_queue.h"
 #include "bus/interface.h"
 
 typedef bx_uint64 bus_address;
 
+struct bx_interface;
+
+struct bx_bus_message {
+	struct bx_mpsc_node node; ///< Link in the inbox or in the pool of the interface
+	struct bx_interface *interface; ///< Interface that received the message
+	bx_uint64 endpoint[BS_ENDPOINT_SIZE / 8]; ///< Sender, in the format of the interface
+	bx_size length;
+	bx_uint8 data[BS_MAX_MESSAGE_SIZE];
+};
+
+/**
+ * Initialize the bus
+ *
+ * @return 0 on success, -1 on failure
+ */
 bx_int8 ha_bus_init();
 
+/**
+ * Add an interface to the bus. The interface receives an identifier and
+ * a pool of messages; it must not deliver messages before it is added.
+ * Interfaces receiving in a thread of their own start it in the start
+ * hook, which is invoked once the identifier and the pool are assigned.
+ *
+ * @param interface Interface to add
+ * @return Identifier of the interface, -1 on failure
+ */
 bx_int8 ha_bus_add_interface(struct bx_interface *interface);
 
+/**
+ * Send a message to an endpoint through one of the interfaces. Interfaces
+ * may batch outgoing messages, see ha_bus_flush.
+ *
+ * @param interface_id Identifier of the interface
+ * @param endpoint Destination, in the format of the interface
+ * @param message Message payload
+ * @param message_length Length of the payload, at most BS_MAX_MESSAGE_SIZE
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 ha_bus_send(bx_int8 interface_id, void *endpoint, void *message, bx_size message_length);
+
+/**
+ * Broadcast a message through all the interfaces
+ *
+ * @param message Message payload
+ * @param message_length Length of the payload, at most BS_MAX_MESSAGE_SIZE
+ * @return 0 on success, -1 if any interface failed
+ */
+bx_int8 ha_bus_broadcast(void *message, bx_size message_length);
+
+/**
+ * Send the messages batched by the interfaces
+ *
+ * @return 0 on success, -1 if any interface failed
+ */
+bx_int8 ha_bus_flush();
+
+/**
+ * Remove the oldest message from the inbox. Only one thread at a time may
+ * receive messages.
+ *
+ * @return Received message, NULL if the inbox is empty
+ */
+struct bx_bus_message *ha_bus_receive();
+
+/**
+ * Return a received message to the pool of its interface. Safe to call
+ * from any thread.
+ *
+ * @param message Message to release
+ */
+void ha_bus_release(struct bx_bus_message *message);
+
+/**
+ * Take a free message from the pool of an interface. Only the receiving
+ * thread of the interface may call this function.
+ *
+ * @param interface Interface
+ * @return Free message, NULL if the pool is exhausted
+ */
+struct bx_bus_message *ha_bus_get_buffer(struct bx_interface *interface);
+
+/**
+ * Deliver a message taken with ha_bus_get_buffer into the inbox
+ *
+ * @param message Message to deliver
+ */
+void ha_bus_deliver(struct bx_bus_message *message);
+
+/**
+ * Copy a received message into the inbox
+ *
+ * @param interface Interface that received the message
+ * @param endpoint Sender, BS_ENDPOINT_SIZE bytes in the format of the interface
+ * @param message Message payload
+ * @param message_length Length of the payload
+ * @return 0 on success, -1 if the message was dropped
+ */
 bx_int8 ha_bus_receive_callback(struct bx_interface *interface, void *endpoint, void *message, bx_size message_length);
 
+/**
+ * Destroy all the interfaces. Messages still held by the application
+ * become invalid.
+ *
+ * @return 0 on success, -1 on failure
+ */
 bx_int8 ha_bus_destroy();
 
 #endif /* BUS_H_ */
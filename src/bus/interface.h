@@ -38,8 +38,11 @@
 struct bx_interface {
 	bx_int8 (*send)(struct bx_interface *interface, void *endpoint, void *message, bx_size message_length);
 	bx_int8 (*broadcast)(struct bx_interface *interface, void *message, bx_size	 message_length);
+	bx_int8 (*flush)(struct bx_interface *interface);
+	bx_int8 (*start)(struct bx_interface *interface); ///< Optional, invoked by ha_bus_add_interface once the identifier is assigned
 	void (*destroy)(struct bx_interface *interface);
 	bx_int8 error;
+	bx_int8 id; ///< Assigned by ha_bus_add_interface, accessed atomically
 	void *data;
 };
 
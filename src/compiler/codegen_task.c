@@ -32,15 +32,18 @@
 #include <string.h>
 #include <stdlib.h>
 #include "logging.h"
+#include "configuration.h"
 #include "utils/linked_list.h"
 #include "compiler/codegen_expression_cast.h"
 #include "compiler/codegen_task.h"
+#include "runtime/task_scheduler.h"
 
 struct bx_comp_task *bx_cgtk_create_task() {
 	struct bx_comp_task *task;
 
 	task = malloc(sizeof *task);
 	memset((void *) task, 0, sizeof (struct bx_comp_task));
+	task->priority = EV_PRIORITY_LEVELS - 1;
 
 	task->pcode = bx_cgpc_create();
 	if (task->pcode == NULL) {
@@ -124,14 +127,21 @@ bx_int8 bx_cgtk_add_every_execution_condition(struct bx_comp_task *task, struct
 	if (int_period == NULL) {
 		return -1;
 	}
+	if (int_period->expression_type == BX_COMP_CONSTANT &&
+			int_period->value.int_value <= 0) {
+		BX_LOG(LOG_ERROR, "compiler",
+				"The 'every' period must be a positive number of microseconds.");
+		bx_cgex_destroy_expression(int_period);
+		return -1;
+	}
 	error = bx_cgex_convert_to_binary(int_period);
 	if (error != 0) {
 		bx_cgex_destroy_expression(int_period);
 		return -1;
 	}
 
-	task->at_execution_condition = bx_cgpc_copy(int_period->value.pcode);
-	if (task->at_execution_condition == NULL) {
+	task->every_execution_condition = bx_cgpc_copy(int_period->value.pcode);
+	if (task->every_execution_condition == NULL) {
 		bx_cgex_destroy_expression(int_period);
 		return -1;
 	}
@@ -141,6 +151,49 @@ bx_int8 bx_cgtk_add_every_execution_condition(struct bx_comp_task *task, struct
 	return 0;
 }
 
+bx_int8 bx_cgtk_set_priority(struct bx_comp_task *task, bx_int32 priority) {
+
+	if (task == NULL) {
+		return -1;
+	}
+
+	if (priority < 0 || priority >= EV_PRIORITY_LEVELS) {
+		BX_LOG(LOG_ERROR, "compiler",
+				"Task priority must be between 0 and %i.", EV_PRIORITY_LEVELS - 1);
+		return -1;
+	}
+
+	task->priority = priority;
+
+	return 0;
+}
+
+bx_int8 bx_cgtk_set_deadline(struct bx_comp_task *task, bx_int32 deadline_msec) {
+
+	if (task == NULL) {
+		return -1;
+	}
+
+	if (deadline_msec <= 0) {
+		BX_LOG(LOG_ERROR, "compiler",
+				"Task deadline must be a positive number of milliseconds.");
+		return -1;
+	}
+
+	task->deadline_msec = deadline_msec;
+
+	return 0;
+}
+
+bx_task_id bx_cgtk_add_to_scheduler(struct bx_comp_task *task) {
+
+	if (task == NULL || task->pcode == NULL) {
+		return -1;
+	}
+
+	return bx_sched_add_pcode_task(task->pcode->data, task->pcode->size, task->priority, task->deadline_msec);
+}
+
 struct bx_comp_task *bx_cgtk_create_child_task(struct bx_comp_task *task) {
 	struct bx_comp_task *child_task;
 	struct bx_linked_list *new_node;
@@ -179,6 +232,10 @@ bx_int8 bx_cgtk_destroy_task(struct bx_comp_task *task) {
 		bx_cgpc_destroy(task->on_execution_condition);
 	}
 
+	if (task->every_execution_condition != NULL) {
+		bx_cgpc_destroy(task->every_execution_condition);
+	}
+
 	if (task->pcode != NULL) {
 		bx_cgpc_destroy(task->pcode);
 	}
@@ -33,6 +33,7 @@
 #define CODEGEN_TASK_H_
 
 #include "types.h"
+#include "runtime/task_scheduler.h"
 #include "compiler/codegen_pcode.h"
 #include "compiler/codegen_expression.h"
 #include "compiler/codegen_symbol_table.h"
@@ -43,6 +44,8 @@ struct bx_comp_task {
 	struct bx_comp_pcode *on_execution_condition;
 	struct bx_comp_pcode *every_execution_condition;
 	struct bx_comp_pcode *pcode;
+	bx_uint8 priority;
+	bx_uint32 deadline_msec;
 	struct bx_linked_list *child_task_list;
 	struct bx_comp_task *parent;
 };
@@ -75,14 +78,48 @@ bx_int8 bx_cgtk_add_on_execution_condition(struct bx_comp_task *task, struct bx_
  * The expression passed as parameter is converted as needed to the data type
  * int. Conversion errors may arise if the execution condition cannot be
  * converted to the target type.
+ * The period is expressed in microseconds; time constants such as 500us,
+ * 1.5ms or 2s are converted to microseconds by the lexer.
  *
  * @param task Target task
- * @param period Period between task invocations
+ * @param period_expression Period between task invocations in microseconds
  *
  * @return 0 on success, -1 on failure
  */
 bx_int8 bx_cgtk_add_every_execution_condition(struct bx_comp_task *task, struct bx_comp_expr *period_expression);
 
+/**
+ * Sets the scheduling priority of the task passed as parameter.
+ * Tasks without a priority annotation are created with the lowest priority.
+ *
+ * @param task Target task
+ * @param priority Task priority, 0 being the highest
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_cgtk_set_priority(struct bx_comp_task *task, bx_int32 priority);
+
+/**
+ * Sets the relative deadline of the task passed as parameter.
+ *
+ * @param task Target task
+ * @param deadline_msec Relative deadline in milliseconds
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_cgtk_set_deadline(struct bx_comp_task *task, bx_int32 deadline_msec);
+
+/**
+ * Adds the program of a compiled task to the task scheduler, with the
+ * priority and the deadline declared by the task. Child tasks are not
+ * added.
+ *
+ * @param task Compiled task
+ *
+ * @return Task id, -1 on failure
+ */
+bx_task_id bx_cgtk_add_to_scheduler(struct bx_comp_task *task);
+
 /**
  * Creates a new empty child task and returns its pointer.
  * The task passed as parameter is set as the parent of the newly created
@@ -51,8 +51,10 @@ static struct bx_comp_task *current_task;
 %token ON CHANGE ALLOW RESAMPLE EXISTING NEW INC_OP DEC_OP FIELD IF
 %token AND_OP OR_OP EQ_OP NEQ_OP LE_OP GE_OP TRUE_CONSTANT FALSE_CONSTANT
 %token INT FLOAT BOOL STRING STREAM SUBNET
+%token PRIORITY DEADLINE
 
 %token <int_val> INT_CONSTANT
+%token <int_val> TIME_CONSTANT
 %token <float_val> FLOAT_CONSTANT
 %token <string_val> IDENTIFIER
 %token <string_val> STRING_LITERAL
@@ -120,6 +122,7 @@ statement
 	| iteration_statement
 	| expression_statement
 	| conditional_execution_statement
+	| task_annotation_statement
 	;
 	
 compound_statement
@@ -411,6 +414,17 @@ event_trigger_modifier
 	| CHANGE
 	;
 	
+task_annotation_statement
+	: PRIORITY INT_CONSTANT ';'
+	{
+		bx_cgtk_set_priority(current_task, $2);
+	}
+	| DEADLINE INT_CONSTANT ';'
+	{
+		bx_cgtk_set_deadline(current_task, $2);
+	}
+	;
+	
 expression_statement
 	: ';'
 	{
@@ -464,6 +478,10 @@ primary_expression
 	{
 		$$ = bx_cgex_create_int_constant($1);
 	}
+	| TIME_CONSTANT
+	{
+		$$ = bx_cgex_create_int_constant($1);
+	}
 	| FLOAT_CONSTANT 		
 	{
 		$$ = bx_cgex_create_float_constant($1);
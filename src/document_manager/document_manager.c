@@ -31,26 +31,324 @@
 
 #include <string.h>
 #include "logging.h"
+#include "atomic.h"
 #include "utils/list.h"
+#include "utils/seqlock.h"
+#include "runtime/tick.h"
+#include "runtime/critical_section.h"
 #include "document_manager/document_manager.h"
+#include "compile_assert.h"
 
 struct internal_field {
-	char identifier[DM_FIELD_IDENTIFIER_LENGTH];
 	struct bx_document_field field;
+	bx_uint32 sequence;		///< Sequence lock of computed fields
+	bx_boolean lock;		///< Serializes the callbacks of computed fields, accessed atomically
+	bx_ssize handle;
+	struct bx_field_history *history;	///< History of computed fields, NULL if not recorded
+	struct bx_field_window *window;		///< Window of computed fields, NULL if not aggregated
 };
 
+/*
+ * Fields are stored in a list and indexed by identifier through an open
+ * addressing hash table with linear probing. Fields are never removed, so
+ * the index does not need tombstones and the list entries never move.
+ * Index slots are published atomically once the field is stored, so fields
+ * can be looked up without entering the critical section.
+ * Field handles are positions in the field table, in order of addition.
+ * Identifiers are only needed by lookups, so they are kept apart from the
+ * fields in a table indexed by handle.
+ *
+ * Each field value is protected by a sequence lock: the lock of plain fields
+ * is stored next to their value, while the lock of computed fields is
+ * stored in the internal field. Readers of plain fields never block and
+ * never enter the critical section; writers of the same field exclude each
+ * other. The callbacks of computed fields are not safe to run speculatively,
+ * so they are serialized by a per-field lock instead of being retried. The
+ * version of a value is the number of updates completed by its lock.
+ * Field histories and windows are fed while holding the lock, so each of
+ * them has a single writer at a time.
+ *
+ * Writes performed through the document manager are also counted before and
+ * after the update, a batch of writes counting as a single update: a reader that observes the same number of started
+ * writes before and after reading a group of fields, with no write in
+ * progress, has read values all belonging to the same update epoch.
+ */
 static struct bx_document_manager {
-	struct internal_field field_list_storage[DM_MAX_FIELD_NUMBER];
+	bx_uint8 field_list_storage[BX_LIST_STORAGE_SIZE(sizeof (struct internal_field), DM_MAX_FIELD_NUMBER)];
 	struct bx_list *field_list;
+	struct internal_field *field_index[DM_INDEX_SIZE];	///< Hash index, NULL if the slot is empty
+	struct internal_field *field_table[DM_MAX_FIELD_NUMBER];	///< Fields indexed by handle
+	char field_identifiers[DM_MAX_FIELD_NUMBER][DM_FIELD_IDENTIFIER_LENGTH];	///< Identifiers indexed by handle
+	bx_ssize field_number;			///< Number of fields in the table, accessed atomically
+	bx_uint32 writes_started;		///< Accessed atomically
+	bx_uint32 writes_completed;		///< Accessed atomically
 } document_manager;
 
 bx_boolean compare_by_id(struct internal_field *field, char *identifier);
 
+/**
+ * Computes the index slot of an identifier using the FNV-1a hash
+ *
+ * @param identifier Field identifier
+ *
+ * @return Home slot of the identifier in the hash index
+ */
+static bx_size hash_identifier(char *identifier) {
+	bx_uint32 hash;
+	bx_size i;
+
+	hash = 2166136261u;
+	for (i = 0; i < DM_FIELD_IDENTIFIER_LENGTH && identifier[i] != '\0'; i++) {
+		hash ^= (bx_uint8) identifier[i];
+		hash *= 16777619u;
+	}
+
+	return hash & (DM_INDEX_SIZE - 1);
+}
+
+/**
+ * Finds the index slot of an identifier
+ *
+ * @param identifier Field identifier
+ *
+ * @return Slot containing the field, or the empty slot where it should be inserted
+ */
+static bx_size index_find_slot(char *identifier) {
+	struct internal_field *internal_field;
+	bx_size slot;
+
+	slot = hash_identifier(identifier);
+	while ((internal_field = BX_ATOMIC_LOAD(&document_manager.field_index[slot])) != NULL) {
+		if (compare_by_id(internal_field, identifier) == BX_BOOLEAN_TRUE) {
+			break;
+		}
+		slot = (slot + 1) & (DM_INDEX_SIZE - 1);
+	}
+
+	return slot;
+}
+
+/**
+ * Returns the field with the given handle
+ *
+ * @param handle Field handle
+ *
+ * @return Field, NULL if the handle is invalid
+ */
+static struct internal_field *field_lookup(bx_ssize handle) {
+
+	if (handle < 0 || handle >= BX_ATOMIC_LOAD(&document_manager.field_number)) {
+		return NULL;
+	}
+
+	return document_manager.field_table[handle];
+}
+
+/**
+ * Returns the sequence lock protecting the value of a field
+ *
+ * @param internal_field Field
+ *
+ * @return Sequence counter
+ */
+static bx_uint32 *field_sequence(struct internal_field *internal_field) {
+
+	if (internal_field->field.get == NULL) {
+		return &((struct bx_field_storage *) internal_field->field.private_data)->sequence;
+	}
+
+	return &internal_field->sequence;
+}
+
+/**
+ * Returns the location of the history pointer of a field
+ *
+ * @param internal_field Field
+ *
+ * @return History pointer location
+ */
+static struct bx_field_history **field_history(struct internal_field *internal_field) {
+
+	if (internal_field->field.get == NULL) {
+		return &((struct bx_field_storage *) internal_field->field.private_data)->history;
+	}
+
+	return &internal_field->history;
+}
+
+/**
+ * Returns the location of the window pointer of a field
+ *
+ * @param internal_field Field
+ *
+ * @return Window pointer location
+ */
+static struct bx_field_window **field_window(struct internal_field *internal_field) {
+
+	if (internal_field->field.get == NULL) {
+		return &((struct bx_field_storage *) internal_field->field.private_data)->window;
+	}
+
+	return &internal_field->window;
+}
+
+/**
+ * Acquires the lock serializing the callbacks of a computed field
+ *
+ * @param internal_field Computed field
+ */
+static void field_lock(struct internal_field *internal_field) {
+	while (BX_ATOMIC_EXCHANGE(&internal_field->lock, BX_BOOLEAN_TRUE) == BX_BOOLEAN_TRUE) {
+	}
+}
+
+/**
+ * Releases the lock serializing the callbacks of a computed field
+ *
+ * @param internal_field Computed field
+ */
+static void field_unlock(struct internal_field *internal_field) {
+	BX_ATOMIC_STORE(&internal_field->lock, BX_BOOLEAN_FALSE);
+}
+
+/**
+ * Records a value in the history and in the window of a field, if any
+ *
+ * @param history History, may be NULL
+ * @param window Window, may be NULL
+ * @param value Raw 32 bit value
+ */
+static void field_record(struct bx_field_history *history, struct bx_field_window *window, bx_uint32 value) {
+	bx_uint64 timestamp;
+
+	if (history == NULL && window == NULL) {
+		return;
+	}
+
+	timestamp = bx_tick_get_time_usec();
+	if (history != NULL) {
+		bx_history_append(history, timestamp, value);
+	}
+	if (window != NULL) {
+		bx_window_add(window, timestamp, value);
+	}
+}
+
+/**
+ * Reads a consistent value of a field.
+ * Plain values are read optimistically and retried if an update was in
+ * progress. The get callback of computed fields runs once, holding the
+ * field lock, and writes directly into the destination.
+ *
+ * @param internal_field Field to read
+ * @param data Destination memory location
+ * @param version Destination of the version of the value, may be NULL
+ *
+ * @return 0 on success, -1 on failure
+ */
+static bx_int8 field_read(struct internal_field *internal_field, void *data, bx_uint32 *version) {
+	struct bx_field_storage *storage;
+	bx_uint32 start;
+	bx_uint32 value;
+	bx_int8 error;
+
+	if (internal_field->field.get != NULL) {
+		field_lock(internal_field);
+		start = bx_seqlock_read_begin(&internal_field->sequence);
+		error = internal_field->field.get(&internal_field->field, data);
+		field_unlock(internal_field);
+		if (error != 0) {
+			return -1;
+		}
+	} else {
+		storage = (struct bx_field_storage *) internal_field->field.private_data;
+		do {
+			start = bx_seqlock_read_begin(&storage->sequence);
+			value = BX_ATOMIC_LOAD(&storage->value);
+		} while (bx_seqlock_read_end(&storage->sequence, start) == BX_BOOLEAN_FALSE);
+		memcpy(data, &value, 4);
+	}
+
+	if (version != NULL) {
+		*version = start >> 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Starts an update of the document, which may write several fields
+ */
+static void update_begin() {
+	BX_ATOMIC_ADD(&document_manager.writes_started, 1);
+}
+
+/**
+ * Completes an update of the document
+ */
+static void update_end() {
+	BX_ATOMIC_ADD(&document_manager.writes_completed, 1);
+}
+
+/**
+ * Writes the value of a field.
+ * Must be invoked between update_begin and update_end. The value is also
+ * recorded in the field history and window.
+ *
+ * @param internal_field Field to write
+ * @param data Source memory location
+ *
+ * @return 0 on success, -1 on failure
+ */
+static bx_int8 field_write(struct internal_field *internal_field, void *data) {
+	struct bx_field_storage *storage;
+	bx_uint32 *sequence;
+	bx_uint32 value;
+	bx_int8 error;
+
+	sequence = field_sequence(internal_field);
+	storage = (struct bx_field_storage *) internal_field->field.private_data;
+	memcpy(&value, data, 4);
+	if (internal_field->field.get != NULL) {
+		field_lock(internal_field);
+	}
+	while (bx_seqlock_write_try_begin(sequence) == BX_BOOLEAN_FALSE) {
+	}
+	if (internal_field->field.set != NULL) {
+		error = internal_field->field.set(&internal_field->field, data);
+	} else {
+		BX_ATOMIC_STORE(&storage->value, value);
+		error = 0;
+	}
+	if (error == 0) {
+		field_record(BX_ATOMIC_LOAD(field_history(internal_field)), BX_ATOMIC_LOAD(field_window(internal_field)),
+				value);
+	}
+	bx_seqlock_write_end(sequence);
+	if (internal_field->field.get != NULL) {
+		field_unlock(internal_field);
+	}
+
+	return error;
+}
+
 bx_int8 bx_docman_init() {
+	bx_size i;
+
 	BX_LOG(LOG_INFO, "document_manager", "Initializing document manager...");
 
+	// The index always contains an empty slot and its mask is valid
+	BX_COMPILE_ASSERT(DM_INDEX_SIZE > DM_MAX_FIELD_NUMBER);
+	BX_COMPILE_ASSERT((DM_INDEX_SIZE & (DM_INDEX_SIZE - 1)) == 0);
+
+	for (i = 0; i < DM_INDEX_SIZE; i++) {
+		document_manager.field_index[i] = NULL;
+	}
+	document_manager.field_number = 0;
+	document_manager.writes_started = 0;
+	document_manager.writes_completed = 0;
 	document_manager.field_list = bx_list_init(document_manager.field_list_storage,
-			DM_MAX_FIELD_NUMBER, sizeof (struct internal_field));
+			sizeof document_manager.field_list_storage, sizeof (struct internal_field));
 	if (document_manager.field_list == NULL) {
 		return -1;
 	}
@@ -60,60 +358,306 @@ bx_int8 bx_docman_init() {
 
 bx_int8 bx_docman_add_field(struct bx_document_field *field, char *identifier) {
 	struct internal_field *internal_field;
+	bx_size slot;
 
-	if (field == NULL) {
+	if (field == NULL || identifier == NULL) {
 		return -1;
 	}
 
-	if (bx_list_indexof(document_manager.field_list, identifier, (equals_function) compare_by_id) != -1) {
+	bx_critical_enter();
+	slot = index_find_slot(identifier);
+	if (BX_ATOMIC_LOAD(&document_manager.field_index[slot]) != NULL) {
+		bx_critical_exit();
 		return -1;
 	}
 
 	internal_field = bx_list_get_empty(document_manager.field_list);
 	if (internal_field == NULL) {
+		bx_critical_exit();
 		return -1;
 	}
 	memcpy(&internal_field->field, field, sizeof (struct bx_document_field));
-	strncpy(internal_field->identifier, identifier, DM_FIELD_IDENTIFIER_LENGTH);
+	strncpy(document_manager.field_identifiers[document_manager.field_number], identifier,
+			DM_FIELD_IDENTIFIER_LENGTH);
+	internal_field->handle = document_manager.field_number;
+	internal_field->history = NULL;
+	internal_field->window = NULL;
+	bx_seqlock_init(&internal_field->sequence);
+	internal_field->lock = BX_BOOLEAN_FALSE;
+	document_manager.field_table[document_manager.field_number] = internal_field;
+	BX_ATOMIC_STORE(&document_manager.field_number, document_manager.field_number + 1);
+	BX_ATOMIC_STORE(&document_manager.field_index[slot], internal_field);
+	bx_critical_exit();
+
+	return 0;
+}
+
+bx_int8 bx_docman_init_plain_field(struct bx_document_field *field, enum bx_builtin_type type,
+		struct bx_field_storage *storage) {
+
+	if (field == NULL || storage == NULL) {
+		return -1;
+	}
+
+	bx_seqlock_init(&storage->sequence);
+	storage->history = NULL;
+	storage->window = NULL;
+	field->type = type;
+	field->private_data = storage;
+	field->get = NULL;
+	field->set = NULL;
 
 	return 0;
 }
 
+struct bx_field_storage *bx_docman_get_storage(char *field_identifier) {
+	struct internal_field *internal_field;
+
+	if (field_identifier == NULL) {
+		return NULL;
+	}
+
+	internal_field = BX_ATOMIC_LOAD(&document_manager.field_index[index_find_slot(field_identifier)]);
+	if (internal_field == NULL || internal_field->field.get != NULL) {
+		return NULL;
+	}
+
+	return (struct bx_field_storage *) internal_field->field.private_data;
+}
+
 bx_int8 bx_docman_invoke_get(char *field_identifier, void *data) {
 	struct internal_field *internal_field;
 
+	if (field_identifier == NULL || data == NULL) {
+		return -1;
+	}
+
+	internal_field = BX_ATOMIC_LOAD(&document_manager.field_index[index_find_slot(field_identifier)]);
+	if (internal_field == NULL) {
+		return -1;
+	}
+
+	return field_read(internal_field, data, NULL);
+}
+
+bx_int8 bx_docman_invoke_set(char *field_identifier, void *data) {
+	struct internal_field *internal_field;
+	bx_int8 error;
+
+	if (field_identifier == NULL || data == NULL) {
+		return -1;
+	}
+
+	internal_field = BX_ATOMIC_LOAD(&document_manager.field_index[index_find_slot(field_identifier)]);
+	if (internal_field == NULL) {
+		return -1;
+	}
+
+	update_begin();
+	error = field_write(internal_field, data);
+	update_end();
+
+	return error;
+}
+
+void bx_docman_write_storage(struct bx_field_storage *storage, bx_uint32 value) {
+
+	while (bx_seqlock_write_try_begin(&storage->sequence) == BX_BOOLEAN_FALSE) {
+	}
+	update_begin();
+	BX_ATOMIC_STORE(&storage->value, value);
+	field_record(BX_ATOMIC_LOAD(&storage->history), BX_ATOMIC_LOAD(&storage->window), value);
+	update_end();
+	bx_seqlock_write_end(&storage->sequence);
+}
+
+bx_ssize bx_docman_get_handle(char *field_identifier) {
+	struct internal_field *internal_field;
+
 	if (field_identifier == NULL) {
 		return -1;
 	}
 
-	internal_field = bx_list_search(document_manager.field_list, field_identifier, (equals_function) compare_by_id);
+	internal_field = BX_ATOMIC_LOAD(&document_manager.field_index[index_find_slot(field_identifier)]);
 	if (internal_field == NULL) {
 		return -1;
 	}
-	internal_field->field.get(&internal_field->field, data);
+
+	return internal_field->handle;
+}
+
+bx_int8 bx_docman_get_identifier(bx_ssize handle, char *identifier) {
+
+	if (identifier == NULL || field_lookup(handle) == NULL) {
+		return -1;
+	}
+
+	memcpy(identifier, document_manager.field_identifiers[handle], DM_FIELD_IDENTIFIER_LENGTH);
 
 	return 0;
 }
 
-bx_int8 bx_docman_invoke_set(char *field_identifier, void *data) {
+/**
+ * Reads the values of several fields
+ *
+ * @param handles Array of field handles
+ * @param count Number of fields
+ * @param values Destination array of 32 bit values
+ *
+ * @return 0 on success, -1 on error
+ */
+static bx_int8 read_fields(bx_ssize *handles, bx_size count, bx_uint32 *values) {
+	struct internal_field *internal_field;
+	bx_size i;
+
+	for (i = 0; i < count; i++) {
+		internal_field = field_lookup(handles[i]);
+		if (internal_field == NULL || field_read(internal_field, &values[i], NULL) != 0) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+bx_int8 bx_docman_get_many(bx_ssize *handles, bx_size count, bx_uint32 *values) {
+
+	if (handles == NULL || values == NULL) {
+		return -1;
+	}
+
+	return read_fields(handles, count, values);
+}
+
+bx_int8 bx_docman_set_many(bx_ssize *handles, bx_size count, bx_uint32 *values) {
+	struct internal_field *internal_field;
+	bx_size i;
+
+	if (handles == NULL || values == NULL) {
+		return -1;
+	}
+
+	update_begin();
+	for (i = 0; i < count; i++) {
+		internal_field = field_lookup(handles[i]);
+		if (internal_field == NULL || field_write(internal_field, &values[i]) != 0) {
+			update_end();
+			return -1;
+		}
+	}
+	update_end();
+
+	return 0;
+}
+
+bx_int8 bx_docman_get_snapshot(bx_ssize *handles, bx_size count, bx_uint32 *values, bx_uint32 *epoch) {
+	bx_uint32 started;
+	bx_uint32 attempts;
+
+	if (handles == NULL || values == NULL) {
+		return -1;
+	}
+
+	for (attempts = 0; attempts < DM_SNAPSHOT_MAX_ATTEMPTS; attempts++) {
+		started = BX_ATOMIC_LOAD(&document_manager.writes_started);
+		if (BX_ATOMIC_LOAD(&document_manager.writes_completed) != started) {
+			continue;
+		}
+		if (read_fields(handles, count, values) != 0) {
+			return -1;
+		}
+		if (BX_ATOMIC_LOAD(&document_manager.writes_started) == started) {
+			if (epoch != NULL) {
+				*epoch = started;
+			}
+			return 0;
+		}
+	}
+
+	BX_LOG(LOG_WARNING, "document_manager", "Cannot take snapshot: too many concurrent updates");
+	return -1;
+}
+
+bx_int8 bx_docman_get_versioned(bx_ssize handle, bx_uint32 *value, bx_uint32 *version) {
+	struct internal_field *internal_field;
+
+	if (value == NULL || version == NULL) {
+		return -1;
+	}
+
+	internal_field = field_lookup(handle);
+	if (internal_field == NULL) {
+		return -1;
+	}
+
+	return field_read(internal_field, value, version);
+}
+
+bx_int8 bx_docman_attach_history(char *field_identifier, struct bx_field_history *history) {
+	struct internal_field *internal_field;
+
+	if (field_identifier == NULL || history == NULL) {
+		return -1;
+	}
+
+	internal_field = BX_ATOMIC_LOAD(&document_manager.field_index[index_find_slot(field_identifier)]);
+	if (internal_field == NULL) {
+		return -1;
+	}
+	BX_ATOMIC_STORE(field_history(internal_field), history);
+
+	return 0;
+}
+
+struct bx_field_history *bx_docman_get_history(char *field_identifier) {
 	struct internal_field *internal_field;
 
 	if (field_identifier == NULL) {
+		return NULL;
+	}
+
+	internal_field = BX_ATOMIC_LOAD(&document_manager.field_index[index_find_slot(field_identifier)]);
+	if (internal_field == NULL) {
+		return NULL;
+	}
+
+	return BX_ATOMIC_LOAD(field_history(internal_field));
+}
+
+bx_int8 bx_docman_attach_window(char *field_identifier, struct bx_field_window *window) {
+	struct internal_field *internal_field;
+
+	if (field_identifier == NULL || window == NULL) {
 		return -1;
 	}
 
-	internal_field = bx_list_search(document_manager.field_list, field_identifier, (equals_function) compare_by_id);
+	internal_field = BX_ATOMIC_LOAD(&document_manager.field_index[index_find_slot(field_identifier)]);
 	if (internal_field == NULL) {
 		return -1;
 	}
-	internal_field->field.set(&internal_field->field, data);
+	BX_ATOMIC_STORE(field_window(internal_field), window);
 
 	return 0;
 }
 
+struct bx_field_window *bx_docman_get_window(char *field_identifier) {
+	struct internal_field *internal_field;
+
+	if (field_identifier == NULL) {
+		return NULL;
+	}
+
+	internal_field = BX_ATOMIC_LOAD(&document_manager.field_index[index_find_slot(field_identifier)]);
+	if (internal_field == NULL) {
+		return NULL;
+	}
+
+	return BX_ATOMIC_LOAD(field_window(internal_field));
+}
+
 bx_boolean compare_by_id(struct internal_field *field, char *identifier) {
 
-	if (strncmp(field->identifier, identifier, DM_FIELD_IDENTIFIER_LENGTH) == 0) {
+	if (strncmp(document_manager.field_identifiers[field->handle], identifier, DM_FIELD_IDENTIFIER_LENGTH) == 0) {
 		return BX_BOOLEAN_TRUE;
 	} else {
 		return BX_BOOLEAN_FALSE;
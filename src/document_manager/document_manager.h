@@ -34,12 +34,27 @@
 
 /**
  * Document manager.
- * The document manager stores information regarding the documents and the fields
+ * The document manager stores information regarding the documents and the fields.
+ * Every field value is protected by its own sequence lock: readers never
+ * block nor enter the critical section, and retry when they overlap with a
+ * writer of the same field. Each completed write increments the version of
+ * the field, which can be used for change detection.
  */
 
 #include "types.h"
 #include "configuration.h"
+#include "document_manager/field_history.h"
+#include "document_manager/field_window.h"
 
+/**
+ * Document field.
+ * Computed fields provide get and set callbacks. Plain storage fields have
+ * NULL callbacks and private_data pointing to their bx_field_storage, whose
+ * value is accessed in place with atomic operations.
+ * The callbacks of a computed field never run concurrently with each
+ * other: the document manager serializes them with a per-field lock. The
+ * get callback receives the destination buffer of the caller.
+ */
 struct bx_document_field {
 	enum bx_builtin_type type;
 	void *private_data;
@@ -47,6 +62,17 @@ struct bx_document_field {
 	bx_int8 (*set)(struct bx_document_field *instance, void *data);
 };
 
+/**
+ * Storage of a plain field: a 32 bit value, its sequence lock, its history
+ * and its window
+ */
+struct bx_field_storage {
+	bx_uint32 sequence;
+	bx_uint32 value;
+	struct bx_field_history *history;	///< NULL if not recorded, accessed atomically
+	struct bx_field_window *window;		///< NULL if not aggregated, accessed atomically
+};
+
 /**
  * Initializes the document manager.
  *
@@ -66,6 +92,30 @@ bx_int8 bx_docman_init(void);
  */
 bx_int8 bx_docman_add_field(struct bx_document_field *field, char *identifier);
 
+/**
+ * Initializes a plain storage field, whose value is accessed directly
+ * instead of through callbacks.
+ *
+ * @param field Field to initialize
+ * @param type Type of the field value
+ * @param storage Location of the value, must outlive the field
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_docman_init_plain_field(struct bx_document_field *field, enum bx_builtin_type type,
+		struct bx_field_storage *storage);
+
+/**
+ * Returns the location of the value of a plain storage field.
+ * The lookup does not enter the critical section; the value must be read
+ * with atomic 32 bit operations and written with bx_docman_write_storage.
+ *
+ * @param field_identifier Field identifier
+ *
+ * @return Value location, NULL if the field does not exist or is computed
+ */
+struct bx_field_storage *bx_docman_get_storage(char *field_identifier);
+
 /**
  * Invokes the getter method of a field managed by the document manager
  *
@@ -86,4 +136,128 @@ bx_int8 bx_docman_invoke_get(char *field_identifier, void *data);
  */
 bx_int8 bx_docman_invoke_set(char *field_identifier, void *data);
 
+/**
+ * Writes the value of a plain storage field whose location was obtained
+ * through bx_docman_get_storage, accounting for the update epoch.
+ *
+ * @param storage Value location
+ * @param value New value
+ */
+void bx_docman_write_storage(struct bx_field_storage *storage, bx_uint32 value);
+
+/**
+ * Returns the handle of a field, to be used with the batch functions.
+ * Handles stay valid until the document manager is initialized again.
+ *
+ * @param field_identifier Field identifier
+ *
+ * @return Field handle, -1 if the field does not exist
+ */
+bx_ssize bx_docman_get_handle(char *field_identifier);
+
+/**
+ * Returns the identifier of a field. Handles are assigned in creation order
+ * starting from 0, so all the fields can be enumerated.
+ *
+ * @param handle Field handle
+ * @param identifier Destination buffer of DM_FIELD_IDENTIFIER_LENGTH characters,
+ * null terminated only if the identifier is shorter
+ *
+ * @return 0 on success, -1 if the field does not exist
+ */
+bx_int8 bx_docman_get_identifier(bx_ssize handle, char *identifier);
+
+/**
+ * Reads the values of several fields, each of them consistently.
+ *
+ * @param handles Array of field handles
+ * @param count Number of fields
+ * @param values Destination array of 32 bit values
+ *
+ * @return 0 on success, -1 on error
+ */
+bx_int8 bx_docman_get_many(bx_ssize *handles, bx_size count, bx_uint32 *values);
+
+/**
+ * Writes the values of several fields as a single update: snapshots
+ * observe either none or all of the values written.
+ * The fields preceding a failure are written.
+ *
+ * @param handles Array of field handles
+ * @param count Number of fields
+ * @param values Source array of 32 bit values
+ *
+ * @return 0 on success, -1 on error
+ */
+bx_int8 bx_docman_set_many(bx_ssize *handles, bx_size count, bx_uint32 *values);
+
+/**
+ * Reads the values of several fields, guaranteeing that no write performed
+ * through the document manager took place while reading them. Values
+ * written in place by external processes are not covered.
+ *
+ * @param handles Array of field handles
+ * @param count Number of fields
+ * @param values Destination array of 32 bit values
+ * @param epoch Destination of the update epoch of the values, may be NULL
+ *
+ * @return 0 on success, -1 on error or if the fields are updated too often
+ */
+bx_int8 bx_docman_get_snapshot(bx_ssize *handles, bx_size count, bx_uint32 *values, bx_uint32 *epoch);
+
+/**
+ * Reads the value of a field together with its version.
+ * The version is incremented by every write performed through the document
+ * manager; values written in place by external processes are not versioned.
+ *
+ * @param handle Field handle
+ * @param value Destination of the 32 bit value
+ * @param version Destination of the version
+ *
+ * @return 0 on success, -1 on error
+ */
+bx_int8 bx_docman_get_versioned(bx_ssize handle, bx_uint32 *value, bx_uint32 *version);
+
+/**
+ * Attaches a history to a field. From then on, every value set through the
+ * document manager is recorded in the history together with the time of
+ * the update; values written in place by external processes are not.
+ * The capacity of the history is chosen per field.
+ *
+ * @param field_identifier Field identifier
+ * @param history Initialized history, must outlive the field
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_docman_attach_history(char *field_identifier, struct bx_field_history *history);
+
+/**
+ * Returns the history of a field
+ *
+ * @param field_identifier Field identifier
+ *
+ * @return Field history, NULL if the field does not exist or has no history
+ */
+struct bx_field_history *bx_docman_get_history(char *field_identifier);
+
+/**
+ * Attaches a window to a field, replacing the previous one. From then on,
+ * every value set through the document manager is added to the window.
+ *
+ * @param field_identifier Field identifier
+ * @param window Initialized window, of the field type, must outlive the field
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_docman_attach_window(char *field_identifier, struct bx_field_window *window);
+
+/**
+ * Returns the window of a field
+ *
+ * @param field_identifier Field identifier
+ *
+ * @return Field window, NULL if the field does not exist or has no window
+ */
+struct bx_field_window *bx_docman_get_window(char *field_identifier);
+
 #endif /* TEST_DOCUMENT_MANAGER_H_ */
@@ -0,0 +1,378 @@
+/*
+ * field_column.c
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <string.h>
+#include "logging.h"
+#include "atomic.h"
+#include "utils/seqlock.h"
+#include "document_manager/field_column.h"
+
+/*
+ * With GCC compatible compilers the bulk operations process COLUMN_LANES
+ * values at a time using vector extensions, which the compiler maps to the
+ * SIMD instructions of the target (SSE2, NEON) or to scalar code. Other
+ * compilers, and the values past the last full vector, use scalar loops.
+ */
+#ifdef __GNUC__
+#define COLUMN_VECTORS
+#define COLUMN_LANES 4
+
+typedef bx_int32 column_int_vector __attribute__ ((vector_size (COLUMN_LANES * 4)));
+typedef bx_uint32 column_raw_vector __attribute__ ((vector_size (COLUMN_LANES * 4)));
+typedef bx_float32 column_float_vector __attribute__ ((vector_size (COLUMN_LANES * 4)));
+#endif
+
+/*
+ * Local copy of the values of a column, evaluated by the bulk operations
+ */
+union column_values {
+	bx_uint32 raw[DM_COLUMN_CAPACITY];
+	bx_int32 int_values[DM_COLUMN_CAPACITY];
+	bx_float32 float_values[DM_COLUMN_CAPACITY];
+#ifdef COLUMN_VECTORS
+	column_raw_vector raw_vectors[DM_COLUMN_CAPACITY / COLUMN_LANES];
+	column_int_vector int_vectors[DM_COLUMN_CAPACITY / COLUMN_LANES];
+	column_float_vector float_vectors[DM_COLUMN_CAPACITY / COLUMN_LANES];
+#endif
+};
+
+#ifdef COLUMN_VECTORS
+/**
+ * Stores the lanes of a comparison mask as 0 or 1 flags
+ *
+ * @param mask Comparison result, -1 or 0 in every lane
+ * @param flags Destination of COLUMN_LANES flags
+ * @param counts Accumulated number of set flags per lane
+ */
+static void vector_store_flags(column_int_vector mask, bx_uint8 *flags, column_int_vector *counts) {
+	bx_size lane;
+
+	for (lane = 0; lane < COLUMN_LANES; lane++) {
+		flags[lane] = mask[lane] & 1;
+	}
+	*counts -= mask;
+}
+
+/**
+ * Sums the lanes of a vector
+ */
+static bx_ssize vector_sum(column_int_vector counts) {
+	bx_ssize sum;
+	bx_size lane;
+
+	sum = 0;
+	for (lane = 0; lane < COLUMN_LANES; lane++) {
+		sum += counts[lane];
+	}
+
+	return sum;
+}
+#endif
+
+/*
+ * Maps the bits of a float to an integer with the same ordering, flipping
+ * all but the sign bit of negative values. The mapping is its own inverse.
+ * NaN values are ordered beyond the infinities.
+ */
+#define FLOAT_ORDER_KEY(bits) ((bits) ^ (((bits) >> 31) & 0x7FFFFFFF))
+
+static bx_int8 column_field_get(struct bx_document_field *instance, void *data);
+static bx_int8 column_field_set(struct bx_document_field *instance, void *data);
+
+bx_int8 bx_column_init(struct bx_field_column *column, enum bx_builtin_type type) {
+
+	if (column == NULL || (type != BX_INT && type != BX_FLOAT && type != BX_BOOL)) {
+		return -1;
+	}
+
+	memset(column->values, 0, sizeof column->values);
+	bx_seqlock_init(&column->sequence);
+	column->size = 0;
+	column->type = type;
+
+	return 0;
+}
+
+bx_ssize bx_column_add_field(struct bx_field_column *column, char *identifier) {
+	struct bx_document_field field;
+	bx_size index;
+	bx_ssize result;
+
+	if (column == NULL || identifier == NULL) {
+		return -1;
+	}
+
+	// The column lock also serializes the additions
+	while (bx_seqlock_write_try_begin(&column->sequence) == BX_BOOLEAN_FALSE) {
+	}
+	index = column->size;
+	result = -1;
+	if (index < DM_COLUMN_CAPACITY) {
+		column->slots[index].column = column;
+		column->slots[index].index = index;
+		BX_ATOMIC_STORE(&column->values[index], 0);
+		field.type = column->type;
+		field.private_data = &column->slots[index];
+		field.get = column_field_get;
+		field.set = column_field_set;
+		if (bx_docman_add_field(&field, identifier) == 0) {
+			BX_ATOMIC_STORE(&column->size, index + 1);
+			result = index;
+		}
+	}
+	bx_seqlock_write_end(&column->sequence);
+
+	return result;
+}
+
+bx_ssize bx_column_read(struct bx_field_column *column, bx_uint32 *values) {
+	bx_uint32 start;
+	bx_uint32 attempts;
+	bx_size size;
+	bx_size i;
+
+	if (column == NULL || values == NULL) {
+		return -1;
+	}
+
+	for (attempts = 0; attempts < DM_COLUMN_MAX_ATTEMPTS; attempts++) {
+		start = bx_seqlock_read_begin(&column->sequence);
+		if ((start & 1) != 0) {
+			continue;
+		}
+		size = BX_ATOMIC_LOAD(&column->size);
+		for (i = 0; i < size; i++) {
+			values[i] = BX_ATOMIC_LOAD(&column->values[i]);
+		}
+		if (bx_seqlock_read_end(&column->sequence, start) == BX_BOOLEAN_TRUE) {
+			return size;
+		}
+	}
+
+	BX_LOG(LOG_WARNING, "field_column", "Cannot read column: too many concurrent updates");
+	return -1;
+}
+
+bx_ssize bx_column_threshold(struct bx_field_column *column, void *low, void *high, bx_uint8 *out_of_range) {
+	union column_values values;
+	bx_float32 float_low;
+	bx_float32 float_high;
+	bx_int32 int_low;
+	bx_int32 int_high;
+	bx_ssize size;
+	bx_ssize count;
+	bx_ssize i;
+#ifdef COLUMN_VECTORS
+	column_int_vector counts = {0};
+	column_int_vector int_low_vector;
+	column_int_vector int_high_vector;
+	column_float_vector float_low_vector;
+	column_float_vector float_high_vector;
+	column_float_vector float_vector;
+	column_int_vector int_vector;
+#endif
+
+	if (low == NULL || high == NULL || out_of_range == NULL) {
+		return -1;
+	}
+	size = bx_column_read(column, values.raw);
+	if (size == -1) {
+		return -1;
+	}
+
+	count = 0;
+	i = 0;
+	if (column->type == BX_FLOAT) {
+		memcpy(&float_low, low, sizeof float_low);
+		memcpy(&float_high, high, sizeof float_high);
+#ifdef COLUMN_VECTORS
+		// Subtracting a zero vector broadcasts the scalar to all the lanes
+		float_low_vector = float_low - (column_float_vector) {0};
+		float_high_vector = float_high - (column_float_vector) {0};
+		for (; i + COLUMN_LANES <= size; i += COLUMN_LANES) {
+			float_vector = values.float_vectors[i / COLUMN_LANES];
+			vector_store_flags((float_vector < float_low_vector) | (float_vector > float_high_vector),
+					out_of_range + i, &counts);
+		}
+		count = vector_sum(counts);
+#endif
+		for (; i < size; i++) {
+			out_of_range[i] = (values.float_values[i] < float_low) | (values.float_values[i] > float_high);
+			count += out_of_range[i];
+		}
+	} else {
+		memcpy(&int_low, low, sizeof int_low);
+		memcpy(&int_high, high, sizeof int_high);
+#ifdef COLUMN_VECTORS
+		// Subtracting a zero vector broadcasts the scalar to all the lanes
+		int_low_vector = int_low - (column_int_vector) {0};
+		int_high_vector = int_high - (column_int_vector) {0};
+		for (; i + COLUMN_LANES <= size; i += COLUMN_LANES) {
+			int_vector = values.int_vectors[i / COLUMN_LANES];
+			vector_store_flags((int_vector < int_low_vector) | (int_vector > int_high_vector),
+					out_of_range + i, &counts);
+		}
+		count = vector_sum(counts);
+#endif
+		for (; i < size; i++) {
+			out_of_range[i] = (values.int_values[i] < int_low) | (values.int_values[i] > int_high);
+			count += out_of_range[i];
+		}
+	}
+
+	return count;
+}
+
+bx_int8 bx_column_min_max(struct bx_field_column *column, void *min, void *max) {
+	union column_values values;
+	bx_int32 int_min;
+	bx_int32 int_max;
+	bx_ssize size;
+	bx_ssize i;
+#ifdef COLUMN_VECTORS
+	column_int_vector min_vector;
+	column_int_vector max_vector;
+	column_int_vector int_vector;
+	column_int_vector mask;
+	bx_size lane;
+#endif
+
+	if (min == NULL || max == NULL) {
+		return -1;
+	}
+	size = bx_column_read(column, values.raw);
+	if (size <= 0) {
+		return -1;
+	}
+
+	// Float values are compared as ordered integers, which also orders NaN values
+	if (column->type == BX_FLOAT) {
+		for (i = 0; i < size; i++) {
+			values.int_values[i] = FLOAT_ORDER_KEY(values.int_values[i]);
+		}
+	}
+	int_min = int_max = values.int_values[0];
+	i = 1;
+#ifdef COLUMN_VECTORS
+	if (size >= COLUMN_LANES) {
+		min_vector = max_vector = values.int_vectors[0];
+		for (i = COLUMN_LANES; i + COLUMN_LANES <= size; i += COLUMN_LANES) {
+			int_vector = values.int_vectors[i / COLUMN_LANES];
+			mask = int_vector < min_vector;
+			min_vector = (int_vector & mask) | (min_vector & ~mask);
+			mask = int_vector > max_vector;
+			max_vector = (int_vector & mask) | (max_vector & ~mask);
+		}
+		for (lane = 0; lane < COLUMN_LANES; lane++) {
+			int_min = min_vector[lane] < int_min ? min_vector[lane] : int_min;
+			int_max = max_vector[lane] > int_max ? max_vector[lane] : int_max;
+		}
+	}
+#endif
+	for (; i < size; i++) {
+		int_min = values.int_values[i] < int_min ? values.int_values[i] : int_min;
+		int_max = values.int_values[i] > int_max ? values.int_values[i] : int_max;
+	}
+	if (column->type == BX_FLOAT) {
+		int_min = FLOAT_ORDER_KEY(int_min);
+		int_max = FLOAT_ORDER_KEY(int_max);
+	}
+	memcpy(min, &int_min, sizeof int_min);
+	memcpy(max, &int_max, sizeof int_max);
+
+	return 0;
+}
+
+bx_ssize bx_column_changes(struct bx_field_column *column, bx_uint32 *previous, bx_uint8 *changed) {
+	union column_values values;
+	bx_ssize size;
+	bx_ssize count;
+	bx_ssize i;
+#ifdef COLUMN_VECTORS
+	column_int_vector counts = {0};
+	column_raw_vector previous_vector;
+#endif
+
+	if (previous == NULL || changed == NULL) {
+		return -1;
+	}
+	size = bx_column_read(column, values.raw);
+	if (size == -1) {
+		return -1;
+	}
+
+	count = 0;
+	i = 0;
+#ifdef COLUMN_VECTORS
+	// The previous values are not necessarily aligned for vector accesses
+	for (; i + COLUMN_LANES <= size; i += COLUMN_LANES) {
+		memcpy(&previous_vector, previous + i, sizeof previous_vector);
+		vector_store_flags(values.raw_vectors[i / COLUMN_LANES] != previous_vector, changed + i, &counts);
+		memcpy(previous + i, &values.raw_vectors[i / COLUMN_LANES], sizeof previous_vector);
+	}
+	count = vector_sum(counts);
+#endif
+	for (; i < size; i++) {
+		changed[i] = values.raw[i] != previous[i];
+		count += changed[i];
+		previous[i] = values.raw[i];
+	}
+
+	return count;
+}
+
+static bx_int8 column_field_get(struct bx_document_field *instance, void *data) {
+	struct bx_column_slot *slot;
+	bx_uint32 value;
+
+	slot = (struct bx_column_slot *) instance->private_data;
+	value = BX_ATOMIC_LOAD(&slot->column->values[slot->index]);
+	memcpy(data, &value, sizeof value);
+
+	return 0;
+}
+
+static bx_int8 column_field_set(struct bx_document_field *instance, void *data) {
+	struct bx_column_slot *slot;
+	bx_uint32 value;
+
+	slot = (struct bx_column_slot *) instance->private_data;
+	memcpy(&value, data, sizeof value);
+	if (slot->column->type == BX_BOOL) {
+		value = value != 0;
+	}
+	while (bx_seqlock_write_try_begin(&slot->column->sequence) == BX_BOOLEAN_FALSE) {
+	}
+	BX_ATOMIC_STORE(&slot->column->values[slot->index], value);
+	bx_seqlock_write_end(&slot->column->sequence);
+
+	return 0;
+}
@@ -0,0 +1,138 @@
+/*
+ * field_column.h
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * Field columns.
+ * A field column stores the values of fields of the same type in a
+ * contiguous array, so that bulk operations over many fields scan only
+ * values. The values are followed by the column metadata and by the cold
+ * per-field data referenced by the document manager callbacks.
+ *
+ * Column fields are regular computed fields of the document manager. Every
+ * update of a column field also advances the sequence lock of the column:
+ * bulk operations copy all the values consistently and then evaluate them
+ * several at a time with GCC vector extensions, or with scalar loops on
+ * other compilers.
+ * Boolean values are stored as 0 or 1 and processed as integers.
+ */
+
+#ifndef FIELD_COLUMN_H_
+#define FIELD_COLUMN_H_
+
+#include "types.h"
+#include "configuration.h"
+#include "document_manager/document_manager.h"
+
+struct bx_field_column;
+
+struct bx_column_slot {
+	struct bx_field_column *column;
+	bx_size index;
+};
+
+struct bx_field_column {
+	bx_uint32 values[DM_COLUMN_CAPACITY];	///< Raw 32 bit values, accessed atomically
+	bx_uint32 sequence;			///< Sequence lock of the whole column
+	bx_size size;				///< Number of fields, accessed atomically
+	enum bx_builtin_type type;
+	struct bx_column_slot slots[DM_COLUMN_CAPACITY];
+};
+
+/**
+ * Initializes an empty column
+ *
+ * @param column Column to initialize
+ * @param type Type of the column fields, BX_INT, BX_FLOAT or BX_BOOL
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_column_init(struct bx_field_column *column, enum bx_builtin_type type);
+
+/**
+ * Adds a field stored in the column to the document manager.
+ * The initial value of the field is zero.
+ *
+ * @param column Column storing the field
+ * @param identifier Name of the field
+ *
+ * @return Index of the field in the column, -1 on failure
+ */
+bx_ssize bx_column_add_field(struct bx_field_column *column, char *identifier);
+
+/**
+ * Copies the values of all the fields of a column, consistently with respect
+ * to concurrent updates.
+ *
+ * @param column Column to read
+ * @param values Destination array of DM_COLUMN_CAPACITY raw values
+ *
+ * @return Number of values copied, -1 if the column is updated too often
+ */
+bx_ssize bx_column_read(struct bx_field_column *column, bx_uint32 *values);
+
+/**
+ * Checks the values of a column against a range of valid values.
+ *
+ * @param column Column to check
+ * @param low Lowest valid value, of the column type
+ * @param high Highest valid value, of the column type
+ * @param out_of_range Destination array, set to 1 for the fields outside the
+ * range and 0 for the others
+ *
+ * @return Number of fields outside the range, -1 on failure
+ */
+bx_ssize bx_column_threshold(struct bx_field_column *column, void *low, void *high, bx_uint8 *out_of_range);
+
+/**
+ * Computes the minimum and maximum values of a column
+ *
+ * @param column Column to evaluate
+ * @param min Destination of the minimum value, of the column type
+ * @param max Destination of the maximum value, of the column type
+ *
+ * @return 0 on success, -1 on failure or if the column is empty
+ */
+bx_int8 bx_column_min_max(struct bx_field_column *column, void *min, void *max);
+
+/**
+ * Compares the values of a column with a previous copy, which is then
+ * updated to the current values. Values are compared bitwise.
+ *
+ * @param column Column to evaluate
+ * @param previous Array of DM_COLUMN_CAPACITY raw values, initially zero
+ * @param changed Destination array, set to 1 for the changed fields and 0
+ * for the others
+ *
+ * @return Number of changed fields, -1 on failure
+ */
+bx_ssize bx_column_changes(struct bx_field_column *column, bx_uint32 *previous, bx_uint8 *changed);
+
+#endif /* FIELD_COLUMN_H_ */
@@ -0,0 +1,88 @@
+/*
+ * field_history.c
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "atomic.h"
+#include "document_manager/field_history.h"
+
+/*
+ * The sample with index i is stored at position i % capacity. The writer
+ * announces the append by incrementing started, fills the position of
+ * sample appended, which still holds sample appended - capacity, and then
+ * publishes appended + 1. Sample i is overwritten by the append of sample
+ * i + capacity, so it is valid as long as started <= i + capacity.
+ */
+
+bx_int8 bx_history_init(struct bx_field_history *history, struct bx_history_sample *samples, bx_uint32 capacity) {
+
+	if (history == NULL || samples == NULL || capacity == 0) {
+		return -1;
+	}
+
+	history->samples = samples;
+	history->capacity = capacity;
+	BX_ATOMIC_STORE(&history->appended, 0);
+	BX_ATOMIC_STORE(&history->started, 0);
+
+	return 0;
+}
+
+void bx_history_append(struct bx_field_history *history, bx_uint64 timestamp, bx_uint32 value) {
+	struct bx_history_sample *sample;
+	bx_uint64 appended;
+
+	appended = BX_ATOMIC_LOAD(&history->appended);
+	sample = &history->samples[appended % history->capacity];
+
+	// The increment keeps the sample stores after it
+	BX_ATOMIC_ADD(&history->started, 1);
+	BX_ATOMIC_STORE(&sample->timestamp, timestamp);
+	BX_ATOMIC_STORE(&sample->value, value);
+	BX_ATOMIC_STORE(&history->appended, appended + 1);
+}
+
+bx_uint64 bx_history_first(struct bx_field_history *history, bx_uint64 *end) {
+	bx_uint64 appended;
+
+	appended = BX_ATOMIC_LOAD(&history->appended);
+	*end = appended;
+
+	return appended > history->capacity ? appended - history->capacity : 0;
+}
+
+struct bx_history_sample *bx_history_sample(struct bx_field_history *history, bx_uint64 index) {
+	return &history->samples[index % history->capacity];
+}
+
+bx_boolean bx_history_valid(struct bx_field_history *history, bx_uint64 index) {
+
+	// The sample loads have acquire semantics and cannot move after this load
+	return index + history->capacity >= BX_ATOMIC_LOAD(&history->started) ? BX_BOOLEAN_TRUE : BX_BOOLEAN_FALSE;
+}
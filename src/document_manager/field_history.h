@@ -0,0 +1,120 @@
+/*
+ * field_history.h
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * Field history.
+ * A field history is a fixed capacity ring buffer recording the samples
+ * (timestamp, value) of a field. Samples are appended by a single writer at
+ * a time and read in place by any number of readers, which never block the
+ * writer. A reader detects that the samples it read were overwritten by
+ * checking, after reading them, that the oldest one is still valid:
+ *
+ * first = bx_history_first(history, &end);
+ * for (index = first; index < end; index++) {
+ *     sample = bx_history_sample(history, index);
+ *     ... read the sample fields with BX_ATOMIC_LOAD ...
+ * }
+ * if (bx_history_valid(history, first) == BX_BOOLEAN_FALSE) {
+ *     ... discard the results and retry ...
+ * }
+ */
+
+#ifndef FIELD_HISTORY_H_
+#define FIELD_HISTORY_H_
+
+#include "types.h"
+
+struct bx_history_sample {
+	bx_uint64 timestamp;		///< Monotonic time in microseconds
+	bx_uint32 value;		///< Raw 32 bit value
+	bx_uint32 reserved;
+};
+
+struct bx_field_history {
+	struct bx_history_sample *samples;
+	bx_uint32 capacity;
+	bx_uint64 appended;		///< Number of samples ever appended, accessed atomically
+	bx_uint64 started;		///< Number of appends ever started, accessed atomically
+};
+
+/**
+ * Initializes an empty history
+ *
+ * @param history History to initialize
+ * @param samples Storage of the samples, must outlive the history
+ * @param capacity Number of samples in the storage
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_history_init(struct bx_field_history *history, struct bx_history_sample *samples, bx_uint32 capacity);
+
+/**
+ * Appends a sample, overwriting the oldest one if the history is full.
+ * Writers of the same history must be serialized.
+ *
+ * @param history History
+ * @param timestamp Time of the sample
+ * @param value Raw 32 bit value
+ */
+void bx_history_append(struct bx_field_history *history, bx_uint64 timestamp, bx_uint32 value);
+
+/**
+ * Returns the range of the samples currently stored
+ *
+ * @param history History
+ * @param end Destination of the index following the newest sample
+ *
+ * @return Index of the oldest sample, equal to end if the history is empty
+ */
+bx_uint64 bx_history_first(struct bx_field_history *history, bx_uint64 *end);
+
+/**
+ * Returns the location of a sample, without copying it
+ *
+ * @param history History
+ * @param index Sample index, as returned by bx_history_first
+ *
+ * @return Sample location
+ */
+struct bx_history_sample *bx_history_sample(struct bx_field_history *history, bx_uint64 index);
+
+/**
+ * Checks that a sample read in place was not being overwritten meanwhile.
+ * Samples with higher indices are valid if the sample is.
+ *
+ * @param history History
+ * @param index Sample index
+ *
+ * @return BX_BOOLEAN_TRUE if the sample read is valid, BX_BOOLEAN_FALSE otherwise
+ */
+bx_boolean bx_history_valid(struct bx_field_history *history, bx_uint64 index);
+
+#endif /* FIELD_HISTORY_H_ */
@@ -0,0 +1,343 @@
+/*
+ * field_window.c
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <string.h>
+#include "atomic.h"
+#include "utils/seqlock.h"
+#include "document_manager/field_window.h"
+
+/**
+ * Converts a raw sample to a number
+ *
+ * @param window Window
+ * @param value Raw 32 bit value
+ *
+ * @return Value of the sample
+ */
+static double sample_value(struct bx_field_window *window, bx_uint32 value) {
+	bx_float32 float_value;
+
+	if (window->type == BX_FLOAT) {
+		memcpy(&float_value, &value, sizeof float_value);
+		return float_value;
+	}
+
+	return (bx_int32) value;
+}
+
+/**
+ * Converts a number to a raw float
+ *
+ * @param value Number
+ *
+ * @return Raw 32 bit float
+ */
+static bx_uint32 raw_float(double value) {
+	bx_float32 float_value;
+	bx_uint32 raw;
+
+	float_value = (bx_float32) value;
+	memcpy(&raw, &float_value, sizeof raw);
+
+	return raw;
+}
+
+/**
+ * Adds a sample to the sums and to the running mean and variance
+ *
+ * @param window Window
+ * @param value Raw 32 bit value
+ */
+static void accumulate(struct bx_field_window *window, bx_uint32 value) {
+	double x;
+	double delta;
+
+	x = sample_value(window, value);
+	window->count++;
+	window->int_sum += (bx_int32) value;
+	window->float_sum += x;
+	delta = x - window->mean;
+	window->mean += delta / window->count;
+	window->m2 += delta * (x - window->mean);
+}
+
+/**
+ * Removes a sample from the sums and from the running mean and variance
+ *
+ * @param window Window
+ * @param value Raw 32 bit value
+ */
+static void subtract(struct bx_field_window *window, bx_uint32 value) {
+	double x;
+	double previous_mean;
+
+	x = sample_value(window, value);
+	window->int_sum -= (bx_int32) value;
+	window->float_sum -= x;
+	if (window->count == 1) {
+		window->float_sum = 0;
+		window->mean = 0;
+		window->m2 = 0;
+	} else {
+		previous_mean = window->mean;
+		window->mean = (window->count * window->mean - x) / (window->count - 1);
+		window->m2 -= (x - previous_mean) * (x - window->mean);
+		if (window->m2 < 0) {
+			window->m2 = 0;
+		}
+	}
+	window->count--;
+}
+
+/**
+ * Publishes the aggregates of the samples accumulated
+ *
+ * @param window Window
+ * @param min_value Raw minimum, ignored if the window is empty
+ * @param max_value Raw maximum, ignored if the window is empty
+ */
+static void publish(struct bx_field_window *window, bx_uint32 min_value, bx_uint32 max_value) {
+	bx_uint32 results[BX_AGGREGATE_NUMBER];
+	bx_size i;
+
+	memset(results, 0, sizeof results);
+	results[BX_AGGREGATE_COUNT] = window->count;
+	if (window->count > 0) {
+		if (window->type == BX_FLOAT) {
+			results[BX_AGGREGATE_SUM] = raw_float(window->float_sum);
+		} else {
+			results[BX_AGGREGATE_SUM] = (bx_uint32) window->int_sum;
+		}
+		results[BX_AGGREGATE_AVG] = raw_float(window->mean);
+		results[BX_AGGREGATE_MIN] = min_value;
+		results[BX_AGGREGATE_MAX] = max_value;
+		results[BX_AGGREGATE_VARIANCE] = raw_float(window->m2 / window->count);
+	}
+
+	while (bx_seqlock_write_try_begin(&window->sequence) == BX_BOOLEAN_FALSE) {
+	}
+	for (i = 0; i < BX_AGGREGATE_NUMBER; i++) {
+		BX_ATOMIC_STORE(&window->results[i], results[i]);
+	}
+	bx_seqlock_write_end(&window->sequence);
+}
+
+/**
+ * Resets the accumulated samples
+ *
+ * @param window Window
+ */
+static void reset(struct bx_field_window *window) {
+	window->first = 0;
+	window->count = 0;
+	window->min_first = 0;
+	window->min_count = 0;
+	window->max_first = 0;
+	window->max_count = 0;
+	window->int_sum = 0;
+	window->float_sum = 0;
+	window->mean = 0;
+	window->m2 = 0;
+}
+
+/**
+ * Evicts the oldest sample of a sliding window
+ *
+ * @param window Window
+ */
+static void evict_oldest(struct bx_field_window *window) {
+	struct bx_window_entry *entries;
+
+	entries = window->entries;
+	if (window->min_count > 0 && entries[window->min_first].min_position == window->first) {
+		window->min_first = (window->min_first + 1) % window->capacity;
+		window->min_count--;
+	}
+	if (window->max_count > 0 && entries[window->max_first].max_position == window->first) {
+		window->max_first = (window->max_first + 1) % window->capacity;
+		window->max_count--;
+	}
+	subtract(window, entries[window->first].value);
+	window->first = (window->first + 1) % window->capacity;
+}
+
+/**
+ * Adds a sample to a sliding window
+ *
+ * @param window Window
+ * @param timestamp Time of the sample
+ * @param value Raw 32 bit value
+ */
+static void sliding_add(struct bx_field_window *window, bx_uint64 timestamp, bx_uint32 value) {
+	struct bx_window_entry *entries;
+	bx_uint32 position;
+	bx_uint32 back;
+	double x;
+
+	entries = window->entries;
+	while (window->count > 0 && (window->count == window->capacity ||
+			(window->span_usec != 0 && entries[window->first].timestamp + window->span_usec < timestamp))) {
+		evict_oldest(window);
+	}
+
+	position = (window->first + window->count) % window->capacity;
+	entries[position].timestamp = timestamp;
+	entries[position].value = value;
+	accumulate(window, value);
+
+	// Samples dominated by the new one can never become the minimum or the maximum
+	x = sample_value(window, value);
+	while (window->min_count > 0) {
+		back = (window->min_first + window->min_count - 1) % window->capacity;
+		if (sample_value(window, entries[entries[back].min_position].value) < x) {
+			break;
+		}
+		window->min_count--;
+	}
+	entries[(window->min_first + window->min_count) % window->capacity].min_position = position;
+	window->min_count++;
+	while (window->max_count > 0) {
+		back = (window->max_first + window->max_count - 1) % window->capacity;
+		if (sample_value(window, entries[entries[back].max_position].value) > x) {
+			break;
+		}
+		window->max_count--;
+	}
+	entries[(window->max_first + window->max_count) % window->capacity].max_position = position;
+	window->max_count++;
+
+	publish(window, entries[entries[window->min_first].min_position].value,
+			entries[entries[window->max_first].max_position].value);
+}
+
+/**
+ * Adds a sample to a tumbling window
+ *
+ * @param window Window
+ * @param timestamp Time of the sample
+ * @param value Raw 32 bit value
+ */
+static void tumbling_add(struct bx_field_window *window, bx_uint64 timestamp, bx_uint32 value) {
+	double x;
+
+	if (window->count > 0 && window->span_usec != 0 && timestamp - window->start_timestamp >= window->span_usec) {
+		publish(window, window->min_value, window->max_value);
+		reset(window);
+	}
+
+	x = sample_value(window, value);
+	if (window->count == 0) {
+		window->start_timestamp = timestamp;
+		window->min_value = value;
+		window->max_value = value;
+	} else if (x < sample_value(window, window->min_value)) {
+		window->min_value = value;
+	} else if (x > sample_value(window, window->max_value)) {
+		window->max_value = value;
+	}
+	accumulate(window, value);
+
+	if (window->count == window->capacity) {
+		publish(window, window->min_value, window->max_value);
+		reset(window);
+	}
+}
+
+bx_int8 bx_window_init(struct bx_field_window *window, enum bx_builtin_type type,
+		enum bx_window_type window_type, bx_uint32 capacity, bx_uint64 span_usec,
+		struct bx_window_entry *entries) {
+
+	if (window == NULL || capacity == 0 || (type != BX_INT && type != BX_FLOAT && type != BX_BOOL)) {
+		return -1;
+	}
+	if (window_type == BX_WINDOW_SLIDING && entries == NULL) {
+		return -1;
+	}
+
+	window->type = type;
+	window->window_type = window_type;
+	window->capacity = capacity;
+	window->span_usec = span_usec;
+	window->entries = window_type == BX_WINDOW_SLIDING ? entries : NULL;
+	reset(window);
+	bx_seqlock_init(&window->sequence);
+	publish(window, 0, 0);
+
+	return 0;
+}
+
+void bx_window_add(struct bx_field_window *window, bx_uint64 timestamp, bx_uint32 value) {
+
+	if (window->window_type == BX_WINDOW_SLIDING) {
+		sliding_add(window, timestamp, value);
+	} else {
+		tumbling_add(window, timestamp, value);
+	}
+}
+
+bx_int8 bx_window_get(struct bx_field_window *window, enum bx_aggregate aggregate, bx_uint32 *value) {
+	bx_uint32 start;
+	bx_uint32 count;
+
+	if (window == NULL || value == NULL || aggregate >= BX_AGGREGATE_NUMBER) {
+		return -1;
+	}
+
+	do {
+		start = bx_seqlock_read_begin(&window->sequence);
+		count = BX_ATOMIC_LOAD(&window->results[BX_AGGREGATE_COUNT]);
+		*value = BX_ATOMIC_LOAD(&window->results[aggregate]);
+	} while (bx_seqlock_read_end(&window->sequence, start) == BX_BOOLEAN_FALSE);
+
+	if (count == 0 && aggregate != BX_AGGREGATE_COUNT && aggregate != BX_AGGREGATE_SUM) {
+		return -1;
+	}
+
+	return 0;
+}
+
+bx_int8 bx_window_get_all(struct bx_field_window *window, bx_uint32 *values) {
+	bx_uint32 start;
+	bx_size i;
+
+	if (window == NULL || values == NULL) {
+		return -1;
+	}
+
+	do {
+		start = bx_seqlock_read_begin(&window->sequence);
+		for (i = 0; i < BX_AGGREGATE_NUMBER; i++) {
+			values[i] = BX_ATOMIC_LOAD(&window->results[i]);
+		}
+	} while (bx_seqlock_read_end(&window->sequence, start) == BX_BOOLEAN_FALSE);
+
+	return 0;
+}
@@ -0,0 +1,155 @@
+/*
+ * field_window.h
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * Field windows.
+ * A field window incrementally computes aggregates over the recent samples
+ * of a field, in O(1) amortized time per sample. Sliding windows contain
+ * the last capacity samples, optionally limited to the samples not older
+ * than span_usec; the sum and the variance are updated by subtracting the
+ * evicted samples and the minimum and the maximum are kept by monotonic
+ * deques. Tumbling windows aggregate consecutive groups of capacity samples,
+ * optionally closed early once span_usec elapsed since their first sample,
+ * and expose the aggregates of the last group completed.
+ *
+ * Samples are added by a single writer at a time; the aggregates are
+ * published through a sequence lock, so readers never block the writer.
+ * Windows only advance when samples are added.
+ */
+
+#ifndef FIELD_WINDOW_H_
+#define FIELD_WINDOW_H_
+
+#include "types.h"
+
+enum bx_window_type {
+	BX_WINDOW_SLIDING,
+	BX_WINDOW_TUMBLING
+};
+
+enum bx_aggregate {
+	BX_AGGREGATE_COUNT,		// Number of samples, integer
+	BX_AGGREGATE_SUM,		// Sum of the samples, of the field type
+	BX_AGGREGATE_AVG,		// Mean of the samples, float
+	BX_AGGREGATE_MIN,		// Minimum sample, of the field type
+	BX_AGGREGATE_MAX,		// Maximum sample, of the field type
+	BX_AGGREGATE_VARIANCE,	// Population variance of the samples, float
+	BX_AGGREGATE_NUMBER
+};
+
+/**
+ * Sample of a sliding window. The ring of entries also stores the two
+ * deques, whose elements are ring positions.
+ */
+struct bx_window_entry {
+	bx_uint64 timestamp;
+	bx_uint32 value;		///< Raw 32 bit value
+	bx_uint32 min_position;		///< Element of the minimum deque
+	bx_uint32 max_position;		///< Element of the maximum deque
+};
+
+struct bx_field_window {
+	enum bx_builtin_type type;
+	enum bx_window_type window_type;
+	bx_uint32 capacity;
+	bx_uint64 span_usec;		///< 0 if the window is not limited in time
+	struct bx_window_entry *entries;	///< Ring of samples, NULL for tumbling windows
+
+	// Writer state
+	bx_uint32 first;		///< Ring position of the oldest sample
+	bx_uint32 count;
+	bx_uint32 min_first;
+	bx_uint32 min_count;
+	bx_uint32 max_first;
+	bx_uint32 max_count;
+	bx_uint64 start_timestamp;	///< Timestamp of the first sample of a tumbling window
+	bx_uint32 min_value;		///< Minimum of a tumbling window
+	bx_uint32 max_value;		///< Maximum of a tumbling window
+	bx_int64 int_sum;
+	double float_sum;
+	double mean;
+	double m2;			///< Sum of squared differences from the mean
+
+	// Published aggregates
+	bx_uint32 sequence;
+	bx_uint32 results[BX_AGGREGATE_NUMBER];	///< Accessed atomically
+};
+
+/**
+ * Initializes an empty window
+ *
+ * @param window Window to initialize
+ * @param type Type of the samples, BX_INT, BX_FLOAT or BX_BOOL
+ * @param window_type Sliding or tumbling window
+ * @param capacity Maximum number of samples in the window
+ * @param span_usec Time span of the window in microseconds, 0 for none
+ * @param entries Storage of capacity samples for sliding windows, must
+ * outlive the window; ignored by tumbling windows
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_window_init(struct bx_field_window *window, enum bx_builtin_type type,
+		enum bx_window_type window_type, bx_uint32 capacity, bx_uint64 span_usec,
+		struct bx_window_entry *entries);
+
+/**
+ * Adds a sample to a window and publishes the updated aggregates.
+ * Writers of the same window must be serialized.
+ *
+ * @param window Window
+ * @param timestamp Time of the sample in microseconds, not decreasing
+ * @param value Raw 32 bit value
+ */
+void bx_window_add(struct bx_field_window *window, bx_uint64 timestamp, bx_uint32 value);
+
+/**
+ * Reads an aggregate of a window
+ *
+ * @param window Window
+ * @param aggregate Aggregate to read
+ * @param value Destination of the raw 32 bit aggregate
+ *
+ * @return 0 on success, -1 on failure or if the aggregate of an empty
+ * window is undefined
+ */
+bx_int8 bx_window_get(struct bx_field_window *window, enum bx_aggregate aggregate, bx_uint32 *value);
+
+/**
+ * Reads all the aggregates of a window consistently
+ *
+ * @param window Window
+ * @param values Destination array of BX_AGGREGATE_NUMBER raw aggregates
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_window_get_all(struct bx_field_window *window, bx_uint32 *values);
+
+#endif /* FIELD_WINDOW_H_ */
@@ -0,0 +1,127 @@
+/*
+ * checkpoint.h
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/**
+ * Runtime checkpoints.
+ * A checkpoint saves in a single file the state needed to resume the
+ * runtime after a restart: the scheduler tasks, the pending timers with the
+ * ticks remaining before their expiration, the programs of the pcode tasks,
+ * the variables of the virtual machine contexts and the values of the plain
+ * document fields. The file is laid out in host byte order exactly as it is
+ * used, so restoring maps it and applies the records in place:
+ *
+ * +--------+--------+-------+--------+-----------+---------+--------------+
+ * | Header | Timers | Tasks | Fields | Variables | Padding | Pcode module |
+ * +--------+--------+-------+--------+-----------+---------+--------------+
+ *
+ * The programs are stored in a pcode module starting at a page boundary and
+ * are executed in place from a mapping of the file, without being copied.
+ * The header records the instruction set of the virtual machine that wrote
+ * the checkpoint: a checkpoint from a different instruction encoding is
+ * rejected, and one from a build with a different set of instructions has
+ * its programs validated again before they are restored.
+ *
+ * Native functions cannot be saved: the application has to add its native
+ * tasks again, obtaining the same ids, before restoring a checkpoint. Computed
+ * fields and runtime statistics are not saved. A checkpoint is only valid for
+ * the configuration that wrote it.
+ */
+
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include "types.h"
+#include "configuration.h"
+
+#define BX_CHECKPOINT_MAGIC 0x42584350
+#define BX_CHECKPOINT_VERSION 2
+
+struct bx_checkpoint_header {
+	bx_uint32 magic;
+	bx_uint16 version;
+	bx_uint8 instruction_set;			///< BX_VM_INSTRUCTION_SET of the writer
+	bx_uint8 last_instruction;			///< BX_INSTR_LAST of the writer
+	bx_uint32 timer_resolution_usec;
+	bx_uint32 context_number;			///< Number of variable tables
+	bx_uint32 variable_table_size;
+	bx_uint32 timer_number;
+	bx_uint32 task_number;
+	bx_uint32 field_number;
+	bx_uint32 timer_offset;				///< Offset of the bx_timer_state array
+	bx_uint32 task_offset;				///< Offset of the bx_checkpoint_task array
+	bx_uint32 field_offset;				///< Offset of the bx_checkpoint_field array
+	bx_uint32 variable_offset;			///< Offset of the variable tables
+	bx_uint32 module_offset;			///< Offset of the pcode module, 0 if there are no pcode tasks
+};
+
+struct bx_checkpoint_task {
+	bx_int16 task_id;
+	bx_uint8 native;
+	bx_uint8 priority;
+	bx_uint8 overrun_policy;
+	bx_uint8 queue_limit;
+	bx_uint16 requests;					///< Outstanding executions, scheduled again on restore
+	bx_uint32 deadline_msec;
+	bx_uint16 program;					///< Index of the program inside the module
+	bx_uint16 reserved;
+};
+
+struct bx_checkpoint_field {
+	char identifier[DM_FIELD_IDENTIFIER_LENGTH];
+	bx_uint32 value;
+};
+
+/**
+ * Saves the state of the runtime. The file is written under a temporary
+ * name and renamed, so an existing checkpoint is replaced atomically.
+ * Tasks must not be added, removed or replaced while saving, and no worker
+ * should be running to capture a consistent state.
+ *
+ * @param path Path of the checkpoint file
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_checkpoint_save(const char *path);
+
+/**
+ * Restores the state of the runtime from a checkpoint. The runtime must be
+ * initialized, with its fields and native tasks added and no pcode task or
+ * timer. The whole checkpoint is checked before the runtime is modified, so
+ * on failure the runtime is left as it was.
+ *
+ * @param path Path of the checkpoint file
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_checkpoint_restore(const char *path);
+
+#endif /* CHECKPOINT_H_ */
@@ -32,79 +32,251 @@
 #include <string.h>
 #include "configuration.h"
 #include "logging.h"
+#include "utils/buddy_allocator.h"
 #include "runtime/pcode_manager.h"
+#include "runtime/pcode_module.h"
 #include "virtual_machine/virtual_machine.h"
 
-#define SPACE_USED (pcode_manager.pcode_count * sizeof (struct bx_pcode)) + pcode_manager.total_instruction_length
-#define PCODE_STRUCT(index) \
-	(struct bx_pcode *) (pcode_manager.pcode_storage + PR_CODE_STORAGE_SIZE - 1 - (index + 1) * sizeof (struct bx_pcode))
+/*
+ * Program instructions are allocated from pcode_storage through a buddy
+ * allocator, while the bx_pcode structures live in a separate table. The
+ * pointer to a bx_pcode structure is a stable handle: neither the structure
+ * nor the instructions it references are ever moved, so adding or removing a
+ * program does not affect the other programs, even while they execute.
+ *
+ * Stored programs are content addressed: adding a program identical to one
+ * already in the storage returns the existing handle and increments its
+ * reference count instead of storing a second copy. Stored programs are
+ * indexed by their FNV-1a hash in PR_HASH_BUCKETS chained buckets, and the
+ * candidates of a bucket are compared by hash and size before their content.
+ * Mapped programs are not shared, since their module already provides a
+ * single copy of the instructions.
+ */
+
+// End of a hash bucket chain
+#define NO_PCODE PR_MAX_PCODES
+
+#define HASH_BUCKET(hash) ((hash) % PR_HASH_BUCKETS)
 
 struct bx_pcode {
 	bx_boolean valid;
 	void *instructions;
 	bx_size size;
+	struct bx_pcode_module *module;		///< Module the instructions are mapped from, NULL if stored
+	bx_uint32 hash;						///< FNV-1a hash of the instructions
+	bx_uint16 references;				///< Number of bx_pcode_add calls returning this handle
+	bx_uint8 next;						///< Next stored program of the hash bucket, NO_PCODE if last
 };
 
 static struct bx_pcode_manager {
-	bx_uint8 pcode_storage[PR_CODE_STORAGE_SIZE];
-	bx_size total_instruction_length;
-	bx_size pcode_count;
+	struct bx_pcode pcode_table[PR_MAX_PCODES];
+	bx_uint8 free_pcodes[PR_MAX_PCODES];	///< Stack of unused pcode table entries
+	bx_uint8 free_pcode_number;
+	bx_uint8 hash_buckets[PR_HASH_BUCKETS];	///< First stored program of each hash bucket, NO_PCODE if empty
+	struct bx_balloc *instruction_balloc;
+	bx_uint8 pcode_storage[BX_BALLOC_STORAGE_SIZE(PR_CODE_STORAGE_SIZE, PR_MIN_BLOCK_SIZE)];
 } pcode_manager;
 
-static struct bx_pcode *get_available_pcode();
+/**
+ * Checks whether a pointer references an entry of the pcode table
+ *
+ * @param pcode Pointer to check
+ *
+ * @return BX_BOOLEAN_TRUE if the pointer is a valid handle, BX_BOOLEAN_FALSE otherwise
+ */
+static bx_boolean is_handle(struct bx_pcode *pcode) {
+
+	if (pcode < pcode_manager.pcode_table || pcode >= pcode_manager.pcode_table + PR_MAX_PCODES) {
+		return BX_BOOLEAN_FALSE;
+	}
+
+	return BX_BOOLEAN_TRUE;
+}
+
+/**
+ * Computes the 32 bit FNV-1a hash of a program
+ *
+ * @param buffer Instruction buffer
+ * @param buffer_size Instruction buffer size
+ *
+ * @return Hash of the buffer content
+ */
+static bx_uint32 hash_instructions(bx_uint8 *buffer, bx_size buffer_size) {
+	bx_uint32 hash;
+	bx_size i;
+
+	hash = 2166136261u;
+	for (i = 0; i < buffer_size; i++) {
+		hash ^= buffer[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/**
+ * Looks for a stored program with the same content as a buffer
+ *
+ * @param buffer Instruction buffer
+ * @param buffer_size Instruction buffer size
+ * @param hash Hash of the buffer content
+ *
+ * @return Handle of the stored program, NULL if none is identical
+ */
+static struct bx_pcode *find_identical(void *buffer, bx_size buffer_size, bx_uint32 hash) {
+	struct bx_pcode *pcode;
+	bx_uint8 index;
+
+	for (index = pcode_manager.hash_buckets[HASH_BUCKET(hash)]; index != NO_PCODE; index = pcode->next) {
+		pcode = &pcode_manager.pcode_table[index];
+		if (pcode->hash == hash && pcode->size == buffer_size
+				&& memcmp(pcode->instructions, buffer, buffer_size) == 0) {
+			return pcode;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Removes a stored program from its hash bucket
+ *
+ * @param pcode Stored program
+ */
+static void unlink_identical(struct bx_pcode *pcode) {
+	bx_uint8 *link;
+
+	link = &pcode_manager.hash_buckets[HASH_BUCKET(pcode->hash)];
+	while (*link != NO_PCODE && &pcode_manager.pcode_table[*link] != pcode) {
+		link = &pcode_manager.pcode_table[*link].next;
+	}
+	if (*link != NO_PCODE) {
+		*link = pcode->next;
+	}
+}
 
 bx_int8 bx_pcode_init() {
-	pcode_manager.total_instruction_length = 0;
-	pcode_manager.pcode_count = 0;
+	bx_size i;
+
+	for (i = 0; i < PR_MAX_PCODES; i++) {
+		pcode_manager.pcode_table[i].valid = BX_BOOLEAN_FALSE;
+		pcode_manager.pcode_table[i].instructions = NULL;
+		pcode_manager.pcode_table[i].size = 0;
+		pcode_manager.pcode_table[i].module = NULL;
+		pcode_manager.pcode_table[i].hash = 0;
+		pcode_manager.pcode_table[i].references = 0;
+		pcode_manager.pcode_table[i].next = NO_PCODE;
+		pcode_manager.free_pcodes[i] = PR_MAX_PCODES - 1 - i;
+	}
+	pcode_manager.free_pcode_number = PR_MAX_PCODES;
+	for (i = 0; i < PR_HASH_BUCKETS; i++) {
+		pcode_manager.hash_buckets[i] = NO_PCODE;
+	}
+
+	pcode_manager.instruction_balloc = bx_balloc_init(pcode_manager.pcode_storage,
+			sizeof pcode_manager.pcode_storage, PR_MIN_BLOCK_SIZE);
+	if (pcode_manager.instruction_balloc == NULL) {
+		return -1;
+	}
 
 	return 0;
 }
 
 struct bx_pcode *bx_pcode_add(void *buffer, bx_size buffer_size) {
 	struct bx_pcode *pcode;
+	void *instructions;
+	bx_uint32 hash;
 
-	if (buffer == NULL) {
+	if (buffer == NULL || buffer_size == 0) {
 		return NULL;
 	}
 
-	if (buffer_size + sizeof (struct bx_pcode) + SPACE_USED > PR_CODE_STORAGE_SIZE) {
+	hash = hash_instructions((bx_uint8 *) buffer, buffer_size);
+	pcode = find_identical(buffer, buffer_size, hash);
+	if (pcode != NULL) {
+		if (pcode->references == 0xFFFF) {
+			BX_LOG(LOG_ERROR, "pcode_repository", "Cannot share pcode program: too many references");
+			return NULL;
+		}
+		pcode->references++;
+		return pcode;
+	}
+
+	if (pcode_manager.free_pcode_number == 0) {
+		BX_LOG(LOG_ERROR, "pcode_repository", "Cannot store new pcode program: too many programs");
+		return NULL;
+	}
+
+	instructions = bx_balloc_alloc(pcode_manager.instruction_balloc, buffer_size);
+	if (instructions == NULL) {
 		BX_LOG(LOG_ERROR, "pcode_repository", "Cannot store new pcode program: not enough space");
 		return NULL;
 	}
 
-	pcode = get_available_pcode();
-	pcode->instructions = (void *) (pcode_manager.pcode_storage + pcode_manager.total_instruction_length);
+	pcode = &pcode_manager.pcode_table[pcode_manager.free_pcodes[--pcode_manager.free_pcode_number]];
+	pcode->instructions = instructions;
 	pcode->size = buffer_size;
+	pcode->module = NULL;
+	pcode->hash = hash;
+	pcode->references = 1;
 	pcode->valid = BX_BOOLEAN_TRUE;
 	memcpy(pcode->instructions, buffer, buffer_size);
-
-	pcode_manager.pcode_count += 1;
-	pcode_manager.total_instruction_length += buffer_size;
+	pcode->next = pcode_manager.hash_buckets[HASH_BUCKET(hash)];
+	pcode_manager.hash_buckets[HASH_BUCKET(hash)] = pcode - pcode_manager.pcode_table;
 
 	return pcode;
 }
 
-static struct bx_pcode *get_available_pcode() {
+struct bx_pcode *bx_pcode_add_in_place(void *instructions, bx_size size, struct bx_pcode_module *module) {
 	struct bx_pcode *pcode;
-	bx_size i;
 
-	for (i = 0; i < pcode_manager.pcode_count; i++) {
-		pcode = PCODE_STRUCT(i);
-		if (pcode->valid == BX_BOOLEAN_FALSE) {
-			return pcode;
-		}
+	if (instructions == NULL || size == 0) {
+		return NULL;
 	}
 
-	return PCODE_STRUCT(pcode_manager.pcode_count++);
+	if (pcode_manager.free_pcode_number == 0) {
+		BX_LOG(LOG_ERROR, "pcode_repository", "Cannot add pcode program: too many programs");
+		return NULL;
+	}
+
+	pcode = &pcode_manager.pcode_table[pcode_manager.free_pcodes[--pcode_manager.free_pcode_number]];
+	pcode->instructions = instructions;
+	pcode->size = size;
+	pcode->module = module;
+	pcode->hash = 0;
+	pcode->references = 1;
+	pcode->valid = BX_BOOLEAN_TRUE;
+
+	return pcode;
+}
+
+bx_int8 bx_pcode_get_instructions(struct bx_pcode *pcode, void **instructions, bx_size *size) {
+
+	if (pcode == NULL || instructions == NULL || size == NULL) {
+		return -1;
+	}
+
+	if (!is_handle(pcode) || pcode->valid == BX_BOOLEAN_FALSE) {
+		BX_LOG(LOG_ERROR, "pcode_repository", "Invalid pcode data structure");
+		return -1;
+	}
+
+	*instructions = pcode->instructions;
+	*size = pcode->size;
+
+	return 0;
 }
 
 bx_int8 bx_pcode_execute(struct bx_pcode *pcode) {
+	return bx_pcode_execute_in_context(pcode, 0);
+}
+
+bx_int8 bx_pcode_execute_in_context(struct bx_pcode *pcode, bx_uint8 context) {
 	if (pcode == NULL) {
 		return -1;
 	}
 
-	if ((bx_uint8 *) pcode > pcode_manager.pcode_storage + PR_CODE_STORAGE_SIZE - 1 ||
-			(bx_uint8 *) pcode < (bx_uint8 *) PCODE_STRUCT(pcode_manager.pcode_count - 1) ) {
+	if (!is_handle(pcode)) {
 		BX_LOG(LOG_ERROR, "pcode_repository", "Invalid pcode data structure");
 		return -1;
 	}
@@ -114,45 +286,40 @@ bx_int8 bx_pcode_execute(struct bx_pcode *pcode) {
 		return -1;
 	}
 
-	return bx_vm_execute((bx_uint8 *) pcode->instructions, pcode->size);
+	return bx_vm_execute_in_context(context, (bx_uint8 *) pcode->instructions, pcode->size);
 }
 
 bx_size bx_pcode_current_capacity() {
-	return PR_CODE_STORAGE_SIZE - SPACE_USED - sizeof (struct bx_pcode);
+	return bx_balloc_remaining_capacity(pcode_manager.instruction_balloc);
 }
 
 bx_int8 bx_pcode_remove(struct bx_pcode *pcode) {
-	void *destination;
-	void *source;
-	bx_size length;
 
 	if (pcode == NULL) {
 		return -1;
 	}
 
-	if ((bx_uint8 *) pcode > pcode_manager.pcode_storage + PR_CODE_STORAGE_SIZE - 1 ||
-			(bx_uint8 *) pcode < (bx_uint8 *) PCODE_STRUCT(pcode_manager.pcode_count - 1)) {
+	if (!is_handle(pcode) || pcode->valid == BX_BOOLEAN_FALSE) {
 		BX_LOG(LOG_ERROR, "pcode_repository", "Invalid pcode data structure");
 		return -1;
 	}
 
-	pcode->valid = BX_BOOLEAN_FALSE;
-	destination = (void *) pcode->instructions;
-	source = (void *) ((bx_uint8 *) pcode->instructions + pcode->size);
-	length = pcode_manager.total_instruction_length - ((bx_uint8 *) source - pcode_manager.pcode_storage);
-	memmove(destination, source, length);
-	pcode_manager.total_instruction_length -= pcode->size;
-
-	int i;
-	for (i = 0; i < pcode_manager.pcode_count; i++) {
-		struct bx_pcode *current_pcode = PCODE_STRUCT(i);
-		if (current_pcode->instructions > pcode->instructions) {
-			current_pcode->instructions = (void *) ((bx_uint8 *) current_pcode->instructions - pcode->size);
-		}
+	pcode->references--;
+	if (pcode->references > 0) {
+		return 0;
 	}
 
+	if (pcode->module != NULL) {
+		bx_pmod_release(pcode->module);
+		pcode->module = NULL;
+	} else {
+		unlink_identical(pcode);
+		bx_balloc_free(pcode_manager.instruction_balloc, pcode->instructions);
+	}
+	pcode->valid = BX_BOOLEAN_FALSE;
 	pcode->instructions = NULL;
 	pcode->size = 0;
+	pcode_manager.free_pcodes[pcode_manager.free_pcode_number++] = pcode - pcode_manager.pcode_table;
 
 	return 0;
 }
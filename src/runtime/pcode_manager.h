@@ -35,6 +35,7 @@
 #include "types.h"
 
 struct bx_pcode;
+struct bx_pcode_module;
 
 /**
  * Initialize pcode repository internal data structures.
@@ -48,6 +49,10 @@ bx_int8 bx_pcode_init();
  * This function creates a copy of the buffer content inside the pcode_manager
  * data structures. This memory can be relinquished by removing the pcode
  * pointer through the bx_pcode_remove function.
+ * The returned pointer is a stable handle to the program until its removal.
+ * If an identical program is already stored, its handle is returned and
+ * shared instead of storing a second copy: every successful call must be
+ * matched by a bx_pcode_remove call.
  *
  * @param buffer Instruction buffer
  * @param buffer_size Instruction buffer size
@@ -56,6 +61,31 @@ bx_int8 bx_pcode_init();
  */
 struct bx_pcode *bx_pcode_add(void *buffer, bx_size buffer_size);
 
+/**
+ * Adds a pcode program executed in place, without copying it.
+ * The instructions must stay valid and unchanged until the program is
+ * removed; they should be checked with bx_vm_validate if they come from an
+ * untrusted source.
+ *
+ * @param instructions Instruction buffer
+ * @param size Instruction buffer size
+ * @param module Module owning the instructions, released on removal, NULL if none
+ *
+ * @return New bx_pcode structure, NULL on failure
+ */
+struct bx_pcode *bx_pcode_add_in_place(void *instructions, bx_size size, struct bx_pcode_module *module);
+
+/**
+ * Returns the instructions of a pcode program.
+ *
+ * @param pcode Program handle
+ * @param instructions Destination of the instruction buffer pointer
+ * @param size Destination of the instruction buffer size
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_pcode_get_instructions(struct bx_pcode *pcode, void **instructions, bx_size *size);
+
 /**
  * Invokes the virtual machine and executes a pcode program.
  *
@@ -65,11 +95,23 @@ struct bx_pcode *bx_pcode_add(void *buffer, bx_size buffer_size);
  */
 bx_int8 bx_pcode_execute(struct bx_pcode *pcode);
 
+/**
+ * Invokes the virtual machine and executes a pcode program using a specific
+ * virtual machine execution context.
+ *
+ * @param pcode Program to execute
+ * @param context Virtual machine execution context index
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_pcode_execute_in_context(struct bx_pcode *pcode, bx_uint8 context);
+
 /**
  * Returns the remaining storage capacity in bytes.
  * This method should be invoked prior to trying to add new pcode data, to
  * check whether the remaining storage capacity is enough to contain the code
- * buffer.
+ * buffer. Programs occupy a power of two number of bytes and fragmentation
+ * may prevent storing a program as large as the remaining capacity.
  *
  * @return Remaining storage capacity in bytes
  */
@@ -77,7 +119,10 @@ bx_size bx_pcode_current_capacity();
 
 /**
  * Removes a pcode program from the repository.
- * Space occupied by the program is reclaimed and freed for future uses.
+ * Space occupied by the program is reclaimed and freed for future uses once
+ * every bx_pcode_add call that returned this handle has been matched by a
+ * removal.
+ * The other programs are not moved, so their bx_pcode pointers stay valid.
  *
  * @param pcode Pointer to the pcode structure to remove
  *
@@ -0,0 +1,159 @@
+/*
+ * pcode_module.h
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * Compiled pcode modules.
+ * A module file contains several pcode programs, which are executed in place
+ * from a read-only memory mapping of the file instead of being copied into
+ * the pcode storage. All the values are stored in big endian byte order:
+ *
+ * +--------+---------+----------------+-----------------------------+
+ * | Magic  | Version | Program number | Program table | Programs    |
+ * | 32 bit | 16 bit  | 16 bit         | 64 bit each   |             |
+ * +--------+---------+----------------+-----------------------------+
+ *
+ * Each program table entry contains the 32 bit offset of a program from the
+ * beginning of the file, followed by its 32 bit size.
+ */
+
+#ifndef PCODE_MODULE_H_
+#define PCODE_MODULE_H_
+
+#include "types.h"
+
+#define BX_PCODE_MODULE_MAGIC 0x4258504D
+#define BX_PCODE_MODULE_VERSION 1
+#define BX_PCODE_MODULE_HEADER_SIZE 8
+#define BX_PCODE_MODULE_ENTRY_SIZE 8
+
+struct bx_pcode;
+struct bx_pcode_module;
+
+/**
+ * Opens a module file and validates all the programs it contains.
+ *
+ * @param path Path of the module file
+ *
+ * @return Module instance pointer, NULL on error or invalid module
+ */
+struct bx_pcode_module *bx_pmod_open(const char *path);
+
+/**
+ * Opens a module stored inside a larger file without validating the code of
+ * its programs. Only the header and the program table are checked, so the
+ * module must come from a trusted source, such as a file written by this
+ * runtime.
+ *
+ * @param path Path of the file
+ * @param offset Offset of the module inside the file, multiple of the page size
+ *
+ * @return Module instance pointer, NULL on error or invalid module
+ */
+struct bx_pcode_module *bx_pmod_open_trusted(const char *path, bx_uint32 offset);
+
+/**
+ * Opens a module stored inside a larger file and validates all the programs
+ * it contains.
+ *
+ * @param path Path of the file
+ * @param offset Offset of the module inside the file, multiple of the page size
+ *
+ * @return Module instance pointer, NULL on error or invalid module
+ */
+struct bx_pcode_module *bx_pmod_open_at(const char *path, bx_uint32 offset);
+
+/**
+ * Returns the number of programs contained in a module
+ *
+ * @param module Module instance pointer
+ *
+ * @return Number of programs, -1 on error
+ */
+bx_int32 bx_pmod_program_number(struct bx_pcode_module *module);
+
+/**
+ * Adds a program of a module to the pcode repository without copying it.
+ * The module stays mapped as long as any of its programs is in the
+ * repository.
+ *
+ * @param module Module instance pointer
+ * @param index Index of the program inside the module
+ *
+ * @return New bx_pcode structure, NULL on failure
+ */
+struct bx_pcode *bx_pmod_load(struct bx_pcode_module *module, bx_uint16 index);
+
+/**
+ * Closes a module. The memory mapping is released as soon as none of its
+ * programs is in the pcode repository.
+ *
+ * @param module Module instance pointer
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_pmod_close(struct bx_pcode_module *module);
+
+/**
+ * Releases the reference held by a program removed from the pcode
+ * repository. Invoked by the pcode manager.
+ *
+ * @param module Module instance pointer
+ */
+void bx_pmod_release(struct bx_pcode_module *module);
+
+/**
+ * Writes a module file.
+ * The module is written to a temporary file, flushed and renamed over the
+ * previous one, so processes mapping the old file keep a valid copy.
+ *
+ * @param path Path of the module file
+ * @param programs Array of programs
+ * @param sizes Array of program sizes
+ * @param program_number Number of programs
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_pmod_write(const char *path, void **programs, bx_size *sizes, bx_uint16 program_number);
+
+/**
+ * Appends a module at the end of an existing file. Program offsets are
+ * relative to the beginning of the module.
+ *
+ * @param path Path of the file
+ * @param programs Array of programs
+ * @param sizes Array of program sizes
+ * @param program_number Number of programs
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_pmod_append(const char *path, void **programs, bx_size *sizes, bx_uint16 program_number);
+
+#endif /* PCODE_MODULE_H_ */
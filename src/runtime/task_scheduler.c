@@ -29,12 +29,25 @@
  *
  */
 
+#include <string.h>
 #include "logging.h"
 #include "configuration.h"
+#include "atomic.h"
 #include "utils/uniform_allocator.h"
+#include "utils/mpsc_queue.h"
 #include "runtime/task_scheduler.h"
 #include "runtime/pcode_manager.h"
+#include "runtime/pcode_module.h"
 #include "runtime/critical_section.h"
+#include "runtime/tick.h"
+#include "runtime/worker.h"
+#include "compile_assert.h"
+
+/**
+ * Flag added to the requests of a task once a worker extracted it, until
+ * the execution completes
+ */
+#define BX_TASK_STARTED 0x8000
 
 enum bx_task_type {
 	BX_TASK_NATIVE,	///< Native C function
@@ -46,65 +59,75 @@ struct bx_task {
 	enum bx_task_type task_type;
 	union bx_task_data {
 		native_function native_function;
-		struct bx_pcode *pcode;
+		struct bx_pcode *pcode;		///< Accessed atomically, replaced by bx_sched_replace_pcode
 	} task;
-	bx_boolean scheduled;
+	bx_uint16 requests;				///< Outstanding executions, 0 if not scheduled, plus BX_TASK_STARTED while executing, accessed atomically
+	bx_uint8 overrun_policy;		///< Handling of the requests received while outstanding
+	bx_uint8 queue_limit;			///< Maximum number of queued executions
+	bx_uint8 priority;				///< Priority bucket, 0 is the highest priority
+	bx_uint32 deadline_msec;		///< Relative deadline, BX_SCHED_NO_DEADLINE if none
+	bx_uint64 release_usec;			///< Monotonic time at the time the task was scheduled
+	struct bx_task_stats stats;		///< Runtime statistics, protected by the scheduler lock
+	struct bx_mpsc_node submit_node;	///< Link inside the submission queue
 	struct bx_task *next;
 };
 
+/**
+ * FIFO queue of scheduled tasks sharing the same priority
+ */
+struct bx_task_queue {
+	struct bx_task *head;
+	struct bx_task *tail;
+};
+
+/**
+ * Per-worker scheduling data.
+ * Each worker executes pcode using the virtual machine context with the
+ * same index as the worker.
+ */
+struct bx_worker {
+	struct bx_task_queue scheduled_queue[EV_PRIORITY_LEVELS];
+	struct bx_task *running;
+	struct bx_pcode *pcode;			///< Program of the running execution, NULL if none
+	bx_uint16 pcode_releases;		///< Removals of the program owed once it is not executed anymore
+};
+
+/**
+ * Scheduling requests are pushed on a lock-free submission queue and moved
+ * to the worker queues by the thread that extracts the next task to execute.
+ * The worker queues are protected by the scheduler lock, which is never held
+ * while a task is executing; the global critical section is only used to
+ * protect the task and pcode storage.
+ */
 static struct bx_task_manager {
 	struct bx_ualloc *task_ualloc;
 	bx_uint8 task_storage[EV_HANDLER_STORAGE_SIZE];
-	bx_uint16 current_id;
-	struct bx_task *running;
-	struct bx_task *scheduled_list;
-	struct bx_task *stopped_list;
+	struct bx_task *task_table[EV_MAX_TASKS];	///< Tasks indexed by id, accessed atomically
+	bx_uint16 task_users[EV_MAX_TASKS];	///< Threads using the task of each id, accessed atomically
+	struct bx_mpsc_queue submit_queue;	///< Scheduled tasks not yet assigned to a worker
+	bx_boolean lock;				///< Scheduler lock, protects the fields below
+	struct bx_worker worker[EV_MAX_WORKERS];
+	bx_uint8 worker_number;			///< Number of workers sharing the scheduled tasks
+	bx_uint8 next_worker;			///< Worker receiving the next scheduled task
+	bx_boolean workers_active;		///< Set while the worker threads are running, accessed atomically
+	bx_uint32 ready_limit;			///< Admission limit on the ready tasks, accessed atomically
+	struct bx_sched_metrics metrics;	///< Load metrics, accessed atomically
 } task_manager;
 
 /**
- * Adds a new task to the list
- *
- * @param task_list Target list
- * @param task Task to add
+ * Acquires the scheduler lock
  */
-static void task_list_add(struct bx_task **task_list, struct bx_task *task) {
-	struct bx_task *current_element;
-
-	task->next = NULL;
-
-	if (*task_list == NULL) {
-		*task_list = task;
-		return;
-	}
-
-	current_element = *task_list;
-	while (current_element->next != NULL) {
-		current_element = current_element->next;
+static void sched_lock() {
+	while (BX_ATOMIC_EXCHANGE(&task_manager.lock, BX_BOOLEAN_TRUE) == BX_BOOLEAN_TRUE) {
+		bx_worker_yield();
 	}
-
-	current_element->next = task;
 }
 
 /**
- * Searches a task inside the task list
- *
- * @param task_list Target list
- * @param task_id Id of the task to find
- *
- * @return Task instance, NULL if not found
+ * Releases the scheduler lock
  */
-static struct bx_task *task_list_search(struct bx_task *task_list, bx_task_id task_id) {
-	struct bx_task *current_task;
-
-	current_task = task_list;
-	while (current_task != NULL) {
-		if (current_task->id == task_id) {
-			break;
-		}
-		current_task = current_task->next;
-	}
-
-	return current_task;
+static void sched_unlock() {
+	BX_ATOMIC_STORE(&task_manager.lock, BX_BOOLEAN_FALSE);
 }
 
 /**
@@ -143,24 +166,276 @@ static struct bx_task *task_list_remove(struct bx_task **task_list, bx_task_id t
 }
 
 /**
- * Removes the first element of the list and returns it.
+ * Appends a task at the tail of the queue in constant time
  *
- * @param task_list Target list
+ * @param queue Target queue
+ * @param task Task to add
+ */
+static void task_queue_push(struct bx_task_queue *queue, struct bx_task *task) {
+
+	task->next = NULL;
+	if (queue->tail == NULL) {
+		queue->head = task;
+	} else {
+		queue->tail->next = task;
+	}
+	queue->tail = task;
+}
+
+/**
+ * Removes a task from the queue
+ *
+ * @param queue Target queue
+ * @param task_id Id of the task to remove
+ *
+ * @return Pointer to the removed task, NULL if the task is not found
+ */
+static struct bx_task *task_queue_remove(struct bx_task_queue *queue, bx_task_id task_id) {
+	struct bx_task *removed_task;
+	struct bx_task *current_task;
+
+	removed_task = task_list_remove(&queue->head, task_id);
+	if (removed_task == NULL || removed_task != queue->tail) {
+		return removed_task;
+	}
+
+	current_task = queue->head;
+	while (current_task != NULL && current_task->next != NULL) {
+		current_task = current_task->next;
+	}
+	queue->tail = current_task;
+
+	return removed_task;
+}
+
+/**
+ * Removes the highest priority scheduled task and returns it.
+ * Tasks in the local queues of the worker are preferred; when no local task
+ * of a given priority is available, the worker steals the oldest task of the
+ * same priority from the other workers.
+ *
+ * @param worker_index Index of the worker requesting a task
  *
- * @return Head of the list, NULL if the list is empty
+ * @return Next task to execute, NULL if no task is available
  */
-static struct bx_task *task_list_extract_head(struct bx_task **task_list) {
+static struct bx_task *scheduled_extract_next(bx_uint8 worker_index) {
+	struct bx_task_queue *queue;
 	struct bx_task *head;
+	bx_size priority;
+	bx_size i;
+
+	for (priority = 0; priority < EV_PRIORITY_LEVELS; priority++) {
+		for (i = 0; i < task_manager.worker_number; i++) {
+			queue = &task_manager.worker[(worker_index + i) % task_manager.worker_number].scheduled_queue[priority];
+			head = queue->head;
+			if (head == NULL) {
+				continue;
+			}
+			queue->head = head->next;
+			if (queue->head == NULL) {
+				queue->tail = NULL;
+			}
+			return head;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Moves the submitted tasks to the worker queues in round robin order.
+ * Must be invoked holding the scheduler lock.
+ */
+static void submitted_dispatch() {
+	struct bx_mpsc_node *node;
+	struct bx_task *task;
+
+	while ((node = bx_mpsc_pop(&task_manager.submit_queue)) != NULL) {
+		task = BX_MPSC_ELEMENT(node, struct bx_task, submit_node);
+		task_queue_push(&task_manager.worker[task_manager.next_worker].scheduled_queue[task->priority], task);
+		task_manager.next_worker = (task_manager.next_worker + 1) % task_manager.worker_number;
+	}
+}
+
+/**
+ * Removes a task from the scheduled ones
+ *
+ * @param task_id Id of the task to remove
+ *
+ * @return Pointer to the removed task, NULL if the task is not found
+ */
+static struct bx_task *scheduled_remove(bx_task_id task_id) {
+	struct bx_task *task;
+	bx_size priority;
+	bx_size i;
+
+	for (i = 0; i < EV_MAX_WORKERS; i++) {
+		for (priority = 0; priority < EV_PRIORITY_LEVELS; priority++) {
+			task = task_queue_remove(&task_manager.worker[i].scheduled_queue[priority], task_id);
+			if (task != NULL) {
+				return task;
+			}
+		}
+	}
 
-	head = *task_list;
-	if (head != NULL) {
-		*task_list = (*task_list)->next;
+	return NULL;
+}
+
+/**
+ * Returns the task with the given id without locking. The task is not
+ * freed until task_release is invoked.
+ *
+ * @param task_id Task id
+ *
+ * @return Task instance, NULL if not found
+ */
+static struct bx_task *task_acquire(bx_task_id task_id) {
+	struct bx_task *task;
+
+	if (task_id < 0 || task_id >= EV_MAX_TASKS) {
+		return NULL;
 	}
 
-	return head;
+	BX_ATOMIC_ADD(&task_manager.task_users[task_id], 1);
+	task = BX_ATOMIC_LOAD(&task_manager.task_table[task_id]);
+	if (task == NULL) {
+		BX_ATOMIC_SUB(&task_manager.task_users[task_id], 1);
+	}
+
+	return task;
+}
+
+/**
+ * Releases a task returned by task_acquire
+ *
+ * @param task_id Task id
+ */
+static void task_release(bx_task_id task_id) {
+	BX_ATOMIC_SUB(&task_manager.task_users[task_id], 1);
+}
+
+/**
+ * Accounts for a task becoming ready for execution
+ *
+ * @param ready_tasks Number of ready tasks including the new one
+ */
+static void ready_update_max(bx_uint32 ready_tasks) {
+	bx_uint32 max_ready_tasks;
+
+	max_ready_tasks = BX_ATOMIC_LOAD(&task_manager.metrics.max_ready_tasks);
+	while (ready_tasks > max_ready_tasks &&
+			!BX_ATOMIC_COMPARE_EXCHANGE(&task_manager.metrics.max_ready_tasks, &max_ready_tasks, ready_tasks)) {
+	}
+}
+
+/**
+ * Admits a task that is not scheduled into the ready tasks.
+ * Tasks with the highest priority are always admitted.
+ *
+ * @param task Task to admit
+ *
+ * @return 1 if the task is admitted, 0 if the admission limit is reached
+ */
+static bx_boolean ready_admit(struct bx_task *task) {
+	bx_uint32 ready_tasks;
+
+	ready_tasks = BX_ATOMIC_ADD(&task_manager.metrics.ready_tasks, 1);
+	if (ready_tasks > BX_ATOMIC_LOAD(&task_manager.ready_limit) &&
+			task->priority != BX_SCHED_HIGHEST_PRIORITY) {
+		BX_ATOMIC_SUB(&task_manager.metrics.ready_tasks, 1);
+		BX_ATOMIC_ADD(&task_manager.metrics.admission_rejections, 1);
+		return BX_BOOLEAN_FALSE;
+	}
+	ready_update_max(ready_tasks);
+
+	return BX_BOOLEAN_TRUE;
+}
+
+/**
+ * Releases a task to the workers
+ *
+ * @param task Task to release
+ */
+static void release_task(struct bx_task *task) {
+	task->release_usec = bx_tick_get_time_usec();
+	bx_mpsc_push(&task_manager.submit_queue, &task->submit_node);
+}
+
+/**
+ * Updates the deadline miss counter of a task that completed its execution
+ *
+ * @param task Task that completed its execution
+ */
+static void check_deadline(struct bx_task *task) {
+	bx_uint64 response_usec;
+
+	if (task->deadline_msec == BX_SCHED_NO_DEADLINE) {
+		return;
+	}
+
+	response_usec = bx_tick_get_time_usec() - task->release_usec;
+	if (response_usec > (bx_uint64) task->deadline_msec * 1000) {
+		BX_ATOMIC_ADD(&task->stats.deadline_misses, 1);
+		BX_LOG(LOG_WARNING, "task_scheduler",
+				"Task %i missed its deadline of %u ms", task->id, task->deadline_msec);
+	}
+}
+
+/**
+ * Updates the runtime statistics of a task that completed its execution.
+ * Must be invoked holding the scheduler lock.
+ *
+ * @param task Task that completed its execution
+ * @param start_usec Monotonic time at the start of the execution
+ * @param end_usec Monotonic time at the end of the execution
+ */
+static void update_stats(struct bx_task *task, bx_uint64 start_usec, bx_uint64 end_usec) {
+	struct bx_task_stats *stats;
+	bx_uint64 execution_usec;
+	bx_uint64 latency_usec;
+	bx_size bucket;
+
+	stats = &task->stats;
+	execution_usec = end_usec - start_usec;
+	if (stats->run_count == 0 || execution_usec < stats->min_execution_usec) {
+		stats->min_execution_usec = execution_usec;
+	}
+	if (execution_usec > stats->max_execution_usec) {
+		stats->max_execution_usec = execution_usec;
+	}
+	stats->total_execution_usec += execution_usec;
+	stats->run_count++;
+
+	latency_usec = start_usec - task->release_usec;
+	bucket = 0;
+	while (bucket < EV_LATENCY_BUCKETS - 1 &&
+			latency_usec >= ((bx_uint64) EV_LATENCY_BUCKET_USEC << bucket)) {
+		bucket++;
+	}
+	stats->latency_histogram[bucket]++;
+}
+
+/**
+ * Copies the runtime statistics of a task.
+ * Must be invoked holding the scheduler lock.
+ *
+ * @param task Source task
+ * @param stats Destination of the statistics
+ */
+static void copy_stats(struct bx_task *task, struct bx_task_stats *stats) {
+	*stats = task->stats;
+	stats->task_id = task->id;
+	stats->overruns = BX_ATOMIC_LOAD(&task->stats.overruns);
+	stats->deadline_misses = BX_ATOMIC_LOAD(&task->stats.deadline_misses);
+	stats->skipped = BX_ATOMIC_LOAD(&task->stats.skipped);
+	stats->coalesced = BX_ATOMIC_LOAD(&task->stats.coalesced);
 }
 
 bx_int8 bx_sched_init() {
+	bx_size priority;
+	bx_size i;
+
+	BX_COMPILE_ASSERT(EV_MAX_WORKERS <= VM_CONTEXT_NUMBER);
 
 	task_manager.task_ualloc = bx_ualloc_init(task_manager.task_storage,
 			EV_HANDLER_STORAGE_SIZE, sizeof (struct bx_task));
@@ -168,77 +443,311 @@ bx_int8 bx_sched_init() {
 		return -1;
 	}
 
-	task_manager.current_id = 0;
-	task_manager.scheduled_list = NULL;
-	task_manager.stopped_list = NULL;
-	task_manager.running = NULL;
+	for (i = 0; i < EV_MAX_TASKS; i++) {
+		task_manager.task_table[i] = NULL;
+		task_manager.task_users[i] = 0;
+	}
+	bx_mpsc_init(&task_manager.submit_queue);
+	task_manager.lock = BX_BOOLEAN_FALSE;
+	for (i = 0; i < EV_MAX_WORKERS; i++) {
+		for (priority = 0; priority < EV_PRIORITY_LEVELS; priority++) {
+			task_manager.worker[i].scheduled_queue[priority].head = NULL;
+			task_manager.worker[i].scheduled_queue[priority].tail = NULL;
+		}
+		task_manager.worker[i].running = NULL;
+		task_manager.worker[i].pcode = NULL;
+		task_manager.worker[i].pcode_releases = 0;
+	}
+	task_manager.worker_number = 1;
+	task_manager.next_worker = 0;
+	task_manager.workers_active = BX_BOOLEAN_FALSE;
+	task_manager.ready_limit = EV_READY_LIMIT;
+	memset(&task_manager.metrics, 0, sizeof task_manager.metrics);
 
 	return 0;
 }
 
 /**
- * Frees the memory occupied by a task
+ * Frees the memory occupied by a task.
+ * The task must not be executing; the pcode programs of the other tasks are
+ * not affected by the removal.
  *
  * @param task Task to remove
  */
 void free_task(struct bx_task *task) {
 
 	if (task->task_type == BX_TASK_PCODE) {
+		bx_critical_enter();
 		bx_pcode_remove(task->task.pcode);
+		bx_critical_exit();
 	}
 
+	bx_critical_enter();
 	bx_ualloc_free(task_manager.task_ualloc, task);
+	bx_critical_exit();
 }
 
-void bx_sched_scheduler_loop(bx_boolean stop_if_empty) {
+/**
+ * Ends the use of a program by a worker. The removals of a replaced program
+ * owed by the worker are handed to another worker still executing it, so
+ * that the last one performs them. Invoked with the scheduler lock held.
+ *
+ * @param worker Worker completing an execution
+ *
+ * @return Number of removals of the program left to the caller
+ */
+static bx_uint16 worker_release_pcode(struct bx_worker *worker) {
+	bx_uint16 releases;
+	bx_size i;
 
-	while (1) {
+	releases = worker->pcode_releases;
+	worker->pcode_releases = 0;
+	for (i = 0; i < EV_MAX_WORKERS && releases > 0; i++) {
+		if (&task_manager.worker[i] != worker && task_manager.worker[i].pcode == worker->pcode) {
+			task_manager.worker[i].pcode_releases += releases;
+			releases = 0;
+		}
+	}
+	worker->pcode = NULL;
+
+	return releases;
+}
+
+/**
+ * Extracts the next task available to a worker and executes it.
+ *
+ * @param worker_index Index of the worker
+ *
+ * @return 1 if a task was executed, 0 if no task was available
+ */
+static bx_boolean run_next_task(bx_uint8 worker_index) {
+	struct bx_worker *worker;
+	struct bx_task *task;
+	struct bx_pcode *pcode;
+	bx_uint64 start_usec;
+	bx_uint16 releases;
+
+	worker = &task_manager.worker[worker_index];
+
+	sched_lock();
+	submitted_dispatch();
+	task = scheduled_extract_next(worker_index);
+	if (task != NULL) {
+		BX_ATOMIC_SUB(&task_manager.metrics.ready_tasks, 1);
+		BX_ATOMIC_ADD(&task->requests, BX_TASK_STARTED);
+		if (task->task_type == BX_TASK_PCODE) {
+			worker->pcode = BX_ATOMIC_LOAD(&task->task.pcode);
+		}
+	}
+	worker->running = task;
+	pcode = worker->pcode;
+	sched_unlock();
+
+	if (task == NULL) {
+		return BX_BOOLEAN_FALSE;
+	}
+
+	start_usec = bx_tick_get_time_usec();
+	switch (task->task_type) {
+	case BX_TASK_NATIVE:
+		task->task.native_function();
+		break;
+	case BX_TASK_PCODE:
+		// The program stays valid until the worker releases it
+		bx_pcode_execute_in_context(pcode, worker_index);
+	}
+	check_deadline(task);
+
+	sched_lock();
+	update_stats(task, start_usec, bx_tick_get_time_usec());
+	releases = worker_release_pcode(worker);
+	worker->running = NULL;
+	sched_unlock();
+
+	// The program was replaced during the execution and nobody else runs it
+	if (releases > 0) {
 		bx_critical_enter();
-		task_manager.running = task_list_extract_head(&task_manager.scheduled_list);
+		while (releases-- > 0) {
+			bx_pcode_remove(pcode);
+		}
 		bx_critical_exit();
+	}
+
+	// Release the queued executions, they were already admitted
+	if (BX_ATOMIC_SUB(&task->requests, 1 + BX_TASK_STARTED) != 0) {
+		ready_update_max(BX_ATOMIC_ADD(&task_manager.metrics.ready_tasks, 1));
+		release_task(task);
+	}
+
+	return BX_BOOLEAN_TRUE;
+}
+
+void bx_sched_scheduler_loop(bx_boolean stop_if_empty) {
 
-		if (task_manager.running == NULL && stop_if_empty == BX_BOOLEAN_TRUE) {
+	// The loop executes tasks as worker 0, using its queue and context
+	if (BX_ATOMIC_LOAD(&task_manager.workers_active) == BX_BOOLEAN_TRUE) {
+		BX_LOG(LOG_ERROR, "task_scheduler", "Cannot run the scheduler loop while the workers are active");
+		return;
+	}
+
+	while (1) {
+		if (run_next_task(0) == BX_BOOLEAN_TRUE) {
+			continue;
+		}
+		if (stop_if_empty == BX_BOOLEAN_TRUE) {
 			break;
-		} else if (task_manager.running == NULL && stop_if_empty == BX_BOOLEAN_FALSE) {
-			continue; //TODO: Is this busy waiting the best way to do it? I don't think so...
 		}
+		//TODO: Is this busy waiting the best way to do it? I don't think so...
+	}
+}
 
-		switch (task_manager.running->task_type) {
-		case BX_TASK_NATIVE:
-			task_manager.running->task.native_function();
-			break;
-		case BX_TASK_PCODE:
-			bx_pcode_execute(task_manager.running->task.pcode);
+bx_int8 bx_sched_simulate(bx_uint64 duration_usec) {
+	bx_uint64 until_usec;
+
+	if (BX_ATOMIC_LOAD(&task_manager.workers_active) == BX_BOOLEAN_TRUE) {
+		BX_LOG(LOG_ERROR, "task_scheduler", "Cannot simulate while the workers are active");
+		return -1;
+	}
+
+	until_usec = bx_tick_get_time_usec() + duration_usec;
+	bx_sched_scheduler_loop(BX_BOOLEAN_TRUE);
+	while (bx_tick_step(until_usec) == BX_BOOLEAN_TRUE) {
+		bx_sched_scheduler_loop(BX_BOOLEAN_TRUE);
+	}
+
+	return 0;
+}
+
+/**
+ * Routine executed by each worker thread
+ *
+ * @param worker_index Index of the worker
+ */
+static void worker_routine(bx_uint8 worker_index) {
+
+	while (BX_ATOMIC_LOAD(&task_manager.workers_active) == BX_BOOLEAN_TRUE) {
+		if (run_next_task(worker_index) == BX_BOOLEAN_FALSE) {
+			bx_worker_yield();
 		}
+	}
+}
 
-		bx_critical_enter();
-		task_list_add(&task_manager.stopped_list, task_manager.running);
-		task_manager.running = NULL;
-		bx_critical_exit();
+bx_int8 bx_sched_start_workers(bx_uint8 worker_number) {
+	bx_boolean expected;
+	bx_int8 error;
+
+	if (worker_number == 0) {
+		worker_number = bx_worker_online_cpus();
+	}
+	if (worker_number > EV_MAX_WORKERS) {
+		BX_LOG(LOG_WARNING, "task_scheduler",
+				"Limiting workers to %u", EV_MAX_WORKERS);
+		worker_number = EV_MAX_WORKERS;
+	}
+
+	expected = BX_BOOLEAN_FALSE;
+	if (!BX_ATOMIC_COMPARE_EXCHANGE(&task_manager.workers_active, &expected, BX_BOOLEAN_TRUE)) {
+		return -1;
+	}
+	sched_lock();
+	if (worker_number > task_manager.worker_number) {
+		task_manager.worker_number = worker_number;
+	}
+	sched_unlock();
+
+	error = bx_worker_start(worker_number, &worker_routine);
+	if (error != 0) {
+		bx_sched_stop_workers();
+		return -1;
 	}
+
+	return 0;
+}
+
+bx_int8 bx_sched_stop_workers() {
+
+	BX_ATOMIC_STORE(&task_manager.workers_active, BX_BOOLEAN_FALSE);
+
+	return bx_worker_stop();
+}
+
+/**
+ * Allocates a new task and initializes its scheduling class
+ *
+ * @param priority Task priority
+ * @param deadline_msec Relative deadline in milliseconds
+ *
+ * @return New task, NULL on error
+ */
+static struct bx_task *create_task(bx_uint8 priority, bx_uint32 deadline_msec) {
+	struct bx_task *task;
+
+	if (priority >= EV_PRIORITY_LEVELS) {
+		BX_LOG(LOG_ERROR, "task_scheduler",
+				"Cannot create task: invalid priority %u", priority);
+		return NULL;
+	}
+
+	bx_critical_enter();
+	task = bx_ualloc_alloc(task_manager.task_ualloc);
+	bx_critical_exit();
+	if (task == NULL) {
+		return NULL;
+	}
+	task->requests = 0;
+	task->overrun_policy = BX_SCHED_OVERRUN_SKIP;
+	task->queue_limit = 0;
+	task->priority = priority;
+	task->deadline_msec = deadline_msec;
+	task->release_usec = 0;
+	memset(&task->stats, 0, sizeof task->stats);
+
+	return task;
+}
+
+/**
+ * Assigns an id to a fully initialized task and makes it visible to the
+ * other scheduler functions. The task is freed if no id is available.
+ *
+ * @param task Task to publish
+ *
+ * @return Task id, -1 on error
+ */
+static bx_task_id publish_task(struct bx_task *task) {
+	struct bx_task *expected;
+	bx_size i;
+
+	for (i = 0; i < EV_MAX_TASKS; i++) {
+		task->id = i;
+		expected = NULL;
+		if (BX_ATOMIC_COMPARE_EXCHANGE(&task_manager.task_table[i], &expected, task)) {
+			return i;
+		}
+	}
+
+	BX_LOG(LOG_ERROR, "task_scheduler", "Cannot add task: task table full");
+	free_task(task);
+	return -1;
 }
 
-bx_task_id bx_sched_add_native_task(native_function function) {
+bx_task_id bx_sched_add_native_task(native_function function, bx_uint8 priority, bx_uint32 deadline_msec) {
 	struct bx_task *native_task;
 
 	if (function == NULL) {
 		return -1;
 	}
 
-	native_task = bx_ualloc_alloc(task_manager.task_ualloc);
-	native_task->id = task_manager.current_id++;
+	native_task = create_task(priority, deadline_msec);
+	if (native_task == NULL) {
+		return -1;
+	}
 	native_task->task_type = BX_TASK_NATIVE;
 	native_task->task.native_function = function;
-	native_task->scheduled = BX_BOOLEAN_FALSE;
 
-	bx_critical_enter();
-	task_list_add(&task_manager.stopped_list, native_task);
-	bx_critical_exit();
-
-	return native_task->id;
+	return publish_task(native_task);
 }
 
-bx_task_id bx_sched_add_pcode_task(void *buffer, bx_size buffer_size) {
+bx_task_id bx_sched_add_pcode_task(void *buffer, bx_size buffer_size, bx_uint8 priority, bx_uint32 deadline_msec) {
 	struct bx_pcode *pcode;
 	struct bx_task *pcode_task;
 
@@ -246,84 +755,450 @@ bx_task_id bx_sched_add_pcode_task(void *buffer, bx_size buffer_size) {
 		return -1;
 	}
 
+	pcode_task = create_task(priority, deadline_msec);
+	if (pcode_task == NULL) {
+		return -1;
+	}
+
+	bx_critical_enter();
 	pcode = bx_pcode_add(buffer, buffer_size);
 	if (pcode == NULL) {
+		bx_ualloc_free(task_manager.task_ualloc, pcode_task);
+		bx_critical_exit();
+		return -1;
+	}
+	bx_critical_exit();
+	pcode_task->task_type = BX_TASK_PCODE;
+	pcode_task->task.pcode = pcode;
+
+	return publish_task(pcode_task);
+}
+
+bx_task_id bx_sched_add_module_task(struct bx_pcode_module *module, bx_uint16 index,
+		bx_uint8 priority, bx_uint32 deadline_msec) {
+	struct bx_pcode *pcode;
+	struct bx_task *pcode_task;
+
+	pcode_task = create_task(priority, deadline_msec);
+	if (pcode_task == NULL) {
 		return -1;
 	}
 
-	pcode_task = bx_ualloc_alloc(task_manager.task_ualloc);
-	pcode_task->id = task_manager.current_id++;
+	bx_critical_enter();
+	pcode = bx_pmod_load(module, index);
+	if (pcode == NULL) {
+		bx_ualloc_free(task_manager.task_ualloc, pcode_task);
+		bx_critical_exit();
+		return -1;
+	}
+	bx_critical_exit();
 	pcode_task->task_type = BX_TASK_PCODE;
 	pcode_task->task.pcode = pcode;
-	pcode_task->scheduled = BX_BOOLEAN_FALSE;
+
+	return publish_task(pcode_task);
+}
+
+bx_int8 bx_sched_replace_pcode(bx_task_id task_id, void *buffer, bx_size buffer_size) {
+	struct bx_task *task;
+	struct bx_pcode *new_pcode;
+	struct bx_pcode *old_pcode;
+	bx_uint16 releases;
+	bx_size i;
+
+	task = task_acquire(task_id);
+	if (task == NULL || task->task_type != BX_TASK_PCODE) {
+		if (task != NULL) {
+			task_release(task_id);
+		}
+		BX_LOG(LOG_ERROR, "task_scheduler",
+				"Cannot replace pcode: Task %i not found", task_id);
+		return -1;
+	}
+	if (buffer == NULL) {
+		task_release(task_id);
+		return -1;
+	}
 
 	bx_critical_enter();
-	task_list_add(&task_manager.stopped_list, pcode_task);
+	new_pcode = bx_pcode_add(buffer, buffer_size);
 	bx_critical_exit();
+	if (new_pcode == NULL) {
+		task_release(task_id);
+		return -1;
+	}
+
+	/*
+	 * Executions starting after the exchange use the new program. Workers
+	 * load the program under the scheduler lock, so the executions of the
+	 * old one are known: the removal is left to them instead of waiting,
+	 * since the task may keep being executed or may be the caller itself.
+	 */
+	releases = 1;
+	sched_lock();
+	old_pcode = BX_ATOMIC_EXCHANGE(&task->task.pcode, new_pcode);
+	for (i = 0; i < EV_MAX_WORKERS && releases > 0; i++) {
+		if (task_manager.worker[i].pcode == old_pcode) {
+			task_manager.worker[i].pcode_releases++;
+			releases = 0;
+		}
+	}
+	sched_unlock();
+	task_release(task_id);
+
+	if (releases > 0) {
+		bx_critical_enter();
+		bx_pcode_remove(old_pcode);
+		bx_critical_exit();
+	}
 
-	return pcode_task->id;
+	return 0;
+}
+
+/**
+ * Schedules a task that has no outstanding execution
+ *
+ * @param task Task to schedule
+ *
+ * @return 0 on success, -1 if rejected, 1 if the task was scheduled concurrently
+ */
+static bx_int8 schedule_stopped(struct bx_task *task) {
+	bx_uint16 requests;
+
+	if (ready_admit(task) == BX_BOOLEAN_FALSE) {
+		BX_ATOMIC_ADD(&task->stats.skipped, 1);
+		BX_LOG(LOG_DEBUG, "task_scheduler",
+				"Task %i rejected: admission limit reached", task->id);
+		return -1;
+	}
+
+	requests = 0;
+	if (!BX_ATOMIC_COMPARE_EXCHANGE(&task->requests, &requests, 1)) {
+		BX_ATOMIC_SUB(&task_manager.metrics.ready_tasks, 1);
+		return 1;
+	}
+	release_task(task);
+
+	return 0;
+}
+
+/**
+ * Applies the overrun policy to a task that has outstanding executions
+ *
+ * @param task Task to schedule
+ * @param requests Outstanding executions of the task
+ *
+ * @return 0 if queued or coalesced, -1 if dropped, 1 if the task completed concurrently
+ */
+static bx_int8 schedule_overrun(struct bx_task *task, bx_uint16 requests) {
+	bx_uint16 limit;
+	bx_uint8 policy;
+
+	policy = BX_ATOMIC_LOAD(&task->overrun_policy);
+	switch (policy) {
+	case BX_SCHED_OVERRUN_QUEUE:
+		limit = BX_ATOMIC_LOAD(&task->queue_limit);
+		break;
+	default:
+		limit = 0;
+	}
+
+	while (requests != 0) {
+		// An execution that has not started serves the request, a running one gets a single follow-up
+		if (policy == BX_SCHED_OVERRUN_COALESCE) {
+			limit = (requests & BX_TASK_STARTED) != 0 ? 1 : 0;
+		}
+		if ((requests & ~BX_TASK_STARTED) > limit) {
+			BX_ATOMIC_ADD(&task->stats.overruns, 1);
+			if (policy == BX_SCHED_OVERRUN_COALESCE) {
+				BX_ATOMIC_ADD(&task->stats.coalesced, 1);
+				return 0;
+			}
+			BX_ATOMIC_ADD(&task->stats.skipped, 1);
+			BX_LOG(LOG_DEBUG, "task_scheduler",
+					"Task %i skipped: already scheduled", task->id);
+			return -1;
+		}
+		if (BX_ATOMIC_COMPARE_EXCHANGE(&task->requests, &requests, requests + 1)) {
+			BX_ATOMIC_ADD(&task->stats.overruns, 1);
+			return 0;
+		}
+	}
+
+	return 1;
 }
 
 bx_int8 bx_sched_schedule_task(bx_task_id task_id) {
 	struct bx_task *task;
+	bx_uint16 requests;
+	bx_int8 result;
 
-	bx_critical_enter();
+	task = task_acquire(task_id);
+	if (task == NULL) {
+		BX_LOG(LOG_ERROR, "task_scheduler",
+				"Cannot schedule: Task %i not found", task_id);
+		return -1;
+	}
+
+	do {
+		requests = BX_ATOMIC_LOAD(&task->requests);
+		if (requests == 0) {
+			result = schedule_stopped(task);
+		} else {
+			result = schedule_overrun(task, requests);
+		}
+	} while (result == 1);
+	task_release(task_id);
+
+	return result;
+}
 
-	task = task_list_search(task_manager.stopped_list, task_id);
+bx_int8 bx_sched_is_scheduled(bx_task_id task_id) {
+	struct bx_task *task;
+	bx_int8 scheduled;
+
+	task = task_acquire(task_id);
 	if (task == NULL) {
 		BX_LOG(LOG_ERROR, "task_scheduler",
-				"Cannot schedule: Task %zu not found or already scheduled", task_id);
+				"Cannot find: Task %i not found", task_id);
 		return -1;
 	}
+	scheduled = BX_ATOMIC_LOAD(&task->requests) != 0 ? 1 : 0;
+	task_release(task_id);
 
-	task_list_remove(&task_manager.stopped_list, task->id);
-	task_list_add(&task_manager.scheduled_list, task);
+	return scheduled;
+}
 
-	bx_critical_exit();
+bx_int32 bx_sched_get_deadline_misses(bx_task_id task_id) {
+	struct bx_task *task;
+	bx_int32 deadline_misses;
+
+	task = task_acquire(task_id);
+	if (task == NULL) {
+		return -1;
+	}
+	deadline_misses = BX_ATOMIC_LOAD(&task->stats.deadline_misses);
+	task_release(task_id);
+
+	return deadline_misses;
+}
+
+bx_int8 bx_sched_set_overrun_policy(bx_task_id task_id,
+		enum bx_sched_overrun_policy policy, bx_uint8 queue_limit) {
+	struct bx_task *task;
+
+	if (policy > BX_SCHED_OVERRUN_DEGRADE) {
+		return -1;
+	}
+	task = task_acquire(task_id);
+	if (task == NULL) {
+		return -1;
+	}
+
+	BX_ATOMIC_STORE(&task->queue_limit, queue_limit);
+	BX_ATOMIC_STORE(&task->overrun_policy, policy);
+	task_release(task_id);
 
 	return 0;
 }
 
-bx_int8 bx_sched_is_scheduled(bx_task_id task_id) {
-	struct bx_task *task_scheduled;
-	struct bx_task *task_stopped;
+bx_int8 bx_sched_get_overrun_policy(bx_task_id task_id) {
+	struct bx_task *task;
+	bx_int8 policy;
 
-	bx_critical_enter();
-	task_scheduled = task_list_search(task_manager.scheduled_list, task_id);
-	task_stopped = task_list_search(task_manager.stopped_list, task_id);
-	bx_critical_exit();
+	task = task_acquire(task_id);
+	if (task == NULL) {
+		return -1;
+	}
+	policy = BX_ATOMIC_LOAD(&task->overrun_policy);
+	task_release(task_id);
 
-	if (task_scheduled != NULL) {
-		return 1;
-	} else if (task_stopped != NULL) {
-		return 0;
-	} else {
-		BX_LOG(LOG_ERROR, "task_scheduler",
-				"Cannot find: Task %zu not found", task_id);
+	return policy;
+}
+
+void bx_sched_set_admission_limit(bx_uint32 ready_limit) {
+	BX_ATOMIC_STORE(&task_manager.ready_limit, ready_limit);
+}
+
+bx_int8 bx_sched_get_metrics(struct bx_sched_metrics *metrics) {
+
+	if (metrics == NULL) {
 		return -1;
 	}
+
+	metrics->ready_tasks = BX_ATOMIC_LOAD(&task_manager.metrics.ready_tasks);
+	metrics->max_ready_tasks = BX_ATOMIC_LOAD(&task_manager.metrics.max_ready_tasks);
+	metrics->admission_rejections = BX_ATOMIC_LOAD(&task_manager.metrics.admission_rejections);
+
+	return 0;
+}
+
+bx_int8 bx_sched_get_stats(bx_task_id task_id, struct bx_task_stats *stats) {
+	struct bx_task *task;
+
+	if (stats == NULL) {
+		return -1;
+	}
+
+	task = task_acquire(task_id);
+	if (task == NULL) {
+		return -1;
+	}
+
+	sched_lock();
+	copy_stats(task, stats);
+	sched_unlock();
+	task_release(task_id);
+
+	return 0;
+}
+
+bx_ssize bx_sched_get_all_stats(struct bx_task_stats *stats, bx_size capacity) {
+	struct bx_task *task;
+	bx_size copied;
+	bx_size i;
+
+	if (stats == NULL) {
+		return -1;
+	}
+
+	copied = 0;
+	sched_lock();
+	for (i = 0; i < EV_MAX_TASKS && copied < capacity; i++) {
+		task = task_acquire(i);
+		if (task != NULL) {
+			copy_stats(task, &stats[copied++]);
+			task_release(i);
+		}
+	}
+	sched_unlock();
+
+	return copied;
+}
+
+void bx_sched_dump_stats() {
+	struct bx_task_stats stats[EV_MAX_TASKS];
+	bx_ssize task_number;
+	bx_ssize i;
+
+	task_number = bx_sched_get_all_stats(stats, EV_MAX_TASKS);
+	for (i = 0; i < task_number; i++) {
+		BX_LOG(LOG_INFO, "task_scheduler",
+				"Task %i: runs %u, execution usec total %llu min %llu max %llu, overruns %u, deadline misses %u",
+				stats[i].task_id, stats[i].run_count,
+				(unsigned long long) stats[i].total_execution_usec,
+				(unsigned long long) stats[i].min_execution_usec,
+				(unsigned long long) stats[i].max_execution_usec,
+				stats[i].overruns, stats[i].deadline_misses);
+	}
+}
+
+bx_ssize bx_sched_get_task_states(struct bx_task_state *states, bx_size capacity) {
+	struct bx_task *task;
+	bx_size copied;
+	bx_size i;
+
+	if (states == NULL) {
+		return -1;
+	}
+
+	copied = 0;
+	sched_lock();
+	for (i = 0; i < EV_MAX_TASKS && copied < capacity; i++) {
+		task = task_acquire(i);
+		if (task == NULL) {
+			continue;
+		}
+		states[copied].task_id = task->id;
+		states[copied].native = task->task_type == BX_TASK_NATIVE;
+		states[copied].priority = task->priority;
+		states[copied].overrun_policy = BX_ATOMIC_LOAD(&task->overrun_policy);
+		states[copied].queue_limit = BX_ATOMIC_LOAD(&task->queue_limit);
+		states[copied].requests = BX_ATOMIC_LOAD(&task->requests) & ~BX_TASK_STARTED;
+		states[copied].deadline_msec = task->deadline_msec;
+		states[copied].pcode = NULL;
+		if (task->task_type == BX_TASK_PCODE) {
+			states[copied].pcode = BX_ATOMIC_LOAD(&task->task.pcode);
+		}
+		task_release(i);
+		copied++;
+	}
+	sched_unlock();
+
+	return copied;
+}
+
+bx_int8 bx_sched_restore_pcode_task(bx_task_id task_id, struct bx_pcode *pcode,
+		bx_uint8 priority, bx_uint32 deadline_msec) {
+	struct bx_task *pcode_task;
+	struct bx_task *expected;
+
+	if (pcode == NULL) {
+		return -1;
+	}
+
+	pcode_task = NULL;
+	if (task_id >= 0 && task_id < EV_MAX_TASKS) {
+		pcode_task = create_task(priority, deadline_msec);
+	}
+	if (pcode_task == NULL) {
+		bx_critical_enter();
+		bx_pcode_remove(pcode);
+		bx_critical_exit();
+		return -1;
+	}
+	pcode_task->task_type = BX_TASK_PCODE;
+	pcode_task->task.pcode = pcode;
+	pcode_task->id = task_id;
+
+	expected = NULL;
+	if (!BX_ATOMIC_COMPARE_EXCHANGE(&task_manager.task_table[task_id], &expected, pcode_task)) {
+		BX_LOG(LOG_ERROR, "task_scheduler", "Cannot restore task: Task %i already exists", task_id);
+		free_task(pcode_task);
+		return -1;
+	}
+
+	return 0;
 }
 
 bx_int8 bx_sched_remove_task(bx_task_id task_id) {
-	struct bx_task *task_scheduled;
-	struct bx_task *task_stopped;
+	struct bx_task *task;
+	struct bx_task *removed;
+	bx_uint16 requests;
 
-	bx_critical_enter();
-	task_scheduled = task_list_remove(&task_manager.stopped_list, task_id);
-	task_stopped = task_list_remove(&task_manager.scheduled_list, task_id);
-	bx_critical_exit();
+	task = task_acquire(task_id);
+	if (task == NULL) {
+		BX_LOG(LOG_ERROR, "task_scheduler",
+				"Cannot remove: Task %i not found", task_id);
+		return -1;
+	}
 
-	if (task_scheduled != NULL) {
-		free_task(task_scheduled);
-		return 0;
+	// Mark the task as outstanding so that it cannot be scheduled anymore
+	requests = 0;
+	if (!BX_ATOMIC_COMPARE_EXCHANGE(&task->requests, &requests, 1)) {
+		sched_lock();
+		submitted_dispatch();
+		removed = scheduled_remove(task_id);
+		sched_unlock();
+		if (removed == NULL) {
+			task_release(task_id);
+			BX_LOG(LOG_ERROR, "task_scheduler",
+					"Cannot remove: Task %i is executing", task_id);
+			return -1;
+		}
+		BX_ATOMIC_SUB(&task_manager.metrics.ready_tasks, 1);
 	}
 
-	if (task_stopped != NULL) {
-		free_task(task_stopped);
-		return 0;
+	/*
+	 * Threads that looked the task up before it was unpublished may still be
+	 * using it. The read-modify-write orders the check after the exchange, so
+	 * any later lookup finds the slot empty.
+	 */
+	removed = BX_ATOMIC_EXCHANGE(&task_manager.task_table[task_id], NULL);
+	task_release(task_id);
+	while (BX_ATOMIC_ADD(&task_manager.task_users[task_id], 0) != 0) {
+		bx_worker_yield();
 	}
+	free_task(task);
 
-	BX_LOG(LOG_ERROR, "task_scheduler",
-			"Cannot remove: Task %zu not found", task_id);
-	return -1;
+	return 0;
 }
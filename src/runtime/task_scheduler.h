@@ -33,12 +33,71 @@
 #define TASK_SCHEDULER_H_
 
 #include "types.h"
+#include "configuration.h"
 #include "runtime/pcode_manager.h"
 
 typedef void (*native_function)();
 
 typedef bx_ssize bx_task_id;
 
+#define BX_SCHED_HIGHEST_PRIORITY 0
+#define BX_SCHED_LOWEST_PRIORITY (EV_PRIORITY_LEVELS - 1)
+#define BX_SCHED_NO_DEADLINE 0
+
+/**
+ * Behaviour of bx_sched_schedule_task when the task still has an execution
+ * pending or running
+ */
+enum bx_sched_overrun_policy {
+	BX_SCHED_OVERRUN_SKIP,		///< Drop the new execution
+	BX_SCHED_OVERRUN_COALESCE,	///< Merge into the pending execution, or into a single one following the running execution
+	BX_SCHED_OVERRUN_QUEUE,		///< Queue up to queue_limit executions, drop the others
+	BX_SCHED_OVERRUN_DEGRADE	///< Drop the new execution, periodic timers lengthen their period
+};
+
+/**
+ * Runtime statistics of a task.
+ * Bucket i of the latency histogram counts the executions that started less
+ * than EV_LATENCY_BUCKET_USEC << i microseconds after the task was scheduled
+ * and that are not counted by a lower bucket; the last bucket counts all the
+ * remaining executions.
+ */
+struct bx_task_stats {
+	bx_task_id task_id;
+	bx_uint32 run_count;				///< Number of completed executions
+	bx_uint64 total_execution_usec;		///< Total execution time in microseconds
+	bx_uint64 min_execution_usec;		///< Shortest execution time, 0 if never executed
+	bx_uint64 max_execution_usec;		///< Longest execution time
+	bx_uint32 overruns;					///< Times the task was scheduled while still pending
+	bx_uint32 skipped;					///< Executions dropped by the overrun policy or admission limit
+	bx_uint32 coalesced;				///< Executions merged by the coalesce overrun policy
+	bx_uint32 deadline_misses;			///< Executions completed past the deadline
+	bx_uint32 latency_histogram[EV_LATENCY_BUCKETS];	///< Schedule to start latency distribution
+};
+
+/**
+ * Scheduler-wide load metrics
+ */
+struct bx_sched_metrics {
+	bx_uint32 ready_tasks;				///< Tasks currently waiting for execution
+	bx_uint32 max_ready_tasks;			///< Highest number of tasks waiting for execution
+	bx_uint32 admission_rejections;		///< Executions rejected by the admission limit
+};
+
+/**
+ * Scheduling state of a task, saved by the runtime checkpoints
+ */
+struct bx_task_state {
+	bx_task_id task_id;
+	bx_boolean native;					///< Native task, its function is not part of the state
+	bx_uint8 priority;
+	bx_uint8 overrun_policy;
+	bx_uint8 queue_limit;
+	bx_uint16 requests;					///< Outstanding executions
+	bx_uint32 deadline_msec;
+	struct bx_pcode *pcode;				///< Program of a pcode task, NULL for native tasks
+};
+
 /**
  * Initializes the task scheduler
  *
@@ -47,21 +106,60 @@ typedef bx_ssize bx_task_id;
 bx_int8 bx_sched_init();
 
 /**
- * Starts the scheduler loop.
+ * Starts the scheduler loop, executing the tasks in the calling thread.
+ * Returns immediately if the worker threads are running.
  *
  * @param stop_if_empty If set to 1 the loop ends as soon as the
  * scheduled queue is empty
  */
 void bx_sched_scheduler_loop(bx_boolean stop_if_empty);
 
+/**
+ * Advances the virtual clock of the tick process by duration_usec and
+ * executes the scheduled tasks synchronously after every tick callback, so
+ * that each task runs at the virtual time it was scheduled. The virtual
+ * clock does not advance while tasks execute.
+ * Must be used with bx_tick_use_virtual_clock and without worker threads.
+ *
+ * @param duration_usec Virtual time to simulate
+ *
+ * @return 0 on success, -1 on error
+ */
+bx_int8 bx_sched_simulate(bx_uint64 duration_usec);
+
+/**
+ * Starts a pool of worker threads executing the scheduled tasks concurrently.
+ * Scheduled tasks are distributed among the workers in round robin order;
+ * idle workers steal tasks from the other workers. Each worker executes pcode
+ * tasks using its own virtual machine context.
+ * bx_sched_scheduler_loop must not be invoked while the workers are active.
+ *
+ * @param worker_number Number of workers, 0 to use one worker per online CPU
+ *
+ * @return 0 on success, -1 on error
+ */
+bx_int8 bx_sched_start_workers(bx_uint8 worker_number);
+
+/**
+ * Stops the worker threads.
+ * Each worker completes the task it is currently executing before stopping.
+ *
+ * @return 0 on success, -1 on error
+ */
+bx_int8 bx_sched_stop_workers();
+
 /**
  * Adds a task based on a native C function.
+ * Scheduled tasks are executed in priority order; tasks with the same
+ * priority are executed in FIFO order.
  *
  * @param function Handler function.
+ * @param priority Task priority, from BX_SCHED_HIGHEST_PRIORITY to BX_SCHED_LOWEST_PRIORITY
+ * @param deadline_msec Relative deadline in milliseconds, BX_SCHED_NO_DEADLINE if none
  *
- * @return Task id, -1 on error
+ * @return Task id, -1 on error. Ids of removed tasks may be reused.
  */
-bx_task_id bx_sched_add_native_task(native_function function);
+bx_task_id bx_sched_add_native_task(native_function function, bx_uint8 priority, bx_uint32 deadline_msec);
 
 /**
  * Adds a task based on a pcode routine.
@@ -70,17 +168,56 @@ bx_task_id bx_sched_add_native_task(native_function function);
  *
  * @param buffer Pcode instruction buffer
  * @param buffer_size Pcode instruction buffer size
+ * @param priority Task priority, from BX_SCHED_HIGHEST_PRIORITY to BX_SCHED_LOWEST_PRIORITY
+ * @param deadline_msec Relative deadline in milliseconds, BX_SCHED_NO_DEADLINE if none
+ *
+ * @return Task id, -1 on error. Ids of removed tasks may be reused.
+ */
+bx_task_id bx_sched_add_pcode_task(void *buffer, bx_size buffer_size, bx_uint8 priority, bx_uint32 deadline_msec);
+
+/**
+ * Adds a task executing a program of a pcode module in place.
+ * The module stays mapped until the task is removed, even if it is closed.
+ *
+ * @param module Module containing the program
+ * @param index Index of the program inside the module
+ * @param priority Task priority, from BX_SCHED_HIGHEST_PRIORITY to BX_SCHED_LOWEST_PRIORITY
+ * @param deadline_msec Relative deadline in milliseconds, BX_SCHED_NO_DEADLINE if none
  *
- * @return Task id, -1 on error
+ * @return Task id, -1 on error. Ids of removed tasks may be reused.
  */
-bx_task_id bx_sched_add_pcode_task(void *buffer, bx_size buffer_size);
+bx_task_id bx_sched_add_module_task(struct bx_pcode_module *module, bx_uint16 index,
+		bx_uint8 priority, bx_uint32 deadline_msec);
 
 /**
- * Schedules a task for execution
+ * Replaces the pcode program of a task without changing its id, its
+ * scheduling state or its statistics.
+ * Executions starting after the replacement use the new program, while an
+ * execution already running completes with the old one. The old program is
+ * removed by the last execution still using it, so this function never
+ * waits and may be invoked by the task being replaced.
+ *
+ * @param task_id Id of the pcode task
+ * @param buffer New pcode instruction buffer
+ * @param buffer_size New pcode instruction buffer size
+ *
+ * @return 0 on success, -1 on error
+ */
+bx_int8 bx_sched_replace_pcode(bx_task_id task_id, void *buffer, bx_size buffer_size);
+
+/**
+ * Schedules a task for execution.
+ * This function is lock-free and may be invoked by any thread, including
+ * the tick thread and the worker threads.
+ * If the task still has an execution pending or running, the request is
+ * handled according to the overrun policy of the task. A task that is not
+ * pending is rejected if the number of ready tasks has reached the admission
+ * limit, unless it has the highest priority.
  *
  * @param task_id Id of the task to schedule
  *
- * @return 0 on successful schedulation, -1 on error
+ * @return 0 if the execution was scheduled or coalesced, -1 if it was
+ * dropped or on error
  */
 bx_int8 bx_sched_schedule_task(bx_task_id task_id);
 
@@ -93,8 +230,110 @@ bx_int8 bx_sched_schedule_task(bx_task_id task_id);
  */
 bx_int8 bx_sched_is_scheduled(bx_task_id task_id);
 
+/**
+ * Returns the number of deadline misses of a task.
+ * A deadline is missed when the task completes its execution more than
+ * deadline_msec milliseconds after being scheduled.
+ *
+ * @param task_id Task id
+ *
+ * @return Number of deadline misses, -1 on error
+ */
+bx_int32 bx_sched_get_deadline_misses(bx_task_id task_id);
+
+/**
+ * Sets the overrun policy of a task. The default policy is
+ * BX_SCHED_OVERRUN_SKIP.
+ *
+ * @param task_id Task id
+ * @param policy Overrun policy
+ * @param queue_limit Maximum number of queued executions, used by BX_SCHED_OVERRUN_QUEUE
+ *
+ * @return 0 on success, -1 on error
+ */
+bx_int8 bx_sched_set_overrun_policy(bx_task_id task_id,
+		enum bx_sched_overrun_policy policy, bx_uint8 queue_limit);
+
+/**
+ * Returns the overrun policy of a task.
+ *
+ * @param task_id Task id
+ *
+ * @return Overrun policy, -1 on error
+ */
+bx_int8 bx_sched_get_overrun_policy(bx_task_id task_id);
+
+/**
+ * Sets the maximum number of tasks waiting for execution. The default limit
+ * is EV_READY_LIMIT.
+ *
+ * @param ready_limit Admission limit
+ */
+void bx_sched_set_admission_limit(bx_uint32 ready_limit);
+
+/**
+ * Copies the scheduler load metrics.
+ *
+ * @param metrics Destination of the metrics
+ *
+ * @return 0 on success, -1 on error
+ */
+bx_int8 bx_sched_get_metrics(struct bx_sched_metrics *metrics);
+
+/**
+ * Copies the runtime statistics of a task.
+ *
+ * @param task_id Task id
+ * @param stats Destination of the statistics
+ *
+ * @return 0 on success, -1 on error
+ */
+bx_int8 bx_sched_get_stats(bx_task_id task_id, struct bx_task_stats *stats);
+
+/**
+ * Copies the runtime statistics of all the tasks, in task id order.
+ *
+ * @param stats Destination array
+ * @param capacity Number of elements of the destination array
+ *
+ * @return Number of statistics copied, -1 on error
+ */
+bx_ssize bx_sched_get_all_stats(struct bx_task_stats *stats, bx_size capacity);
+
+/**
+ * Logs the runtime statistics of all the tasks
+ */
+void bx_sched_dump_stats();
+
+/**
+ * Copies the scheduling state of all the tasks, in task id order.
+ * The program handles remain valid as long as the tasks are neither removed
+ * nor replaced.
+ *
+ * @param states Destination array
+ * @param capacity Number of elements of the destination array
+ *
+ * @return Number of states copied, -1 on error
+ */
+bx_ssize bx_sched_get_task_states(struct bx_task_state *states, bx_size capacity);
+
+/**
+ * Adds a pcode task with a given id, as saved by bx_sched_get_task_states.
+ * The task takes ownership of the program, which is removed on failure.
+ *
+ * @param task_id Id of the task, must be unused
+ * @param pcode Program of the task
+ * @param priority Task priority, from BX_SCHED_HIGHEST_PRIORITY to BX_SCHED_LOWEST_PRIORITY
+ * @param deadline_msec Relative deadline in milliseconds, BX_SCHED_NO_DEADLINE if none
+ *
+ * @return 0 on success, -1 on error
+ */
+bx_int8 bx_sched_restore_pcode_task(bx_task_id task_id, struct bx_pcode *pcode,
+		bx_uint8 priority, bx_uint32 deadline_msec);
+
 /**
  * Removes the task.
+ * A task cannot be removed while it is executing.
  *
  * @param task_id Id of the task to remove
  *
@@ -34,9 +34,42 @@
 
 #include "types.h"
 
+/**
+ * Value of bx_tick_set_next meaning that no callback is requested
+ */
+#define BX_TICK_IDLE UINT64_MAX
+
 typedef void (*bx_tick_callback)();
 
-bx_int8 bx_tick_start(bx_int32 period_msec, bx_tick_callback callback);
+/**
+ * Starts the tick process
+ *
+ * @param period_usec Tick period in microseconds
+ * @param callback Function invoked at the ticks requested through bx_tick_set_next
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_tick_start(bx_uint32 period_usec, bx_tick_callback callback);
+
+/**
+ * Changes the tick period while the tick process is running.
+ * The tick count restarts from 0 and any pending request is discarded.
+ *
+ * @param period_usec New tick period in microseconds
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_tick_set_period(bx_uint32 period_usec);
+
+
+/**
+ * Requests the tick callback to be invoked as soon as the tick count reaches
+ * tick_count. The callback is invoked once per request, so it has to request
+ * the next invocation itself; no callback is invoked while idle.
+ *
+ * @param tick_count Tick count at which the callback is invoked, BX_TICK_IDLE for none
+ */
+void bx_tick_set_next(bx_uint64 tick_count);
 
 void bx_tick_pause();
 
@@ -44,6 +77,43 @@ void bx_tick_resume();
 
 bx_uint64 bx_tick_get_count();
 
+/**
+ * Returns the value of the monotonic clock at which a tick begins
+ *
+ * @param tick_count Tick count
+ *
+ * @return Monotonic time in microseconds
+ */
+bx_uint64 bx_tick_get_tick_time_usec(bx_uint64 tick_count);
+
+/**
+ * Returns the value of a monotonic clock in microseconds
+ */
+bx_uint64 bx_tick_get_time_usec();
+
 bx_int8 bx_tick_stop();
 
+/**
+ * Selects the clock driving the tick process.
+ * The virtual clock starts at 0 and only advances through bx_tick_step,
+ * making the timing of the system deterministic. The clock can only be
+ * changed while the tick process is stopped.
+ *
+ * @param enabled BX_BOOLEAN_TRUE to use the virtual clock, BX_BOOLEAN_FALSE for the monotonic clock
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_tick_use_virtual_clock(bx_boolean enabled);
+
+/**
+ * Advances the virtual clock to the next requested tick and invokes the
+ * callback in the calling thread. If no tick is requested up to until_usec,
+ * the clock is advanced to until_usec and no callback is invoked.
+ *
+ * @param until_usec Virtual time not to be exceeded
+ *
+ * @return BX_BOOLEAN_TRUE if the callback was invoked, BX_BOOLEAN_FALSE otherwise
+ */
+bx_boolean bx_tick_step(bx_uint64 until_usec);
+
 #endif /* TICK_H_ */
@@ -29,73 +29,353 @@
  *
  */
 
+#include <string.h>
 #include "logging.h"
 #include "configuration.h"
 #include "utils/uniform_allocator.h"
 #include "runtime/timer.h"
 #include "runtime/tick.h"
 #include "runtime/task_scheduler.h"
+#include "runtime/critical_section.h"
+
+#define WHEEL_SLOTS (1 << TM_WHEEL_SLOT_BITS)
+#define WHEEL_SLOT_MASK (WHEEL_SLOTS - 1)
+#define MAX_GENERATION (0x7FFF / TM_MAX_TIMERS)
+#define LATENCY_SUB_BUCKETS (1 << TM_LATENCY_SUB_BUCKET_BITS)
+
+/**
+ * Returns the slot of a level of the wheel matching an expiry tick
+ */
+#define WHEEL_SLOT(expiry_tick, level) \
+	(((expiry_tick) >> ((level) * TM_WHEEL_SLOT_BITS)) & WHEEL_SLOT_MASK)
 
 struct timer_entry {
-	enum bx_timer_type timer_type;		///< Type of timer (native or pcode)
-	bx_uint64 period_msec;				///< Timer firing period in milliseconds
-	bx_uint64 period_ticks;				///< Timer firing period in ticks
+	struct timer_entry *next;			///< Next timer entry in the same slot
+	struct timer_entry **previous_next;	///< Pointer to the link referencing this entry
+	bx_uint64 expiry_tick;				///< Tick at which the timer fires
+	bx_uint64 period_usec;				///< Timer firing period in microseconds
+	bx_timer_id id;						///< Timer id, checked on cancellation
 	bx_task_id task;					///< Task instance
-	bx_uint64 ticks_to_next_timer;		///< Number of ticks between this timer and the next one
-	struct timer_entry *next_timer;		///< Next timer entry in the list
+	bx_uint8 timer_type;				///< Type of timer (periodic or one-off)
+	bx_uint8 degrade_shift;				///< The period is lengthened 2^degrade_shift times on overload
 };
 
+/**
+ * Hierarchical timing wheel.
+ * Level 0 has one slot per tick; each slot of level n spans all the slots of
+ * level n - 1. Timers are inserted in the lowest level able to contain them
+ * and cascade to the lower levels as time advances, so insertion, removal and
+ * expiration take constant time.
+ */
 static struct bx_timer {
-	bx_uint64 ticks_to_next_to_fire;
-	struct timer_entry *next_to_fire;
+	bx_uint64 current_tick;				///< Last tick processed by the wheel
+	bx_uint32 resolution_usec;			///< Duration of a tick
+	struct timer_entry *wheel[TM_WHEEL_LEVELS][WHEEL_SLOTS];
+	struct timer_entry *timer_table[TM_MAX_TIMERS];	///< Timers indexed by id modulo TM_MAX_TIMERS
+	bx_uint16 free_slots[TM_MAX_TIMERS];	///< Stack of unused timer table slots
+	bx_uint16 free_slot_number;
+	struct bx_timer_stats stats[TM_MAX_TIMERS];	///< Timer statistics indexed by id modulo TM_MAX_TIMERS
+	struct bx_timer_stats global_stats;
+	bx_timer_id generation;				///< Distinguishes the ids sharing a table slot
 	struct bx_ualloc *timer_entry_ualloc;
 	bx_uint8 timer_entry_storage[TM_TIMER_STORAGE_SIZE];
 } timer;
 
-static void add_to_timer_list(struct timer_entry *new_timer);
+/**
+ * Converts a duration to the nearest number of ticks, with a minimum of one
+ *
+ * @param usec Duration in microseconds
+ *
+ * @return Number of ticks
+ */
+static bx_uint64 usec_to_ticks(bx_uint64 usec) {
+	bx_uint64 ticks;
 
-static void tick_callback() {
-	struct timer_entry *timer_fired;
-	bx_uint64 start_tick_count;
-	bx_uint64 ticks_elapsed;
+	ticks = (usec + timer.resolution_usec / 2) / timer.resolution_usec;
+	if (ticks == 0) {
+		ticks = 1;
+	}
+
+	return ticks;
+}
+
+/**
+ * Returns the lateness histogram bucket matching a value
+ *
+ * @param lateness_usec Lateness in microseconds
+ *
+ * @return Bucket index
+ */
+static bx_size lateness_bucket(bx_uint64 lateness_usec) {
+	bx_size msb;
+	bx_size bucket;
+
+	if (lateness_usec < LATENCY_SUB_BUCKETS) {
+		return lateness_usec;
+	}
+
+	msb = TM_LATENCY_SUB_BUCKET_BITS;
+	while (lateness_usec >> (msb + 1) != 0) {
+		msb++;
+	}
+	bucket = LATENCY_SUB_BUCKETS * (msb - TM_LATENCY_SUB_BUCKET_BITS + 1) +
+			((lateness_usec >> (msb - TM_LATENCY_SUB_BUCKET_BITS)) - LATENCY_SUB_BUCKETS);
+	if (bucket >= TM_LATENCY_BUCKETS) {
+		bucket = TM_LATENCY_BUCKETS - 1;
+	}
+
+	return bucket;
+}
+
+/**
+ * Adds the lateness of an expiration to a set of statistics
+ *
+ * @param stats Statistics to update
+ * @param lateness_usec Lateness in microseconds
+ */
+static void update_stats(struct bx_timer_stats *stats, bx_uint64 lateness_usec) {
+
+	if (lateness_usec > 0xFFFFFFFF) {
+		lateness_usec = 0xFFFFFFFF;
+	}
+	if (stats->fire_count == 0 || lateness_usec < stats->min_lateness_usec) {
+		stats->min_lateness_usec = lateness_usec;
+	}
+	if (lateness_usec > stats->max_lateness_usec) {
+		stats->max_lateness_usec = lateness_usec;
+	}
+	stats->total_lateness_usec += lateness_usec;
+	stats->fire_count++;
+	stats->lateness_histogram[lateness_bucket(lateness_usec)]++;
+}
+
+/**
+ * Inserts a timer entry in the wheel slot matching its expiry tick.
+ * Timers expiring beyond the range of the wheel are stored in the last slot
+ * of the highest level and inserted again when that slot cascades.
+ *
+ * @param entry Entry to insert
+ */
+static void wheel_insert(struct timer_entry *entry) {
+	struct timer_entry **slot;
+	bx_uint64 delta;
+	bx_size level;
+
+	delta = entry->expiry_tick - timer.current_tick;
+	for (level = 0; level < TM_WHEEL_LEVELS - 1; level++) {
+		if (delta < (bx_uint64) 1 << ((level + 1) * TM_WHEEL_SLOT_BITS)) {
+			break;
+		}
+	}
+	if (level == TM_WHEEL_LEVELS - 1 &&
+			delta >= (bx_uint64) 1 << (TM_WHEEL_LEVELS * TM_WHEEL_SLOT_BITS)) {
+		slot = &timer.wheel[level][WHEEL_SLOT(timer.current_tick - 1, level)];
+	} else {
+		slot = &timer.wheel[level][WHEEL_SLOT(entry->expiry_tick, level)];
+	}
+
+	entry->next = *slot;
+	if (entry->next != NULL) {
+		entry->next->previous_next = &entry->next;
+	}
+	entry->previous_next = slot;
+	*slot = entry;
+}
+
+/**
+ * Removes a timer entry from its wheel slot
+ *
+ * @param entry Entry to remove
+ */
+static void wheel_remove(struct timer_entry *entry) {
+	*entry->previous_next = entry->next;
+	if (entry->next != NULL) {
+		entry->next->previous_next = entry->previous_next;
+	}
+}
+
+/**
+ * Moves the entries of a slot of a higher level to the lower levels
+ *
+ * @param level Level of the slot
+ * @param slot_index Index of the slot
+ */
+static void wheel_cascade(bx_size level, bx_size slot_index) {
+	struct timer_entry *entry;
+	struct timer_entry *next;
 
-	if (timer.next_to_fire == NULL) {
+	entry = timer.wheel[level][slot_index];
+	timer.wheel[level][slot_index] = NULL;
+	while (entry != NULL) {
+		next = entry->next;
+		wheel_insert(entry);
+		entry = next;
+	}
+}
+
+/**
+ * Frees a timer entry and its id
+ *
+ * @param entry Entry to free
+ */
+static void free_timer(struct timer_entry *entry) {
+	timer.timer_table[entry->id % TM_MAX_TIMERS] = NULL;
+	timer.free_slots[timer.free_slot_number++] = entry->id % TM_MAX_TIMERS;
+	bx_ualloc_free(timer.timer_entry_ualloc, entry);
+}
+
+/**
+ * Adapts the period of a periodic timer whose task uses the degrade overrun
+ * policy. The period is doubled every time the task cannot be scheduled, up
+ * to 2^TM_MAX_DEGRADE_SHIFT times the nominal period, and halved every time
+ * the task is scheduled successfully.
+ *
+ * @param entry Periodic timer that fired
+ * @param schedule_error Result of the scheduling of the timer task
+ */
+static void degrade_period(struct timer_entry *entry, bx_int8 schedule_error) {
+
+	if (bx_sched_get_overrun_policy(entry->task) != BX_SCHED_OVERRUN_DEGRADE) {
 		return;
 	}
 
-	bx_tick_pause();
+	if (schedule_error != 0) {
+		if (entry->degrade_shift < TM_MAX_DEGRADE_SHIFT) {
+			entry->degrade_shift++;
+		}
+	} else if (entry->degrade_shift > 0) {
+		entry->degrade_shift--;
+	}
+}
+
+/**
+ * Advances the wheel by one tick and fires the expired timers
+ */
+static void wheel_advance() {
+	struct timer_entry *entry;
+	struct timer_entry *next;
+	bx_uint64 expiry_usec;
+	bx_uint64 now_usec;
+	bx_size level;
+	bx_int8 error;
 
-	--timer.ticks_to_next_to_fire;
-	while (timer.ticks_to_next_to_fire == 0) {
-		start_tick_count = bx_tick_get_count();
+	timer.current_tick++;
 
-		timer_fired = timer.next_to_fire;
-		timer.ticks_to_next_to_fire = timer.next_to_fire->ticks_to_next_timer;
-		timer.next_to_fire = timer.next_to_fire->next_timer;
-		bx_sched_schedule_task(timer_fired->task);
+	// Cascade the higher levels when the lower level wraps around
+	for (level = 1; level < TM_WHEEL_LEVELS; level++) {
+		if (WHEEL_SLOT(timer.current_tick, level - 1) != 0) {
+			break;
+		}
+	}
+	while (level > 1) {
+		level--;
+		wheel_cascade(level, WHEEL_SLOT(timer.current_tick, level));
+	}
 
-		if (timer_fired->timer_type == BX_TIMER_PERIODIC) {
-			add_to_timer_list(timer_fired);
+	entry = timer.wheel[0][WHEEL_SLOT(timer.current_tick, 0)];
+	timer.wheel[0][WHEEL_SLOT(timer.current_tick, 0)] = NULL;
+	expiry_usec = bx_tick_get_tick_time_usec(timer.current_tick);
+	while (entry != NULL) {
+		next = entry->next;
+		now_usec = bx_tick_get_time_usec();
+		if (now_usec < expiry_usec) {
+			now_usec = expiry_usec;
+		}
+		update_stats(&timer.stats[entry->id % TM_MAX_TIMERS], now_usec - expiry_usec);
+		update_stats(&timer.global_stats, now_usec - expiry_usec);
+		error = bx_sched_schedule_task(entry->task);
+		if (entry->timer_type == BX_TIMER_PERIODIC) {
+			degrade_period(entry, error);
+			entry->expiry_tick += usec_to_ticks(entry->period_usec) << entry->degrade_shift;
+			wheel_insert(entry);
 		} else {
-			bx_ualloc_free(timer.timer_entry_ualloc, timer_fired);
+			free_timer(entry);
 		}
+		entry = next;
+	}
+}
 
-		ticks_elapsed = bx_tick_get_count() - start_tick_count;
-		if (timer.ticks_to_next_to_fire <= ticks_elapsed) {
-			timer.ticks_to_next_to_fire = 0;
+/**
+ * Returns the next tick at which the wheel has to be advanced.
+ * Timers stored in the higher levels only need the wheel to be advanced
+ * when the lowest level wraps around and they cascade.
+ *
+ * @return Next tick to process, BX_TICK_IDLE if there are no timers
+ */
+static bx_uint64 wheel_next_tick() {
+	bx_size level;
+	bx_size i;
+
+	for (i = 1; i < WHEEL_SLOTS; i++) {
+		if (timer.wheel[0][WHEEL_SLOT(timer.current_tick + i, 0)] != NULL) {
+			return timer.current_tick + i;
+		}
+	}
+
+	for (level = 1; level < TM_WHEEL_LEVELS; level++) {
+		for (i = 0; i < WHEEL_SLOTS; i++) {
+			if (timer.wheel[level][i] != NULL) {
+				return ((timer.current_tick >> TM_WHEEL_SLOT_BITS) + 1) << TM_WHEEL_SLOT_BITS;
+			}
+		}
+	}
+
+	return BX_TICK_IDLE;
+}
+
+/**
+ * Processes all the ticks elapsed since the last invocation.
+ * The ticks elapsed without timers expiring nor cascading are skipped at
+ * once.
+ */
+static void wheel_catch_up() {
+	bx_uint64 tick_count;
+	bx_uint64 next_tick;
+
+	tick_count = bx_tick_get_count();
+	while (timer.current_tick < tick_count) {
+		next_tick = wheel_next_tick();
+		if (next_tick == BX_TICK_IDLE || next_tick > tick_count) {
+			timer.current_tick = tick_count;
 		} else {
-			timer.ticks_to_next_to_fire -= ticks_elapsed;
+			timer.current_tick = next_tick - 1;
+			wheel_advance();
 		}
 	}
+}
 
-	bx_tick_resume();
+/**
+ * Processes the elapsed ticks and requests the tick process to invoke the
+ * callback again at the next timer expiry.
+ */
+static void tick_callback() {
+	wheel_catch_up();
+	bx_tick_set_next(wheel_next_tick());
 }
 
 bx_int8 bx_timer_init() {
-	bx_int8 error;
+	bx_size level;
+	bx_size i;
 
-	timer.ticks_to_next_to_fire = 0;
-	timer.next_to_fire = NULL;
+	timer.current_tick = 0;
+	timer.resolution_usec = TM_DEFAULT_RESOLUTION_USEC;
+	for (level = 0; level < TM_WHEEL_LEVELS; level++) {
+		for (i = 0; i < WHEEL_SLOTS; i++) {
+			timer.wheel[level][i] = NULL;
+		}
+	}
+	for (i = 0; i < TM_MAX_TIMERS; i++) {
+		timer.timer_table[i] = NULL;
+		timer.free_slots[i] = TM_MAX_TIMERS - 1 - i;
+	}
+	timer.free_slot_number = TM_MAX_TIMERS;
+	timer.generation = 0;
+	memset(timer.stats, 0, sizeof timer.stats);
+	memset(&timer.global_stats, 0, sizeof timer.global_stats);
+	for (i = 0; i < TM_MAX_TIMERS; i++) {
+		timer.stats[i].timer_id = -1;
+	}
+	timer.global_stats.timer_id = -1;
 
 	timer.timer_entry_ualloc = bx_ualloc_init(timer.timer_entry_storage,
 			TM_TIMER_STORAGE_SIZE, sizeof (struct timer_entry));
@@ -103,8 +383,7 @@ bx_int8 bx_timer_init() {
 		return -1;
 	}
 
-	error = bx_tick_start(TM_TICK_PERIOD_MS, &tick_callback);
-	if (error != 0) {
+	if (bx_tick_start(timer.resolution_usec, &tick_callback) != 0) {
 		return -1;
 	}
 
@@ -115,66 +394,255 @@ bx_uint64 bx_timer_get_tick_count() {
 	return bx_tick_get_count();
 }
 
-bx_int8 bx_timer_add_timer(enum bx_timer_type timer_type,
-		bx_int64 time_msec, bx_task_id task_id) {
+bx_int8 bx_timer_set_resolution(bx_uint32 resolution_usec) {
+	struct timer_entry *entry;
+	bx_size level;
+	bx_size i;
+
+	if (resolution_usec < TM_MIN_RESOLUTION_USEC) {
+		BX_LOG(LOG_ERROR, "timer", "Timer resolution must be at least %u usec",
+				TM_MIN_RESOLUTION_USEC);
+		return -1;
+	}
+
+	bx_critical_enter();
+	wheel_catch_up();
+	for (level = 0; level < TM_WHEEL_LEVELS; level++) {
+		for (i = 0; i < WHEEL_SLOTS; i++) {
+			timer.wheel[level][i] = NULL;
+		}
+	}
+
+	// Convert the remaining delays, the tick count restarts from 0
+	for (i = 0; i < TM_MAX_TIMERS; i++) {
+		entry = timer.timer_table[i];
+		if (entry != NULL) {
+			entry->expiry_tick = (entry->expiry_tick - timer.current_tick) * timer.resolution_usec;
+		}
+	}
+	timer.resolution_usec = resolution_usec;
+	timer.current_tick = 0;
+	bx_tick_set_period(resolution_usec);
+	for (i = 0; i < TM_MAX_TIMERS; i++) {
+		entry = timer.timer_table[i];
+		if (entry != NULL) {
+			entry->expiry_tick = usec_to_ticks(entry->expiry_tick);
+			wheel_insert(entry);
+		}
+	}
+	bx_tick_set_next(wheel_next_tick());
+	bx_critical_exit();
+
+	return 0;
+}
+
+bx_uint32 bx_timer_get_resolution() {
+	bx_uint32 resolution_usec;
+
+	bx_critical_enter();
+	resolution_usec = timer.resolution_usec;
+	bx_critical_exit();
+
+	return resolution_usec;
+}
+
+bx_timer_id bx_timer_add_timer(enum bx_timer_type timer_type,
+		bx_int64 time_usec, bx_task_id task_id) {
 	struct timer_entry *new_timer;
+	bx_uint16 table_slot;
 
-	if (task_id < 0) {
+	if (task_id < 0 || time_usec < 0) {
 		return -1;
 	}
 
-	new_timer = bx_ualloc_alloc(timer.timer_entry_ualloc);
+	// The tick callback runs inside the critical section
+	bx_critical_enter();
+
+	// Process the elapsed ticks first, so that the period starts now
+	wheel_catch_up();
+
+	new_timer = NULL;
+	if (timer.free_slot_number != 0) {
+		new_timer = bx_ualloc_alloc(timer.timer_entry_ualloc);
+	}
 	if (new_timer == NULL) {
+		bx_critical_exit();
+		BX_LOG(LOG_ERROR, "timer", "Cannot add timer: timer storage full");
 		return -1;
 	}
 
+	table_slot = timer.free_slots[--timer.free_slot_number];
+	new_timer->id = timer.generation++ * TM_MAX_TIMERS + table_slot;
+	if (timer.generation == MAX_GENERATION) {
+		timer.generation = 0;
+	}
+	timer.timer_table[table_slot] = new_timer;
+	memset(&timer.stats[table_slot], 0, sizeof timer.stats[table_slot]);
+	timer.stats[table_slot].timer_id = new_timer->id;
+
 	new_timer->task = task_id;
-	new_timer->period_msec = time_msec;
-	new_timer->period_ticks = time_msec / TM_TICK_PERIOD_MS;
+	new_timer->period_usec = time_usec;
+	new_timer->degrade_shift = 0;
 	new_timer->timer_type = timer_type;
 
-	bx_tick_pause();
-	add_to_timer_list(new_timer);
-	bx_tick_resume();
+	new_timer->expiry_tick = timer.current_tick + usec_to_ticks(time_usec);
+	wheel_insert(new_timer);
+	bx_tick_set_next(wheel_next_tick());
+	bx_critical_exit();
+
+	return new_timer->id;
+}
+
+bx_int8 bx_timer_cancel(bx_timer_id timer_id) {
+	struct timer_entry *entry;
+
+	if (timer_id < 0) {
+		return -1;
+	}
+
+	bx_critical_enter();
+	entry = timer.timer_table[timer_id % TM_MAX_TIMERS];
+	if (entry == NULL || entry->id != timer_id) {
+		bx_critical_exit();
+		return -1;
+	}
+	wheel_remove(entry);
+	free_timer(entry);
+	bx_tick_set_next(wheel_next_tick());
+	bx_critical_exit();
 
 	return 0;
 }
 
-static void add_to_timer_list(struct timer_entry *new_timer) {
-	struct timer_entry *timer_list_entry;
-	bx_uint64 accumulated_ticks;
+bx_ssize bx_timer_get_states(struct bx_timer_state *states, bx_size capacity) {
+	struct timer_entry *entry;
+	bx_size copied;
+	bx_size i;
 
-	if (timer.next_to_fire == NULL) {
-		timer.next_to_fire = new_timer;
-		timer.ticks_to_next_to_fire = new_timer->period_msec;
-		new_timer->next_timer = NULL;
-		new_timer->ticks_to_next_timer = 0;
-		return;
+	if (states == NULL) {
+		return -1;
 	}
 
-	if (new_timer->period_ticks < timer.ticks_to_next_to_fire) {
-		new_timer->next_timer = timer.next_to_fire;
-		new_timer->ticks_to_next_timer = timer.ticks_to_next_to_fire - new_timer->period_msec;
-		timer.ticks_to_next_to_fire = new_timer->period_ticks;
-		timer.next_to_fire = new_timer;
-		return;
+	bx_critical_enter();
+	wheel_catch_up();
+	copied = 0;
+	for (i = 0; i < TM_MAX_TIMERS && copied < capacity; i++) {
+		entry = timer.timer_table[i];
+		if (entry == NULL) {
+			continue;
+		}
+		states[copied].timer_id = entry->id;
+		states[copied].task_id = entry->task;
+		states[copied].timer_type = entry->timer_type;
+		states[copied].degrade_shift = entry->degrade_shift;
+		states[copied].period_usec = entry->period_usec;
+		states[copied].remaining_ticks = entry->expiry_tick - timer.current_tick;
+		copied++;
 	}
+	bx_critical_exit();
+
+	return copied;
+}
+
+bx_int8 bx_timer_restore(const struct bx_timer_state *state) {
+	struct timer_entry *entry;
+	bx_uint16 table_slot;
+	bx_size i;
 
-	timer_list_entry = timer.next_to_fire;
-	accumulated_ticks = timer.ticks_to_next_to_fire;
-	while (timer_list_entry->next_timer != NULL &&
-			new_timer->period_ticks < accumulated_ticks + timer_list_entry->ticks_to_next_timer) {
-		accumulated_ticks += timer_list_entry->ticks_to_next_timer;
-		timer_list_entry = timer_list_entry->next_timer;
+	if (state == NULL || state->timer_id < 0 || state->task_id < 0 || state->remaining_ticks == 0
+			|| state->timer_type > BX_TIMER_ONE_OFF || state->degrade_shift > TM_MAX_DEGRADE_SHIFT
+			|| state->timer_id / TM_MAX_TIMERS >= MAX_GENERATION) {
+		return -1;
 	}
 
-	new_timer->next_timer = timer_list_entry->next_timer;
-	if (new_timer->next_timer != NULL) {
-		new_timer->ticks_to_next_timer =
-				new_timer->next_timer->period_ticks - new_timer->period_ticks;
+	bx_critical_enter();
+	wheel_catch_up();
+	table_slot = state->timer_id % TM_MAX_TIMERS;
+	entry = NULL;
+	if (timer.timer_table[table_slot] == NULL) {
+		entry = bx_ualloc_alloc(timer.timer_entry_ualloc);
+	}
+	if (entry == NULL) {
+		bx_critical_exit();
+		BX_LOG(LOG_ERROR, "timer", "Cannot restore timer %i", state->timer_id);
+		return -1;
+	}
+
+	// Take the slot out of the stack of the unused ones
+	for (i = 0; timer.free_slots[i] != table_slot; i++) {
+	}
+	timer.free_slot_number--;
+	memmove(&timer.free_slots[i], &timer.free_slots[i + 1],
+			(timer.free_slot_number - i) * sizeof timer.free_slots[0]);
+	if (state->timer_id / TM_MAX_TIMERS >= timer.generation) {
+		timer.generation = (state->timer_id / TM_MAX_TIMERS + 1) % MAX_GENERATION;
 	}
-	timer_list_entry->next_timer = new_timer;
-	timer_list_entry->ticks_to_next_timer = new_timer->period_ticks - accumulated_ticks;
+
+	entry->id = state->timer_id;
+	entry->task = state->task_id;
+	entry->period_usec = state->period_usec;
+	entry->degrade_shift = state->degrade_shift;
+	entry->timer_type = state->timer_type;
+	timer.timer_table[table_slot] = entry;
+	memset(&timer.stats[table_slot], 0, sizeof timer.stats[table_slot]);
+	timer.stats[table_slot].timer_id = entry->id;
+
+	entry->expiry_tick = timer.current_tick + state->remaining_ticks;
+	wheel_insert(entry);
+	bx_tick_set_next(wheel_next_tick());
+	bx_critical_exit();
+
+	return 0;
+}
+
+bx_int8 bx_timer_get_stats(bx_timer_id timer_id, struct bx_timer_stats *stats) {
+
+	if (timer_id < 0 || stats == NULL) {
+		return -1;
+	}
+
+	bx_critical_enter();
+	if (timer.stats[timer_id % TM_MAX_TIMERS].timer_id != timer_id) {
+		bx_critical_exit();
+		return -1;
+	}
+	*stats = timer.stats[timer_id % TM_MAX_TIMERS];
+	bx_critical_exit();
+
+	return 0;
+}
+
+bx_int8 bx_timer_get_global_stats(struct bx_timer_stats *stats) {
+
+	if (stats == NULL) {
+		return -1;
+	}
+
+	bx_critical_enter();
+	*stats = timer.global_stats;
+	bx_critical_exit();
+
+	return 0;
+}
+
+bx_uint32 bx_timer_get_bucket_usec(bx_size bucket) {
+
+	if (bucket < LATENCY_SUB_BUCKETS) {
+		return bucket;
+	}
+
+	return (LATENCY_SUB_BUCKETS + bucket % LATENCY_SUB_BUCKETS) <<
+			(bucket / LATENCY_SUB_BUCKETS - 1);
+}
+
+void bx_timer_dump_stats() {
+	struct bx_timer_stats stats;
+
+	bx_timer_get_global_stats(&stats);
+	BX_LOG(LOG_INFO, "timer",
+			"Timers fired %u, lateness usec total %llu min %u max %u",
+			stats.fire_count, (unsigned long long) stats.total_lateness_usec,
+			stats.min_lateness_usec, stats.max_lateness_usec);
 }
 
 bx_int8 bx_timer_destroy() {
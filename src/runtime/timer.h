@@ -33,14 +33,46 @@
 #define TIMER_H_
 
 #include "types.h"
+#include "configuration.h"
 #include "runtime/tick.h"
 #include "runtime/task_scheduler.h"
 
+typedef bx_ssize bx_timer_id;
+
 enum bx_timer_type {
 	BX_TIMER_PERIODIC,
 	BX_TIMER_ONE_OFF
 };
 
+/**
+ * Lateness statistics of a timer, or of all the timers.
+ * The lateness is the time elapsed between the beginning of the tick at which
+ * a timer expires and the scheduling of its task. The histogram buckets are
+ * log-linear: every power of two is split in 2^TM_LATENCY_SUB_BUCKET_BITS
+ * buckets, whose lower bounds are returned by bx_timer_get_bucket_usec. The
+ * last bucket counts all the larger values.
+ */
+struct bx_timer_stats {
+	bx_timer_id timer_id;				///< Timer id, -1 for the global statistics
+	bx_uint32 fire_count;				///< Number of expirations
+	bx_uint64 total_lateness_usec;		///< Sum of the lateness of all the expirations
+	bx_uint32 min_lateness_usec;		///< Smallest lateness, 0 if never fired
+	bx_uint32 max_lateness_usec;		///< Largest lateness
+	bx_uint32 lateness_histogram[TM_LATENCY_BUCKETS];	///< Lateness distribution
+};
+
+/**
+ * State of a pending timer, saved by the runtime checkpoints
+ */
+struct bx_timer_state {
+	bx_timer_id timer_id;
+	bx_task_id task_id;
+	bx_uint8 timer_type;
+	bx_uint8 degrade_shift;				///< Current lengthening of the period on overload
+	bx_uint64 period_usec;
+	bx_uint64 remaining_ticks;			///< Ticks left before the next expiration, at least 1
+};
+
 /**
  * Initializes the timer.
  *
@@ -55,20 +87,106 @@ bx_int8 bx_timer_init();
  */
 bx_uint64 bx_timer_get_tick_count();
 
+/**
+ * Changes the duration of a tick at runtime.
+ * The delays of the pending timers are preserved, rounded to the new
+ * resolution; the tick count restarts from 0.
+ *
+ * @param resolution_usec Tick duration in microseconds, at least TM_MIN_RESOLUTION_USEC
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_timer_set_resolution(bx_uint32 resolution_usec);
+
+/**
+ * Returns the duration of a tick in microseconds
+ */
+bx_uint32 bx_timer_get_resolution();
+
 /**
  * Adds a new timer in the system.
  * There are 2 different types of timers: Periodic and One-off.
  * Periodic timers are executed periodically.
  * One-off timers are only fired once.
  *
+ * The delay is rounded to the nearest multiple of the timer resolution,
+ * with a minimum of one tick.
+ *
  * @param timer_type Type of timer (periodic or one-off)
- * @param time_msec Timer fire delay
+ * @param time_usec Timer fire delay in microseconds
  * @param task Task to schedule when the timer fires
  *
- * @return 0 on successful addition, -1 on error
+ * @return Timer id, -1 on error
+ */
+bx_timer_id bx_timer_add_timer(enum bx_timer_type timer_type,
+		bx_int64 time_usec, bx_task_id task_id);
+
+/**
+ * Cancels a timer.
+ * One-off timers are removed automatically after firing and cannot be
+ * cancelled afterwards.
+ *
+ * @param timer_id Id of the timer to cancel
+ *
+ * @return 0 on successful cancellation, -1 on error
+ */
+bx_int8 bx_timer_cancel(bx_timer_id timer_id);
+
+/**
+ * Copies the state of all the pending timers, after processing the elapsed
+ * ticks.
+ *
+ * @param states Destination array
+ * @param capacity Number of elements of the destination array
+ *
+ * @return Number of states copied, -1 on error
+ */
+bx_ssize bx_timer_get_states(struct bx_timer_state *states, bx_size capacity);
+
+/**
+ * Adds a timer with a given id, as saved by bx_timer_get_states. The timer
+ * expires after the remaining ticks, then follows its period.
+ *
+ * @param state State of the timer, its id must be unused
+ *
+ * @return 0 on success, -1 on error
+ */
+bx_int8 bx_timer_restore(const struct bx_timer_state *state);
+
+/**
+ * Copies the lateness statistics of a timer.
+ * The statistics of a timer remain available after its cancellation or
+ * expiration, until its id is reused.
+ *
+ * @param timer_id Id of the timer
+ * @param stats Destination of the statistics
+ *
+ * @return 0 on success, -1 on error
+ */
+bx_int8 bx_timer_get_stats(bx_timer_id timer_id, struct bx_timer_stats *stats);
+
+/**
+ * Copies the lateness statistics of all the timers fired since initialization
+ *
+ * @param stats Destination of the statistics
+ *
+ * @return 0 on success, -1 on error
+ */
+bx_int8 bx_timer_get_global_stats(struct bx_timer_stats *stats);
+
+/**
+ * Returns the lower bound of a lateness histogram bucket
+ *
+ * @param bucket Bucket index, lower than TM_LATENCY_BUCKETS
+ *
+ * @return Lower bound in microseconds
+ */
+bx_uint32 bx_timer_get_bucket_usec(bx_size bucket);
+
+/**
+ * Logs the global lateness statistics
  */
-bx_int8 bx_timer_add_timer(enum bx_timer_type timer_type,
-		bx_int64 time_msec, bx_task_id task_id);
+void bx_timer_dump_stats();
 
 /**
  * Destroys the timer.
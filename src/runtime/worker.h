@@ -0,0 +1,72 @@
+/*
+ * worker.h
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WORKER_H_
+#define WORKER_H_
+
+#include "types.h"
+
+typedef void (*bx_worker_routine)(bx_uint8 worker_index);
+
+/**
+ * Starts a pool of worker threads.
+ * Each worker invokes the routine passed as parameter with its own index,
+ * ranging from 0 to worker_number - 1. The routine is expected to return
+ * when the pool is being stopped.
+ *
+ * @param worker_number Number of workers to start
+ * @param routine Routine executed by each worker
+ *
+ * @return 0 on success, -1 on error
+ */
+bx_int8 bx_worker_start(bx_uint8 worker_number, bx_worker_routine routine);
+
+/**
+ * Returns the number of processors currently online.
+ *
+ * @return Number of online processors, at least 1
+ */
+bx_uint8 bx_worker_online_cpus();
+
+/**
+ * Yields the processor to other threads.
+ * Invoked by idle workers.
+ */
+void bx_worker_yield();
+
+/**
+ * Waits for all worker routines to return and releases the worker threads.
+ *
+ * @return 0 on success, -1 on error
+ */
+bx_int8 bx_worker_stop();
+
+#endif /* WORKER_H_ */
@@ -0,0 +1,287 @@
+/*
+ * buddy_allocator.c
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "utils/buddy_allocator.h"
+#include "logging.h"
+#include "compile_assert.h"
+
+/*
+ * The balloc structure is stored at the beginning of the storage array,
+ * followed by the block map and by the arena the blocks are allocated from.
+ * The arena is a sequence of minimum sized blocks; a block of order n spans
+ * 2^n minimum blocks and is aligned to its own size. The block map stores
+ * one byte for each minimum block: the entry of the first minimum block of
+ * a block contains its order and whether it is free. Free blocks of the same
+ * order are linked in a doubly linked list, whose nodes are stored inside the
+ * free blocks themselves.
+ * When the arena size is not a power of two, the blocks close to its end
+ * have no buddy and are never merged.
+ *
+ * +--------+-----------+----------------------------------------+
+ * |        |           |                                        |
+ * | Balloc | Block map | Arena                                  |
+ * |        |           |                                        |
+ * +--------+-----------+----------------------------------------+
+ */
+
+#define MAX_ORDERS 16
+#define FREE_FLAG 0x80
+#define ORDER_MASK 0x7F
+
+struct free_block {
+	struct free_block *next;
+	struct free_block *previous;
+};
+
+struct bx_balloc {
+	bx_uint8 *block_map;			///< Order and status of each block
+	bx_uint8 *arena;				///< First minimum block
+	bx_size block_number;			///< Number of minimum blocks in the arena
+	bx_size min_block_size;			///< Size of a block of order 0 in bytes
+	bx_size free_blocks;			///< Number of free minimum blocks
+	bx_uint8 max_order;				///< Highest order of a block
+	struct free_block *free_list[MAX_ORDERS];	///< Free blocks of each order
+};
+
+#define BLOCK_POINTER(balloc, index) \
+	((struct free_block *) ((balloc)->arena + (bx_uint32) (index) * (balloc)->min_block_size))
+
+#define BLOCK_INDEX(balloc, pointer) \
+	((bx_size) (((bx_uint8 *) (pointer) - (balloc)->arena) / (balloc)->min_block_size))
+
+/**
+ * Inserts a free block in the list of its order
+ *
+ * @param balloc Buddy allocator instance pointer
+ * @param index Index of the first minimum block
+ * @param order Order of the block
+ */
+static void push_free(struct bx_balloc *balloc, bx_size index, bx_uint8 order) {
+	struct free_block *block;
+
+	block = BLOCK_POINTER(balloc, index);
+	block->previous = NULL;
+	block->next = balloc->free_list[order];
+	if (block->next != NULL) {
+		block->next->previous = block;
+	}
+	balloc->free_list[order] = block;
+	balloc->block_map[index] = FREE_FLAG | order;
+}
+
+/**
+ * Removes a free block from the list of its order
+ *
+ * @param balloc Buddy allocator instance pointer
+ * @param index Index of the first minimum block
+ * @param order Order of the block
+ */
+static void remove_free(struct bx_balloc *balloc, bx_size index, bx_uint8 order) {
+	struct free_block *block;
+
+	block = BLOCK_POINTER(balloc, index);
+	if (block->previous != NULL) {
+		block->previous->next = block->next;
+	} else {
+		balloc->free_list[order] = block->next;
+	}
+	if (block->next != NULL) {
+		block->next->previous = block->previous;
+	}
+	balloc->block_map[index] = order;
+}
+
+struct bx_balloc *bx_balloc_init(void *storage, bx_size storage_size, bx_size min_block_size) {
+	struct bx_balloc *balloc;
+	bx_uint8 *arena;
+	bx_size index;
+	bx_uint8 order;
+
+	BX_COMPILE_ASSERT(sizeof (struct bx_balloc) <= BX_BALLOC_SIZE);
+
+	if (storage == NULL || min_block_size < sizeof (struct free_block) ||
+			(min_block_size & (min_block_size - 1)) != 0) {
+		return NULL;
+	}
+
+	if (storage_size < sizeof (struct bx_balloc) + 1 + 2 * min_block_size) {
+		return NULL;
+	}
+
+	balloc = (struct bx_balloc *) storage;
+	balloc->min_block_size = min_block_size;
+	balloc->block_map = (bx_uint8 *) storage + sizeof (struct bx_balloc);
+
+	// The block map takes one byte for each block, the arena is aligned to the block size
+	balloc->block_number = (storage_size - sizeof (struct bx_balloc)) / (min_block_size + 1);
+	while (balloc->block_number > 0) {
+		arena = balloc->block_map + balloc->block_number;
+		arena += (min_block_size - (uintptr_t) arena % min_block_size) % min_block_size;
+		if (arena + (bx_uint32) balloc->block_number * min_block_size <=
+				(bx_uint8 *) storage + storage_size) {
+			break;
+		}
+		balloc->block_number--;
+	}
+	if (balloc->block_number == 0) {
+		return NULL;
+	}
+	balloc->arena = arena;
+	memset(balloc->block_map, 0, balloc->block_number);
+
+	balloc->max_order = 0;
+	while (balloc->max_order < MAX_ORDERS - 1 &&
+			(bx_size) (1 << (balloc->max_order + 1)) <= balloc->block_number) {
+		balloc->max_order++;
+	}
+	for (order = 0; order < MAX_ORDERS; order++) {
+		balloc->free_list[order] = NULL;
+	}
+
+	// Carve the arena in the largest aligned blocks
+	index = 0;
+	while (index < balloc->block_number) {
+		order = balloc->max_order;
+		while (index % (1 << order) != 0 || index + (1 << order) > balloc->block_number) {
+			order--;
+		}
+		push_free(balloc, index, order);
+		index += 1 << order;
+	}
+	balloc->free_blocks = balloc->block_number;
+
+	return balloc;
+}
+
+void *bx_balloc_alloc(struct bx_balloc *balloc, bx_size size) {
+	bx_uint8 needed_order;
+	bx_uint8 order;
+	bx_size index;
+
+	if (balloc == NULL || size == 0) {
+		return NULL;
+	}
+
+	needed_order = 0;
+	while ((bx_uint32) balloc->min_block_size << needed_order < size) {
+		needed_order++;
+		if (needed_order > balloc->max_order) {
+			return NULL;
+		}
+	}
+
+	order = needed_order;
+	while (order <= balloc->max_order && balloc->free_list[order] == NULL) {
+		order++;
+	}
+	if (order > balloc->max_order) {
+		return NULL;
+	}
+
+	index = BLOCK_INDEX(balloc, balloc->free_list[order]);
+	remove_free(balloc, index, order);
+
+	// Split the block, releasing the upper halves
+	while (order > needed_order) {
+		order--;
+		push_free(balloc, index + (1 << order), order);
+	}
+	balloc->block_map[index] = order;
+	balloc->free_blocks -= 1 << order;
+
+	return (void *) BLOCK_POINTER(balloc, index);
+}
+
+bx_int8 bx_balloc_free(struct bx_balloc *balloc, void *block_pointer) {
+	bx_size index;
+	bx_size buddy;
+	bx_uint8 order;
+
+	if (balloc == NULL || block_pointer == NULL) {
+		return -1;
+	}
+
+	if ((bx_uint8 *) block_pointer < balloc->arena ||
+			((bx_uint8 *) block_pointer - balloc->arena) % balloc->min_block_size != 0) {
+		return -1;
+	}
+	index = BLOCK_INDEX(balloc, block_pointer);
+	if (index >= balloc->block_number || (balloc->block_map[index] & FREE_FLAG) != 0) {
+		return -1;
+	}
+
+	order = balloc->block_map[index] & ORDER_MASK;
+	balloc->free_blocks += 1 << order;
+
+	// Merge the block with its buddy as long as the buddy is free
+	while (order < balloc->max_order) {
+		buddy = index ^ (1 << order);
+		if (buddy + (1 << order) > balloc->block_number ||
+				balloc->block_map[buddy] != (FREE_FLAG | order)) {
+			break;
+		}
+		remove_free(balloc, buddy, order);
+		if (buddy < index) {
+			index = buddy;
+		}
+		order++;
+	}
+	push_free(balloc, index, order);
+
+	return 0;
+}
+
+bx_size bx_balloc_remaining_capacity(struct bx_balloc *balloc) {
+
+	if (balloc == NULL) {
+		return 0;
+	}
+
+	return balloc->free_blocks * balloc->min_block_size;
+}
+
+bx_size bx_balloc_largest_block(struct bx_balloc *balloc) {
+	bx_int8 order;
+
+	if (balloc == NULL) {
+		return 0;
+	}
+
+	for (order = balloc->max_order; order >= 0; order--) {
+		if (balloc->free_list[order] != NULL) {
+			return balloc->min_block_size << order;
+		}
+	}
+
+	return 0;
+}
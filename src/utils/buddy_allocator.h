@@ -0,0 +1,107 @@
+/*
+ * buddy_allocator.h
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * A component for managing the allocation of variably sized memory blocks
+ * inside a fixed storage array, using the buddy system
+ */
+
+#ifndef BUDDY_ALLOCATOR_H_
+#define BUDDY_ALLOCATOR_H_
+
+#include "types.h"
+
+/**
+ * Upper bound of the bookkeeping data stored at the beginning of the storage
+ */
+#define BX_BALLOC_SIZE (20 * sizeof (void *))
+
+/**
+ * Storage size needed for an arena of arena_size bytes, including the block
+ * map and the alignment of the arena
+ */
+#define BX_BALLOC_STORAGE_SIZE(arena_size, min_block_size) \
+	(BX_BALLOC_SIZE + (arena_size) / (min_block_size) + (min_block_size) + (arena_size))
+
+/**
+ * Buddy allocator data structure initialization.
+ * The storage array also contains the allocator bookkeeping data, so the
+ * allocatable space is slightly smaller than storage_size.
+ *
+ * @param storage Storage byte array
+ * @param storage_size Size of the storage byte array in bytes
+ * @param min_block_size Size of the smallest block, a power of two of at least 2 pointers
+ *
+ * @return Buddy allocator instance pointer, NULL on error
+ */
+struct bx_balloc *bx_balloc_init(void *storage, bx_size storage_size, bx_size min_block_size);
+
+/**
+ * Allocates a block of memory able to contain size bytes.
+ * Blocks are never moved once allocated.
+ *
+ * @param balloc Buddy allocator instance pointer
+ * @param size Number of bytes to allocate
+ *
+ * @return A pointer to the newly allocated block, NULL on error
+ */
+void *bx_balloc_alloc(struct bx_balloc *balloc, bx_size size);
+
+/**
+ * Deallocates a block of memory, merging it with its free buddies.
+ *
+ * @param balloc Buddy allocator instance pointer
+ * @param block_pointer Pointer to the block to deallocate
+ *
+ * @return 0 upon success, -1 otherwise
+ */
+bx_int8 bx_balloc_free(struct bx_balloc *balloc, void *block_pointer);
+
+/**
+ * Returns the total number of free bytes.
+ * Fragmentation may prevent the allocation of a single block of this size.
+ *
+ * @param balloc Buddy allocator instance pointer
+ *
+ * @return Free bytes, 0 on error
+ */
+bx_size bx_balloc_remaining_capacity(struct bx_balloc *balloc);
+
+/**
+ * Returns the size of the largest block that can currently be allocated.
+ *
+ * @param balloc Buddy allocator instance pointer
+ *
+ * @return Largest allocatable size in bytes, 0 on error
+ */
+bx_size bx_balloc_largest_block(struct bx_balloc *balloc);
+
+#endif /* BUDDY_ALLOCATOR_H_ */
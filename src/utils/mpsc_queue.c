@@ -0,0 +1,85 @@
+/*
+ * mpsc_queue.c
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "atomic.h"
+#include "utils/mpsc_queue.h"
+
+void bx_mpsc_init(struct bx_mpsc_queue *queue) {
+	queue->stub.next = NULL;
+	queue->head = &queue->stub;
+	queue->tail = &queue->stub;
+}
+
+void bx_mpsc_push(struct bx_mpsc_queue *queue, struct bx_mpsc_node *node) {
+	struct bx_mpsc_node *previous;
+
+	BX_ATOMIC_STORE(&node->next, NULL);
+	previous = BX_ATOMIC_EXCHANGE(&queue->head, node);
+	BX_ATOMIC_STORE(&previous->next, node);
+}
+
+struct bx_mpsc_node *bx_mpsc_pop(struct bx_mpsc_queue *queue) {
+	struct bx_mpsc_node *tail;
+	struct bx_mpsc_node *next;
+
+	tail = queue->tail;
+	next = BX_ATOMIC_LOAD(&tail->next);
+
+	// Skip the stub node
+	if (tail == &queue->stub) {
+		if (next == NULL) {
+			return NULL;
+		}
+		queue->tail = next;
+		tail = next;
+		next = BX_ATOMIC_LOAD(&next->next);
+	}
+
+	if (next != NULL) {
+		queue->tail = next;
+		return tail;
+	}
+
+	// The tail is not the last node: a producer has not linked its node yet
+	if (tail != BX_ATOMIC_LOAD(&queue->head)) {
+		return NULL;
+	}
+
+	// The tail is the last node, push the stub behind it before removing it
+	bx_mpsc_push(queue, &queue->stub);
+	next = BX_ATOMIC_LOAD(&tail->next);
+	if (next != NULL) {
+		queue->tail = next;
+		return tail;
+	}
+
+	return NULL;
+}
@@ -0,0 +1,89 @@
+/*
+ * mpsc_queue.h
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef MPSC_QUEUE_H_
+#define MPSC_QUEUE_H_
+
+#include "types.h"
+
+/**
+ * Intrusive queue node, embedded in the elements stored inside the queue
+ */
+struct bx_mpsc_node {
+	struct bx_mpsc_node *next;
+};
+
+/**
+ * Lock-free, unbounded, intrusive multiple producer single consumer queue.
+ * Any number of threads may push concurrently; only one thread at a time
+ * may pop.
+ */
+struct bx_mpsc_queue {
+	struct bx_mpsc_node *head;		///< Last pushed node, updated by the producers
+	struct bx_mpsc_node *tail;		///< Next node to pop, owned by the consumer
+	struct bx_mpsc_node stub;		///< Placeholder node, keeps the queue never empty
+};
+
+/**
+ * Returns the pointer to the structure containing a queue node
+ */
+#define BX_MPSC_ELEMENT(node_pointer, type, member) \
+	((type *) ((bx_uint8 *) (node_pointer) - offsetof(type, member)))
+
+/**
+ * Initializes the queue.
+ *
+ * @param queue Queue pointer
+ */
+void bx_mpsc_init(struct bx_mpsc_queue *queue);
+
+/**
+ * Appends a node at the end of the queue.
+ * This function is wait-free and may be invoked concurrently by any thread.
+ *
+ * @param queue Queue pointer
+ * @param node Node to append, must not be already stored inside a queue
+ */
+void bx_mpsc_push(struct bx_mpsc_queue *queue, struct bx_mpsc_node *node);
+
+/**
+ * Removes the node at the beginning of the queue.
+ * A node whose push is still in progress is not visible yet, so the function
+ * may return NULL even if a concurrent push has started.
+ * Must be invoked by a single consumer thread at a time.
+ *
+ * @param queue Queue pointer
+ *
+ * @return Removed node, NULL if the queue is empty
+ */
+struct bx_mpsc_node *bx_mpsc_pop(struct bx_mpsc_queue *queue);
+
+#endif /* MPSC_QUEUE_H_ */
@@ -0,0 +1,71 @@
+/*
+ * seqlock.c
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "atomic.h"
+#include "utils/seqlock.h"
+
+void bx_seqlock_init(bx_uint32 *sequence) {
+	BX_ATOMIC_STORE(sequence, 0);
+}
+
+bx_boolean bx_seqlock_write_try_begin(bx_uint32 *sequence) {
+	bx_uint32 start;
+
+	start = BX_ATOMIC_LOAD(sequence);
+	if ((start & 1) != 0) {
+		return BX_BOOLEAN_FALSE;
+	}
+
+	// The exchange also keeps the data stores after the odd counter
+	return BX_ATOMIC_COMPARE_EXCHANGE(sequence, &start, start + 1) ? BX_BOOLEAN_TRUE : BX_BOOLEAN_FALSE;
+}
+
+void bx_seqlock_write_end(bx_uint32 *sequence) {
+	BX_ATOMIC_ADD(sequence, 1);
+}
+
+bx_uint32 bx_seqlock_read_begin(bx_uint32 *sequence) {
+	return BX_ATOMIC_LOAD(sequence);
+}
+
+bx_boolean bx_seqlock_read_end(bx_uint32 *sequence, bx_uint32 start) {
+
+	if ((start & 1) != 0) {
+		return BX_BOOLEAN_FALSE;
+	}
+
+	// The data loads have acquire semantics and cannot move after this load
+	return BX_ATOMIC_LOAD(sequence) == start ? BX_BOOLEAN_TRUE : BX_BOOLEAN_FALSE;
+}
+
+bx_uint32 bx_seqlock_version(bx_uint32 *sequence) {
+	return BX_ATOMIC_LOAD(sequence) >> 1;
+}
@@ -0,0 +1,102 @@
+/*
+ * seqlock.h
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef SEQLOCK_H_
+#define SEQLOCK_H_
+
+#include "types.h"
+
+/**
+ * Sequence lock.
+ * A sequence lock is a 32 bit counter protecting data that is written
+ * rarely compared to the number of reads. Writers make the counter odd for
+ * the duration of the update, readers never block the writers and retry
+ * if the counter was odd or changed during the read. Half of the counter
+ * value is the number of completed updates, usable as a version number.
+ * The counter contains no pointer, so it can be placed in memory shared
+ * between processes. Data protected by the lock must be accessed with
+ * atomic operations.
+ */
+
+/**
+ * Initializes a sequence lock
+ *
+ * @param sequence Sequence counter
+ */
+void bx_seqlock_init(bx_uint32 *sequence);
+
+/**
+ * Tries to start an update. Concurrent writers are excluded.
+ *
+ * @param sequence Sequence counter
+ *
+ * @return BX_BOOLEAN_TRUE if the update can proceed, BX_BOOLEAN_FALSE if
+ * another update is in progress
+ */
+bx_boolean bx_seqlock_write_try_begin(bx_uint32 *sequence);
+
+/**
+ * Completes an update started with bx_seqlock_write_try_begin
+ *
+ * @param sequence Sequence counter
+ */
+void bx_seqlock_write_end(bx_uint32 *sequence);
+
+/**
+ * Starts a read
+ *
+ * @param sequence Sequence counter
+ *
+ * @return Sequence value to pass to bx_seqlock_read_end
+ */
+bx_uint32 bx_seqlock_read_begin(bx_uint32 *sequence);
+
+/**
+ * Completes a read
+ *
+ * @param sequence Sequence counter
+ * @param start Sequence value returned by bx_seqlock_read_begin
+ *
+ * @return BX_BOOLEAN_TRUE if the data read is consistent, BX_BOOLEAN_FALSE
+ * if the read must be retried
+ */
+bx_boolean bx_seqlock_read_end(bx_uint32 *sequence, bx_uint32 start);
+
+/**
+ * Returns the number of completed updates
+ *
+ * @param sequence Sequence counter
+ *
+ * @return Version number
+ */
+bx_uint32 bx_seqlock_version(bx_uint32 *sequence);
+
+#endif /* SEQLOCK_H_ */
@@ -63,7 +63,7 @@ struct bx_ualloc {
 #define CHUNK_POINTER(ualloc_pointer, index) \
 	(void *) (CHUNK_BASE_POINTER(ualloc_pointer) + index * ualloc_pointer->chunk_size)
 
-#define MAM_BLOCK_POINTER(ualloc_pointer, block_number) (bx_uint32 *) ualloc_pointer->mam + block_number
+#define MAM_BLOCK_POINTER(ualloc_pointer, block_number) ((bx_uint32 *) (ualloc_pointer)->mam + (block_number))
 
 static bx_size get_available_chunk_index(struct bx_ualloc *ualloc);
 static void set_unavailable(struct bx_ualloc *ualloc, bx_size index);
@@ -88,10 +88,10 @@ struct bx_ualloc *bx_ualloc_init(void *storage, bx_size storage_size, bx_size ch
 	available_bytes = storage_size - sizeof (struct bx_ualloc);
 	ualloc->mam_size = available_bytes / (32 * chunk_size + 4);
 	ualloc->capacity = 32 * ualloc->mam_size;
-	available_bytes -= ualloc->capacity * (32 * chunk_size + 4) + 4;
-	if (available_bytes > chunk_size) {
+	available_bytes -= ualloc->mam_size * (32 * chunk_size + 4);
+	if (available_bytes >= chunk_size + 4) {
 		ualloc->mam_size += 1;
-		ualloc->capacity += available_bytes / chunk_size;
+		ualloc->capacity += (available_bytes - 4) / chunk_size;
 	}
 	ualloc->mam = (void *) ((bx_uint8 *) storage + storage_size - 4 * ualloc->mam_size);
 	memset(ualloc->mam, 0xFF, 4 * ualloc->mam_size);
@@ -133,6 +133,7 @@ static bx_size get_available_chunk_index(struct bx_ualloc *ualloc) {
 	available_chunk_index = 0;
 	i = 0;
 	for (i = 0; i < ualloc->mam_size; i++) {
+		available_chunk_index = 0;
 		mam_block_copy = *MAM_BLOCK_POINTER(ualloc, i);
 		if ((mam_block_copy & 0xFFFF0000) == 0) {
 			available_chunk_index += 16;
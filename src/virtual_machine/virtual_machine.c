@@ -34,6 +34,7 @@
 #include "utils/stack.h"
 #include "utils/memory_utils.h"
 #include "logging.h"
+#include "atomic.h"
 #include "document_manager/document_manager.h"
 
 enum vm_operand {
@@ -64,11 +65,11 @@ static struct bx_vm_status {
 	bx_uint8 variable_table[VM_VARIABLE_TABLE_SIZE];
 	bx_size pcode_size;
 	bx_boolean stop;
-} vm_status;
+} vm_context_table[VM_CONTEXT_NUMBER];
 
 typedef bx_int8 (*bx_instruction)(struct bx_vm_status *);
 
-static bx_int8 stack_byte_array[VM_STACK_SIZE];
+static bx_int8 stack_byte_array[VM_CONTEXT_NUMBER][VM_STACK_SIZE];
 
 static const bx_int32 int_const_0 = 0;
 static const bx_int32 int_const_1 = 1;
@@ -79,6 +80,7 @@ static const bx_float32 float_const_1 = 1.0;
 static inline bx_int8 bx_integer_functions(struct bx_stack *execution_stack, enum vm_operand operation);
 static inline bx_int8 bx_float_functions(struct bx_stack *execution_stack, enum vm_operand operation);
 static inline bx_int8 bx_fetch_instruction(struct bx_vm_status *vm_status, bx_uint8 *instruction_id);
+static inline bx_int8 bx_fetch8(struct bx_vm_status *vm_status, void *data);
 static inline bx_int8 bx_fetch16(struct bx_vm_status *vm_status, void *data);
 static inline bx_int8 bx_fetch32(struct bx_vm_status *vm_status, void *data);
 static inline bx_int8 bx_fetch_identifier(struct bx_vm_status *vm_status, void *data);
@@ -416,14 +418,17 @@ static bx_int8 bx_fpush_1_function(struct bx_vm_status *vm_status) {
 static bx_int8 bx_rload32_function(struct bx_vm_status *vm_status) {
 	bx_int8 error;
 	char identifier[DM_FIELD_IDENTIFIER_LENGTH];
+	struct bx_field_storage *storage;
 	bx_uint32 data;
 
 	error = bx_fetch_identifier(vm_status, &identifier);
 	if (error == -1) {
 		return -1;
 	}
-	error = bx_docman_invoke_get(identifier, &data);
-	if (error == -1) {
+	storage = bx_docman_get_storage(identifier);
+	if (storage != NULL) {
+		data = BX_ATOMIC_LOAD(&storage->value);
+	} else if (bx_docman_invoke_get(identifier, &data) == -1) {
 		return -1;
 	}
 	error = BX_STACK_PUSH_VARIABLE(vm_status->execution_stack, data);
@@ -437,6 +442,7 @@ static bx_int8 bx_rload32_function(struct bx_vm_status *vm_status) {
 static bx_int8 bx_rstore32_function(struct bx_vm_status *vm_status) {
 	bx_int8 error;
 	char identifier[DM_FIELD_IDENTIFIER_LENGTH];
+	struct bx_field_storage *storage;
 	bx_uint32 data;
 
 	error = bx_fetch_identifier(vm_status, &identifier);
@@ -447,7 +453,36 @@ static bx_int8 bx_rstore32_function(struct bx_vm_status *vm_status) {
 	if (error == -1) {
 		return -1;
 	}
-	error = bx_docman_invoke_set(identifier, &data);
+	storage = bx_docman_get_storage(identifier);
+	if (storage != NULL) {
+		bx_docman_write_storage(storage, data);
+	} else if (bx_docman_invoke_set(identifier, &data) == -1) {
+		return -1;
+	}
+
+	return 0;
+}
+
+static bx_int8 bx_wload32_function(struct bx_vm_status *vm_status) {
+	bx_int8 error;
+	char identifier[DM_FIELD_IDENTIFIER_LENGTH];
+	struct bx_field_window *window;
+	bx_uint8 aggregate;
+	bx_uint32 data;
+
+	error = bx_fetch_identifier(vm_status, &identifier);
+	if (error == -1) {
+		return -1;
+	}
+	error = bx_fetch8(vm_status, &aggregate);
+	if (error == -1) {
+		return -1;
+	}
+	window = bx_docman_get_window(identifier);
+	if (window == NULL || bx_window_get(window, aggregate, &data) == -1) {
+		return -1;
+	}
+	error = BX_STACK_PUSH_VARIABLE(vm_status->execution_stack, data);
 	if (error == -1) {
 		return -1;
 	}
@@ -693,38 +728,151 @@ static const bx_instruction instruction_array[256] = {
 	&bx_nop_function,
 	&bx_i2f_function,
 	&bx_f2i_function,
-	&bx_halt_function
+	&bx_halt_function,
+	&bx_wload32_function
 };
 
+/**
+ * Returns the size of the operand of an instruction
+ *
+ * @param instruction_id Instruction
+ *
+ * @return Operand size in bytes, -1 if the instruction is not valid
+ */
+static bx_ssize operand_size(bx_uint8 instruction_id) {
+
+	switch (instruction_id) {
+	case BX_INSTR_PUSH32:
+		return 4;
+	case BX_INSTR_RLOAD32:
+	case BX_INSTR_RSTORE32:
+		return DM_FIELD_IDENTIFIER_LENGTH;
+	case BX_INSTR_WLOAD32:
+		return DM_FIELD_IDENTIFIER_LENGTH + 1;
+	case BX_INSTR_VLOAD32:
+	case BX_INSTR_VSTORE32:
+	case BX_INSTR_JUMP:
+	case BX_INSTR_JEQZ:
+	case BX_INSTR_JNEZ:
+	case BX_INSTR_JGTZ:
+	case BX_INSTR_JGEZ:
+	case BX_INSTR_JLTZ:
+	case BX_INSTR_JLEZ:
+		return 2;
+	default:
+		return instruction_id > BX_INSTR_LAST ? -1 : 0;
+	}
+}
+
+/**
+ * Checks whether an address is the beginning of an instruction
+ *
+ * @param pcode Program
+ * @param pcode_size Program size
+ * @param address Address to check
+ *
+ * @return BX_BOOLEAN_TRUE if an instruction begins at the address, BX_BOOLEAN_FALSE otherwise
+ */
+static bx_boolean is_instruction_start(bx_uint8 *pcode, bx_size pcode_size, bx_size address) {
+	bx_uint32 current;
+
+	current = 0;
+	while (current < address) {
+		current += 1 + operand_size(pcode[current]);
+	}
+
+	return current == address;
+}
+
 bx_int8 bx_vm_virtual_machine_init() {
+	bx_size i;
 
 	BX_LOG(LOG_INFO, "virtual_machine", "Initializing virtual machine data structures...");
-	vm_status.execution_stack = bx_stack_init(stack_byte_array, VM_STACK_SIZE);
+	for (i = 0; i < VM_CONTEXT_NUMBER; i++) {
+		vm_context_table[i].execution_stack = bx_stack_init(stack_byte_array[i], VM_STACK_SIZE);
+	}
+
+	return 0;
+}
+
+bx_int8 bx_vm_validate(bx_uint8 *pcode, bx_size pcode_size) {
+	bx_uint32 address;
+	bx_uint16 operand;
+	bx_ssize size;
+
+	if (pcode == NULL || pcode_size == 0) {
+		return -1;
+	}
+
+	// Instructions and operands
+	address = 0;
+	while (address < pcode_size) {
+		size = operand_size(pcode[address]);
+		if (size < 0 || address + 1 + size > pcode_size) {
+			return -1;
+		}
+		if (pcode[address] == BX_INSTR_WLOAD32 &&
+				pcode[address + DM_FIELD_IDENTIFIER_LENGTH + 1] >= BX_AGGREGATE_NUMBER) {
+			return -1;
+		}
+		if (size == 2) {
+			BX_MUTILS_BTH_COPY(&operand, pcode + address + 1, 2);
+			if ((pcode[address] == BX_INSTR_VLOAD32 || pcode[address] == BX_INSTR_VSTORE32) &&
+					(bx_uint32) operand * 4 + 4 > VM_VARIABLE_TABLE_SIZE) {
+				return -1;
+			}
+		}
+		address += 1 + size;
+	}
+
+	// Jump targets
+	address = 0;
+	while (address < pcode_size) {
+		size = operand_size(pcode[address]);
+		if (size == 2 && pcode[address] != BX_INSTR_VLOAD32 && pcode[address] != BX_INSTR_VSTORE32) {
+			BX_MUTILS_BTH_COPY(&operand, pcode + address + 1, 2);
+			if (operand >= pcode_size || !is_instruction_start(pcode, pcode_size, operand)) {
+				return -1;
+			}
+		}
+		address += 1 + size;
+	}
 
 	return 0;
 }
 
 bx_int8 bx_vm_execute(bx_uint8 *pcode, bx_size pcode_size) {
+	return bx_vm_execute_in_context(0, pcode, pcode_size);
+}
+
+bx_int8 bx_vm_execute_in_context(bx_uint8 context, bx_uint8 *pcode, bx_size pcode_size) {
 	bx_int8 error;
 	bx_uint8 instruction_id;
+	struct bx_vm_status *vm_status;
+
+	if (context >= VM_CONTEXT_NUMBER) {
+		BX_LOG(LOG_ERROR, "virtual_machine", "Invalid execution context %u", context);
+		return -1;
+	}
+	vm_status = &vm_context_table[context];
 
-	vm_status.pcode = pcode;
-	vm_status.pcode_size = pcode_size;
-	vm_status.program_counter = 0;
-	bx_stack_reset(vm_status.execution_stack);
-	vm_status.stop = BX_BOOLEAN_FALSE;
+	vm_status->pcode = pcode;
+	vm_status->pcode_size = pcode_size;
+	vm_status->program_counter = 0;
+	bx_stack_reset(vm_status->execution_stack);
+	vm_status->stop = BX_BOOLEAN_FALSE;
 
 	do {
-		error = bx_fetch_instruction(&vm_status, &instruction_id);
+		error = bx_fetch_instruction(vm_status, &instruction_id);
 		if (error != 0) {
 			break;
 		}
-		error = instruction_array[instruction_id](&vm_status);
+		error = instruction_array[instruction_id](vm_status);
 		if (error != 0) {
 			break;
 		}
 
-	} while(vm_status.stop == BX_BOOLEAN_FALSE && vm_status.program_counter < vm_status.pcode_size);
+	} while(vm_status->stop == BX_BOOLEAN_FALSE && vm_status->program_counter < vm_status->pcode_size);
 
 	if (error != 0) {
 		BX_LOG(LOG_ERROR, "virtual_machine", "Abnormal virtual machine termination");
@@ -734,6 +882,28 @@ bx_int8 bx_vm_execute(bx_uint8 *pcode, bx_size pcode_size) {
 	return 0;
 }
 
+bx_int8 bx_vm_get_variables(bx_uint8 context, void *variables) {
+
+	if (context >= VM_CONTEXT_NUMBER || variables == NULL) {
+		return -1;
+	}
+
+	memcpy(variables, vm_context_table[context].variable_table, VM_VARIABLE_TABLE_SIZE);
+
+	return 0;
+}
+
+bx_int8 bx_vm_set_variables(bx_uint8 context, const void *variables) {
+
+	if (context >= VM_CONTEXT_NUMBER || variables == NULL) {
+		return -1;
+	}
+
+	memcpy(vm_context_table[context].variable_table, variables, VM_VARIABLE_TABLE_SIZE);
+
+	return 0;
+}
+
 static inline bx_int8 bx_fetch_instruction(struct bx_vm_status *vm_status, bx_uint8 *instruction_id) {
 
 	if (vm_status->program_counter > vm_status->pcode_size) {
@@ -760,6 +930,19 @@ static inline bx_int8 bx_fetch_identifier(struct bx_vm_status *vm_status, void *
 	return 0;
 }
 
+static inline bx_int8 bx_fetch8(struct bx_vm_status *vm_status, void *data) {
+
+	if (vm_status->program_counter + 1 > vm_status->pcode_size) {
+		BX_LOG(LOG_ERROR, "virtual_machine", "Error while fetching 8 bit data: unexpected end of code");
+		return -1;
+	}
+
+	memcpy(data, BYTE_AT_PC(vm_status), 1);
+	vm_status->program_counter += 1;
+
+	return 0;
+}
+
 static inline bx_int8 bx_fetch16(struct bx_vm_status *vm_status, void *data) {
 
 	if (vm_status->program_counter + 2 > vm_status->pcode_size) {
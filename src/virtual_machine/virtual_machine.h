@@ -82,11 +82,68 @@ enum bx_instruction {
 	BX_INSTR_NOP,		// Do nothing
 	BX_INSTR_I2F,		// Convert top stack value from integer to float
 	BX_INSTR_F2I,		// Convert top stack value from float to integer
-	BX_INSTR_HALT		// Halt the execution of the virtual machine
+	BX_INSTR_HALT,		// Halt the execution of the virtual machine
+	// Instructions added after the first release follow HALT, so that compiled pcode keeps its meaning
+	BX_INSTR_WLOAD32	// Load 32 bit window aggregate of a reference on the stack
 };
 
+#define BX_INSTR_LAST BX_INSTR_WLOAD32
+
+/**
+ * Revision of the instruction encoding. It changes whenever an existing
+ * instruction changes number, operands or behaviour, making compiled pcode
+ * unusable; appending instructions after BX_INSTR_LAST does not change it.
+ */
+#define BX_VM_INSTRUCTION_SET 1
+
 bx_int8 bx_vm_virtual_machine_init();
 
 bx_int8 bx_vm_execute(bx_uint8 *pcode, bx_size pcode_size);
 
+/**
+ * Checks that a pcode program only contains valid instructions with complete
+ * operands, variable numbers inside the variable table and jump targets at
+ * the beginning of an instruction. Programs from untrusted sources have to be
+ * validated before being executed.
+ * @param pcode Program to check
+ * @param pcode_size Program size
+ * @return 0 if the program is valid, -1 otherwise
+ */
+bx_int8 bx_vm_validate(bx_uint8 *pcode, bx_size pcode_size);
+
+/**
+ * Executes a pcode program using one of the VM_CONTEXT_NUMBER execution
+ * contexts. Each context owns its stack and variable table, so programs
+ * running in different contexts can be executed concurrently.
+ *
+ * @param context Execution context index
+ * @param pcode Program to execute
+ * @param pcode_size Program size
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_vm_execute_in_context(bx_uint8 context, bx_uint8 *pcode, bx_size pcode_size);
+
+/**
+ * Copies the variable table of an execution context. The variables keep
+ * their values between the executions of the programs using the context.
+ *
+ * @param context Execution context index
+ * @param variables Destination buffer of VM_VARIABLE_TABLE_SIZE bytes
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_vm_get_variables(bx_uint8 context, void *variables);
+
+/**
+ * Replaces the variable table of an execution context. No program may be
+ * executing in the context.
+ *
+ * @param context Execution context index
+ * @param variables Source buffer of VM_VARIABLE_TABLE_SIZE bytes
+ *
+ * @return 0 on success, -1 on failure
+ */
+bx_int8 bx_vm_set_variables(bx_uint8 context, const void *variables);
+
 #endif /* VIRTUAL_MACHINE_H_ */
@@ -83,3 +83,12 @@ bx_int8 bx_vmutils_add_identifier(struct bx_byte_buffer *buffer, char *identifie
 
 	return bx_bbuf_append(buffer, identifier, DM_FIELD_IDENTIFIER_LENGTH);
 }
+
+bx_int8 bx_vmutils_add_byte(struct bx_byte_buffer *buffer, bx_uint8 data) {
+
+	if (buffer == NULL) {
+		return -1;
+	}
+
+	return bx_bbuf_append(buffer, &data, 1);
+}
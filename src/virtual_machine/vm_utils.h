@@ -45,4 +45,6 @@ bx_int8 bx_vmutils_add_float(struct bx_byte_buffer *buffer, bx_float32 data);
 
 bx_int8 bx_vmutils_add_identifier(struct bx_byte_buffer *buffer, char *identifier);
 
+bx_int8 bx_vmutils_add_byte(struct bx_byte_buffer *buffer, bx_uint8 data);
+
 #endif /* VM_UTILS_H_ */
@@ -0,0 +1,278 @@
+/*
+ * test_bus.c
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <string.h>
+#include "test_bus.h"
+#include "bus/bus.h"
+
+static struct bx_interface interfaces[BS_MAX_INTERFACES + 1];
+static bx_uint8 sent_data[BS_MAX_MESSAGE_SIZE];
+static bx_size sent_length;
+static void *sent_endpoint;
+static bx_uint8 send_number;
+static bx_uint8 broadcast_number;
+static bx_uint8 flush_number;
+static bx_uint8 destroy_number;
+static bx_int8 started_id;
+
+static bx_int8 fake_send(struct bx_interface *interface, void *endpoint, void *message, bx_size message_length) {
+	memcpy(sent_data, message, message_length);
+	sent_length = message_length;
+	sent_endpoint = endpoint;
+	send_number++;
+	return 0;
+}
+
+static bx_int8 fake_broadcast(struct bx_interface *interface, void *message, bx_size message_length) {
+	broadcast_number++;
+	return 0;
+}
+
+static bx_int8 fake_flush(struct bx_interface *interface) {
+	flush_number++;
+	return 0;
+}
+
+static void fake_destroy(struct bx_interface *interface) {
+	destroy_number++;
+}
+
+static bx_int8 fake_start(struct bx_interface *interface) {
+	started_id = interface->id;
+	return 0;
+}
+
+static bx_int8 fake_start_failure(struct bx_interface *interface) {
+	return -1;
+}
+
+/**
+ * Initializes the bus and adds a number of fake interfaces
+ *
+ * @param interface_number Number of interfaces to add
+ */
+static void bus_create(bx_uint8 interface_number) {
+	bx_int8 error;
+	bx_uint8 i;
+
+	error = ha_bus_init();
+	ck_assert_int_eq(error, 0);
+	memset(interfaces, 0, sizeof interfaces);
+	send_number = 0;
+	broadcast_number = 0;
+	flush_number = 0;
+	destroy_number = 0;
+	for (i = 0; i < interface_number; i++) {
+		interfaces[i].send = fake_send;
+		interfaces[i].flush = fake_flush;
+		interfaces[i].destroy = fake_destroy;
+		error = ha_bus_add_interface(&interfaces[i]);
+		ck_assert_int_eq(error, i);
+		ck_assert_int_eq(interfaces[i].id, i);
+	}
+}
+
+START_TEST (add_interface_test) {
+	bx_int8 error;
+
+	bus_create(BS_MAX_INTERFACES);
+
+	interfaces[BS_MAX_INTERFACES].send = fake_send;
+	error = ha_bus_add_interface(&interfaces[BS_MAX_INTERFACES]);
+	ck_assert_int_eq(error, -1);
+	error = ha_bus_add_interface(NULL);
+	ck_assert_int_eq(error, -1);
+
+	error = ha_bus_destroy();
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(destroy_number, BS_MAX_INTERFACES);
+
+	// Interfaces are started once their identifier is assigned
+	bus_create(1);
+	started_id = -1;
+	interfaces[1].send = fake_send;
+	interfaces[1].start = fake_start;
+	error = ha_bus_add_interface(&interfaces[1]);
+	ck_assert_int_eq(error, 1);
+	ck_assert_int_eq(started_id, 1);
+
+	// An interface that cannot start is not added
+	interfaces[2].send = fake_send;
+	interfaces[2].start = fake_start_failure;
+	error = ha_bus_add_interface(&interfaces[2]);
+	ck_assert_int_eq(error, -1);
+	ck_assert_int_eq(interfaces[2].id, -1);
+	interfaces[2].start = NULL;
+	error = ha_bus_add_interface(&interfaces[2]);
+	ck_assert_int_eq(error, 2);
+
+	error = ha_bus_destroy();
+	ck_assert_int_eq(error, 0);
+}
+END_TEST
+
+START_TEST (send_test) {
+	bx_uint32 endpoint;
+	bx_uint8 message[BS_MAX_MESSAGE_SIZE + 1];
+	bx_int8 error;
+
+	bus_create(2);
+	interfaces[1].broadcast = fake_broadcast;
+	memset(message, 7, sizeof message);
+	endpoint = 42;
+
+	error = ha_bus_send(1, &endpoint, message, 10);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(send_number, 1);
+	ck_assert_int_eq(sent_length, 10);
+	ck_assert_ptr_eq(sent_endpoint, &endpoint);
+	ck_assert_int_eq(sent_data[9], 7);
+
+	error = ha_bus_send(2, &endpoint, message, 10);
+	ck_assert_int_eq(error, -1);
+	error = ha_bus_send(-1, &endpoint, message, 10);
+	ck_assert_int_eq(error, -1);
+	error = ha_bus_send(0, &endpoint, message, BS_MAX_MESSAGE_SIZE + 1);
+	ck_assert_int_eq(error, -1);
+	ck_assert_int_eq(send_number, 1);
+
+	// Interfaces without a broadcast hook are skipped
+	error = ha_bus_broadcast(message, 10);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(broadcast_number, 1);
+
+	error = ha_bus_flush();
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(flush_number, 2);
+
+	ha_bus_destroy();
+}
+END_TEST
+
+START_TEST (receive_test) {
+	struct bx_bus_message *message;
+	bx_uint64 endpoint[BS_ENDPOINT_SIZE / 8];
+	bx_uint8 data;
+	bx_int8 error;
+
+	bus_create(2);
+	memset(endpoint, 0, sizeof endpoint);
+
+	message = ha_bus_receive();
+	ck_assert_ptr_eq(message, NULL);
+
+	for (data = 0; data < 4; data++) {
+		endpoint[0] = data;
+		error = ha_bus_receive_callback(&interfaces[data % 2], endpoint, &data, 1);
+		ck_assert_int_eq(error, 0);
+	}
+
+	// Messages are received in delivery order
+	for (data = 0; data < 4; data++) {
+		message = ha_bus_receive();
+		ck_assert_ptr_ne(message, NULL);
+		ck_assert_ptr_eq(message->interface, &interfaces[data % 2]);
+		ck_assert_int_eq(message->endpoint[0], data);
+		ck_assert_int_eq(message->length, 1);
+		ck_assert_int_eq(message->data[0], data);
+		ha_bus_release(message);
+	}
+	message = ha_bus_receive();
+	ck_assert_ptr_eq(message, NULL);
+
+	ha_bus_destroy();
+}
+END_TEST
+
+START_TEST (pool_test) {
+	struct bx_bus_message *message;
+	struct bx_bus_message *buffer;
+	bx_uint64 endpoint[BS_ENDPOINT_SIZE / 8];
+	bx_uint8 data;
+	bx_int8 error;
+	bx_size i;
+
+	bus_create(2);
+	memset(endpoint, 0, sizeof endpoint);
+	data = 1;
+
+	for (i = 0; i < BS_INTERFACE_MESSAGES; i++) {
+		error = ha_bus_receive_callback(&interfaces[0], endpoint, &data, 1);
+		ck_assert_int_eq(error, 0);
+	}
+
+	// The pool of the first interface is exhausted, the second one is not affected
+	error = ha_bus_receive_callback(&interfaces[0], endpoint, &data, 1);
+	ck_assert_int_eq(error, -1);
+	buffer = ha_bus_get_buffer(&interfaces[0]);
+	ck_assert_ptr_eq(buffer, NULL);
+	buffer = ha_bus_get_buffer(&interfaces[1]);
+	ck_assert_ptr_ne(buffer, NULL);
+	buffer->length = 0;
+	ha_bus_deliver(buffer);
+
+	// Released messages return to the pool of their interface
+	message = ha_bus_receive();
+	ck_assert_ptr_ne(message, NULL);
+	ha_bus_release(message);
+	error = ha_bus_receive_callback(&interfaces[0], endpoint, &data, 1);
+	ck_assert_int_eq(error, 0);
+
+	error = ha_bus_receive_callback(&interfaces[1], endpoint, &data, BS_MAX_MESSAGE_SIZE + 1);
+	ck_assert_int_eq(error, -1);
+
+	ha_bus_destroy();
+}
+END_TEST
+
+Suite *test_bus_create_suite(void) {
+	Suite *suite = suite_create("bus");
+	TCase *tcase;
+
+	tcase = tcase_create("add_interface_test");
+	tcase_add_test(tcase, add_interface_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("send_test");
+	tcase_add_test(tcase, send_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("receive_test");
+	tcase_add_test(tcase, receive_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("pool_test");
+	tcase_add_test(tcase, pool_test);
+	suite_add_tcase(suite, tcase);
+
+	return suite;
+}
@@ -0,0 +1,405 @@
+/*
+ * test_datagram_interface.c
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "test_datagram_interface.h"
+#include "bus/bus.h"
+#include "bus/datagram_interface.h"
+
+#define WAIT_ATTEMPTS 2000
+#define WAIT_USEC 1000
+
+static struct bx_interface interfaces[3];
+static struct bx_dgram_endpoint locals[3];
+
+/**
+ * Initializes the bus with a number of UDP interfaces bound to free
+ * loopback ports
+ *
+ * @param interface_number Number of interfaces
+ */
+static void udp_create(bx_uint8 interface_number) {
+	bx_int8 error;
+	bx_uint8 i;
+
+	error = ha_bus_init();
+	ck_assert_int_eq(error, 0);
+	for (i = 0; i < interface_number; i++) {
+		bx_dgram_udp_endpoint(&locals[i], 0);
+		error = bx_dgram_init(&interfaces[i], &locals[i]);
+		ck_assert_int_eq(error, 0);
+		error = bx_dgram_get_local(&interfaces[i], &locals[i]);
+		ck_assert_int_eq(error, 0);
+		error = ha_bus_add_interface(&interfaces[i]);
+		ck_assert_int_eq(error, i);
+	}
+}
+
+/**
+ * Initializes the bus with a number of Unix domain socket interfaces
+ *
+ * @param interface_number Number of interfaces
+ */
+static void unix_create(bx_uint8 interface_number) {
+	char path[64];
+	bx_int8 error;
+	bx_uint8 i;
+
+	error = ha_bus_init();
+	ck_assert_int_eq(error, 0);
+	for (i = 0; i < interface_number; i++) {
+		snprintf(path, sizeof path, "/tmp/bx_test_bus_%d_%u", getpid(), i);
+		error = bx_dgram_unix_endpoint(&locals[i], path);
+		ck_assert_int_eq(error, 0);
+		error = bx_dgram_init(&interfaces[i], &locals[i]);
+		ck_assert_int_eq(error, 0);
+		error = ha_bus_add_interface(&interfaces[i]);
+		ck_assert_int_eq(error, i);
+	}
+}
+
+/**
+ * Waits for a message to be delivered into the inbox
+ *
+ * @return Received message, NULL on timeout
+ */
+static struct bx_bus_message *receive_wait() {
+	struct bx_bus_message *message;
+	bx_uint32 i;
+
+	for (i = 0; i < WAIT_ATTEMPTS; i++) {
+		message = ha_bus_receive();
+		if (message != NULL) {
+			return message;
+		}
+		usleep(WAIT_USEC);
+	}
+	return NULL;
+}
+
+/**
+ * Sends a message, waiting while the batch of the interface is full
+ *
+ * @return Result of the last attempt
+ */
+static bx_int8 send_wait(bx_int8 interface_id, void *endpoint, void *message, bx_size message_length) {
+	bx_uint32 i;
+	bx_int8 error;
+
+	error = -1;
+	for (i = 0; i < WAIT_ATTEMPTS && error != 0; i++) {
+		error = ha_bus_send(interface_id, endpoint, message, message_length);
+		if (error != 0) {
+			usleep(WAIT_USEC);
+		}
+	}
+	return error;
+}
+
+/**
+ * Returns the monotonic time in milliseconds
+ */
+static bx_uint64 time_msec() {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (bx_uint64) now.tv_sec * 1000 + now.tv_nsec / (1000 * 1000);
+}
+
+/**
+ * Returns the port of a UDP endpoint in host byte order
+ */
+static bx_uint16 endpoint_port(void *endpoint) {
+	return ntohs(((struct sockaddr_in *) &((struct bx_dgram_endpoint *) endpoint)->address)->sin_port);
+}
+
+/**
+ * Returns the path of a Unix domain socket endpoint
+ */
+static char *endpoint_path(void *endpoint) {
+	return ((struct sockaddr_un *) &((struct bx_dgram_endpoint *) endpoint)->address)->sun_path;
+}
+
+START_TEST (udp_test) {
+	struct bx_bus_message *message;
+	bx_uint32 data;
+	bx_int8 error;
+
+	udp_create(2);
+	ck_assert_int_ne(endpoint_port(&locals[1]), 0);
+
+	data = 0xCAFE;
+	error = ha_bus_send(0, &locals[1], &data, sizeof data);
+	ck_assert_int_eq(error, 0);
+	error = ha_bus_flush();
+	ck_assert_int_eq(error, 0);
+
+	message = receive_wait();
+	ck_assert_ptr_ne(message, NULL);
+	ck_assert_ptr_eq(message->interface, &interfaces[1]);
+	ck_assert_int_eq(message->length, sizeof data);
+	ck_assert_int_eq(*(bx_uint32 *) message->data, 0xCAFE);
+	ck_assert_int_eq(endpoint_port(message->endpoint), endpoint_port(&locals[0]));
+
+	// Reply to the sender of the message
+	data = 0xBEEF;
+	error = ha_bus_send(1, message->endpoint, &data, sizeof data);
+	ck_assert_int_eq(error, 0);
+	ha_bus_release(message);
+
+	// Without an explicit flush the batch is sent by the receiving thread
+	message = receive_wait();
+	ck_assert_ptr_ne(message, NULL);
+	ck_assert_ptr_eq(message->interface, &interfaces[0]);
+	ck_assert_int_eq(*(bx_uint32 *) message->data, 0xBEEF);
+	ck_assert_int_eq(endpoint_port(message->endpoint), endpoint_port(&locals[1]));
+	ha_bus_release(message);
+
+	error = ha_bus_send(0, &locals[1], &data, BS_MAX_MESSAGE_SIZE + 1);
+	ck_assert_int_eq(error, -1);
+	error = ha_bus_send(0, NULL, &data, sizeof data);
+	ck_assert_int_eq(error, -1);
+
+	ck_assert_int_eq(bx_dgram_get_dropped(&interfaces[0]), 0);
+	ck_assert_int_eq(bx_dgram_get_dropped(&interfaces[1]), 0);
+	ha_bus_destroy();
+}
+END_TEST
+
+START_TEST (batch_test) {
+	struct bx_bus_message *message;
+	bx_uint8 data[BS_MAX_MESSAGE_SIZE];
+	bx_uint32 count;
+	bx_uint32 i;
+	bx_int8 error;
+
+	unix_create(2);
+	count = 3 * BS_BATCH_SIZE + 1;
+	memset(data, 0, sizeof data);
+
+	// The queue of a Unix socket is shorter than a batch: the sender retries
+	for (i = 0; i < count; i++) {
+		data[0] = i;
+		data[BS_MAX_MESSAGE_SIZE - 1] = i;
+		error = send_wait(0, &locals[1], data, BS_MAX_MESSAGE_SIZE);
+		ck_assert_int_eq(error, 0);
+	}
+
+	// Messages arrive in order, full batches and the pending one alike
+	for (i = 0; i < count; i++) {
+		message = receive_wait();
+		ck_assert_ptr_ne(message, NULL);
+		ck_assert_ptr_eq(message->interface, &interfaces[1]);
+		ck_assert_int_eq(message->length, BS_MAX_MESSAGE_SIZE);
+		ck_assert_int_eq(message->data[0], i);
+		ck_assert_int_eq(message->data[BS_MAX_MESSAGE_SIZE - 1], i);
+		ck_assert_int_eq(strcmp(endpoint_path(message->endpoint), endpoint_path(&locals[0])), 0);
+		ha_bus_release(message);
+	}
+	message = ha_bus_receive();
+	ck_assert_ptr_eq(message, NULL);
+	ck_assert_int_eq(bx_dgram_get_dropped(&interfaces[0]), 0);
+
+	ha_bus_destroy();
+	ck_assert_int_ne(access(endpoint_path(&locals[0]), F_OK), 0);
+}
+END_TEST
+
+START_TEST (blocked_peer_test) {
+	struct bx_dgram_endpoint peer;
+	struct bx_bus_message *message;
+	char path[64];
+	bx_uint8 data[BS_MAX_MESSAGE_SIZE];
+	bx_uint64 start;
+	bx_uint32 refused;
+	bx_uint32 i;
+	bx_int8 error;
+	int fd;
+
+	// A peer that never reads its socket
+	snprintf(path, sizeof path, "/tmp/bx_test_bus_%d_peer", getpid());
+	unlink(path);
+	error = bx_dgram_unix_endpoint(&peer, path);
+	ck_assert_int_eq(error, 0);
+	fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+	ck_assert_int_ge(fd, 0);
+	ck_assert_int_eq(bind(fd, (struct sockaddr *) &peer.address, peer.length), 0);
+	unix_create(2);
+
+	// Senders are never blocked: messages are refused once the batch is full
+	memset(data, 0, sizeof data);
+	refused = 0;
+	start = time_msec();
+	for (i = 0; i < 4 * BS_BATCH_SIZE; i++) {
+		if (ha_bus_send(0, &peer, data, BS_MAX_MESSAGE_SIZE) != 0) {
+			refused++;
+		}
+	}
+	ha_bus_flush();
+	ck_assert_int_lt(time_msec() - start, 5 * BS_SEND_TIMEOUT_MSEC);
+	ck_assert_int_gt(refused, 0);
+
+	// Messages waiting for the peer do not delay the other destinations
+	data[0] = 0x42;
+	error = send_wait(0, &locals[1], data, sizeof data);
+	ck_assert_int_eq(error, 0);
+	message = receive_wait();
+	ck_assert_ptr_ne(message, NULL);
+	ck_assert_int_eq(message->data[0], 0x42);
+	ha_bus_release(message);
+
+	// Messages still waiting after BS_SEND_TIMEOUT_MSEC are dropped
+	for (i = 0; i < WAIT_ATTEMPTS && bx_dgram_get_dropped(&interfaces[0]) == 0; i++) {
+		usleep(WAIT_USEC);
+	}
+	ck_assert_int_gt(bx_dgram_get_dropped(&interfaces[0]), 0);
+	error = ha_bus_send(0, &peer, data, BS_MAX_MESSAGE_SIZE);
+	ck_assert_int_eq(error, 0);
+
+	ha_bus_destroy();
+	close(fd);
+	unlink(path);
+}
+END_TEST
+
+START_TEST (broadcast_test) {
+	struct bx_bus_message *message;
+	bx_boolean received[3];
+	bx_uint32 data;
+	bx_int8 error;
+	bx_uint8 i;
+
+	unix_create(3);
+	error = bx_dgram_add_peer(&interfaces[0], &locals[1]);
+	ck_assert_int_eq(error, 0);
+	error = bx_dgram_add_peer(&interfaces[0], &locals[2]);
+	ck_assert_int_eq(error, 0);
+
+	data = 0xF00D;
+	error = ha_bus_broadcast(&data, sizeof data);
+	ck_assert_int_eq(error, 0);
+	error = ha_bus_flush();
+	ck_assert_int_eq(error, 0);
+
+	memset(received, 0, sizeof received);
+	for (i = 0; i < 2; i++) {
+		message = receive_wait();
+		ck_assert_ptr_ne(message, NULL);
+		ck_assert_int_eq(*(bx_uint32 *) message->data, 0xF00D);
+		received[message->interface->id] = BX_BOOLEAN_TRUE;
+		ha_bus_release(message);
+	}
+	ck_assert_int_eq(received[0], BX_BOOLEAN_FALSE);
+	ck_assert_int_eq(received[1], BX_BOOLEAN_TRUE);
+	ck_assert_int_eq(received[2], BX_BOOLEAN_TRUE);
+
+	ha_bus_destroy();
+}
+END_TEST
+
+START_TEST (drop_test) {
+	struct bx_bus_message *messages[BS_INTERFACE_MESSAGES];
+	struct bx_bus_message *message;
+	bx_uint32 data;
+	bx_uint32 i;
+	bx_int8 error;
+
+	udp_create(2);
+
+	// Messages received while the pool is exhausted are dropped
+	for (i = 0; i < BS_INTERFACE_MESSAGES + 5; i++) {
+		data = i;
+		error = ha_bus_send(0, &locals[1], &data, sizeof data);
+		ck_assert_int_eq(error, 0);
+	}
+	ha_bus_flush();
+
+	for (i = 0; i < BS_INTERFACE_MESSAGES; i++) {
+		messages[i] = receive_wait();
+		ck_assert_ptr_ne(messages[i], NULL);
+		ck_assert_int_eq(*(bx_uint32 *) messages[i]->data, i);
+	}
+	for (i = 0; i < WAIT_ATTEMPTS && bx_dgram_get_dropped(&interfaces[1]) < 5; i++) {
+		usleep(WAIT_USEC);
+	}
+	ck_assert_int_eq(bx_dgram_get_dropped(&interfaces[1]), 5);
+	message = ha_bus_receive();
+	ck_assert_ptr_eq(message, NULL);
+
+	// Released messages are used again
+	for (i = 0; i < BS_INTERFACE_MESSAGES; i++) {
+		ha_bus_release(messages[i]);
+	}
+	data = 0xABCD;
+	error = ha_bus_send(0, &locals[1], &data, sizeof data);
+	ck_assert_int_eq(error, 0);
+	message = receive_wait();
+	ck_assert_ptr_ne(message, NULL);
+	ck_assert_int_eq(*(bx_uint32 *) message->data, 0xABCD);
+	ha_bus_release(message);
+
+	ha_bus_destroy();
+}
+END_TEST
+
+Suite *test_datagram_interface_create_suite(void) {
+	Suite *suite = suite_create("datagram_interface");
+	TCase *tcase;
+
+	tcase = tcase_create("udp_test");
+	tcase_add_test(tcase, udp_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("batch_test");
+	tcase_add_test(tcase, batch_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("blocked_peer_test");
+	tcase_add_test(tcase, blocked_peer_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("broadcast_test");
+	tcase_add_test(tcase, broadcast_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("drop_test");
+	tcase_add_test(tcase, drop_test);
+	suite_add_tcase(suite, tcase);
+
+	return suite;
+}
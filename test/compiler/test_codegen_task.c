@@ -30,6 +30,7 @@
  */
 
 #include "test_codegen_task.h"
+#include "configuration.h"
 #include "utils/linked_list.h"
 #include "compiler/codegen_expression.h"
 #include "compiler/codegen_task.h"
@@ -57,7 +58,34 @@ START_TEST (on_execution_condition) {
 } END_TEST
 
 START_TEST (every_execution_condition) {
-	//TODO: Stub
+	bx_int8 error;
+
+	error = bx_cgtk_add_every_execution_condition(task, bx_cgex_create_int_constant(0));
+	ck_assert_int_eq(error, -1);
+	ck_assert_ptr_eq(task->every_execution_condition, NULL);
+	error = bx_cgtk_add_every_execution_condition(task, bx_cgex_create_int_constant(500));
+	ck_assert_int_eq(error, 0);
+	ck_assert_ptr_ne(task->every_execution_condition, NULL);
+	error = bx_cgtk_add_every_execution_condition(task, bx_cgex_create_int_constant(500));
+	ck_assert_int_eq(error, -1);
+} END_TEST
+
+START_TEST (scheduling_annotations) {
+	bx_int8 error;
+
+	ck_assert_int_eq(task->priority, EV_PRIORITY_LEVELS - 1);
+	ck_assert_int_eq(task->deadline_msec, 0);
+	error = bx_cgtk_set_priority(task, 0);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(task->priority, 0);
+	error = bx_cgtk_set_priority(task, EV_PRIORITY_LEVELS);
+	ck_assert_int_eq(error, -1);
+	ck_assert_int_eq(task->priority, 0);
+	error = bx_cgtk_set_deadline(task, 250);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(task->deadline_msec, 250);
+	error = bx_cgtk_set_deadline(task, 0);
+	ck_assert_int_eq(error, -1);
 } END_TEST
 
 START_TEST (create_child_task) {
@@ -102,6 +130,10 @@ Suite *test_codegen_task_create_suite(void) {
 	tcase_add_test(tcase, every_execution_condition);
 	suite_add_tcase(suite, tcase);
 
+	tcase = tcase_create("scheduling_annotations");
+	tcase_add_test(tcase, scheduling_annotations);
+	suite_add_tcase(suite, tcase);
+
 	tcase = tcase_create("create_child_task");
 	tcase_add_test(tcase, create_child_task);
 	suite_add_tcase(suite, tcase);
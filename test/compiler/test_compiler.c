@@ -448,6 +448,23 @@ START_TEST (automatic_variable) {
 	ck_assert_int_eq(bx_tfield_get_int(&int_output_test_field), 5);
 } END_TEST
 
+START_TEST (scheduling_annotation_test) {
+	int parse_result;
+	struct bx_comp_task *main_task;
+	char *program = "priority 1; deadline 50; field int test; test = 5;";
+
+	main_task = bx_cgtk_create_task();
+	init_parser(main_task);
+	yyin = fmemopen(program, strlen(program), "r");
+	ck_assert_ptr_ne(yyin, NULL);
+	parse_result = yyparse();
+	ck_assert_int_eq(parse_result, 0);
+	fclose(yyin);
+	ck_assert_int_eq(main_task->priority, 1);
+	ck_assert_int_eq(main_task->deadline_msec, 50);
+	bx_cgtk_destroy_task(main_task);
+} END_TEST
+
 Suite *test_compiler_create_suite(void) {
 	Suite *suite = suite_create("copmiler");
 	TCase *tcase;
@@ -504,5 +521,9 @@ Suite *test_compiler_create_suite(void) {
 	tcase_add_test(tcase, automatic_variable);
 	suite_add_tcase(suite, tcase);
 
+	tcase = tcase_create("scheduling_annotation_test");
+	tcase_add_test(tcase, scheduling_annotation_test);
+	suite_add_tcase(suite, tcase);
+
 	return suite;
 }
@@ -29,12 +29,18 @@
  *
  */
 
+#include <stdio.h>
+#include <pthread.h>
+#include <string.h>
 #include "test_document_manager.h"
 #include "document_manager/document_manager.h"
 #include "document_manager/test_field.h"
 
 #define FIELD_ID1 "test_field_1"
 #define FIELD_ID2 "test_field_2"
+#define INDEX_FIELD_NUMBER 256
+#define SNAPSHOT_WRITES 10000
+#define WIDE_WORDS 4
 
 static struct bx_document_field test_field1;
 static struct bx_test_field_data test_field_data1;
@@ -111,6 +117,276 @@ START_TEST (get_field_value) {
 	ck_assert_int_eq(out_value, bx_tfield_get_int(&test_field2));
 } END_TEST
 
+START_TEST (index_test) {
+	static struct bx_document_field fields[INDEX_FIELD_NUMBER];
+	static struct bx_test_field_data field_data[INDEX_FIELD_NUMBER];
+	char identifier[DM_FIELD_IDENTIFIER_LENGTH + 1];
+	bx_int32 out_value;
+	bx_int8 error;
+	bx_size i;
+
+	// Fields with distinct identifiers are found through the index
+	for (i = 0; i < INDEX_FIELD_NUMBER; i++) {
+		bx_tfield_init(&fields[i], &field_data[i]);
+		bx_tfield_set_int(&fields[i], i);
+		snprintf(identifier, sizeof identifier, "index_field_%u", i);
+		error = bx_docman_add_field(&fields[i], identifier);
+		ck_assert_int_eq(error, 0);
+	}
+	for (i = 0; i < INDEX_FIELD_NUMBER; i++) {
+		snprintf(identifier, sizeof identifier, "index_field_%u", i);
+		error = bx_docman_invoke_get(identifier, &out_value);
+		ck_assert_int_eq(error, 0);
+		ck_assert_int_eq(out_value, i);
+		error = bx_docman_add_field(&fields[i], identifier);
+		ck_assert_int_eq(error, -1);
+	}
+	error = bx_docman_invoke_get("index_field_x", &out_value);
+	ck_assert_int_eq(error, -1);
+
+	// Identifiers are compared on DM_FIELD_IDENTIFIER_LENGTH characters
+	memset(identifier, 'a', DM_FIELD_IDENTIFIER_LENGTH);
+	identifier[DM_FIELD_IDENTIFIER_LENGTH] = '\0';
+	error = bx_docman_add_field(&fields[0], identifier);
+	ck_assert_int_eq(error, 0);
+	error = bx_docman_invoke_get(identifier, &out_value);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(out_value, 0);
+} END_TEST
+
+START_TEST (plain_field_test) {
+	static struct bx_field_storage storage;
+	struct bx_document_field plain_field;
+	bx_int32 value;
+	bx_int8 error;
+
+	error = bx_docman_init_plain_field(&plain_field, BX_INT, &storage);
+	ck_assert_int_eq(error, 0);
+	error = bx_docman_add_field(&plain_field, "plain_field");
+	ck_assert_int_eq(error, 0);
+	ck_assert_ptr_eq(bx_docman_get_storage("plain_field"), &storage);
+	ck_assert_ptr_eq(bx_docman_get_storage(FIELD_ID1), NULL);
+	ck_assert_ptr_eq(bx_docman_get_storage("missing_field"), NULL);
+
+	// Plain fields are also accessible through the generic functions
+	value = 17;
+	error = bx_docman_invoke_set("plain_field", &value);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(storage.value, 17);
+	storage.value = 23;
+	error = bx_docman_invoke_get("plain_field", &value);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(value, 23);
+} END_TEST
+
+static struct bx_field_storage first_storage;
+static struct bx_field_storage second_storage;
+
+static void *pair_writer_routine(void *arg) {
+	bx_ssize handles[2];
+	bx_uint32 values[2];
+	bx_uint32 i;
+
+	handles[0] = bx_docman_get_handle("first_pair");
+	handles[1] = bx_docman_get_handle("second_pair");
+	for (i = 1; i <= SNAPSHOT_WRITES; i++) {
+		values[0] = values[1] = i;
+		bx_docman_set_many(handles, 2, values);
+	}
+
+	return NULL;
+}
+
+START_TEST (batch_test) {
+	struct bx_document_field first_field;
+	struct bx_document_field second_field;
+	bx_ssize handles[3];
+	bx_uint32 values[3];
+	bx_uint32 epoch;
+	bx_uint32 next_epoch;
+	bx_int8 error;
+
+	bx_docman_init_plain_field(&first_field, BX_INT, &first_storage);
+	bx_docman_init_plain_field(&second_field, BX_INT, &second_storage);
+	ck_assert_int_eq(bx_docman_add_field(&first_field, "first_pair"), 0);
+	ck_assert_int_eq(bx_docman_add_field(&second_field, "second_pair"), 0);
+
+	handles[0] = bx_docman_get_handle(FIELD_ID1);
+	handles[1] = bx_docman_get_handle("first_pair");
+	handles[2] = bx_docman_get_handle("second_pair");
+	ck_assert_int_ge(handles[0], 0);
+	ck_assert_int_ne(handles[1], handles[0]);
+	ck_assert_int_ne(handles[2], handles[1]);
+	ck_assert_int_eq(bx_docman_get_handle("missing_field"), -1);
+
+	// Computed and plain fields are accessed in a single call
+	values[0] = 5;
+	values[1] = 6;
+	values[2] = 7;
+	error = bx_docman_set_many(handles, 3, values);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(bx_tfield_get_int(&test_field1), 5);
+	ck_assert_int_eq(first_storage.value, 6);
+	ck_assert_int_eq(second_storage.value, 7);
+	values[0] = values[1] = values[2] = 0;
+	error = bx_docman_get_many(handles, 3, values);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(values[0], 5);
+	ck_assert_int_eq(values[1], 6);
+	ck_assert_int_eq(values[2], 7);
+
+	// Each write advances the update epoch
+	error = bx_docman_get_snapshot(handles, 3, values, &epoch);
+	ck_assert_int_eq(error, 0);
+	bx_docman_write_storage(&first_storage, 8);
+	error = bx_docman_get_snapshot(handles, 3, values, &next_epoch);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(next_epoch, epoch + 1);
+	ck_assert_int_eq(values[1], 8);
+
+	handles[1] = DM_MAX_FIELD_NUMBER;
+	ck_assert_int_eq(bx_docman_get_many(handles, 3, values), -1);
+	ck_assert_int_eq(bx_docman_set_many(handles, 3, values), -1);
+	ck_assert_int_eq(bx_docman_get_snapshot(handles, 3, values, NULL), -1);
+} END_TEST
+
+START_TEST (snapshot_test) {
+	pthread_t writer;
+	bx_ssize handles[2];
+	bx_uint32 values[2];
+	bx_uint32 snapshots;
+
+	bx_docman_write_storage(&first_storage, 0);
+	bx_docman_write_storage(&second_storage, 0);
+	handles[0] = bx_docman_get_handle("first_pair");
+	handles[1] = bx_docman_get_handle("second_pair");
+	ck_assert_int_eq(pthread_create(&writer, NULL, pair_writer_routine, NULL), 0);
+
+	// Snapshots never observe a pair half written
+	snapshots = 0;
+	do {
+		if (bx_docman_get_snapshot(handles, 2, values, NULL) == 0) {
+			ck_assert_int_eq(values[0], values[1]);
+			snapshots++;
+		}
+	} while (snapshots == 0 || values[0] != SNAPSHOT_WRITES || values[1] != SNAPSHOT_WRITES);
+
+	ck_assert_int_eq(pthread_join(writer, NULL), 0);
+} END_TEST
+
+static void *single_writer_routine(void *arg) {
+	bx_uint32 i;
+
+	for (i = 1; i <= SNAPSHOT_WRITES; i++) {
+		bx_docman_write_storage(&first_storage, i);
+	}
+
+	return NULL;
+}
+
+START_TEST (versioned_test) {
+	pthread_t writer;
+	bx_ssize handle;
+	bx_uint32 value;
+	bx_uint32 version;
+	bx_uint32 base_version;
+	bx_uint32 last_version;
+	bx_int32 int_value;
+
+	// Computed fields are versioned too
+	handle = bx_docman_get_handle(FIELD_ID1);
+	ck_assert_int_eq(bx_docman_get_versioned(handle, &value, &base_version), 0);
+	int_value = 11;
+	ck_assert_int_eq(bx_docman_invoke_set(FIELD_ID1, &int_value), 0);
+	ck_assert_int_eq(bx_docman_get_versioned(handle, &value, &version), 0);
+	ck_assert_int_eq(value, 11);
+	ck_assert_int_eq(version, base_version + 1);
+	ck_assert_int_eq(bx_docman_get_versioned(-1, &value, &version), -1);
+
+	// Readers observe the value matching its version while it is written
+	bx_docman_write_storage(&first_storage, 0);
+	handle = bx_docman_get_handle("first_pair");
+	ck_assert_int_eq(bx_docman_get_versioned(handle, &value, &base_version), 0);
+	ck_assert_int_eq(pthread_create(&writer, NULL, single_writer_routine, NULL), 0);
+	last_version = base_version;
+	do {
+		ck_assert_int_eq(bx_docman_get_versioned(handle, &value, &version), 0);
+		ck_assert_int_ge(version, last_version);
+		ck_assert_int_eq(value, version - base_version);
+		last_version = version;
+	} while (value != SNAPSHOT_WRITES);
+	ck_assert_int_eq(pthread_join(writer, NULL), 0);
+} END_TEST
+
+static bx_uint32 wide_value[WIDE_WORDS];
+
+static bx_int8 wide_field_get(struct bx_document_field *instance, void *data) {
+	bx_uint32 *words = (bx_uint32 *) data;
+	bx_uint32 i;
+
+	for (i = 0; i < WIDE_WORDS; i++) {
+		words[i] = wide_value[i];
+	}
+
+	return 0;
+}
+
+static bx_int8 wide_field_set(struct bx_document_field *instance, void *data) {
+	bx_uint32 *words = (bx_uint32 *) data;
+	bx_uint32 i;
+
+	for (i = 0; i < WIDE_WORDS; i++) {
+		wide_value[i] = words[i];
+	}
+
+	return 0;
+}
+
+static void *wide_writer_routine(void *arg) {
+	bx_uint32 words[WIDE_WORDS];
+	bx_uint32 i;
+	bx_uint32 j;
+
+	for (i = 1; i <= SNAPSHOT_WRITES; i++) {
+		for (j = 0; j < WIDE_WORDS; j++) {
+			words[j] = i;
+		}
+		bx_docman_invoke_set("wide_field", words);
+	}
+
+	return NULL;
+}
+
+START_TEST (computed_test) {
+	static struct bx_document_field field;
+	pthread_t writer;
+	bx_uint32 words[WIDE_WORDS];
+	bx_uint32 i;
+
+	field.type = BX_STRING;
+	field.private_data = NULL;
+	field.get = &wide_field_get;
+	field.set = &wide_field_set;
+	ck_assert_int_eq(bx_docman_add_field(&field, "wide_field"), 0);
+
+	// The getter fills the whole buffer of the caller
+	memset(words, 0xFF, sizeof(words));
+	ck_assert_int_eq(bx_docman_invoke_get("wide_field", words), 0);
+	for (i = 0; i < WIDE_WORDS; i++) {
+		ck_assert_int_eq(words[i], 0);
+	}
+
+	// The callbacks never overlap, so no torn value is observed
+	ck_assert_int_eq(pthread_create(&writer, NULL, wide_writer_routine, NULL), 0);
+	do {
+		ck_assert_int_eq(bx_docman_invoke_get("wide_field", words), 0);
+		for (i = 1; i < WIDE_WORDS; i++) {
+			ck_assert_int_eq(words[i], words[0]);
+		}
+	} while (words[0] != SNAPSHOT_WRITES);
+	ck_assert_int_eq(pthread_join(writer, NULL), 0);
+} END_TEST
+
 Suite *test_document_manager_create_suite() {
 	Suite *suite = suite_create("document_manager");
 	TCase *tcase;
@@ -143,5 +419,29 @@ Suite *test_document_manager_create_suite() {
 	tcase_add_test(tcase, get_field_value);
 	suite_add_tcase(suite, tcase);
 
+	tcase = tcase_create("plain_field_test");
+	tcase_add_test(tcase, plain_field_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("batch_test");
+	tcase_add_test(tcase, batch_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("snapshot_test");
+	tcase_add_test(tcase, snapshot_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("versioned_test");
+	tcase_add_test(tcase, versioned_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("computed_test");
+	tcase_add_test(tcase, computed_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("index_test");
+	tcase_add_test(tcase, index_test);
+	suite_add_tcase(suite, tcase);
+
 	return suite;
 }
@@ -0,0 +1,251 @@
+/*
+ * test_field_column.c
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "test_field_column.h"
+#include "runtime/critical_section.h"
+#include "document_manager/document_manager.h"
+#include "document_manager/field_column.h"
+
+#define FLOAT_FIELDS 101
+#define COLUMN_WRITES 10000
+
+static struct bx_field_column int_column;
+static struct bx_field_column float_column;
+static struct bx_field_column bool_column;
+
+START_TEST (init_test) {
+	char identifier[DM_FIELD_IDENTIFIER_LENGTH];
+	bx_ssize i;
+
+	ck_assert_int_eq(bx_critical_init(), 0);
+	ck_assert_int_eq(bx_docman_init(), 0);
+
+	ck_assert_int_eq(bx_column_init(&int_column, BX_INT), 0);
+	ck_assert_int_eq(bx_column_init(&float_column, BX_FLOAT), 0);
+	ck_assert_int_eq(bx_column_init(&bool_column, BX_BOOL), 0);
+	ck_assert_int_eq(bx_column_init(&int_column, BX_STRING), -1);
+	ck_assert_int_eq(bx_column_init(NULL, BX_INT), -1);
+
+	ck_assert_int_eq(bx_column_add_field(&int_column, "int_0"), 0);
+	ck_assert_int_eq(bx_column_add_field(&int_column, "int_1"), 1);
+	ck_assert_int_eq(bx_column_add_field(&int_column, "int_2"), 2);
+	ck_assert_int_eq(bx_column_add_field(&bool_column, "bool_0"), 0);
+	for (i = 0; i < FLOAT_FIELDS; i++) {
+		snprintf(identifier, DM_FIELD_IDENTIFIER_LENGTH, "float_%i", (int) i);
+		ck_assert_int_eq(bx_column_add_field(&float_column, identifier), i);
+	}
+
+	// Duplicate identifiers are rejected without using a column entry
+	ck_assert_int_eq(bx_column_add_field(&int_column, "int_0"), -1);
+	ck_assert_int_eq(int_column.size, 3);
+} END_TEST
+
+START_TEST (field_access_test) {
+	bx_uint32 values[DM_COLUMN_CAPACITY];
+	bx_float32 float_value;
+	bx_int32 int_value;
+
+	// Values set through the document manager are stored in the column
+	int_value = -7;
+	ck_assert_int_eq(bx_docman_invoke_set("int_1", &int_value), 0);
+	float_value = 1.5;
+	ck_assert_int_eq(bx_docman_invoke_set("float_3", &float_value), 0);
+	int_value = 5;
+	ck_assert_int_eq(bx_docman_invoke_set("bool_0", &int_value), 0);
+
+	ck_assert_int_eq(bx_column_read(&int_column, values), 3);
+	ck_assert_int_eq((bx_int32) values[1], -7);
+	ck_assert_int_eq(bx_column_read(&bool_column, values), 1);
+	ck_assert_int_eq(values[0], 1);
+
+	float_value = 0;
+	ck_assert_int_eq(bx_docman_invoke_get("float_3", &float_value), 0);
+	ck_assert(float_value == 1.5);
+	int_value = 0;
+	ck_assert_int_eq(bx_docman_invoke_get("int_1", &int_value), 0);
+	ck_assert_int_eq(int_value, -7);
+} END_TEST
+
+START_TEST (threshold_test) {
+	bx_uint8 out_of_range[DM_COLUMN_CAPACITY];
+	bx_float32 float_low;
+	bx_float32 float_high;
+	bx_float32 float_value;
+	bx_int32 int_low;
+	bx_int32 int_high;
+	char identifier[DM_FIELD_IDENTIFIER_LENGTH];
+	bx_ssize i;
+
+	for (i = 0; i < FLOAT_FIELDS; i++) {
+		snprintf(identifier, DM_FIELD_IDENTIFIER_LENGTH, "float_%i", (int) i);
+		float_value = i * 0.5;
+		ck_assert_int_eq(bx_docman_invoke_set(identifier, &float_value), 0);
+	}
+	float_low = 5;
+	float_high = 40;
+	ck_assert_int_eq(bx_column_threshold(&float_column, &float_low, &float_high, out_of_range), 30);
+	for (i = 0; i < FLOAT_FIELDS; i++) {
+		ck_assert_int_eq(out_of_range[i], i < 10 || i > 80);
+	}
+
+	int_low = -5;
+	int_high = 5;
+	ck_assert_int_eq(bx_column_threshold(&int_column, &int_low, &int_high, out_of_range), 1);
+	ck_assert_int_eq(out_of_range[0], 0);
+	ck_assert_int_eq(out_of_range[1], 1);
+	ck_assert_int_eq(out_of_range[2], 0);
+	ck_assert_int_eq(bx_column_threshold(&int_column, NULL, &int_high, out_of_range), -1);
+} END_TEST
+
+START_TEST (min_max_test) {
+	struct bx_field_column empty_column;
+	bx_float32 float_min;
+	bx_float32 float_max;
+	bx_int32 int_min;
+	bx_int32 int_max;
+
+	ck_assert_int_eq(bx_column_min_max(&float_column, &float_min, &float_max), 0);
+	ck_assert(float_min == 0);
+	ck_assert(float_max == 50);
+	float_min = -2.5;
+	ck_assert_int_eq(bx_docman_invoke_set("float_7", &float_min), 0);
+	float_min = -0.25;
+	ck_assert_int_eq(bx_docman_invoke_set("float_8", &float_min), 0);
+	ck_assert_int_eq(bx_column_min_max(&float_column, &float_min, &float_max), 0);
+	ck_assert(float_min == -2.5);
+	ck_assert(float_max == 50);
+
+	int_max = 12;
+	ck_assert_int_eq(bx_docman_invoke_set("int_2", &int_max), 0);
+	ck_assert_int_eq(bx_column_min_max(&int_column, &int_min, &int_max), 0);
+	ck_assert_int_eq(int_min, -7);
+	ck_assert_int_eq(int_max, 12);
+
+	bx_column_init(&empty_column, BX_INT);
+	ck_assert_int_eq(bx_column_min_max(&empty_column, &int_min, &int_max), -1);
+} END_TEST
+
+START_TEST (changes_test) {
+	bx_uint32 previous[DM_COLUMN_CAPACITY];
+	bx_uint8 changed[DM_COLUMN_CAPACITY];
+	bx_float32 float_value;
+	bx_int32 int_value;
+
+	memset(previous, 0, sizeof previous);
+	ck_assert_int_eq(bx_column_changes(&int_column, previous, changed), 2);
+	ck_assert_int_eq(changed[0], 0);
+	ck_assert_int_eq(changed[1], 1);
+	ck_assert_int_eq(changed[2], 1);
+
+	// The previous values are updated, so only new changes are reported
+	ck_assert_int_eq(bx_column_changes(&int_column, previous, changed), 0);
+	int_value = 3;
+	ck_assert_int_eq(bx_docman_invoke_set("int_0", &int_value), 0);
+	ck_assert_int_eq(bx_column_changes(&int_column, previous, changed), 1);
+	ck_assert_int_eq(changed[0], 1);
+	ck_assert_int_eq((bx_int32) previous[0], 3);
+
+	// Values past the last full vector and unaligned previous values
+	memset(previous, 0, sizeof previous);
+	ck_assert_int_eq(bx_column_changes(&float_column, previous + 1, changed), FLOAT_FIELDS - 1);
+	ck_assert_int_eq(changed[0], 0);
+	ck_assert_int_eq(changed[FLOAT_FIELDS - 1], 1);
+	float_value = 0.75;
+	ck_assert_int_eq(bx_docman_invoke_set("float_100", &float_value), 0);
+	ck_assert_int_eq(bx_column_changes(&float_column, previous + 1, changed), 1);
+	ck_assert_int_eq(changed[FLOAT_FIELDS - 1], 1);
+	ck_assert_int_eq(memcmp(&previous[FLOAT_FIELDS], &float_value, sizeof float_value), 0);
+} END_TEST
+
+static void *column_writer_routine(void *arg) {
+	bx_int32 i;
+
+	for (i = 1; i <= COLUMN_WRITES; i++) {
+		bx_docman_invoke_set("int_0", &i);
+	}
+
+	return NULL;
+}
+
+START_TEST (concurrent_read_test) {
+	bx_uint32 values[DM_COLUMN_CAPACITY];
+	pthread_t writer;
+	bx_int32 last_value;
+	bx_int32 zero;
+
+	zero = 0;
+	ck_assert_int_eq(bx_docman_invoke_set("int_0", &zero), 0);
+	ck_assert_int_eq(pthread_create(&writer, NULL, column_writer_routine, NULL), 0);
+
+	// Bulk reads never observe an update going backwards
+	last_value = 0;
+	do {
+		if (bx_column_read(&int_column, values) == 3) {
+			ck_assert_int_ge((bx_int32) values[0], last_value);
+			last_value = values[0];
+		}
+	} while (last_value != COLUMN_WRITES);
+	ck_assert_int_eq(pthread_join(writer, NULL), 0);
+} END_TEST
+
+Suite *test_field_column_create_suite() {
+	Suite *suite = suite_create("field_column");
+	TCase *tcase;
+
+	tcase = tcase_create("init_test");
+	tcase_add_test(tcase, init_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("field_access_test");
+	tcase_add_test(tcase, field_access_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("threshold_test");
+	tcase_add_test(tcase, threshold_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("min_max_test");
+	tcase_add_test(tcase, min_max_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("changes_test");
+	tcase_add_test(tcase, changes_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("concurrent_read_test");
+	tcase_add_test(tcase, concurrent_read_test);
+	suite_add_tcase(suite, tcase);
+
+	return suite;
+}
@@ -0,0 +1,198 @@
+/*
+ * test_field_history.c
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <pthread.h>
+#include "test_field_history.h"
+#include "atomic.h"
+#include "runtime/critical_section.h"
+#include "document_manager/document_manager.h"
+#include "document_manager/field_history.h"
+#include "document_manager/test_field.h"
+
+#define HISTORY_CAPACITY 8
+#define HISTORY_WRITES 20000
+
+START_TEST (ring_test) {
+	struct bx_history_sample samples[HISTORY_CAPACITY];
+	struct bx_field_history history;
+	bx_uint64 first;
+	bx_uint64 end;
+	bx_uint64 i;
+
+	ck_assert_int_eq(bx_history_init(&history, samples, 0), -1);
+	ck_assert_int_eq(bx_history_init(&history, samples, HISTORY_CAPACITY), 0);
+	first = bx_history_first(&history, &end);
+	ck_assert_int_eq(first, 0);
+	ck_assert_int_eq(end, 0);
+
+	for (i = 0; i < 5; i++) {
+		bx_history_append(&history, i * 10, i);
+	}
+	first = bx_history_first(&history, &end);
+	ck_assert_int_eq(first, 0);
+	ck_assert_int_eq(end, 5);
+
+	// Once full, the oldest samples are overwritten
+	for (i = 5; i < 12; i++) {
+		bx_history_append(&history, i * 10, i);
+	}
+	first = bx_history_first(&history, &end);
+	ck_assert_int_eq(first, 12 - HISTORY_CAPACITY);
+	ck_assert_int_eq(end, 12);
+	for (i = first; i < end; i++) {
+		ck_assert_int_eq(bx_history_sample(&history, i)->value, i);
+		ck_assert_int_eq(bx_history_sample(&history, i)->timestamp, i * 10);
+	}
+	ck_assert(bx_history_valid(&history, first) == BX_BOOLEAN_TRUE);
+
+	// A sample is invalid once the writer may be overwriting it
+	bx_history_append(&history, 120, 12);
+	ck_assert(bx_history_valid(&history, first) == BX_BOOLEAN_FALSE);
+	ck_assert(bx_history_valid(&history, first + 1) == BX_BOOLEAN_TRUE);
+} END_TEST
+
+START_TEST (field_history_test) {
+	static struct bx_history_sample computed_samples[HISTORY_CAPACITY];
+	static struct bx_history_sample plain_samples[2];
+	static struct bx_field_history computed_history;
+	static struct bx_field_history plain_history;
+	static struct bx_test_field_data data;
+	static struct bx_field_storage storage;
+	struct bx_document_field computed_field;
+	struct bx_document_field plain_field;
+	bx_uint64 first;
+	bx_uint64 end;
+	bx_int32 value;
+
+	ck_assert_int_eq(bx_critical_init(), 0);
+	ck_assert_int_eq(bx_docman_init(), 0);
+	bx_tfield_init(&computed_field, &data);
+	bx_docman_init_plain_field(&plain_field, BX_INT, &storage);
+	ck_assert_int_eq(bx_docman_add_field(&computed_field, "computed"), 0);
+	ck_assert_int_eq(bx_docman_add_field(&plain_field, "plain"), 0);
+
+	// Values set before the history is attached are not recorded
+	value = 1;
+	ck_assert_int_eq(bx_docman_invoke_set("computed", &value), 0);
+	ck_assert_ptr_eq(bx_docman_get_history("computed"), NULL);
+
+	bx_history_init(&computed_history, computed_samples, HISTORY_CAPACITY);
+	bx_history_init(&plain_history, plain_samples, 2);
+	ck_assert_int_eq(bx_docman_attach_history("computed", &computed_history), 0);
+	ck_assert_int_eq(bx_docman_attach_history("plain", &plain_history), 0);
+	ck_assert_int_eq(bx_docman_attach_history("missing", &plain_history), -1);
+	ck_assert_ptr_eq(bx_docman_get_history("computed"), &computed_history);
+	ck_assert_ptr_eq(bx_docman_get_history("plain"), &plain_history);
+
+	value = 2;
+	ck_assert_int_eq(bx_docman_invoke_set("computed", &value), 0);
+	value = 3;
+	ck_assert_int_eq(bx_docman_invoke_set("computed", &value), 0);
+	first = bx_history_first(&computed_history, &end);
+	ck_assert_int_eq(end - first, 2);
+	ck_assert_int_eq(bx_history_sample(&computed_history, first)->value, 2);
+	ck_assert_int_eq(bx_history_sample(&computed_history, first + 1)->value, 3);
+	ck_assert(bx_history_sample(&computed_history, first)->timestamp
+			<= bx_history_sample(&computed_history, first + 1)->timestamp);
+
+	// Plain fields record the values written in place as well
+	value = 4;
+	ck_assert_int_eq(bx_docman_invoke_set("plain", &value), 0);
+	bx_docman_write_storage(&storage, 5);
+	bx_docman_write_storage(&storage, 6);
+	first = bx_history_first(&plain_history, &end);
+	ck_assert_int_eq(first, 1);
+	ck_assert_int_eq(end, 3);
+	ck_assert_int_eq(bx_history_sample(&plain_history, 1)->value, 5);
+	ck_assert_int_eq(bx_history_sample(&plain_history, 2)->value, 6);
+} END_TEST
+
+static struct bx_history_sample concurrent_samples[HISTORY_CAPACITY];
+static struct bx_field_history concurrent_history;
+
+static void *history_writer_routine(void *arg) {
+	bx_uint32 i;
+
+	for (i = 1; i <= HISTORY_WRITES; i++) {
+		bx_history_append(&concurrent_history, i, i);
+	}
+
+	return NULL;
+}
+
+START_TEST (concurrent_read_test) {
+	struct bx_history_sample *sample;
+	pthread_t writer;
+	bx_uint32 values[HISTORY_CAPACITY];
+	bx_uint64 timestamps[HISTORY_CAPACITY];
+	bx_uint64 first;
+	bx_uint64 end;
+	bx_uint64 i;
+
+	bx_history_init(&concurrent_history, concurrent_samples, HISTORY_CAPACITY);
+	ck_assert_int_eq(pthread_create(&writer, NULL, history_writer_routine, NULL), 0);
+
+	// Valid reads always observe complete samples
+	do {
+		first = bx_history_first(&concurrent_history, &end);
+		for (i = first; i < end; i++) {
+			sample = bx_history_sample(&concurrent_history, i);
+			timestamps[i - first] = BX_ATOMIC_LOAD(&sample->timestamp);
+			values[i - first] = BX_ATOMIC_LOAD(&sample->value);
+		}
+		if (bx_history_valid(&concurrent_history, first) == BX_BOOLEAN_TRUE) {
+			for (i = first; i < end; i++) {
+				ck_assert_int_eq(values[i - first], i + 1);
+				ck_assert_int_eq(timestamps[i - first], i + 1);
+			}
+		}
+	} while (end != HISTORY_WRITES);
+	ck_assert_int_eq(pthread_join(writer, NULL), 0);
+} END_TEST
+
+Suite *test_field_history_create_suite() {
+	Suite *suite = suite_create("field_history");
+	TCase *tcase;
+
+	tcase = tcase_create("ring_test");
+	tcase_add_test(tcase, ring_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("field_history_test");
+	tcase_add_test(tcase, field_history_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("concurrent_read_test");
+	tcase_add_test(tcase, concurrent_read_test);
+	suite_add_tcase(suite, tcase);
+
+	return suite;
+}
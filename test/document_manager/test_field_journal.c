@@ -0,0 +1,349 @@
+/*
+ * test_field_journal.c
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "test_field_journal.h"
+#include "runtime/critical_section.h"
+#include "document_manager/document_manager.h"
+#include "document_manager/field_journal.h"
+
+#define FIRST_FIELD_ID "journal_first"
+#define SECOND_FIELD_ID "journal_second"
+#define VOLATILE_FIELD_ID "journal_other"
+#define COMMIT_INTERVAL 1000000
+
+static char journal_path[64];
+static char snapshot_path[64];
+static struct bx_field_storage storages[3];
+
+/**
+ * Recreates the document manager with all the fields set to 0 and
+ * registers the persistent fields
+ */
+static void fields_create() {
+	static char *identifiers[] = { FIRST_FIELD_ID, SECOND_FIELD_ID, VOLATILE_FIELD_ID };
+	struct bx_document_field field;
+	bx_int8 error;
+	bx_size i;
+
+	error = bx_docman_init();
+	ck_assert_int_eq(error, 0);
+	memset(storages, 0, sizeof storages);
+	for (i = 0; i < 3; i++) {
+		error = bx_docman_init_plain_field(&field, BX_INT, &storages[i]);
+		ck_assert_int_eq(error, 0);
+		error = bx_docman_add_field(&field, identifiers[i]);
+		ck_assert_int_eq(error, 0);
+	}
+	error = bx_journal_add_field(FIRST_FIELD_ID);
+	ck_assert_int_eq(error, 0);
+	error = bx_journal_add_field(SECOND_FIELD_ID);
+	ck_assert_int_eq(error, 0);
+}
+
+/**
+ * Returns the size of a file
+ *
+ * @param path File path
+ *
+ * @return File size, -1 if the file does not exist
+ */
+static off_t file_size(const char *path) {
+	struct stat status;
+
+	if (stat(path, &status) != 0) {
+		return -1;
+	}
+
+	return status.st_size;
+}
+
+/**
+ * Reads the header of a file
+ *
+ * @param path File path
+ *
+ * @return Generation of the file
+ */
+static bx_uint32 file_generation(const char *path) {
+	struct bx_journal_header header;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	ck_assert_int_ge(fd, 0);
+	ck_assert_int_eq(read(fd, &header, sizeof header), sizeof header);
+	close(fd);
+	ck_assert_int_eq(header.magic, BX_JOURNAL_MAGIC);
+
+	return header.generation;
+}
+
+static bx_int32 field_value(char *identifier) {
+	bx_int32 value;
+
+	ck_assert_int_eq(bx_docman_invoke_get(identifier, &value), 0);
+
+	return value;
+}
+
+static void field_set(char *identifier, bx_int32 value) {
+
+	ck_assert_int_eq(bx_docman_invoke_set(identifier, &value), 0);
+}
+
+START_TEST (init_test) {
+	bx_int8 error;
+
+	error = bx_critical_init();
+	ck_assert_int_eq(error, 0);
+	snprintf(journal_path, sizeof journal_path, "/tmp/bx_test_journal_%i", (int) getpid());
+	snprintf(snapshot_path, sizeof snapshot_path, "/tmp/bx_test_snapshot_%i", (int) getpid());
+	unlink(journal_path);
+	unlink(snapshot_path);
+
+	fields_create();
+	error = bx_journal_add_field(FIRST_FIELD_ID);
+	ck_assert_int_eq(error, -1);
+	error = bx_journal_add_field("journal_missing");
+	ck_assert_int_eq(error, -1);
+	error = bx_journal_commit();
+	ck_assert_int_eq(error, -1);
+
+	error = bx_journal_open(journal_path, snapshot_path, COMMIT_INTERVAL);
+	ck_assert_int_eq(error, 0);
+	error = bx_journal_open(journal_path, snapshot_path, COMMIT_INTERVAL);
+	ck_assert_int_eq(error, -1);
+	error = bx_journal_add_field(VOLATILE_FIELD_ID);
+	ck_assert_int_eq(error, -1);
+
+	ck_assert_int_eq(file_generation(snapshot_path), 1);
+	ck_assert_int_eq(file_generation(journal_path), 1);
+	ck_assert_int_eq(file_size(journal_path), sizeof (struct bx_journal_header));
+} END_TEST
+
+START_TEST (commit_test) {
+	struct bx_journal_record records[3];
+	bx_int32 value;
+	bx_int8 error;
+	int fd;
+
+	// Intermediate values are conflated into a single record per field
+	field_set(FIRST_FIELD_ID, 1);
+	field_set(FIRST_FIELD_ID, 2);
+	field_set(FIRST_FIELD_ID, 3);
+	field_set(SECOND_FIELD_ID, 7);
+	field_set(VOLATILE_FIELD_ID, 11);
+	error = bx_journal_commit();
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(file_size(journal_path),
+			sizeof (struct bx_journal_header) + 2 * sizeof (struct bx_journal_record));
+
+	fd = open(journal_path, O_RDONLY);
+	ck_assert_int_ge(fd, 0);
+	lseek(fd, sizeof (struct bx_journal_header), SEEK_SET);
+	ck_assert_int_eq(read(fd, records, sizeof records), 2 * sizeof (struct bx_journal_record));
+	close(fd);
+	ck_assert_int_eq(strncmp(records[0].identifier, FIRST_FIELD_ID, DM_FIELD_IDENTIFIER_LENGTH), 0);
+	memcpy(&value, &records[0].value, 4);
+	ck_assert_int_eq(value, 3);
+	ck_assert_int_eq(strncmp(records[1].identifier, SECOND_FIELD_ID, DM_FIELD_IDENTIFIER_LENGTH), 0);
+	memcpy(&value, &records[1].value, 4);
+	ck_assert_int_eq(value, 7);
+
+	// Nothing is written when no persistent field changed
+	field_set(VOLATILE_FIELD_ID, 12);
+	error = bx_journal_commit();
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(file_size(journal_path),
+			sizeof (struct bx_journal_header) + 2 * sizeof (struct bx_journal_record));
+
+	field_set(SECOND_FIELD_ID, 8);
+	error = bx_journal_close();
+	ck_assert_int_eq(error, 0);
+	error = bx_journal_close();
+	ck_assert_int_eq(error, -1);
+	ck_assert_int_eq(file_size(journal_path),
+			sizeof (struct bx_journal_header) + 3 * sizeof (struct bx_journal_record));
+} END_TEST
+
+START_TEST (restore_test) {
+	bx_int8 error;
+
+	fields_create();
+	error = bx_journal_open(journal_path, snapshot_path, COMMIT_INTERVAL);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(field_value(FIRST_FIELD_ID), 3);
+	ck_assert_int_eq(field_value(SECOND_FIELD_ID), 8);
+	ck_assert_int_eq(field_value(VOLATILE_FIELD_ID), 0);
+
+	// Opening compacts the journal into the snapshot
+	ck_assert_int_eq(file_generation(snapshot_path), 2);
+	ck_assert_int_eq(file_generation(journal_path), 2);
+	ck_assert_int_eq(file_size(journal_path), sizeof (struct bx_journal_header));
+	ck_assert_int_eq(file_size(snapshot_path),
+			sizeof (struct bx_journal_header) + 2 * sizeof (struct bx_journal_record));
+} END_TEST
+
+START_TEST (compaction_test) {
+	char stale_journal[128];
+	ssize_t stale_size;
+	bx_int8 error;
+	bx_size i;
+	int fd;
+
+	// The journal is compacted automatically when it grows too large
+	for (i = 0; i <= DM_JOURNAL_COMPACTION_SIZE / sizeof (struct bx_journal_record); i++) {
+		field_set(FIRST_FIELD_ID, i);
+		error = bx_journal_commit();
+		ck_assert_int_eq(error, 0);
+	}
+	ck_assert_int_eq(file_generation(snapshot_path), 3);
+	ck_assert_int_eq(file_size(journal_path), sizeof (struct bx_journal_header));
+
+	// Keep a copy of the journal before the next compaction
+	field_set(FIRST_FIELD_ID, 99);
+	error = bx_journal_commit();
+	ck_assert_int_eq(error, 0);
+	fd = open(journal_path, O_RDONLY);
+	ck_assert_int_ge(fd, 0);
+	stale_size = read(fd, stale_journal, sizeof stale_journal);
+	close(fd);
+	ck_assert_int_eq(stale_size, sizeof (struct bx_journal_header) + sizeof (struct bx_journal_record));
+
+	field_set(FIRST_FIELD_ID, 20);
+	error = bx_journal_compact();
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(file_generation(snapshot_path), 4);
+	ck_assert_int_eq(file_generation(journal_path), 4);
+	error = bx_journal_close();
+	ck_assert_int_eq(error, 0);
+
+	// A journal older than the snapshot is already contained in it
+	fd = open(journal_path, O_WRONLY | O_TRUNC);
+	ck_assert_int_ge(fd, 0);
+	ck_assert_int_eq(write(fd, stale_journal, stale_size), stale_size);
+	close(fd);
+
+	fields_create();
+	error = bx_journal_open(journal_path, snapshot_path, COMMIT_INTERVAL);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(field_value(FIRST_FIELD_ID), 20);
+	ck_assert_int_eq(field_value(SECOND_FIELD_ID), 8);
+} END_TEST
+
+START_TEST (torn_tail_test) {
+	struct bx_journal_record record;
+	bx_int8 error;
+	int fd;
+
+	field_set(FIRST_FIELD_ID, 5);
+	field_set(SECOND_FIELD_ID, 6);
+	error = bx_journal_close();
+	ck_assert_int_eq(error, 0);
+
+	// Only half of the record of a later commit reached the disk
+	field_set(SECOND_FIELD_ID, 9);
+	fd = open(journal_path, O_WRONLY | O_APPEND);
+	ck_assert_int_ge(fd, 0);
+	memset(&record, 0, sizeof record);
+	strncpy(record.identifier, SECOND_FIELD_ID, DM_FIELD_IDENTIFIER_LENGTH);
+	ck_assert_int_eq(write(fd, &record, sizeof record / 2), sizeof record / 2);
+	close(fd);
+
+	fields_create();
+	error = bx_journal_open(journal_path, snapshot_path, COMMIT_INTERVAL);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(field_value(FIRST_FIELD_ID), 5);
+	ck_assert_int_eq(field_value(SECOND_FIELD_ID), 6);
+	ck_assert_int_eq(file_size(journal_path), sizeof (struct bx_journal_header));
+	error = bx_journal_close();
+	ck_assert_int_eq(error, 0);
+} END_TEST
+
+START_TEST (background_commit_test) {
+	bx_uint32 attempts;
+	bx_int8 error;
+
+	fields_create();
+	error = bx_journal_open(journal_path, snapshot_path, 1000);
+	ck_assert_int_eq(error, 0);
+
+	field_set(SECOND_FIELD_ID, 30);
+	for (attempts = 0; attempts < 5000; attempts++) {
+		if (file_size(journal_path) > sizeof (struct bx_journal_header)) {
+			break;
+		}
+		usleep(1000);
+	}
+	ck_assert_int_eq(file_size(journal_path),
+			sizeof (struct bx_journal_header) + sizeof (struct bx_journal_record));
+
+	error = bx_journal_close();
+	ck_assert_int_eq(error, 0);
+	unlink(journal_path);
+	unlink(snapshot_path);
+} END_TEST
+
+Suite *test_field_journal_create_suite(void) {
+	Suite *suite = suite_create("field_journal");
+	TCase *tcase;
+
+	tcase = tcase_create("init_test");
+	tcase_add_test(tcase, init_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("commit_test");
+	tcase_add_test(tcase, commit_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("restore_test");
+	tcase_add_test(tcase, restore_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("compaction_test");
+	tcase_add_test(tcase, compaction_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("torn_tail_test");
+	tcase_add_test(tcase, torn_tail_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("background_commit_test");
+	tcase_add_test(tcase, background_commit_test);
+	suite_add_tcase(suite, tcase);
+
+	return suite;
+}
@@ -0,0 +1,252 @@
+/*
+ * test_field_window.c
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include "test_field_window.h"
+#include "runtime/critical_section.h"
+#include "document_manager/document_manager.h"
+#include "document_manager/field_window.h"
+
+#define WINDOW_CAPACITY 16
+#define RANDOM_SAMPLES 2000
+
+static bx_int32 get_int(struct bx_field_window *window, enum bx_aggregate aggregate) {
+	bx_uint32 value;
+
+	ck_assert_int_eq(bx_window_get(window, aggregate, &value), 0);
+
+	return (bx_int32) value;
+}
+
+static bx_float32 get_float(struct bx_field_window *window, enum bx_aggregate aggregate) {
+	bx_float32 float_value;
+	bx_uint32 value;
+
+	ck_assert_int_eq(bx_window_get(window, aggregate, &value), 0);
+	memcpy(&float_value, &value, sizeof float_value);
+
+	return float_value;
+}
+
+static bx_uint32 raw_float(bx_float32 value) {
+	bx_uint32 raw;
+
+	memcpy(&raw, &value, sizeof raw);
+
+	return raw;
+}
+
+START_TEST (sliding_test) {
+	struct bx_window_entry entries[4];
+	struct bx_field_window window;
+	bx_uint32 value;
+
+	ck_assert_int_eq(bx_window_init(&window, BX_INT, BX_WINDOW_SLIDING, 4, 0, NULL), -1);
+	ck_assert_int_eq(bx_window_init(&window, BX_STRING, BX_WINDOW_SLIDING, 4, 0, entries), -1);
+	ck_assert_int_eq(bx_window_init(&window, BX_INT, BX_WINDOW_SLIDING, 4, 0, entries), 0);
+
+	// The aggregates of an empty window are undefined, except count and sum
+	ck_assert_int_eq(get_int(&window, BX_AGGREGATE_COUNT), 0);
+	ck_assert_int_eq(get_int(&window, BX_AGGREGATE_SUM), 0);
+	ck_assert_int_eq(bx_window_get(&window, BX_AGGREGATE_MIN, &value), -1);
+	ck_assert_int_eq(bx_window_get(&window, BX_AGGREGATE_NUMBER, &value), -1);
+
+	bx_window_add(&window, 1, 5);
+	bx_window_add(&window, 2, 1);
+	bx_window_add(&window, 3, 3);
+	bx_window_add(&window, 4, 7);
+	ck_assert_int_eq(get_int(&window, BX_AGGREGATE_COUNT), 4);
+	ck_assert_int_eq(get_int(&window, BX_AGGREGATE_SUM), 16);
+	ck_assert_int_eq(get_int(&window, BX_AGGREGATE_MIN), 1);
+	ck_assert_int_eq(get_int(&window, BX_AGGREGATE_MAX), 7);
+	ck_assert(get_float(&window, BX_AGGREGATE_AVG) == 4);
+	ck_assert(get_float(&window, BX_AGGREGATE_VARIANCE) == 5);
+
+	// The oldest samples are evicted, together with their extremes
+	bx_window_add(&window, 5, 2);
+	ck_assert_int_eq(get_int(&window, BX_AGGREGATE_COUNT), 4);
+	ck_assert_int_eq(get_int(&window, BX_AGGREGATE_SUM), 13);
+	ck_assert_int_eq(get_int(&window, BX_AGGREGATE_MIN), 1);
+	bx_window_add(&window, 6, 8);
+	ck_assert_int_eq(get_int(&window, BX_AGGREGATE_MIN), 2);
+	ck_assert_int_eq(get_int(&window, BX_AGGREGATE_MAX), 8);
+	bx_window_add(&window, 7, (bx_uint32) -4);
+	ck_assert_int_eq(get_int(&window, BX_AGGREGATE_MIN), -4);
+	ck_assert_int_eq(get_int(&window, BX_AGGREGATE_SUM), 13);
+} END_TEST
+
+START_TEST (random_test) {
+	struct bx_window_entry entries[WINDOW_CAPACITY];
+	struct bx_field_window window;
+	bx_float32 samples[RANDOM_SAMPLES];
+	bx_float32 min;
+	bx_float32 max;
+	double sum;
+	double mean;
+	double variance;
+	bx_uint32 i;
+	bx_uint32 j;
+	bx_uint32 first;
+
+	// Incremental aggregates match the ones computed over the whole window
+	srand(7);
+	bx_window_init(&window, BX_FLOAT, BX_WINDOW_SLIDING, WINDOW_CAPACITY, 0, entries);
+	for (i = 0; i < RANDOM_SAMPLES; i++) {
+		samples[i] = (rand() % 20000) / 100.0 - 100;
+		bx_window_add(&window, i, raw_float(samples[i]));
+
+		first = i + 1 >= WINDOW_CAPACITY ? i + 1 - WINDOW_CAPACITY : 0;
+		min = max = samples[first];
+		sum = 0;
+		for (j = first; j <= i; j++) {
+			min = samples[j] < min ? samples[j] : min;
+			max = samples[j] > max ? samples[j] : max;
+			sum += samples[j];
+		}
+		mean = sum / (i + 1 - first);
+		variance = 0;
+		for (j = first; j <= i; j++) {
+			variance += (samples[j] - mean) * (samples[j] - mean);
+		}
+		variance /= i + 1 - first;
+
+		ck_assert_int_eq(get_int(&window, BX_AGGREGATE_COUNT), i + 1 - first);
+		ck_assert(get_float(&window, BX_AGGREGATE_MIN) == min);
+		ck_assert(get_float(&window, BX_AGGREGATE_MAX) == max);
+		ck_assert(fabs(get_float(&window, BX_AGGREGATE_SUM) - sum) < 0.01);
+		ck_assert(fabs(get_float(&window, BX_AGGREGATE_AVG) - mean) < 0.001);
+		ck_assert(fabs(get_float(&window, BX_AGGREGATE_VARIANCE) - variance) < 0.01);
+	}
+} END_TEST
+
+START_TEST (span_test) {
+	struct bx_window_entry entries[WINDOW_CAPACITY];
+	struct bx_field_window window;
+
+	// Samples older than the span are evicted when a sample is added
+	bx_window_init(&window, BX_INT, BX_WINDOW_SLIDING, WINDOW_CAPACITY, 100, entries);
+	bx_window_add(&window, 0, 10);
+	bx_window_add(&window, 50, 20);
+	bx_window_add(&window, 100, 30);
+	ck_assert_int_eq(get_int(&window, BX_AGGREGATE_COUNT), 3);
+	bx_window_add(&window, 120, 40);
+	ck_assert_int_eq(get_int(&window, BX_AGGREGATE_COUNT), 3);
+	ck_assert_int_eq(get_int(&window, BX_AGGREGATE_MIN), 20);
+	bx_window_add(&window, 1000, 5);
+	ck_assert_int_eq(get_int(&window, BX_AGGREGATE_COUNT), 1);
+	ck_assert_int_eq(get_int(&window, BX_AGGREGATE_MAX), 5);
+} END_TEST
+
+START_TEST (tumbling_test) {
+	struct bx_field_window window;
+	bx_uint32 values[BX_AGGREGATE_NUMBER];
+	bx_uint32 value;
+
+	ck_assert_int_eq(bx_window_init(&window, BX_INT, BX_WINDOW_TUMBLING, 3, 0, NULL), 0);
+	bx_window_add(&window, 0, 4);
+	bx_window_add(&window, 1, 2);
+	ck_assert_int_eq(get_int(&window, BX_AGGREGATE_COUNT), 0);
+	ck_assert_int_eq(bx_window_get(&window, BX_AGGREGATE_AVG, &value), -1);
+
+	// Aggregates are published when a group is complete
+	bx_window_add(&window, 2, 9);
+	ck_assert_int_eq(bx_window_get_all(&window, values), 0);
+	ck_assert_int_eq(values[BX_AGGREGATE_COUNT], 3);
+	ck_assert_int_eq(values[BX_AGGREGATE_SUM], 15);
+	ck_assert_int_eq(values[BX_AGGREGATE_MIN], 2);
+	ck_assert_int_eq(values[BX_AGGREGATE_MAX], 9);
+	ck_assert(get_float(&window, BX_AGGREGATE_AVG) == 5);
+	bx_window_add(&window, 3, 100);
+	ck_assert_int_eq(get_int(&window, BX_AGGREGATE_SUM), 15);
+
+	// The span closes groups early
+	bx_window_init(&window, BX_INT, BX_WINDOW_TUMBLING, 10, 100, NULL);
+	bx_window_add(&window, 0, 1);
+	bx_window_add(&window, 60, 3);
+	ck_assert_int_eq(get_int(&window, BX_AGGREGATE_COUNT), 0);
+	bx_window_add(&window, 100, 50);
+	ck_assert_int_eq(get_int(&window, BX_AGGREGATE_COUNT), 2);
+	ck_assert_int_eq(get_int(&window, BX_AGGREGATE_SUM), 4);
+} END_TEST
+
+START_TEST (field_window_test) {
+	static struct bx_window_entry entries[WINDOW_CAPACITY];
+	static struct bx_field_window window;
+	static struct bx_field_storage storage;
+	struct bx_document_field field;
+	bx_int32 value;
+
+	ck_assert_int_eq(bx_critical_init(), 0);
+	ck_assert_int_eq(bx_docman_init(), 0);
+	bx_docman_init_plain_field(&field, BX_INT, &storage);
+	ck_assert_int_eq(bx_docman_add_field(&field, "windowed"), 0);
+	bx_window_init(&window, BX_INT, BX_WINDOW_SLIDING, WINDOW_CAPACITY, 0, entries);
+	ck_assert_ptr_eq(bx_docman_get_window("windowed"), NULL);
+	ck_assert_int_eq(bx_docman_attach_window("windowed", &window), 0);
+	ck_assert_int_eq(bx_docman_attach_window("missing", &window), -1);
+	ck_assert_ptr_eq(bx_docman_get_window("windowed"), &window);
+
+	// Values set through the document manager feed the window
+	value = 6;
+	ck_assert_int_eq(bx_docman_invoke_set("windowed", &value), 0);
+	bx_docman_write_storage(&storage, 10);
+	ck_assert_int_eq(get_int(&window, BX_AGGREGATE_COUNT), 2);
+	ck_assert_int_eq(get_int(&window, BX_AGGREGATE_SUM), 16);
+} END_TEST
+
+Suite *test_field_window_create_suite() {
+	Suite *suite = suite_create("field_window");
+	TCase *tcase;
+
+	tcase = tcase_create("sliding_test");
+	tcase_add_test(tcase, sliding_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("random_test");
+	tcase_add_test(tcase, random_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("span_test");
+	tcase_add_test(tcase, span_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("tumbling_test");
+	tcase_add_test(tcase, tumbling_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("field_window_test");
+	tcase_add_test(tcase, field_window_test);
+	suite_add_tcase(suite, tcase);
+
+	return suite;
+}
@@ -0,0 +1,271 @@
+/*
+ * test_memory_map_field.c
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "test_memory_map_field.h"
+#include "atomic.h"
+#include "utils/seqlock.h"
+#include "runtime/critical_section.h"
+#include "document_manager/document_manager.h"
+#include "document_manager/memory_map_field.h"
+
+#define INT_FIELD_ID "mmap_int"
+#define FLOAT_FIELD_ID "mmap_float"
+
+static char region_name[32];
+static struct bx_document_field int_field;
+static struct bx_document_field float_field;
+
+/**
+ * Maps the region independently, as an external process would
+ *
+ * @return Beginning of the region
+ */
+static struct bx_mmap_header *map_external() {
+	struct bx_mmap_header *header;
+	int fd;
+
+	fd = shm_open(region_name, O_RDWR, 0600);
+	ck_assert_int_ge(fd, 0);
+	header = mmap(NULL, DM_MMAP_STORAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	ck_assert_ptr_ne(header, MAP_FAILED);
+
+	return header;
+}
+
+/**
+ * Creates the region the way a slow process would: the object is sized and
+ * then initialized after a delay
+ *
+ * @param arg Shared memory object created with size 0
+ *
+ * @return NULL
+ */
+static void *creator_routine(void *arg) {
+	struct bx_mmap_header *header;
+	int fd;
+
+	fd = *(int *) arg;
+	usleep(20000);
+	ck_assert_int_eq(ftruncate(fd, DM_MMAP_STORAGE_SIZE), 0);
+	header = mmap(NULL, DM_MMAP_STORAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	ck_assert_ptr_ne(header, MAP_FAILED);
+	usleep(20000);
+	header->version = BX_MMAP_VERSION;
+	header->slot_number = BX_MMAP_SLOT_NUMBER;
+	BX_ATOMIC_STORE(&header->magic, BX_MMAP_MAGIC);
+	munmap(header, DM_MMAP_STORAGE_SIZE);
+
+	return NULL;
+}
+
+START_TEST (init_test) {
+	bx_int8 error;
+
+	error = bx_critical_init();
+	ck_assert_int_eq(error, 0);
+	error = bx_docman_init();
+	ck_assert_int_eq(error, 0);
+
+	snprintf(region_name, sizeof region_name, "/bx_test_mmap_%i", (int) getpid());
+	shm_unlink(region_name);
+	error = bx_mmap_open(region_name);
+	ck_assert_int_eq(error, 0);
+	error = bx_mmap_open(region_name);
+	ck_assert_int_eq(error, -1);
+
+	error = bx_mmap_field_init(&int_field, BX_INT, 0);
+	ck_assert_int_eq(error, 0);
+	error = bx_mmap_field_init(&float_field, BX_FLOAT, 1);
+	ck_assert_int_eq(error, 0);
+	error = bx_docman_add_field(&int_field, INT_FIELD_ID);
+	ck_assert_int_eq(error, 0);
+	error = bx_docman_add_field(&float_field, FLOAT_FIELD_ID);
+	ck_assert_int_eq(error, 0);
+} END_TEST
+
+START_TEST (slot_type_test) {
+	struct bx_document_field field;
+	bx_int8 error;
+
+	// Slots keep the type of their first field
+	error = bx_mmap_field_init(&field, BX_INT, 0);
+	ck_assert_int_eq(error, 0);
+	error = bx_mmap_field_init(&field, BX_FLOAT, 0);
+	ck_assert_int_eq(error, -1);
+	error = bx_mmap_field_init(&field, BX_STRING, 2);
+	ck_assert_int_eq(error, -1);
+	error = bx_mmap_field_init(&field, BX_INT, BX_MMAP_SLOT_NUMBER);
+	ck_assert_int_eq(error, -1);
+} END_TEST
+
+START_TEST (shared_value_test) {
+	struct bx_mmap_header *header;
+	struct bx_mmap_slot *slots;
+	bx_float32 float_value;
+	bx_int32 int_value;
+	bx_int8 error;
+
+	header = map_external();
+	ck_assert_int_eq(header->magic, BX_MMAP_MAGIC);
+	ck_assert_int_eq(header->slot_number, BX_MMAP_SLOT_NUMBER);
+	slots = (struct bx_mmap_slot *) (header + 1);
+	ck_assert_int_eq(slots[0].type, BX_INT);
+	ck_assert_int_eq(slots[1].type, BX_FLOAT);
+	ck_assert_int_eq(slots[2].type, BX_MMAP_SLOT_UNUSED);
+
+	// Values set through the document manager are visible in the region
+	int_value = 42;
+	error = bx_docman_invoke_set(INT_FIELD_ID, &int_value);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(BX_ATOMIC_LOAD(&slots[0].value), 42);
+	ck_assert_int_eq(bx_seqlock_version(&slots[0].sequence), 1);
+
+	// Values published in the region are read by the document manager
+	float_value = 2.5;
+	ck_assert_int_eq(bx_seqlock_write_try_begin(&slots[1].sequence), BX_BOOLEAN_TRUE);
+	memcpy(&slots[1].value, &float_value, 4);
+	bx_seqlock_write_end(&slots[1].sequence);
+	float_value = 0;
+	error = bx_docman_invoke_get(FLOAT_FIELD_ID, &float_value);
+	ck_assert_int_eq(error, 0);
+	ck_assert(float_value == 2.5);
+
+	// A writer that never completes makes the accesses fail instead of blocking
+	ck_assert_int_eq(bx_seqlock_write_try_begin(&slots[1].sequence), BX_BOOLEAN_TRUE);
+	error = bx_docman_invoke_get(FLOAT_FIELD_ID, &float_value);
+	ck_assert_int_eq(error, -1);
+	error = bx_mmap_write(1, &float_value);
+	ck_assert_int_eq(error, -1);
+	bx_seqlock_write_end(&slots[1].sequence);
+	error = bx_mmap_read(1, &float_value);
+	ck_assert_int_eq(error, 0);
+
+	munmap(header, DM_MMAP_STORAGE_SIZE);
+} END_TEST
+
+START_TEST (reopen_test) {
+	struct bx_document_field field;
+	bx_int32 int_value;
+	bx_int8 error;
+
+	error = bx_mmap_close();
+	ck_assert_int_eq(error, 0);
+	error = bx_mmap_close();
+	ck_assert_int_eq(error, -1);
+	error = bx_mmap_read(0, &int_value);
+	ck_assert_int_eq(error, -1);
+
+	// Registered fields are detached from a closed region
+	error = bx_docman_invoke_get(INT_FIELD_ID, &int_value);
+	ck_assert_int_eq(error, -1);
+	error = bx_docman_invoke_set(INT_FIELD_ID, &int_value);
+	ck_assert_int_eq(error, -1);
+
+	// An existing region keeps its slots and values
+	error = bx_mmap_open(region_name);
+	ck_assert_int_eq(error, 0);
+	error = bx_mmap_field_init(&field, BX_FLOAT, 0);
+	ck_assert_int_eq(error, -1);
+	error = bx_mmap_read(0, &int_value);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(int_value, 42);
+	int_value = 0;
+	error = bx_docman_invoke_get(INT_FIELD_ID, &int_value);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(int_value, 42);
+
+	error = bx_mmap_close();
+	ck_assert_int_eq(error, 0);
+	shm_unlink(region_name);
+} END_TEST
+
+START_TEST (creator_race_test) {
+	pthread_t creator;
+	bx_int32 int_value;
+	bx_int8 error;
+	int fd;
+
+	// A region that is never sized is rejected instead of raising SIGBUS
+	fd = shm_open(region_name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	ck_assert_int_ge(fd, 0);
+	error = bx_mmap_open(region_name);
+	ck_assert_int_eq(error, -1);
+
+	// A region being created is opened once it is sized and initialized
+	ck_assert_int_eq(pthread_create(&creator, NULL, creator_routine, &fd), 0);
+	error = bx_mmap_open(region_name);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(pthread_join(creator, NULL), 0);
+	close(fd);
+	int_value = 1;
+	error = bx_mmap_read(0, &int_value);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(int_value, 0);
+	error = bx_mmap_read(BX_MMAP_SLOT_NUMBER, &int_value);
+	ck_assert_int_eq(error, -1);
+
+	error = bx_mmap_close();
+	ck_assert_int_eq(error, 0);
+	shm_unlink(region_name);
+} END_TEST
+
+Suite *test_memory_map_field_create_suite(void) {
+	Suite *suite = suite_create("memory_map_field");
+	TCase *tcase;
+
+	tcase = tcase_create("init_test");
+	tcase_add_test(tcase, init_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("slot_type_test");
+	tcase_add_test(tcase, slot_type_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("shared_value_test");
+	tcase_add_test(tcase, shared_value_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("reopen_test");
+	tcase_add_test(tcase, reopen_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("creator_race_test");
+	tcase_add_test(tcase, creator_race_test);
+	suite_add_tcase(suite, tcase);
+
+	return suite;
+}
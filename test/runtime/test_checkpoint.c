@@ -0,0 +1,311 @@
+/*
+ * test_checkpoint.c
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "test_checkpoint.h"
+#include "configuration.h"
+#include "runtime/checkpoint.h"
+#include "runtime/critical_section.h"
+#include "runtime/pcode_manager.h"
+#include "runtime/task_scheduler.h"
+#include "runtime/tick.h"
+#include "runtime/timer.h"
+#include "compiler/codegen_pcode.h"
+#include "document_manager/document_manager.h"
+#include "virtual_machine/virtual_machine.h"
+
+#define PLAIN_FIELD_ID "cp_plain"
+#define COUNTER_VARIABLE 1
+
+static char checkpoint_path[64];
+static struct bx_field_storage plain_storage;
+static bx_uint32 native_count;
+static bx_task_id native_task_id;
+static bx_task_id pcode_task_id;
+static bx_timer_id periodic_timer_id;
+static bx_timer_id one_off_timer_id;
+
+static void counting_function() {
+	native_count++;
+}
+
+/**
+ * Initializes the runtime as the application would at startup, with the
+ * field and the native task but without pcode tasks or timers
+ */
+static void runtime_init() {
+	struct bx_document_field field;
+	bx_uint8 variables[VM_VARIABLE_TABLE_SIZE];
+	bx_size i;
+
+	ck_assert_int_eq(bx_vm_virtual_machine_init(), 0);
+	memset(variables, 0, sizeof variables);
+	for (i = 0; i < VM_CONTEXT_NUMBER; i++) {
+		ck_assert_int_eq(bx_vm_set_variables(i, variables), 0);
+	}
+	ck_assert_int_eq(bx_docman_init(), 0);
+	memset(&plain_storage, 0, sizeof plain_storage);
+	ck_assert_int_eq(bx_docman_init_plain_field(&field, BX_INT, &plain_storage), 0);
+	ck_assert_int_eq(bx_docman_add_field(&field, PLAIN_FIELD_ID), 0);
+	ck_assert_int_eq(bx_pcode_init(), 0);
+	ck_assert_int_eq(bx_sched_init(), 0);
+	ck_assert_int_eq(bx_tick_use_virtual_clock(BX_BOOLEAN_TRUE), 0);
+	ck_assert_int_eq(bx_timer_init(), 0);
+
+	native_count = 0;
+	native_task_id = bx_sched_add_native_task(&counting_function,
+			BX_SCHED_LOWEST_PRIORITY, BX_SCHED_NO_DEADLINE);
+	ck_assert_int_eq(native_task_id, 0);
+}
+
+/**
+ * Stops the tick process as a terminating process would
+ */
+static void runtime_stop() {
+	ck_assert_int_eq(bx_timer_destroy(), 0);
+	ck_assert_int_eq(bx_tick_use_virtual_clock(BX_BOOLEAN_FALSE), 0);
+}
+
+/**
+ * Returns the counter incremented by the pcode task
+ */
+static bx_int32 counter_value() {
+	bx_uint8 variables[VM_VARIABLE_TABLE_SIZE];
+	bx_int32 value;
+
+	ck_assert_int_eq(bx_vm_get_variables(0, variables), 0);
+	memcpy(&value, variables + COUNTER_VARIABLE * 4, 4);
+
+	return value;
+}
+
+/**
+ * Overwrites a byte of the checkpoint header
+ *
+ * @param offset Offset of the byte
+ * @param value New value
+ *
+ * @return Previous value
+ */
+static bx_uint8 header_patch(size_t offset, bx_uint8 value) {
+	FILE *file;
+	int previous;
+
+	file = fopen(checkpoint_path, "r+b");
+	ck_assert_ptr_ne(file, NULL);
+	ck_assert_int_eq(fseek(file, offset, SEEK_SET), 0);
+	previous = fgetc(file);
+	ck_assert_int_ne(previous, EOF);
+	ck_assert_int_eq(fseek(file, offset, SEEK_SET), 0);
+	ck_assert_int_eq(fputc(value, file), value);
+	fclose(file);
+
+	return previous;
+}
+
+/**
+ * Checks that a failed restore left the runtime as runtime_init created it
+ */
+static void runtime_check_unchanged() {
+	struct bx_task_state task_states[EV_MAX_TASKS];
+	struct bx_timer_state timer_states[1];
+	bx_int32 value;
+
+	ck_assert_int_eq(bx_docman_invoke_get(PLAIN_FIELD_ID, &value), 0);
+	ck_assert_int_eq(value, 0);
+	ck_assert_int_eq(counter_value(), 0);
+	ck_assert_int_eq(bx_timer_get_states(timer_states, 1), 0);
+	ck_assert_int_le(bx_sched_get_task_states(task_states, EV_MAX_TASKS), 1);
+	ck_assert_int_ne(bx_sched_is_scheduled(native_task_id), 1);
+}
+
+START_TEST (init_test) {
+	ck_assert_int_eq(bx_critical_init(), 0);
+	snprintf(checkpoint_path, sizeof checkpoint_path, "/tmp/bx_test_checkpoint_%i", (int) getpid());
+	unlink(checkpoint_path);
+	runtime_init();
+} END_TEST
+
+START_TEST (save_test) {
+	struct bx_comp_pcode *comp_pcode;
+	bx_uint32 resolution_usec;
+	bx_int32 value;
+
+	// Program incrementing a variable, which keeps its value between executions
+	comp_pcode = bx_cgpc_create();
+	ck_assert_ptr_ne(comp_pcode, NULL);
+	bx_cgpc_add_instruction(comp_pcode, BX_INSTR_VLOAD32);
+	bx_cgpc_add_address(comp_pcode, COUNTER_VARIABLE);
+	bx_cgpc_add_instruction(comp_pcode, BX_INSTR_IPUSH_1);
+	bx_cgpc_add_instruction(comp_pcode, BX_INSTR_IADD);
+	bx_cgpc_add_instruction(comp_pcode, BX_INSTR_VSTORE32);
+	bx_cgpc_add_address(comp_pcode, COUNTER_VARIABLE);
+	bx_cgpc_add_instruction(comp_pcode, BX_INSTR_HALT);
+	pcode_task_id = bx_sched_add_pcode_task(comp_pcode->data, comp_pcode->size,
+			BX_SCHED_HIGHEST_PRIORITY, 5);
+	bx_cgpc_destroy(comp_pcode);
+	ck_assert_int_eq(pcode_task_id, 1);
+	ck_assert_int_eq(bx_sched_set_overrun_policy(pcode_task_id, BX_SCHED_OVERRUN_QUEUE, 3), 0);
+
+	resolution_usec = bx_timer_get_resolution();
+	periodic_timer_id = bx_timer_add_timer(BX_TIMER_PERIODIC, 10 * resolution_usec, pcode_task_id);
+	ck_assert_int_ne(periodic_timer_id, -1);
+	one_off_timer_id = bx_timer_add_timer(BX_TIMER_ONE_OFF, 25 * resolution_usec, native_task_id);
+	ck_assert_int_ne(one_off_timer_id, -1);
+	ck_assert_int_eq(bx_sched_simulate(13 * resolution_usec), 0);
+	ck_assert_int_eq(counter_value(), 1);
+
+	value = 42;
+	ck_assert_int_eq(bx_docman_invoke_set(PLAIN_FIELD_ID, &value), 0);
+	ck_assert_int_eq(bx_sched_schedule_task(native_task_id), 0);
+
+	ck_assert_int_eq(bx_checkpoint_save(checkpoint_path), 0);
+	runtime_stop();
+} END_TEST
+
+START_TEST (restore_test) {
+	struct bx_timer_state states[3];
+	bx_uint32 resolution_usec;
+	bx_int32 value;
+
+	runtime_init();
+	ck_assert_int_eq(bx_checkpoint_restore(checkpoint_path), 0);
+
+	ck_assert_int_eq(bx_docman_invoke_get(PLAIN_FIELD_ID, &value), 0);
+	ck_assert_int_eq(value, 42);
+	ck_assert_int_eq(counter_value(), 1);
+	ck_assert_int_eq(bx_sched_get_overrun_policy(pcode_task_id), BX_SCHED_OVERRUN_QUEUE);
+	ck_assert_int_eq(bx_sched_is_scheduled(native_task_id), 1);
+
+	// Timers keep their ids and their phase
+	ck_assert_int_eq(bx_timer_get_states(states, 3), 2);
+	ck_assert_int_eq(states[0].timer_id, periodic_timer_id);
+	ck_assert_int_eq(states[0].task_id, pcode_task_id);
+	ck_assert_int_eq(states[0].remaining_ticks, 7);
+	ck_assert_int_eq(states[1].timer_id, one_off_timer_id);
+	ck_assert_int_eq(states[1].task_id, native_task_id);
+	ck_assert_int_eq(states[1].remaining_ticks, 12);
+
+	resolution_usec = bx_timer_get_resolution();
+	ck_assert_int_eq(bx_sched_simulate(6 * resolution_usec), 0);
+	ck_assert_int_eq(native_count, 1);
+	ck_assert_int_eq(counter_value(), 1);
+	ck_assert_int_eq(bx_sched_simulate(resolution_usec), 0);
+	ck_assert_int_eq(counter_value(), 2);
+	ck_assert_int_eq(bx_sched_simulate(5 * resolution_usec), 0);
+	ck_assert_int_eq(native_count, 2);
+	ck_assert_int_eq(bx_timer_cancel(one_off_timer_id), -1);
+
+	// The restored program is released with its task
+	ck_assert_int_eq(bx_timer_cancel(periodic_timer_id), 0);
+	ck_assert_int_eq(bx_sched_remove_task(pcode_task_id), 0);
+	ck_assert_int_eq(bx_sched_remove_task(native_task_id), 0);
+	runtime_stop();
+} END_TEST
+
+START_TEST (instruction_set_test) {
+	size_t offset;
+	bx_uint8 previous;
+
+	// A checkpoint from an incompatible instruction encoding is rejected
+	runtime_init();
+	offset = offsetof(struct bx_checkpoint_header, instruction_set);
+	previous = header_patch(offset, BX_VM_INSTRUCTION_SET + 1);
+	ck_assert_int_eq(bx_checkpoint_restore(checkpoint_path), -1);
+	runtime_check_unchanged();
+	header_patch(offset, previous);
+	runtime_stop();
+
+	// With different instructions the programs are validated and restored
+	runtime_init();
+	offset = offsetof(struct bx_checkpoint_header, last_instruction);
+	previous = header_patch(offset, BX_INSTR_LAST - 1);
+	ck_assert_int_eq(bx_checkpoint_restore(checkpoint_path), 0);
+	ck_assert_int_eq(counter_value(), 1);
+	header_patch(offset, previous);
+	ck_assert_int_eq(bx_timer_cancel(periodic_timer_id), 0);
+	ck_assert_int_eq(bx_timer_cancel(one_off_timer_id), 0);
+	ck_assert_int_eq(bx_sched_remove_task(pcode_task_id), 0);
+	runtime_stop();
+} END_TEST
+
+START_TEST (invalid_test) {
+	FILE *file;
+
+	runtime_init();
+
+	// The native tasks have to be added again before restoring, nothing is applied otherwise
+	ck_assert_int_eq(bx_sched_remove_task(native_task_id), 0);
+	ck_assert_int_eq(bx_checkpoint_restore(checkpoint_path), -1);
+	runtime_check_unchanged();
+
+	file = fopen(checkpoint_path, "r+b");
+	ck_assert_ptr_ne(file, NULL);
+	ck_assert_int_eq(fputc(0, file), 0);
+	fclose(file);
+	ck_assert_int_eq(bx_checkpoint_restore(checkpoint_path), -1);
+	unlink(checkpoint_path);
+	ck_assert_int_eq(bx_checkpoint_restore(checkpoint_path), -1);
+	ck_assert_int_eq(bx_checkpoint_save(NULL), -1);
+
+	runtime_stop();
+} END_TEST
+
+Suite *test_checkpoint_create_suite(void) {
+	Suite *suite = suite_create("checkpoint");
+	TCase *tcase;
+
+	tcase = tcase_create("init_test");
+	tcase_add_test(tcase, init_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("save_test");
+	tcase_add_test(tcase, save_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("restore_test");
+	tcase_add_test(tcase, restore_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("instruction_set_test");
+	tcase_add_test(tcase, instruction_set_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("invalid_test");
+	tcase_add_test(tcase, invalid_test);
+	suite_add_tcase(suite, tcase);
+
+	return suite;
+}
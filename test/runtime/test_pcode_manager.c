@@ -32,14 +32,17 @@
 #include <string.h>
 #include "test_pcode_manager.h"
 #include "runtime/pcode_manager.h"
+#include "configuration.h"
 
 #define DATA1 "Test data 1"
 #define DATA2 "Test data number two"
 #define DATA3 "This is data three test data"
+#define DATA4 "Shared test data four"
 
 #define DATA1_SIZE strlen(DATA1)
 #define DATA2_SIZE strlen(DATA2)
 #define DATA3_SIZE strlen(DATA3)
+#define DATA4_SIZE strlen(DATA4)
 
 struct test_bx_pcode *pcode1;
 struct test_bx_pcode *pcode2;
@@ -49,13 +52,25 @@ struct test_bx_pcode {
 	bx_boolean valid;
 	void *instructions;
 	bx_size size;
+	void *module;
+	bx_uint32 hash;
+	bx_uint16 references;
+	bx_uint8 next;
 };
 
 START_TEST (init_test) {
+	static bx_uint8 buffer[PR_CODE_STORAGE_SIZE];
+	struct bx_pcode *pcode;
 	bx_int8 error;
 
 	error = bx_pcode_init();
 	ck_assert_int_eq(error, 0);
+
+	// A single program can use the whole storage
+	ck_assert_int_ge(bx_pcode_current_capacity(), PR_CODE_STORAGE_SIZE);
+	pcode = bx_pcode_add((void *) buffer, PR_CODE_STORAGE_SIZE);
+	ck_assert_ptr_ne(pcode, NULL);
+	ck_assert_int_eq(bx_pcode_remove(pcode), 0);
 } END_TEST
 
 START_TEST (add_test) {
@@ -93,7 +108,8 @@ START_TEST (remove_test) {
 	ck_assert_int_eq(pcode1->valid, BX_BOOLEAN_FALSE);
 	ck_assert_int_eq(pcode1->size, 0);
 	ck_assert_ptr_eq(pcode1->instructions, NULL);
-	ck_assert_ptr_ne(data2_pcode_pointer, pcode2->instructions);
+	ck_assert_ptr_eq(data2_pcode_pointer, pcode2->instructions);
+	ck_assert_int_eq(bx_pcode_remove((struct bx_pcode *) pcode1), -1);
 	ck_assert_int_eq(pcode2->valid, BX_BOOLEAN_TRUE);
 	ck_assert_int_eq(pcode2->size, DATA2_SIZE);
 	ck_assert_int_eq(memcmp(pcode2->instructions, DATA2, DATA2_SIZE), 0);
@@ -108,7 +124,79 @@ START_TEST (remove_test) {
 	ck_assert_int_eq(pcode2->valid, BX_BOOLEAN_TRUE);
 	ck_assert_int_eq(pcode2->size, DATA2_SIZE);
 	ck_assert_int_eq(memcmp(pcode2->instructions, DATA2, DATA2_SIZE), 0);
-	ck_assert_ptr_eq(pcode3->instructions, (void *) ((bx_uint8 *) pcode2->instructions + pcode2->size));
+	ck_assert_ptr_eq(data2_pcode_pointer, pcode2->instructions);
+} END_TEST
+
+START_TEST (fill_test) {
+	static bx_uint8 buffer[PR_CODE_STORAGE_SIZE];
+	struct test_bx_pcode *pcode_array[PR_MAX_PCODES];
+	bx_size capacity;
+	bx_size count;
+	bx_size i;
+
+	// Fill the storage with programs of the minimum block size
+	capacity = bx_pcode_current_capacity();
+	count = 0;
+	while (count < PR_MAX_PCODES) {
+		memset(buffer, count, PR_MIN_BLOCK_SIZE);
+		pcode_array[count] = (struct test_bx_pcode *) bx_pcode_add((void *) buffer, PR_MIN_BLOCK_SIZE);
+		if (pcode_array[count] == NULL) {
+			break;
+		}
+		count++;
+	}
+	ck_assert_int_gt(count, 0);
+
+	// Removing every other program leaves the remaining ones in place and indexed
+	for (i = 0; i < count; i += 2) {
+		ck_assert_int_eq(bx_pcode_remove((struct bx_pcode *) pcode_array[i]), 0);
+	}
+	for (i = 1; i < count; i += 2) {
+		memset(buffer, i, PR_MIN_BLOCK_SIZE);
+		ck_assert_int_eq(memcmp(pcode_array[i]->instructions, buffer, PR_MIN_BLOCK_SIZE), 0);
+		ck_assert_ptr_eq(bx_pcode_add((void *) buffer, PR_MIN_BLOCK_SIZE), pcode_array[i]);
+		ck_assert_int_eq(bx_pcode_remove((struct bx_pcode *) pcode_array[i]), 0);
+		ck_assert_int_eq(bx_pcode_remove((struct bx_pcode *) pcode_array[i]), 0);
+	}
+	ck_assert_int_eq(bx_pcode_current_capacity(), capacity);
+
+	// The freed blocks are merged: half of the storage fits a single program
+	pcode_array[0] = (struct test_bx_pcode *) bx_pcode_add((void *) buffer, capacity / 2);
+	ck_assert_ptr_ne(pcode_array[0], NULL);
+	ck_assert_int_eq(bx_pcode_remove((struct bx_pcode *) pcode_array[0]), 0);
+} END_TEST
+
+START_TEST (dedup_test) {
+	static bx_uint8 buffer[sizeof DATA4];
+	struct test_bx_pcode *shared1;
+	struct test_bx_pcode *shared2;
+	bx_size capacity;
+
+	// Identical programs share a single copy
+	memcpy(buffer, DATA4, DATA4_SIZE);
+	shared1 = (struct test_bx_pcode *) bx_pcode_add((void *) buffer, DATA4_SIZE);
+	ck_assert_ptr_ne(shared1, NULL);
+	capacity = bx_pcode_current_capacity();
+	shared2 = (struct test_bx_pcode *) bx_pcode_add((void *) DATA4, DATA4_SIZE);
+	ck_assert_ptr_eq(shared2, shared1);
+	ck_assert_int_eq(shared1->references, 2);
+	ck_assert_int_eq(bx_pcode_current_capacity(), capacity);
+
+	// A different program of the same size is stored separately
+	buffer[0]++;
+	shared2 = (struct test_bx_pcode *) bx_pcode_add((void *) buffer, DATA4_SIZE);
+	ck_assert_ptr_ne(shared2, NULL);
+	ck_assert_ptr_ne(shared2, shared1);
+	ck_assert_int_eq(bx_pcode_remove((struct bx_pcode *) shared2), 0);
+
+	// The copy is released with the last reference
+	ck_assert_int_eq(bx_pcode_remove((struct bx_pcode *) shared1), 0);
+	ck_assert_int_eq(shared1->valid, BX_BOOLEAN_TRUE);
+	ck_assert_int_eq(memcmp(shared1->instructions, DATA4, DATA4_SIZE), 0);
+	ck_assert_int_eq(bx_pcode_remove((struct bx_pcode *) shared1), 0);
+	ck_assert_int_eq(shared1->valid, BX_BOOLEAN_FALSE);
+	ck_assert_int_gt(bx_pcode_current_capacity(), capacity);
+	ck_assert_int_eq(bx_pcode_remove((struct bx_pcode *) shared1), -1);
 } END_TEST
 
 Suite *test_pcode_manager_create_suite() {
@@ -127,5 +215,13 @@ Suite *test_pcode_manager_create_suite() {
 	tcase_add_test(tcase, remove_test);
 	suite_add_tcase(suite, tcase);
 
+	tcase = tcase_create("fill_test");
+	tcase_add_test(tcase, fill_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("dedup_test");
+	tcase_add_test(tcase, dedup_test);
+	suite_add_tcase(suite, tcase);
+
 	return suite;
 }
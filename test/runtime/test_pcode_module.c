@@ -0,0 +1,176 @@
+/*
+ * test_pcode_module.c
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include "test_pcode_module.h"
+#include "runtime/pcode_module.h"
+#include "runtime/pcode_manager.h"
+#include "runtime/critical_section.h"
+#include "virtual_machine/virtual_machine.h"
+
+static bx_uint8 program1[] = { BX_INSTR_IPUSH_1, BX_INSTR_HALT };
+static bx_uint8 program2[] = { BX_INSTR_JUMP, 0x00, 0x03, BX_INSTR_NOP };
+static bx_uint8 invalid_program[] = { BX_INSTR_JUMP, 0x00, 0x02, BX_INSTR_HALT };
+
+static char module_path[] = "/tmp/bx_pcode_module_XXXXXX";
+
+/**
+ * Writes a module to the temporary module file
+ *
+ * @param first First program of the module
+ * @param first_size Size of the first program
+ *
+ * @return 0 on success, -1 on failure
+ */
+static bx_int8 write_module(bx_uint8 *first, bx_size first_size) {
+	void *programs[2];
+	bx_size sizes[2];
+
+	programs[0] = first;
+	sizes[0] = first_size;
+	programs[1] = program2;
+	sizes[1] = sizeof program2;
+
+	return bx_pmod_write(module_path, programs, sizes, 2);
+}
+
+START_TEST (init_test) {
+	bx_int8 error;
+	int fd;
+
+	error = bx_critical_init();
+	ck_assert_int_eq(error, 0);
+	error = bx_vm_virtual_machine_init();
+	ck_assert_int_eq(error, 0);
+	error = bx_pcode_init();
+	ck_assert_int_eq(error, 0);
+
+	fd = mkstemp(module_path);
+	ck_assert_int_ge(fd, 0);
+	close(fd);
+} END_TEST
+
+START_TEST (load_test) {
+	struct bx_pcode_module *module;
+	struct bx_pcode *pcode1;
+	struct bx_pcode *pcode2;
+	bx_size capacity;
+	bx_int8 error;
+
+	error = write_module(program1, sizeof program1);
+	ck_assert_int_eq(error, 0);
+
+	module = bx_pmod_open(module_path);
+	ck_assert_ptr_ne(module, NULL);
+	ck_assert_int_eq(bx_pmod_program_number(module), 2);
+
+	// Programs are executed from the mapping, not copied in the storage
+	capacity = bx_pcode_current_capacity();
+	pcode1 = bx_pmod_load(module, 0);
+	ck_assert_ptr_ne(pcode1, NULL);
+	pcode2 = bx_pmod_load(module, 1);
+	ck_assert_ptr_ne(pcode2, NULL);
+	ck_assert_ptr_eq(bx_pmod_load(module, 2), NULL);
+	ck_assert_int_eq(bx_pcode_current_capacity(), capacity);
+
+	error = bx_pcode_execute(pcode1);
+	ck_assert_int_eq(error, 0);
+	error = bx_pcode_execute(pcode2);
+	ck_assert_int_eq(error, 0);
+
+	// Rewriting the file replaces it and leaves the mapping untouched
+	error = bx_pmod_write(module_path, NULL, NULL, 0);
+	ck_assert_int_eq(error, 0);
+	error = bx_pcode_execute(pcode1);
+	ck_assert_int_eq(error, 0);
+	error = bx_pcode_execute(pcode2);
+	ck_assert_int_eq(error, 0);
+
+	// Loaded programs outlive the module handle
+	error = bx_pmod_close(module);
+	ck_assert_int_eq(error, 0);
+	error = bx_pmod_close(module);
+	ck_assert_int_eq(error, -1);
+	ck_assert_ptr_eq(bx_pmod_load(module, 0), NULL);
+	error = bx_pcode_execute(pcode1);
+	ck_assert_int_eq(error, 0);
+
+	error = bx_pcode_remove(pcode1);
+	ck_assert_int_eq(error, 0);
+	error = bx_pcode_execute(pcode2);
+	ck_assert_int_eq(error, 0);
+	error = bx_pcode_remove(pcode2);
+	ck_assert_int_eq(error, 0);
+} END_TEST
+
+START_TEST (invalid_test) {
+	struct bx_pcode_module *module;
+	bx_int8 error;
+
+	// Program with a jump in the middle of an instruction
+	error = write_module(invalid_program, sizeof invalid_program);
+	ck_assert_int_eq(error, 0);
+	module = bx_pmod_open(module_path);
+	ck_assert_ptr_eq(module, NULL);
+
+	// Truncated module
+	error = write_module(program1, sizeof program1);
+	ck_assert_int_eq(error, 0);
+	error = truncate(module_path, BX_PCODE_MODULE_HEADER_SIZE + BX_PCODE_MODULE_ENTRY_SIZE);
+	ck_assert_int_eq(error, 0);
+	module = bx_pmod_open(module_path);
+	ck_assert_ptr_eq(module, NULL);
+
+	module = bx_pmod_open("/nonexistent/module");
+	ck_assert_ptr_eq(module, NULL);
+
+	unlink(module_path);
+} END_TEST
+
+Suite *test_pcode_module_create_suite(void) {
+	Suite *suite = suite_create("pcode_module");
+	TCase *tcase;
+
+	tcase = tcase_create("init_test");
+	tcase_add_test(tcase, init_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("load_test");
+	tcase_add_test(tcase, load_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("invalid_test");
+	tcase_add_test(tcase, invalid_test);
+	suite_add_tcase(suite, tcase);
+
+	return suite;
+}
@@ -30,26 +30,120 @@
  */
 
 #include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "atomic.h"
 #include "test_task_scheduler.h"
 #include "virtual_machine/virtual_machine.h"
 #include "document_manager/document_manager.h"
 #include "document_manager/test_field.h"
 #include "runtime/task_scheduler.h"
+#include "runtime/pcode_manager.h"
 #include "compiler/codegen_pcode.h"
+#include "compiler/codegen_task.h"
 #include "virtual_machine/virtual_machine.h"
 #include "runtime/critical_section.h"
 
 #define INT_TEST_FIELD "int_test_field"
+#define WORKER_TASK_NUMBER 8
+#define REMOVE_ITERATIONS 2000
+#define REPLACE_FIELD "replace_field"
+#define REPLACE_ITERATIONS 200
 
 static struct bx_document_field int_test_field;
 static struct bx_test_field_data int_test_field_data;
 
 static bx_uint8 native_function_value;
 
+static bx_uint8 execution_order[2];
+static bx_uint8 execution_count;
+
 static void native_event_function() {
 	native_function_value = 1;
 }
 
+static bx_task_id coalescing_task_id;
+static bx_uint8 coalescing_count;
+
+static void coalescing_function() {
+	if (coalescing_count++ == 0) {
+		bx_sched_schedule_task(coalescing_task_id);
+		bx_sched_schedule_task(coalescing_task_id);
+	}
+}
+
+static void low_priority_function() {
+	execution_order[execution_count++] = BX_SCHED_LOWEST_PRIORITY;
+}
+
+static void high_priority_function() {
+	execution_order[execution_count++] = BX_SCHED_HIGHEST_PRIORITY;
+}
+
+static bx_uint8 worker_execution_count;
+
+static void sleeping_function() {
+	usleep(1000);
+}
+
+static void worker_function() {
+	bx_critical_enter();
+	worker_execution_count++;
+	bx_critical_exit();
+}
+
+static bx_task_id contended_task_id;
+static bx_boolean scheduling_active;
+
+/**
+ * Keeps scheduling the contended task, which is repeatedly removed and added
+ * again, or has its program replaced, by the main thread
+ */
+static void *scheduling_routine(void *arg) {
+
+	while (BX_ATOMIC_LOAD(&scheduling_active) == BX_BOOLEAN_TRUE) {
+		bx_sched_schedule_task(BX_ATOMIC_LOAD(&contended_task_id));
+	}
+
+	return NULL;
+}
+
+static bx_task_id replacing_task_id;
+static struct bx_comp_pcode *replacing_program;
+
+/**
+ * Set callback of the replace field: the task storing in the field replaces
+ * its own program
+ */
+static bx_int8 replace_field_set(struct bx_document_field *instance, void *data) {
+	return bx_sched_replace_pcode(replacing_task_id, replacing_program->data, replacing_program->size);
+}
+
+static bx_int8 replace_field_get(struct bx_document_field *instance, void *data) {
+	return -1;
+}
+
+/**
+ * Creates a program storing a constant in the integer test field
+ *
+ * @param value Constant to store
+ *
+ * @return Compiled program
+ */
+static struct bx_comp_pcode *create_store_program(bx_int32 value) {
+	struct bx_comp_pcode *comp_pcode;
+
+	comp_pcode = bx_cgpc_create();
+	ck_assert_ptr_ne(comp_pcode, NULL);
+	bx_cgpc_add_instruction(comp_pcode, BX_INSTR_PUSH32);
+	bx_cgpc_add_int_constant(comp_pcode, value);
+	bx_cgpc_add_instruction(comp_pcode, BX_INSTR_RSTORE32);
+	bx_cgpc_add_identifier(comp_pcode, INT_TEST_FIELD);
+	bx_cgpc_add_instruction(comp_pcode, BX_INSTR_HALT);
+
+	return comp_pcode;
+}
+
 START_TEST (init_test) {
 	bx_int8 error;
 
@@ -79,7 +173,8 @@ START_TEST (native_handler_test) {
 	bx_task_id native_task_id;
 
 	native_function_value = 0;
-	native_task_id = bx_sched_add_native_task(*native_event_function);
+	native_task_id = bx_sched_add_native_task(*native_event_function,
+			BX_SCHED_LOWEST_PRIORITY, BX_SCHED_NO_DEADLINE);
 	ck_assert_int_ne(native_task_id, -1);
 	ck_assert_int_ne(native_function_value, 1);
 	error = bx_sched_schedule_task(native_task_id);
@@ -104,7 +199,8 @@ START_TEST (pcode_handler_test) {
 	bx_cgpc_add_identifier(comp_pcode, INT_TEST_FIELD);
 	bx_cgpc_add_instruction(comp_pcode, BX_INSTR_HALT);
 
-	pcode_task_id = bx_sched_add_pcode_task(comp_pcode->data, comp_pcode->size);
+	pcode_task_id = bx_sched_add_pcode_task(comp_pcode->data, comp_pcode->size,
+			BX_SCHED_LOWEST_PRIORITY, BX_SCHED_NO_DEADLINE);
 	ck_assert_int_ne(pcode_task_id, -1);
 	ck_assert_int_ne(bx_tfield_get_int(&int_test_field), 1);
 	error = bx_sched_schedule_task(pcode_task_id);
@@ -117,6 +213,427 @@ START_TEST (pcode_handler_test) {
 	ck_assert_int_eq(error, 0);
 } END_TEST
 
+START_TEST (priority_test) {
+	bx_int8 error;
+	bx_task_id low_task_id;
+	bx_task_id high_task_id;
+
+	execution_count = 0;
+	low_task_id = bx_sched_add_native_task(*low_priority_function,
+			BX_SCHED_LOWEST_PRIORITY, BX_SCHED_NO_DEADLINE);
+	ck_assert_int_ne(low_task_id, -1);
+	high_task_id = bx_sched_add_native_task(*high_priority_function,
+			BX_SCHED_HIGHEST_PRIORITY, 1000);
+	ck_assert_int_ne(high_task_id, -1);
+	ck_assert_int_eq(bx_sched_add_native_task(*low_priority_function,
+			EV_PRIORITY_LEVELS, BX_SCHED_NO_DEADLINE), -1);
+
+	error = bx_sched_schedule_task(low_task_id);
+	ck_assert_int_eq(error, 0);
+	error = bx_sched_schedule_task(high_task_id);
+	ck_assert_int_eq(error, 0);
+	error = bx_sched_schedule_task(high_task_id);
+	ck_assert_int_eq(error, -1);
+	bx_sched_scheduler_loop(BX_BOOLEAN_TRUE);
+	ck_assert_int_eq(execution_count, 2);
+	ck_assert_int_eq(execution_order[0], BX_SCHED_HIGHEST_PRIORITY);
+	ck_assert_int_eq(execution_order[1], BX_SCHED_LOWEST_PRIORITY);
+	ck_assert_int_eq(bx_sched_get_deadline_misses(high_task_id), 0);
+
+	error = bx_sched_remove_task(low_task_id);
+	ck_assert_int_eq(error, 0);
+	error = bx_sched_remove_task(high_task_id);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(bx_sched_get_deadline_misses(high_task_id), -1);
+} END_TEST
+
+START_TEST (worker_test) {
+	bx_int8 error;
+	bx_task_id task_id[WORKER_TASK_NUMBER];
+	bx_uint8 executed;
+	int i;
+
+	worker_execution_count = 0;
+	for (i = 0; i < WORKER_TASK_NUMBER; i++) {
+		task_id[i] = bx_sched_add_native_task(*worker_function,
+				BX_SCHED_LOWEST_PRIORITY, BX_SCHED_NO_DEADLINE);
+		ck_assert_int_ne(task_id[i], -1);
+	}
+
+	error = bx_sched_start_workers(2);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(bx_sched_start_workers(2), -1);
+	ck_assert_int_eq(bx_sched_simulate(1000), -1);
+	// Rejected as well, the workers run the scheduled tasks
+	bx_sched_scheduler_loop(BX_BOOLEAN_TRUE);
+	for (i = 0; i < WORKER_TASK_NUMBER; i++) {
+		error = bx_sched_schedule_task(task_id[i]);
+		ck_assert_int_eq(error, 0);
+	}
+	for (i = 0; i < 100; i++) {
+		bx_critical_enter();
+		executed = worker_execution_count;
+		bx_critical_exit();
+		if (executed == WORKER_TASK_NUMBER) {
+			break;
+		}
+		usleep(10000);
+	}
+	error = bx_sched_stop_workers();
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(worker_execution_count, WORKER_TASK_NUMBER);
+
+	for (i = 0; i < WORKER_TASK_NUMBER; i++) {
+		ck_assert_int_eq(bx_sched_is_scheduled(task_id[i]), 0);
+		error = bx_sched_remove_task(task_id[i]);
+		ck_assert_int_eq(error, 0);
+	}
+} END_TEST
+
+START_TEST (stats_test) {
+	bx_int8 error;
+	bx_task_id task_id;
+	struct bx_task_stats stats;
+	struct bx_task_stats all_stats[EV_MAX_TASKS];
+	bx_ssize task_number;
+	bx_uint32 latency_count;
+	int i;
+
+	task_id = bx_sched_add_native_task(*sleeping_function,
+			BX_SCHED_LOWEST_PRIORITY, BX_SCHED_NO_DEADLINE);
+	ck_assert_int_ne(task_id, -1);
+	error = bx_sched_get_stats(task_id, &stats);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(stats.task_id, task_id);
+	ck_assert_int_eq(stats.run_count, 0);
+
+	// Scheduling a pending task is an overrun
+	error = bx_sched_schedule_task(task_id);
+	ck_assert_int_eq(error, 0);
+	error = bx_sched_schedule_task(task_id);
+	ck_assert_int_eq(error, -1);
+	bx_sched_scheduler_loop(BX_BOOLEAN_TRUE);
+	error = bx_sched_schedule_task(task_id);
+	ck_assert_int_eq(error, 0);
+	bx_sched_scheduler_loop(BX_BOOLEAN_TRUE);
+
+	error = bx_sched_get_stats(task_id, &stats);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(stats.run_count, 2);
+	ck_assert_int_eq(stats.overruns, 1);
+	ck_assert_int_ge(stats.min_execution_usec, 1000);
+	ck_assert_int_ge(stats.max_execution_usec, stats.min_execution_usec);
+	ck_assert_int_ge(stats.total_execution_usec, stats.min_execution_usec + stats.max_execution_usec);
+	latency_count = 0;
+	for (i = 0; i < EV_LATENCY_BUCKETS; i++) {
+		latency_count += stats.latency_histogram[i];
+	}
+	ck_assert_int_eq(latency_count, 2);
+
+	task_number = bx_sched_get_all_stats(all_stats, EV_MAX_TASKS);
+	ck_assert_int_eq(task_number, 1);
+	ck_assert_int_eq(all_stats[0].task_id, task_id);
+	ck_assert_int_eq(all_stats[0].run_count, 2);
+	bx_sched_dump_stats();
+
+	error = bx_sched_remove_task(task_id);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(bx_sched_get_stats(task_id, &stats), -1);
+} END_TEST
+
+START_TEST (overrun_policy_test) {
+	bx_int8 error;
+	bx_task_id task_id;
+	bx_task_id blocked_task_id;
+	struct bx_task_stats stats;
+	struct bx_sched_metrics metrics;
+
+	task_id = bx_sched_add_native_task(*native_event_function,
+			BX_SCHED_LOWEST_PRIORITY, BX_SCHED_NO_DEADLINE);
+	ck_assert_int_ne(task_id, -1);
+	ck_assert_int_eq(bx_sched_get_overrun_policy(task_id), BX_SCHED_OVERRUN_SKIP);
+
+	// Queue up to 2 further executions
+	error = bx_sched_set_overrun_policy(task_id, BX_SCHED_OVERRUN_QUEUE, 2);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(bx_sched_schedule_task(task_id), 0);
+	ck_assert_int_eq(bx_sched_schedule_task(task_id), 0);
+	ck_assert_int_eq(bx_sched_schedule_task(task_id), 0);
+	ck_assert_int_eq(bx_sched_schedule_task(task_id), -1);
+	bx_sched_scheduler_loop(BX_BOOLEAN_TRUE);
+	error = bx_sched_get_stats(task_id, &stats);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(stats.run_count, 3);
+	ck_assert_int_eq(stats.overruns, 3);
+	ck_assert_int_eq(stats.skipped, 1);
+	ck_assert_int_eq(bx_sched_is_scheduled(task_id), 0);
+
+	// A burst received before the execution starts runs once
+	error = bx_sched_set_overrun_policy(task_id, BX_SCHED_OVERRUN_COALESCE, 0);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(bx_sched_schedule_task(task_id), 0);
+	ck_assert_int_eq(bx_sched_schedule_task(task_id), 0);
+	ck_assert_int_eq(bx_sched_schedule_task(task_id), 0);
+	ck_assert_int_eq(bx_sched_schedule_task(task_id), 0);
+	bx_sched_scheduler_loop(BX_BOOLEAN_TRUE);
+	error = bx_sched_get_stats(task_id, &stats);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(stats.run_count, 4);
+	ck_assert_int_eq(stats.coalesced, 3);
+	ck_assert_int_eq(bx_sched_set_overrun_policy(task_id, BX_SCHED_OVERRUN_DEGRADE + 1, 0), -1);
+
+	// A burst received while executing runs once after the execution
+	coalescing_count = 0;
+	coalescing_task_id = bx_sched_add_native_task(*coalescing_function,
+			BX_SCHED_LOWEST_PRIORITY, BX_SCHED_NO_DEADLINE);
+	ck_assert_int_ne(coalescing_task_id, -1);
+	error = bx_sched_set_overrun_policy(coalescing_task_id, BX_SCHED_OVERRUN_COALESCE, 0);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(bx_sched_schedule_task(coalescing_task_id), 0);
+	bx_sched_scheduler_loop(BX_BOOLEAN_TRUE);
+	ck_assert_int_eq(coalescing_count, 2);
+	error = bx_sched_get_stats(coalescing_task_id, &stats);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(stats.run_count, 2);
+	ck_assert_int_eq(stats.coalesced, 1);
+	ck_assert_int_eq(bx_sched_is_scheduled(coalescing_task_id), 0);
+	error = bx_sched_remove_task(coalescing_task_id);
+	ck_assert_int_eq(error, 0);
+
+	// Only the highest priority tasks are admitted beyond the limit
+	blocked_task_id = bx_sched_add_native_task(*native_event_function,
+			BX_SCHED_HIGHEST_PRIORITY, BX_SCHED_NO_DEADLINE);
+	ck_assert_int_ne(blocked_task_id, -1);
+	bx_sched_set_admission_limit(0);
+	ck_assert_int_eq(bx_sched_schedule_task(task_id), -1);
+	ck_assert_int_eq(bx_sched_schedule_task(blocked_task_id), 0);
+	error = bx_sched_get_metrics(&metrics);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(metrics.ready_tasks, 1);
+	ck_assert_int_eq(metrics.admission_rejections, 1);
+	ck_assert_int_ge(metrics.max_ready_tasks, 1);
+	bx_sched_scheduler_loop(BX_BOOLEAN_TRUE);
+	bx_sched_set_admission_limit(EV_READY_LIMIT);
+	error = bx_sched_get_metrics(&metrics);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(metrics.ready_tasks, 0);
+
+	error = bx_sched_remove_task(task_id);
+	ck_assert_int_eq(error, 0);
+	error = bx_sched_remove_task(blocked_task_id);
+	ck_assert_int_eq(error, 0);
+} END_TEST
+
+START_TEST (compiled_task_test) {
+	struct bx_task_state states[EV_MAX_TASKS];
+	struct bx_comp_task *comp_task;
+	bx_task_id task_id;
+	bx_ssize state_number;
+	bx_ssize i;
+
+	// The task keeps the priority and the deadline declared in the script
+	comp_task = bx_cgtk_create_task();
+	ck_assert_ptr_ne(comp_task, NULL);
+	bx_cgpc_add_instruction(comp_task->pcode, BX_INSTR_HALT);
+	ck_assert_int_eq(bx_cgtk_set_priority(comp_task, BX_SCHED_HIGHEST_PRIORITY), 0);
+	ck_assert_int_eq(bx_cgtk_set_deadline(comp_task, 50), 0);
+	task_id = bx_cgtk_add_to_scheduler(comp_task);
+	ck_assert_int_ne(task_id, -1);
+	bx_cgtk_destroy_task(comp_task);
+
+	state_number = bx_sched_get_task_states(states, EV_MAX_TASKS);
+	for (i = 0; i < state_number && states[i].task_id != task_id; i++) {
+	}
+	ck_assert_int_lt(i, state_number);
+	ck_assert_int_eq(states[i].priority, BX_SCHED_HIGHEST_PRIORITY);
+	ck_assert_int_eq(states[i].deadline_msec, 50);
+	ck_assert_int_eq(bx_sched_remove_task(task_id), 0);
+
+	ck_assert_int_eq(bx_cgtk_add_to_scheduler(NULL), -1);
+} END_TEST
+
+START_TEST (replace_pcode_test) {
+	struct bx_comp_pcode *program[2];
+	struct bx_task_stats stats;
+	bx_task_id pcode_task_id;
+	bx_task_id native_task_id;
+	bx_int32 value;
+	bx_int8 error;
+	int i;
+
+	program[0] = create_store_program(10);
+	program[1] = create_store_program(20);
+	pcode_task_id = bx_sched_add_pcode_task(program[0]->data, program[0]->size,
+			BX_SCHED_LOWEST_PRIORITY, BX_SCHED_NO_DEADLINE);
+	ck_assert_int_ne(pcode_task_id, -1);
+
+	// A pending execution runs the new program
+	error = bx_sched_schedule_task(pcode_task_id);
+	ck_assert_int_eq(error, 0);
+	error = bx_sched_replace_pcode(pcode_task_id, program[1]->data, program[1]->size);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(bx_sched_is_scheduled(pcode_task_id), 1);
+	bx_sched_scheduler_loop(BX_BOOLEAN_TRUE);
+	ck_assert_int_eq(bx_tfield_get_int(&int_test_field), 20);
+	error = bx_sched_get_stats(pcode_task_id, &stats);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(stats.run_count, 1);
+
+	// Replace the program while the workers execute it
+	error = bx_sched_set_overrun_policy(pcode_task_id, BX_SCHED_OVERRUN_COALESCE, 0);
+	ck_assert_int_eq(error, 0);
+	error = bx_sched_start_workers(2);
+	ck_assert_int_eq(error, 0);
+	for (i = 0; i < 200; i++) {
+		bx_sched_schedule_task(pcode_task_id);
+		error = bx_sched_replace_pcode(pcode_task_id, program[i % 2]->data, program[i % 2]->size);
+		ck_assert_int_eq(error, 0);
+	}
+	while (bx_sched_is_scheduled(pcode_task_id) == 1) {
+		usleep(1000);
+	}
+	error = bx_sched_stop_workers();
+	ck_assert_int_eq(error, 0);
+	value = bx_tfield_get_int(&int_test_field);
+	ck_assert(value == 10 || value == 20);
+
+	bx_sched_schedule_task(pcode_task_id);
+	bx_sched_scheduler_loop(BX_BOOLEAN_TRUE);
+	ck_assert_int_eq(bx_tfield_get_int(&int_test_field), 20);
+
+	// Native tasks have no program to replace
+	native_task_id = bx_sched_add_native_task(*native_event_function,
+			BX_SCHED_LOWEST_PRIORITY, BX_SCHED_NO_DEADLINE);
+	ck_assert_int_ne(native_task_id, -1);
+	error = bx_sched_replace_pcode(native_task_id, program[0]->data, program[0]->size);
+	ck_assert_int_eq(error, -1);
+	error = bx_sched_replace_pcode(EV_MAX_TASKS, program[0]->data, program[0]->size);
+	ck_assert_int_eq(error, -1);
+
+	error = bx_sched_remove_task(native_task_id);
+	ck_assert_int_eq(error, 0);
+	error = bx_sched_remove_task(pcode_task_id);
+	ck_assert_int_eq(error, 0);
+	bx_cgpc_destroy(program[0]);
+	bx_cgpc_destroy(program[1]);
+} END_TEST
+
+START_TEST (replace_running_test) {
+	static struct bx_document_field replace_field;
+	struct bx_comp_pcode *program[3];
+	bx_task_id task_id;
+	bx_size capacity;
+	pthread_t scheduler;
+	bx_int8 error;
+	int i;
+
+	capacity = bx_pcode_current_capacity();
+	program[0] = create_store_program(10);
+	program[1] = create_store_program(20);
+
+	// The program of a task is replaced by the task itself
+	replace_field.type = BX_INT;
+	replace_field.private_data = NULL;
+	replace_field.get = &replace_field_get;
+	replace_field.set = &replace_field_set;
+	error = bx_docman_add_field(&replace_field, REPLACE_FIELD);
+	ck_assert_int_eq(error, 0);
+	program[2] = bx_cgpc_create();
+	ck_assert_ptr_ne(program[2], NULL);
+	bx_cgpc_add_instruction(program[2], BX_INSTR_PUSH32);
+	bx_cgpc_add_int_constant(program[2], 1);
+	bx_cgpc_add_instruction(program[2], BX_INSTR_RSTORE32);
+	bx_cgpc_add_identifier(program[2], REPLACE_FIELD);
+	bx_cgpc_add_instruction(program[2], BX_INSTR_HALT);
+	task_id = bx_sched_add_pcode_task(program[2]->data, program[2]->size,
+			BX_SCHED_LOWEST_PRIORITY, BX_SCHED_NO_DEADLINE);
+	ck_assert_int_ne(task_id, -1);
+	replacing_task_id = task_id;
+	replacing_program = program[0];
+	bx_tfield_set_int(&int_test_field, 0);
+	error = bx_sched_schedule_task(task_id);
+	ck_assert_int_eq(error, 0);
+	bx_sched_scheduler_loop(BX_BOOLEAN_TRUE);
+	ck_assert_int_eq(bx_tfield_get_int(&int_test_field), 0);
+	error = bx_sched_schedule_task(task_id);
+	ck_assert_int_eq(error, 0);
+	bx_sched_scheduler_loop(BX_BOOLEAN_TRUE);
+	ck_assert_int_eq(bx_tfield_get_int(&int_test_field), 10);
+
+	// Replacing a task that is scheduled again as soon as it completes
+	error = bx_sched_set_overrun_policy(task_id, BX_SCHED_OVERRUN_COALESCE, 0);
+	ck_assert_int_eq(error, 0);
+	BX_ATOMIC_STORE(&contended_task_id, task_id);
+	BX_ATOMIC_STORE(&scheduling_active, BX_BOOLEAN_TRUE);
+	error = bx_sched_start_workers(2);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(pthread_create(&scheduler, NULL, scheduling_routine, NULL), 0);
+	for (i = 0; i < REPLACE_ITERATIONS; i++) {
+		error = bx_sched_replace_pcode(task_id, program[i % 2]->data, program[i % 2]->size);
+		ck_assert_int_eq(error, 0);
+	}
+	BX_ATOMIC_STORE(&scheduling_active, BX_BOOLEAN_FALSE);
+	ck_assert_int_eq(pthread_join(scheduler, NULL), 0);
+	bx_sched_schedule_task(task_id);
+	while (bx_sched_is_scheduled(task_id) == 1) {
+		usleep(1000);
+	}
+	error = bx_sched_stop_workers();
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(bx_tfield_get_int(&int_test_field), 20);
+
+	// Every replaced program was removed
+	error = bx_sched_remove_task(task_id);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(bx_pcode_current_capacity(), capacity);
+	bx_cgpc_destroy(program[0]);
+	bx_cgpc_destroy(program[1]);
+	bx_cgpc_destroy(program[2]);
+} END_TEST
+
+START_TEST (remove_schedule_test) {
+	struct bx_comp_pcode *program;
+	struct bx_sched_metrics metrics;
+	pthread_t thread;
+	bx_task_id task_id;
+	bx_int8 error;
+	int i;
+
+	// Tasks are removed while another thread schedules them
+	program = create_store_program(30);
+	task_id = bx_sched_add_pcode_task(program->data, program->size,
+			BX_SCHED_LOWEST_PRIORITY, BX_SCHED_NO_DEADLINE);
+	ck_assert_int_ne(task_id, -1);
+	error = bx_sched_set_overrun_policy(task_id, BX_SCHED_OVERRUN_QUEUE, 4);
+	ck_assert_int_eq(error, 0);
+	BX_ATOMIC_STORE(&contended_task_id, task_id);
+	BX_ATOMIC_STORE(&scheduling_active, BX_BOOLEAN_TRUE);
+	ck_assert_int_eq(pthread_create(&thread, NULL, scheduling_routine, NULL), 0);
+
+	for (i = 0; i < REMOVE_ITERATIONS; i++) {
+		// Removal fails in the short window in which the task is being released
+		while (bx_sched_remove_task(task_id) != 0) {
+			bx_sched_scheduler_loop(BX_BOOLEAN_TRUE);
+		}
+		task_id = bx_sched_add_pcode_task(program->data, program->size,
+				BX_SCHED_LOWEST_PRIORITY, BX_SCHED_NO_DEADLINE);
+		ck_assert_int_ne(task_id, -1);
+		BX_ATOMIC_STORE(&contended_task_id, task_id);
+	}
+
+	BX_ATOMIC_STORE(&scheduling_active, BX_BOOLEAN_FALSE);
+	pthread_join(thread, NULL);
+	bx_sched_schedule_task(task_id);
+	bx_sched_scheduler_loop(BX_BOOLEAN_TRUE);
+	ck_assert_int_eq(bx_tfield_get_int(&int_test_field), 30);
+	error = bx_sched_remove_task(task_id);
+	ck_assert_int_eq(error, 0);
+	error = bx_sched_get_metrics(&metrics);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(metrics.ready_tasks, 0);
+	bx_cgpc_destroy(program);
+} END_TEST
+
 Suite *test_task_scheduler_create_suite() {
 	Suite *suite = suite_create("task_scheduler");
 	TCase *tcase;
@@ -133,5 +650,37 @@ Suite *test_task_scheduler_create_suite() {
 	tcase_add_test(tcase, pcode_handler_test);
 	suite_add_tcase(suite, tcase);
 
+	tcase = tcase_create("priority_test");
+	tcase_add_test(tcase, priority_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("worker_test");
+	tcase_add_test(tcase, worker_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("stats_test");
+	tcase_add_test(tcase, stats_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("overrun_policy_test");
+	tcase_add_test(tcase, overrun_policy_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("compiled_task_test");
+	tcase_add_test(tcase, compiled_task_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("replace_pcode_test");
+	tcase_add_test(tcase, replace_pcode_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("replace_running_test");
+	tcase_add_test(tcase, replace_running_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("remove_schedule_test");
+	tcase_add_test(tcase, remove_schedule_test);
+	suite_add_tcase(suite, tcase);
+
 	return suite;
 }
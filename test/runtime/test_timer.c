@@ -32,9 +32,17 @@
 #include "test_timer.h"
 #include <unistd.h>
 #include "runtime/timer.h"
+#include "runtime/tick.h"
 #include "runtime/critical_section.h"
+#include "runtime/task_scheduler.h"
 #include "configuration.h"
 
+static bx_uint32 execution_count;
+
+static void timer_function() {
+	execution_count++;
+}
+
 START_TEST (timer_init) {
 	bx_int8 error;
 
@@ -55,6 +63,151 @@ START_TEST (timer_ticking) {
 	ck_assert_int_gt(bx_timer_get_tick_count(), previous_count);
 } END_TEST
 
+START_TEST (timer_periodic) {
+	bx_task_id task_id;
+	bx_timer_id timer_id;
+	bx_uint32 executions;
+
+	execution_count = 0;
+	task_id = bx_sched_add_native_task(*timer_function,
+			BX_SCHED_LOWEST_PRIORITY, BX_SCHED_NO_DEADLINE);
+	ck_assert_int_ne(task_id, -1);
+	timer_id = bx_timer_add_timer(BX_TIMER_PERIODIC, 2 * TM_DEFAULT_RESOLUTION_USEC, task_id);
+	ck_assert_int_ne(timer_id, -1);
+
+	usleep(9 * TM_DEFAULT_RESOLUTION_USEC);
+	bx_sched_scheduler_loop(BX_BOOLEAN_TRUE);
+	usleep(9 * TM_DEFAULT_RESOLUTION_USEC);
+	bx_sched_scheduler_loop(BX_BOOLEAN_TRUE);
+	ck_assert_int_ge(execution_count, 2);
+
+	// No execution after the cancellation
+	ck_assert_int_eq(bx_timer_cancel(timer_id), 0);
+	ck_assert_int_eq(bx_timer_cancel(timer_id), -1);
+	bx_sched_scheduler_loop(BX_BOOLEAN_TRUE);
+	executions = execution_count;
+	usleep(4 * TM_DEFAULT_RESOLUTION_USEC);
+	bx_sched_scheduler_loop(BX_BOOLEAN_TRUE);
+	ck_assert_int_eq(execution_count, executions);
+
+	ck_assert_int_eq(bx_sched_remove_task(task_id), 0);
+} END_TEST
+
+START_TEST (timer_one_off) {
+	bx_task_id task_id;
+	bx_timer_id timer_id;
+
+	execution_count = 0;
+	task_id = bx_sched_add_native_task(*timer_function,
+			BX_SCHED_LOWEST_PRIORITY, BX_SCHED_NO_DEADLINE);
+	ck_assert_int_ne(task_id, -1);
+	timer_id = bx_timer_add_timer(BX_TIMER_ONE_OFF, TM_DEFAULT_RESOLUTION_USEC, task_id);
+	ck_assert_int_ne(timer_id, -1);
+	ck_assert_int_eq(bx_timer_add_timer(BX_TIMER_ONE_OFF, TM_DEFAULT_RESOLUTION_USEC, -1), -1);
+
+	usleep(4 * TM_DEFAULT_RESOLUTION_USEC);
+	bx_sched_scheduler_loop(BX_BOOLEAN_TRUE);
+	ck_assert_int_eq(execution_count, 1);
+	ck_assert_int_eq(bx_timer_cancel(timer_id), -1);
+
+	ck_assert_int_eq(bx_sched_remove_task(task_id), 0);
+} END_TEST
+
+START_TEST (timer_stats) {
+	struct bx_timer_stats stats;
+	struct bx_timer_stats global_stats;
+	bx_task_id task_id;
+	bx_timer_id timer_id;
+	bx_uint32 histogram_count;
+	bx_size i;
+
+	for (i = 1; i < TM_LATENCY_BUCKETS; i++) {
+		ck_assert_int_gt(bx_timer_get_bucket_usec(i), bx_timer_get_bucket_usec(i - 1));
+	}
+
+	task_id = bx_sched_add_native_task(*timer_function,
+			BX_SCHED_LOWEST_PRIORITY, BX_SCHED_NO_DEADLINE);
+	ck_assert_int_ne(task_id, -1);
+	timer_id = bx_timer_add_timer(BX_TIMER_PERIODIC, TM_DEFAULT_RESOLUTION_USEC, task_id);
+	ck_assert_int_ne(timer_id, -1);
+	ck_assert_int_eq(bx_timer_get_stats(timer_id, &stats), 0);
+	ck_assert_int_eq(stats.timer_id, timer_id);
+	ck_assert_int_eq(stats.fire_count, 0);
+
+	usleep(4 * TM_DEFAULT_RESOLUTION_USEC);
+	ck_assert_int_eq(bx_timer_cancel(timer_id), 0);
+	bx_sched_scheduler_loop(BX_BOOLEAN_TRUE);
+
+	// Statistics survive the cancellation
+	ck_assert_int_eq(bx_timer_get_stats(timer_id, &stats), 0);
+	ck_assert_int_ge(stats.fire_count, 2);
+	ck_assert_int_le(stats.min_lateness_usec, stats.max_lateness_usec);
+	ck_assert_int_le(stats.max_lateness_usec, TM_DEFAULT_RESOLUTION_USEC);
+	histogram_count = 0;
+	for (i = 0; i < TM_LATENCY_BUCKETS; i++) {
+		histogram_count += stats.lateness_histogram[i];
+	}
+	ck_assert_int_eq(histogram_count, stats.fire_count);
+
+	ck_assert_int_eq(bx_timer_get_global_stats(&global_stats), 0);
+	ck_assert_int_eq(global_stats.timer_id, -1);
+	ck_assert_int_ge(global_stats.fire_count, stats.fire_count);
+	ck_assert_int_eq(bx_timer_get_stats(-1, &stats), -1);
+
+	ck_assert_int_eq(bx_sched_remove_task(task_id), 0);
+} END_TEST
+
+START_TEST (timer_capacity) {
+	static bx_timer_id timer_id[TM_MAX_TIMERS];
+	bx_task_id task_id;
+	int i;
+
+	task_id = bx_sched_add_native_task(*timer_function,
+			BX_SCHED_LOWEST_PRIORITY, BX_SCHED_NO_DEADLINE);
+	ck_assert_int_ne(task_id, -1);
+	for (i = 0; i < TM_MAX_TIMERS; i++) {
+		timer_id[i] = bx_timer_add_timer(BX_TIMER_PERIODIC, (bx_int64) (i + 1) * 60 * 1000 * 1000, task_id);
+		ck_assert_int_ne(timer_id[i], -1);
+	}
+	ck_assert_int_eq(bx_timer_add_timer(BX_TIMER_PERIODIC, 1000 * 1000, task_id), -1);
+	for (i = 0; i < TM_MAX_TIMERS; i++) {
+		ck_assert_int_eq(bx_timer_cancel(timer_id[i]), 0);
+	}
+
+	ck_assert_int_eq(bx_sched_remove_task(task_id), 0);
+} END_TEST
+
+START_TEST (timer_resolution) {
+	bx_task_id task_id;
+	bx_timer_id timer_id;
+	bx_uint64 start_usec;
+
+	ck_assert_int_eq(bx_timer_get_resolution(), TM_DEFAULT_RESOLUTION_USEC);
+	ck_assert_int_eq(bx_timer_set_resolution(TM_MIN_RESOLUTION_USEC - 1), -1);
+	ck_assert_int_eq(bx_timer_set_resolution(1000), 0);
+	ck_assert_int_eq(bx_timer_get_resolution(), 1000);
+
+	// 1 kHz periodic timer
+	execution_count = 0;
+	task_id = bx_sched_add_native_task(*timer_function,
+			BX_SCHED_LOWEST_PRIORITY, BX_SCHED_NO_DEADLINE);
+	ck_assert_int_ne(task_id, -1);
+	timer_id = bx_timer_add_timer(BX_TIMER_PERIODIC, 1000, task_id);
+	ck_assert_int_ne(timer_id, -1);
+	start_usec = bx_tick_get_time_usec();
+	while (bx_tick_get_time_usec() - start_usec < 100 * 1000) {
+		bx_sched_scheduler_loop(BX_BOOLEAN_TRUE);
+		usleep(100);
+	}
+	ck_assert_int_eq(bx_timer_cancel(timer_id), 0);
+	bx_sched_scheduler_loop(BX_BOOLEAN_TRUE);
+	ck_assert_int_ge(execution_count, 25);
+	ck_assert_int_le(execution_count, 110);
+
+	ck_assert_int_eq(bx_sched_remove_task(task_id), 0);
+	ck_assert_int_eq(bx_timer_set_resolution(TM_DEFAULT_RESOLUTION_USEC), 0);
+} END_TEST
+
 START_TEST (timer_stop) {
 	bx_int8 error;
 	bx_uint64 previous_count;
@@ -66,6 +219,51 @@ START_TEST (timer_stop) {
 	ck_assert_int_eq(bx_timer_get_tick_count(), previous_count);
 } END_TEST
 
+START_TEST (timer_virtual_clock) {
+	struct bx_timer_stats stats;
+	bx_task_id task_id;
+	bx_timer_id timer_id;
+	bx_uint64 day_usec;
+
+	day_usec = (bx_uint64) 24 * 60 * 60 * 1000 * 1000;
+	ck_assert_int_eq(bx_tick_use_virtual_clock(BX_BOOLEAN_TRUE), 0);
+	ck_assert_int_eq(bx_timer_init(), 0);
+	ck_assert_int_eq(bx_tick_use_virtual_clock(BX_BOOLEAN_FALSE), -1);
+	ck_assert_int_eq(bx_tick_get_time_usec(), 0);
+
+	// A simulated day of a 1 Hz periodic timer and a one-off timer
+	execution_count = 0;
+	task_id = bx_sched_add_native_task(*timer_function,
+			BX_SCHED_LOWEST_PRIORITY, BX_SCHED_NO_DEADLINE);
+	ck_assert_int_ne(task_id, -1);
+	timer_id = bx_timer_add_timer(BX_TIMER_PERIODIC, 1000 * 1000, task_id);
+	ck_assert_int_ne(timer_id, -1);
+	ck_assert_int_ne(bx_timer_add_timer(BX_TIMER_ONE_OFF, 1500 * 1000, task_id), -1);
+	ck_assert_int_eq(bx_sched_simulate(day_usec), 0);
+	ck_assert_int_eq(bx_tick_get_time_usec(), day_usec);
+	ck_assert_int_eq(execution_count, 24 * 60 * 60 + 1);
+
+	// Tasks run at the simulated expiry time
+	ck_assert_int_eq(bx_timer_get_stats(timer_id, &stats), 0);
+	ck_assert_int_eq(stats.fire_count, 24 * 60 * 60);
+	ck_assert_int_eq(stats.max_lateness_usec, 0);
+
+	ck_assert_int_eq(bx_timer_cancel(timer_id), 0);
+
+	// Ticks without expiries are skipped without missing the cascades
+	execution_count = 0;
+	ck_assert_int_ne(bx_timer_add_timer(BX_TIMER_ONE_OFF, 10 * 60 * 1000 * 1000, task_id), -1);
+	ck_assert_int_ne(bx_timer_add_timer(BX_TIMER_ONE_OFF, 1500 * 1000, task_id), -1);
+	ck_assert_int_eq(bx_sched_simulate(10 * 60 * 1000 * 1000), 0);
+	ck_assert_int_eq(execution_count, 2);
+	ck_assert_int_eq(bx_timer_get_global_stats(&stats), 0);
+	ck_assert_int_eq(stats.max_lateness_usec, 0);
+
+	ck_assert_int_eq(bx_sched_remove_task(task_id), 0);
+	ck_assert_int_eq(bx_timer_destroy(), 0);
+	ck_assert_int_eq(bx_tick_use_virtual_clock(BX_BOOLEAN_FALSE), 0);
+} END_TEST
+
 Suite *test_timer_create_suite() {
 	Suite *suite = suite_create("timer");
 	TCase *tcase;
@@ -78,9 +276,33 @@ Suite *test_timer_create_suite() {
 	tcase_add_test(tcase, timer_ticking);
 	suite_add_tcase(suite, tcase);
 
+	tcase = tcase_create("timer_periodic");
+	tcase_add_test(tcase, timer_periodic);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("timer_one_off");
+	tcase_add_test(tcase, timer_one_off);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("timer_stats");
+	tcase_add_test(tcase, timer_stats);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("timer_capacity");
+	tcase_add_test(tcase, timer_capacity);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("timer_resolution");
+	tcase_add_test(tcase, timer_resolution);
+	suite_add_tcase(suite, tcase);
+
 	tcase = tcase_create("timer_stop");
 	tcase_add_test(tcase, timer_stop);
 	suite_add_tcase(suite, tcase);
 
+	tcase = tcase_create("timer_virtual_clock");
+	tcase_add_test(tcase, timer_virtual_clock);
+	suite_add_tcase(suite, tcase);
+
 	return suite;
 }
@@ -35,10 +35,18 @@
 #include "utils/test_list.h"
 #include "utils/test_byte_buffer.h"
 #include "utils/test_uniform_allocator.h"
+#include "utils/test_buddy_allocator.h"
 #include "utils/test_linked_list.h"
 #include "utils/test_fmemopen.h"
 #include "utils/test_memory_utils.h"
+#include "utils/test_mpsc_queue.h"
+#include "utils/test_seqlock.h"
 #include "document_manager/test_document_manager.h"
+#include "document_manager/test_memory_map_field.h"
+#include "document_manager/test_field_column.h"
+#include "document_manager/test_field_history.h"
+#include "document_manager/test_field_window.h"
+#include "document_manager/test_field_journal.h"
 #include "virtual_machine/test_virtual_machine.h"
 #include "compiler/test_codegen_symbol_table.h"
 #include "compiler/test_codegen_pcode.h"
@@ -51,8 +59,12 @@
 #include "compiler/test_codegen_task.h"
 #include "compiler/test_compiler.h"
 #include "runtime/test_pcode_manager.h"
+#include "runtime/test_pcode_module.h"
 #include "runtime/test_timer.h"
 #include "runtime/test_task_scheduler.h"
+#include "runtime/test_checkpoint.h"
+#include "bus/test_bus.h"
+#include "bus/test_datagram_interface.h"
 
 int main(void) {
 	int number_failed = 0;
@@ -63,11 +75,19 @@ int main(void) {
 	srunner_add_suite(runner, test_list_create_suite());
 	srunner_add_suite(runner, test_byte_buffer_create_suite());
 	srunner_add_suite(runner, test_uniform_allocator_create_suite());
+	srunner_add_suite(runner, test_buddy_allocator_create_suite());
 	srunner_add_suite(runner, test_document_manager_create_suite());
+	srunner_add_suite(runner, test_memory_map_field_create_suite());
+	srunner_add_suite(runner, test_field_column_create_suite());
+	srunner_add_suite(runner, test_field_history_create_suite());
+	srunner_add_suite(runner, test_field_window_create_suite());
+	srunner_add_suite(runner, test_field_journal_create_suite());
 	srunner_add_suite(runner, test_virtual_machine_create_suite());
 	srunner_add_suite(runner, test_linked_list_create_suite());
 	srunner_add_suite(runner, test_fmemopen_create_suite());
 	srunner_add_suite(runner, test_memory_utils_create_suite());
+	srunner_add_suite(runner, test_mpsc_queue_create_suite());
+	srunner_add_suite(runner, test_seqlock_create_suite());
 	srunner_add_suite(runner, test_codegen_symbol_table_create_suite());
 	srunner_add_suite(runner, test_codegen_pcode_create_suite());
 	srunner_add_suite(runner, test_codegen_expression_arithmetics_create_suite());
@@ -79,8 +99,12 @@ int main(void) {
 	srunner_add_suite(runner, test_codegen_task_create_suite());
 	srunner_add_suite(runner, test_compiler_create_suite());
 	srunner_add_suite(runner, test_pcode_manager_create_suite());
+	srunner_add_suite(runner, test_pcode_module_create_suite());
 	srunner_add_suite(runner, test_task_scheduler_create_suite());
 	srunner_add_suite(runner, test_timer_create_suite());
+	srunner_add_suite(runner, test_checkpoint_create_suite());
+	srunner_add_suite(runner, test_bus_create_suite());
+	srunner_add_suite(runner, test_datagram_interface_create_suite());
 
 	srunner_run_all(runner, CK_VERBOSE);
 	number_failed = srunner_ntests_failed(runner);
@@ -0,0 +1,130 @@
+/*
+ * test_buddy_allocator.c
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <string.h>
+#include "test_buddy_allocator.h"
+#include "utils/buddy_allocator.h"
+
+#define STORAGE_SIZE 2048
+#define MIN_BLOCK_SIZE 16
+
+static bx_uint8 storage[STORAGE_SIZE];
+static struct bx_balloc *balloc;
+
+START_TEST (init_test) {
+	ck_assert_ptr_eq(bx_balloc_init((void *) storage, STORAGE_SIZE, 24), NULL);
+	ck_assert_ptr_eq(bx_balloc_init((void *) storage, 16, MIN_BLOCK_SIZE), NULL);
+	balloc = bx_balloc_init((void *) storage, STORAGE_SIZE, MIN_BLOCK_SIZE);
+	ck_assert_ptr_ne(balloc, NULL);
+	ck_assert_int_gt(bx_balloc_remaining_capacity(balloc), STORAGE_SIZE / 2);
+	ck_assert_int_le(bx_balloc_remaining_capacity(balloc), STORAGE_SIZE);
+	ck_assert_int_gt(bx_balloc_largest_block(balloc), 0);
+} END_TEST
+
+START_TEST (allocation_deallocation_test) {
+	bx_size capacity;
+	bx_size largest_block;
+	void *block_pointer;
+
+	capacity = bx_balloc_remaining_capacity(balloc);
+	largest_block = bx_balloc_largest_block(balloc);
+	ck_assert_ptr_eq(bx_balloc_alloc(balloc, 0), NULL);
+	ck_assert_ptr_eq(bx_balloc_alloc(balloc, largest_block + 1), NULL);
+
+	// Sizes are rounded up to a power of two
+	block_pointer = bx_balloc_alloc(balloc, 3 * MIN_BLOCK_SIZE);
+	ck_assert_ptr_ne(block_pointer, NULL);
+	ck_assert_int_eq(bx_balloc_remaining_capacity(balloc), capacity - 4 * MIN_BLOCK_SIZE);
+	ck_assert_int_eq(bx_balloc_free(balloc, block_pointer), 0);
+	ck_assert_int_eq(bx_balloc_free(balloc, block_pointer), -1);
+	ck_assert_int_eq(bx_balloc_free(balloc, (bx_uint8 *) block_pointer + 1), -1);
+
+	// Freed blocks merge back with their buddies
+	ck_assert_int_eq(bx_balloc_remaining_capacity(balloc), capacity);
+	ck_assert_int_eq(bx_balloc_largest_block(balloc), largest_block);
+	block_pointer = bx_balloc_alloc(balloc, largest_block);
+	ck_assert_ptr_ne(block_pointer, NULL);
+	ck_assert_int_eq(bx_balloc_free(balloc, block_pointer), 0);
+} END_TEST
+
+START_TEST (bulk_allocation_test) {
+	void *pointer_array[STORAGE_SIZE / MIN_BLOCK_SIZE];
+	bx_size capacity;
+	bx_size block_number;
+	bx_size i;
+	bx_size j;
+
+	capacity = bx_balloc_remaining_capacity(balloc);
+	block_number = capacity / MIN_BLOCK_SIZE;
+	for (i = 0; i < block_number; i++) {
+		pointer_array[i] = bx_balloc_alloc(balloc, MIN_BLOCK_SIZE);
+		ck_assert_ptr_ne(pointer_array[i], NULL);
+		memset(pointer_array[i], i, MIN_BLOCK_SIZE);
+	}
+	ck_assert_ptr_eq(bx_balloc_alloc(balloc, 1), NULL);
+	ck_assert_int_eq(bx_balloc_remaining_capacity(balloc), 0);
+
+	// Blocks do not overlap and are never moved
+	for (i = 0; i < block_number; i++) {
+		for (j = 0; j < MIN_BLOCK_SIZE; j++) {
+			ck_assert_int_eq(((bx_uint8 *) pointer_array[i])[j], (bx_uint8) i);
+		}
+	}
+
+	// Free in an interleaved order to exercise the merging
+	for (i = 0; i < block_number; i += 2) {
+		ck_assert_int_eq(bx_balloc_free(balloc, pointer_array[i]), 0);
+	}
+	ck_assert_int_eq(bx_balloc_largest_block(balloc), MIN_BLOCK_SIZE);
+	for (i = 1; i < block_number; i += 2) {
+		ck_assert_int_eq(bx_balloc_free(balloc, pointer_array[i]), 0);
+	}
+	ck_assert_int_eq(bx_balloc_remaining_capacity(balloc), capacity);
+} END_TEST
+
+Suite *test_buddy_allocator_create_suite(void) {
+	Suite *suite = suite_create("buddy_allocator");
+	TCase *tcase;
+
+	tcase = tcase_create("init_test");
+	tcase_add_test(tcase, init_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("allocation_deallocation_test");
+	tcase_add_test(tcase, allocation_deallocation_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("bulk_allocation_test");
+	tcase_add_test(tcase, bulk_allocation_test);
+	suite_add_tcase(suite, tcase);
+
+	return suite;
+}
@@ -0,0 +1,147 @@
+/*
+ * test_mpsc_queue.c
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <pthread.h>
+#include "test_mpsc_queue.h"
+#include "types.h"
+#include "utils/mpsc_queue.h"
+
+#define ELEMENT_NUMBER 4
+#define PRODUCER_NUMBER 4
+#define PRODUCER_ELEMENTS 1000
+
+struct test_element {
+	bx_int32 value;
+	struct bx_mpsc_node node;
+};
+
+static struct bx_mpsc_queue queue;
+static struct test_element elements[ELEMENT_NUMBER];
+static struct test_element producer_elements[PRODUCER_NUMBER][PRODUCER_ELEMENTS];
+
+static void *producer_routine(void *arg) {
+	struct test_element *producer_array;
+	int i;
+
+	producer_array = arg;
+	for (i = 0; i < PRODUCER_ELEMENTS; i++) {
+		bx_mpsc_push(&queue, &producer_array[i].node);
+	}
+
+	return NULL;
+}
+
+START_TEST (empty_queue_pop) {
+	bx_mpsc_init(&queue);
+	ck_assert_ptr_eq(bx_mpsc_pop(&queue), NULL);
+} END_TEST
+
+START_TEST (push_pop_fifo) {
+	struct bx_mpsc_node *node;
+	int i;
+
+	bx_mpsc_init(&queue);
+	for (i = 0; i < ELEMENT_NUMBER; i++) {
+		elements[i].value = i;
+		bx_mpsc_push(&queue, &elements[i].node);
+	}
+	for (i = 0; i < ELEMENT_NUMBER; i++) {
+		node = bx_mpsc_pop(&queue);
+		ck_assert_ptr_ne(node, NULL);
+		ck_assert_int_eq(BX_MPSC_ELEMENT(node, struct test_element, node)->value, i);
+	}
+	ck_assert_ptr_eq(bx_mpsc_pop(&queue), NULL);
+
+	// The queue is reusable once emptied
+	bx_mpsc_push(&queue, &elements[0].node);
+	ck_assert_ptr_eq(bx_mpsc_pop(&queue), &elements[0].node);
+	ck_assert_ptr_eq(bx_mpsc_pop(&queue), NULL);
+} END_TEST
+
+START_TEST (concurrent_producers) {
+	pthread_t producers[PRODUCER_NUMBER];
+	bx_int32 last_value[PRODUCER_NUMBER];
+	struct bx_mpsc_node *node;
+	struct test_element *element;
+	int popped;
+	int producer;
+	int i;
+
+	bx_mpsc_init(&queue);
+	for (producer = 0; producer < PRODUCER_NUMBER; producer++) {
+		for (i = 0; i < PRODUCER_ELEMENTS; i++) {
+			producer_elements[producer][i].value = producer * PRODUCER_ELEMENTS + i;
+		}
+		last_value[producer] = -1;
+	}
+	for (producer = 0; producer < PRODUCER_NUMBER; producer++) {
+		ck_assert_int_eq(pthread_create(&producers[producer], NULL,
+				producer_routine, producer_elements[producer]), 0);
+	}
+
+	// Elements pushed by the same producer are popped in order
+	popped = 0;
+	while (popped < PRODUCER_NUMBER * PRODUCER_ELEMENTS) {
+		node = bx_mpsc_pop(&queue);
+		if (node == NULL) {
+			continue;
+		}
+		element = BX_MPSC_ELEMENT(node, struct test_element, node);
+		producer = element->value / PRODUCER_ELEMENTS;
+		ck_assert_int_gt(element->value, last_value[producer]);
+		last_value[producer] = element->value;
+		popped++;
+	}
+
+	for (producer = 0; producer < PRODUCER_NUMBER; producer++) {
+		pthread_join(producers[producer], NULL);
+	}
+	ck_assert_ptr_eq(bx_mpsc_pop(&queue), NULL);
+} END_TEST
+
+Suite *test_mpsc_queue_create_suite(void) {
+	Suite *suite = suite_create("mpsc_queue");
+	TCase *tcase;
+
+	tcase = tcase_create("empty_queue_pop");
+	tcase_add_test(tcase, empty_queue_pop);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("push_pop_fifo");
+	tcase_add_test(tcase, push_pop_fifo);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("concurrent_producers");
+	tcase_add_test(tcase, concurrent_producers);
+	suite_add_tcase(suite, tcase);
+
+	return suite;
+}
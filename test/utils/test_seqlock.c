@@ -0,0 +1,118 @@
+/*
+ * test_seqlock.c
+ * Created on: Oct 19, 2026
+ * Author: Guido Rota
+ *
+ * Copyright (c) 2014, Guido Rota
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, 
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <pthread.h>
+#include "test_seqlock.h"
+#include "atomic.h"
+#include "utils/seqlock.h"
+
+#define WRITER_UPDATES 10000
+
+static bx_uint32 sequence;
+static bx_uint32 first_word;
+static bx_uint32 second_word;
+
+static void *writer_routine(void *arg) {
+	bx_uint32 i;
+
+	for (i = 1; i <= WRITER_UPDATES; i++) {
+		while (bx_seqlock_write_try_begin(&sequence) == BX_BOOLEAN_FALSE) {
+		}
+		BX_ATOMIC_STORE(&first_word, i);
+		BX_ATOMIC_STORE(&second_word, i);
+		bx_seqlock_write_end(&sequence);
+	}
+
+	return NULL;
+}
+
+START_TEST (write_read_test) {
+	bx_uint32 start;
+
+	bx_seqlock_init(&sequence);
+	ck_assert_int_eq(bx_seqlock_version(&sequence), 0);
+
+	// Writers exclude each other and invalidate the reads in progress
+	start = bx_seqlock_read_begin(&sequence);
+	ck_assert_int_eq(bx_seqlock_write_try_begin(&sequence), BX_BOOLEAN_TRUE);
+	ck_assert_int_eq(bx_seqlock_write_try_begin(&sequence), BX_BOOLEAN_FALSE);
+	ck_assert_int_eq(bx_seqlock_read_end(&sequence, bx_seqlock_read_begin(&sequence)), BX_BOOLEAN_FALSE);
+	bx_seqlock_write_end(&sequence);
+	ck_assert_int_eq(bx_seqlock_read_end(&sequence, start), BX_BOOLEAN_FALSE);
+	ck_assert_int_eq(bx_seqlock_version(&sequence), 1);
+
+	start = bx_seqlock_read_begin(&sequence);
+	ck_assert_int_eq(bx_seqlock_read_end(&sequence, start), BX_BOOLEAN_TRUE);
+} END_TEST
+
+START_TEST (concurrent_test) {
+	pthread_t writer;
+	bx_uint32 first;
+	bx_uint32 second;
+	bx_uint32 start;
+	bx_uint32 consistent_reads;
+
+	bx_seqlock_init(&sequence);
+	first_word = 0;
+	second_word = 0;
+	ck_assert_int_eq(pthread_create(&writer, NULL, writer_routine, NULL), 0);
+
+	// Consistent reads never observe a partial update
+	consistent_reads = 0;
+	do {
+		start = bx_seqlock_read_begin(&sequence);
+		first = BX_ATOMIC_LOAD(&first_word);
+		second = BX_ATOMIC_LOAD(&second_word);
+		if (bx_seqlock_read_end(&sequence, start) == BX_BOOLEAN_TRUE) {
+			ck_assert_int_eq(first, second);
+			consistent_reads++;
+		}
+	} while (first != WRITER_UPDATES || second != WRITER_UPDATES);
+
+	ck_assert_int_eq(pthread_join(writer, NULL), 0);
+	ck_assert_int_gt(consistent_reads, 0);
+	ck_assert_int_eq(bx_seqlock_version(&sequence), WRITER_UPDATES);
+} END_TEST
+
+Suite *test_seqlock_create_suite(void) {
+	Suite *suite = suite_create("seqlock");
+	TCase *tcase;
+
+	tcase = tcase_create("write_read_test");
+	tcase_add_test(tcase, write_read_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("concurrent_test");
+	tcase_add_test(tcase, concurrent_test);
+	suite_add_tcase(suite, tcase);
+
+	return suite;
+}
@@ -34,6 +34,7 @@
 
 #define STORAGE_SIZE 2048
 #define CHUNK_SIZE 128
+#define SMALL_CHUNK_SIZE 8
 
 static bx_uint8 storage[STORAGE_SIZE];
 static struct bx_ualloc *ualloc;
@@ -77,6 +78,29 @@ START_TEST (bulk_allocation_test) {
 	}
 } END_TEST
 
+START_TEST (multi_block_allocation_test) {
+	static bx_uint8 small_storage[STORAGE_SIZE];
+	struct bx_ualloc *small_ualloc;
+	void *pointer_array[STORAGE_SIZE / SMALL_CHUNK_SIZE];
+	bx_size capacity;
+	bx_size i;
+	bx_size j;
+
+	// More than 32 chunks span several allocation map blocks
+	small_ualloc = bx_ualloc_init((void *) small_storage, STORAGE_SIZE, SMALL_CHUNK_SIZE);
+	ck_assert_ptr_ne(small_ualloc, NULL);
+	capacity = bx_ualloc_remaining_capacity(small_ualloc);
+	ck_assert_int_gt(capacity, 32);
+	for (i = 0; i < capacity; i++) {
+		pointer_array[i] = bx_ualloc_alloc(small_ualloc);
+		ck_assert_ptr_ne(pointer_array[i], NULL);
+		for (j = 0; j < i; j++) {
+			ck_assert_ptr_ne(pointer_array[i], pointer_array[j]);
+		}
+	}
+	ck_assert_ptr_eq(bx_ualloc_alloc(small_ualloc), NULL);
+} END_TEST
+
 Suite *test_uniform_allocator_create_suite(void) {
 	Suite *suite = suite_create("uniform_allocator");
 	TCase *tcase;
@@ -93,5 +117,9 @@ Suite *test_uniform_allocator_create_suite(void) {
 	tcase_add_test(tcase, bulk_allocation_test);
 	suite_add_tcase(suite, tcase);
 
+	tcase = tcase_create("multi_block_allocation_test");
+	tcase_add_test(tcase, multi_block_allocation_test);
+	suite_add_tcase(suite, tcase);
+
 	return suite;
 }
@@ -32,6 +32,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "types.h"
+#include "configuration.h"
 #include "test_virtual_machine.h"
 #include "utils/byte_buffer.h"
 #include "virtual_machine/virtual_machine.h"
@@ -42,6 +43,7 @@
 #define CODE_BUFFER_LENGTH 128
 #define TEST_FIELD_ID "test_field"
 #define OUTPUT_TEST_FIELD_ID "output_test_field"
+#define PLAIN_FIELD_ID "plain_field"
 
 static struct bx_document_field test_field;
 static struct bx_test_field_data test_field_data;
@@ -49,6 +51,9 @@ static struct bx_test_field_data test_field_data;
 static struct bx_document_field output_test_field;
 static struct bx_test_field_data output_test_field_data;
 
+static struct bx_document_field plain_field;
+static struct bx_field_storage plain_field_value;
+
 static struct bx_byte_buffer *buffer;
 static bx_uint8 buffer_storage[CODE_BUFFER_LENGTH];
 
@@ -70,6 +75,10 @@ START_TEST (test_init) {
 	ck_assert_int_eq(error, 0);
 	error = bx_docman_add_field(&output_test_field, OUTPUT_TEST_FIELD_ID);
 	ck_assert_int_eq(error, 0);
+	error = bx_docman_init_plain_field(&plain_field, BX_INT, &plain_field_value);
+	ck_assert_int_eq(error, 0);
+	error = bx_docman_add_field(&plain_field, PLAIN_FIELD_ID);
+	ck_assert_int_eq(error, 0);
 	buffer = bx_bbuf_init(buffer_storage, CODE_BUFFER_LENGTH);
 } END_TEST
 
@@ -1495,6 +1504,124 @@ START_TEST (test_dup32) {
 	ck_assert_int_eq(bx_tfield_get_float(&output_test_field), value);
 } END_TEST
 
+START_TEST (test_execution_context) {
+	bx_int8 error;
+	bx_int32 value = 37;
+
+	bx_tfield_set_int(&test_field, 0);
+	bx_bbuf_reset(buffer);
+	bx_vmutils_add_instruction(buffer, BX_INSTR_PUSH32);
+	bx_vmutils_add_int(buffer, value);
+	bx_vmutils_add_instruction(buffer, BX_INSTR_RSTORE32);
+	bx_vmutils_add_identifier(buffer, TEST_FIELD_ID);
+
+	code_length = bx_bbuf_size(buffer);
+	bx_bbuf_get(buffer, code, code_length);
+	error = bx_vm_execute_in_context(VM_CONTEXT_NUMBER - 1, code, code_length);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(bx_tfield_get_int(&test_field), value);
+	error = bx_vm_execute_in_context(VM_CONTEXT_NUMBER, code, code_length);
+	ck_assert_int_eq(error, -1);
+} END_TEST
+
+START_TEST (validate_test) {
+	bx_int8 error;
+	bx_uint8 halt_program[] = { BX_INSTR_IPUSH_1, BX_INSTR_HALT };
+	bx_uint8 jump_program[] = { BX_INSTR_JUMP, 0x00, 0x03, BX_INSTR_HALT };
+	bx_uint8 bad_jump_program[] = { BX_INSTR_JUMP, 0x00, 0x02, BX_INSTR_HALT };
+	bx_uint8 bad_opcode_program[] = { 0xFF };
+	bx_uint8 next_opcode_program[] = { BX_INSTR_LAST + 1 };
+	bx_uint8 truncated_program[] = { BX_INSTR_PUSH32, 0x00, 0x01 };
+
+	// New instructions never renumber the existing ones
+	ck_assert_int_eq(BX_INSTR_HALT, BX_INSTR_F2I + 1);
+	ck_assert_int_gt(BX_INSTR_WLOAD32, BX_INSTR_HALT);
+
+	error = bx_vm_validate(halt_program, sizeof halt_program);
+	ck_assert_int_eq(error, 0);
+	error = bx_vm_validate(jump_program, sizeof jump_program);
+	ck_assert_int_eq(error, 0);
+	error = bx_vm_validate(bad_jump_program, sizeof bad_jump_program);
+	ck_assert_int_eq(error, -1);
+	error = bx_vm_validate(bad_opcode_program, sizeof bad_opcode_program);
+	ck_assert_int_eq(error, -1);
+	error = bx_vm_validate(next_opcode_program, sizeof next_opcode_program);
+	ck_assert_int_eq(error, -1);
+	error = bx_vm_validate(truncated_program, sizeof truncated_program);
+	ck_assert_int_eq(error, -1);
+	error = bx_vm_validate(NULL, 0);
+	ck_assert_int_eq(error, -1);
+} END_TEST
+
+START_TEST (plain_field_test) {
+	bx_int8 error;
+	bx_int32 value = 31;
+
+	// Plain fields are loaded and stored in place
+	plain_field_value.value = value;
+	bx_tfield_set_int(&test_field, 0);
+	bx_bbuf_reset(buffer);
+	bx_vmutils_add_instruction(buffer, BX_INSTR_RLOAD32);
+	bx_vmutils_add_identifier(buffer, PLAIN_FIELD_ID);
+	bx_vmutils_add_instruction(buffer, BX_INSTR_DUP32);
+	bx_vmutils_add_instruction(buffer, BX_INSTR_IADD);
+	bx_vmutils_add_instruction(buffer, BX_INSTR_DUP32);
+	bx_vmutils_add_instruction(buffer, BX_INSTR_RSTORE32);
+	bx_vmutils_add_identifier(buffer, PLAIN_FIELD_ID);
+	bx_vmutils_add_instruction(buffer, BX_INSTR_RSTORE32);
+	bx_vmutils_add_identifier(buffer, TEST_FIELD_ID);
+
+	code_length = bx_bbuf_size(buffer);
+	bx_bbuf_get(buffer, code, code_length);
+	error = bx_vm_execute(code, code_length);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(plain_field_value.value, value * 2);
+	ck_assert_int_eq(bx_tfield_get_int(&test_field), value * 2);
+} END_TEST
+
+START_TEST (window_test) {
+	static struct bx_window_entry entries[4];
+	static struct bx_field_window window;
+	bx_int8 error;
+
+	// Window aggregates are loaded by field and aggregate
+	bx_window_init(&window, BX_INT, BX_WINDOW_SLIDING, 4, 0, entries);
+	error = bx_docman_attach_window(PLAIN_FIELD_ID, &window);
+	ck_assert_int_eq(error, 0);
+	bx_docman_write_storage(&plain_field_value, 3);
+	bx_docman_write_storage(&plain_field_value, 11);
+	bx_docman_write_storage(&plain_field_value, 7);
+	bx_bbuf_reset(buffer);
+	bx_vmutils_add_instruction(buffer, BX_INSTR_WLOAD32);
+	bx_vmutils_add_identifier(buffer, PLAIN_FIELD_ID);
+	bx_vmutils_add_byte(buffer, BX_AGGREGATE_MAX);
+	bx_vmutils_add_instruction(buffer, BX_INSTR_WLOAD32);
+	bx_vmutils_add_identifier(buffer, PLAIN_FIELD_ID);
+	bx_vmutils_add_byte(buffer, BX_AGGREGATE_COUNT);
+	bx_vmutils_add_instruction(buffer, BX_INSTR_IADD);
+	bx_vmutils_add_instruction(buffer, BX_INSTR_RSTORE32);
+	bx_vmutils_add_identifier(buffer, TEST_FIELD_ID);
+
+	code_length = bx_bbuf_size(buffer);
+	bx_bbuf_get(buffer, code, code_length);
+	ck_assert_int_eq(bx_vm_validate(code, code_length), 0);
+	error = bx_vm_execute(code, code_length);
+	ck_assert_int_eq(error, 0);
+	ck_assert_int_eq(bx_tfield_get_int(&test_field), 14);
+
+	// Invalid aggregates are rejected, fields without window fail
+	code[DM_FIELD_IDENTIFIER_LENGTH + 1] = BX_AGGREGATE_NUMBER;
+	ck_assert_int_eq(bx_vm_validate(code, code_length), -1);
+	bx_bbuf_reset(buffer);
+	bx_vmutils_add_instruction(buffer, BX_INSTR_WLOAD32);
+	bx_vmutils_add_identifier(buffer, TEST_FIELD_ID);
+	bx_vmutils_add_byte(buffer, BX_AGGREGATE_COUNT);
+	code_length = bx_bbuf_size(buffer);
+	bx_bbuf_get(buffer, code, code_length);
+	error = bx_vm_execute(code, code_length);
+	ck_assert_int_eq(error, -1);
+} END_TEST
+
 Suite *test_virtual_machine_create_suite() {
 	Suite *suite = suite_create("virtual_machine");
 	TCase *tcase;
@@ -1603,5 +1730,21 @@ Suite *test_virtual_machine_create_suite() {
 	tcase_add_test(tcase, test_dup32);
 	suite_add_tcase(suite, tcase);
 
+	tcase = tcase_create("test_execution_context");
+	tcase_add_test(tcase, test_execution_context);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("plain_field_test");
+	tcase_add_test(tcase, plain_field_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("window_test");
+	tcase_add_test(tcase, window_test);
+	suite_add_tcase(suite, tcase);
+
+	tcase = tcase_create("validate_test");
+	tcase_add_test(tcase, validate_test);
+	suite_add_tcase(suite, tcase);
+
 	return suite;
 }